@@ -210,4 +210,31 @@ int cfs_crypto_hash_final(struct cfs_crypto_hash_desc *desc,
 int cfs_crypto_register(void);
 void cfs_crypto_unregister(void);
 int cfs_crypto_hash_speed(enum cfs_crypto_hash_alg hash_alg);
+int cfs_crypto_hash_speed_nowait(enum cfs_crypto_hash_alg hash_alg);
+
+/* Amount of data processed by one run of a speed test */
+#define CFS_CRYPTO_SPEED_TEST_SIZE	(1U << 20)
+
+/**
+ * Speed test of an algorithm which is not a hash, e.g. a cipher or a
+ * compressor, registered with cfs_crypto_speed_register().
+ */
+struct cfs_crypto_speed_test {
+	struct list_head	cst_list;
+	/** algorithm name, in the crypto_speeds file and module parameter */
+	const char	       *cst_name;
+	/** process CFS_CRYPTO_SPEED_TEST_SIZE bytes once, 0 or -errno */
+	int		      (*cst_run)(void *data);
+	/** optional, allocate the buffers of cst_run, 0 or -errno */
+	int		      (*cst_setup)(void *data);
+	/** optional, free the buffers after a successful cst_setup */
+	void		      (*cst_cleanup)(void *data);
+	void		       *cst_data;
+	/** speed in MB/s, 0 if not measured yet, or negative errno */
+	int			cst_speed;
+};
+
+void cfs_crypto_speed_register(struct cfs_crypto_speed_test *cst);
+void cfs_crypto_speed_unregister(struct cfs_crypto_speed_test *cst);
+int cfs_crypto_speeds_print(char *buf, int len);
 #endif
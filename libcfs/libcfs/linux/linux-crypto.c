@@ -29,6 +29,11 @@
 
 #include <crypto/hash.h>
 #include <linux/scatterlist.h>
+#include <linux/utsname.h>
+#include <linux/workqueue.h>
+#ifdef CONFIG_X86
+#include <asm/processor.h>
+#endif
 #include <libcfs/libcfs.h>
 #include <libcfs/libcfs_crypto.h>
 #include <libcfs/linux/linux-crypto.h>
@@ -50,6 +55,19 @@ static inline const char *crypto_ahash_driver_name(struct crypto_ahash *tfm)
  */
 static int cfs_crypto_hash_speeds[CFS_HASH_ALG_MAX];
 
+/* registered speed tests of other algorithms */
+static LIST_HEAD(cfs_crypto_speed_tests);
+/* serializes the speed tests, protects cfs_crypto_speed_tests */
+static DEFINE_MUTEX(cfs_crypto_speed_mutex);
+
+/* CPU model of this node, selects the cached speeds to use */
+static char cfs_crypto_cpu[32];
+
+static char *crypto_speeds;
+module_param(crypto_speeds, charp, 0444);
+MODULE_PARM_DESC(crypto_speeds,
+		 "algorithm speeds as printed in crypto_speeds, ';' between CPU models");
+
 /**
  * Initialize the state descriptor for the specified hash algorithm.
  *
@@ -304,90 +322,175 @@ free:
 EXPORT_SYMBOL(cfs_crypto_hash_final);
 
 /**
- * Compute the speed of specified hash function
+ * Find a speed in the crypto_speeds module parameter
  *
- * Run a speed test on the given hash algorithm on buffer using a 1MB buffer
- * size.  This is a reasonable buffer size for Lustre RPCs, even if the actual
- * RPC size is larger or smaller.
+ * Only the section of the parameter for the CPU model of this node, i.e.
+ * the one starting with cfs_crypto_cpu, is used.
  *
- * The speed is stored internally in the cfs_crypto_hash_speeds[] array, and
- * is available through the cfs_crypto_hash_speed() function.
+ * \param[in] name	algorithm name
  *
- * \param[in] hash_alg	hash algorithm id (CFS_HASH_ALG_*)
- * \param[in] buf	data buffer on which to compute the hash
- * \param[in] buf_len	length of \buf on which to compute hash
+ * \retval		speed of \a name in MB/s
+ * \retval		0 if it is unknown
  */
-static void cfs_crypto_performance_test(enum cfs_crypto_hash_alg hash_alg)
+static int cfs_crypto_cached_speed(const char *name)
 {
-	int			buf_len = max(PAGE_SIZE, 1048576UL);
-	void			*buf;
-	unsigned long		start, end;
-	int			err = 0;
-	unsigned long		bcount;
-	struct page		*page;
-	unsigned char		hash[CFS_CRYPTO_HASH_DIGESTSIZE_MAX];
-	unsigned int		hash_len = sizeof(hash);
-
-	page = alloc_page(GFP_KERNEL);
-	if (page == NULL) {
-		err = -ENOMEM;
-		goto out_err;
+	const char	*sect = crypto_speeds;
+	int		 cpulen = strlen(cfs_crypto_cpu);
+	int		 namelen = strlen(name);
+
+	while (sect != NULL && *sect != '\0') {
+		const char *end = strchrnul(sect, ';');
+		const char *p = sect + cpulen;
+
+		if (end - sect <= cpulen ||
+		    strncmp(sect, cfs_crypto_cpu, cpulen) != 0 || *p != ',')
+			p = end;
+
+		/* p is on the ',' before each "name=speed" */
+		while (p < end) {
+			const char *next;
+			char num[12];
+			int speed;
+			int len;
+
+			p++;
+			next = p + strcspn(p, ",;");
+			len = next - p - namelen - 1;
+			if (len <= 0 || strncmp(p, name, namelen) != 0 ||
+			    p[namelen] != '=') {
+				p = next;
+				continue;
+			}
+
+			if (len >= sizeof(num))
+				return 0;
+			memcpy(num, p + namelen + 1, len);
+			num[len] = '\0';
+			if (kstrtoint(num, 10, &speed) != 0 || speed <= 0)
+				return 0;
+			return speed;
+		}
+
+		if (*end == '\0')
+			break;
+		sect = end + 1;
 	}
 
-	buf = kmap(page);
-	memset(buf, 0xAD, PAGE_SIZE);
-	kunmap(page);
+	return 0;
+}
+
+/**
+ * Time repeated runs of a speed test
+ *
+ * Call \a run on \a data for a quarter of a second, each call processing
+ * CFS_CRYPTO_SPEED_TEST_SIZE bytes.
+ *
+ * \param[in] run	function running the test once
+ * \param[in] data	argument of \a run
+ *
+ * \retval		speed in MB/s
+ * \retval		negative errno returned by \a run
+ */
+static int cfs_crypto_time_test(int (*run)(void *data), void *data)
+{
+	unsigned long	start, end;
+	unsigned long	bcount;
+	int		err = 0;
 
 	for (start = jiffies, end = start + msecs_to_jiffies(MSEC_PER_SEC / 4),
 	     bcount = 0; time_before(jiffies, end) && err == 0; bcount++) {
-		struct cfs_crypto_hash_desc *hdesc;
-		int i;
+		err = run(data);
+		cond_resched();
+	}
+	end = jiffies;
+	if (err != 0)
+		return err;
 
-		hdesc = cfs_crypto_hash_init(hash_alg, NULL, 0);
-		if (IS_ERR(hdesc)) {
-			err = PTR_ERR(hdesc);
-			break;
-		}
+	return ((bcount * CFS_CRYPTO_SPEED_TEST_SIZE /
+		 jiffies_to_msecs(end - start)) * 1000) / (1024 * 1024);
+}
 
-		for (i = 0; i < buf_len / PAGE_SIZE; i++) {
-			err = cfs_crypto_hash_update_page(hdesc, page, 0,
-							  PAGE_SIZE);
-			if (err != 0)
-				break;
-		}
+struct cfs_crypto_hash_test {
+	enum cfs_crypto_hash_alg	 chtt_alg;
+	struct page			*chtt_page;
+};
 
-		err = cfs_crypto_hash_final(hdesc, hash, &hash_len);
+static int cfs_crypto_hash_test_run(void *data)
+{
+	struct cfs_crypto_hash_test	*test = data;
+	struct cfs_crypto_hash_desc	*hdesc;
+	unsigned char			 hash[CFS_CRYPTO_HASH_DIGESTSIZE_MAX];
+	unsigned int			 hash_len = sizeof(hash);
+	int				 err = 0;
+	int				 rc;
+	int				 i;
+
+	hdesc = cfs_crypto_hash_init(test->chtt_alg, NULL, 0);
+	if (IS_ERR(hdesc))
+		return PTR_ERR(hdesc);
+
+	for (i = 0; i < CFS_CRYPTO_SPEED_TEST_SIZE / PAGE_SIZE; i++) {
+		err = cfs_crypto_hash_update_page(hdesc, test->chtt_page, 0,
+						  PAGE_SIZE);
 		if (err != 0)
 			break;
 	}
-	end = jiffies;
-	__free_page(page);
-out_err:
-	if (err != 0) {
-		cfs_crypto_hash_speeds[hash_alg] = err;
-		CDEBUG(D_INFO, "Crypto hash algorithm %s test error: rc = %d\n",
-		       cfs_crypto_hash_name(hash_alg), err);
+
+	/* always release the descriptor */
+	rc = cfs_crypto_hash_final(hdesc, hash, &hash_len);
+
+	return err != 0 ? err : rc;
+}
+
+/**
+ * Compute the speed of specified hash function
+ *
+ * Run a speed test on the given hash algorithm on buffer using a 1MB buffer
+ * size.  This is a reasonable buffer size for Lustre RPCs, even if the actual
+ * RPC size is larger or smaller.
+ *
+ * The speed is stored internally in the cfs_crypto_hash_speeds[] array, and
+ * is available through the cfs_crypto_hash_speed() function.
+ *
+ * \param[in] hash_alg	hash algorithm id (CFS_HASH_ALG_*)
+ */
+static void cfs_crypto_performance_test(enum cfs_crypto_hash_alg hash_alg)
+{
+	struct cfs_crypto_hash_test	test = { .chtt_alg = hash_alg };
+	void				*buf;
+	int				err;
+
+	test.chtt_page = alloc_page(GFP_KERNEL);
+	if (test.chtt_page == NULL) {
+		err = -ENOMEM;
 	} else {
-		unsigned long   tmp;
+		buf = kmap(test.chtt_page);
+		memset(buf, 0xAD, PAGE_SIZE);
+		kunmap(test.chtt_page);
 
-		tmp = ((bcount * buf_len / jiffies_to_msecs(end - start)) *
-		       1000) / (1024 * 1024);
-		cfs_crypto_hash_speeds[hash_alg] = (int)tmp;
-		CDEBUG(D_CONFIG, "Crypto hash algorithm %s speed = %d MB/s\n",
-		       cfs_crypto_hash_name(hash_alg),
-		       cfs_crypto_hash_speeds[hash_alg]);
+		err = cfs_crypto_time_test(cfs_crypto_hash_test_run, &test);
+		__free_page(test.chtt_page);
 	}
+
+	cfs_crypto_hash_speeds[hash_alg] = err;
+	if (err < 0)
+		CDEBUG(D_INFO, "Crypto hash algorithm %s test error: rc = %d\n",
+		       cfs_crypto_hash_name(hash_alg), err);
+	else
+		CDEBUG(D_CONFIG, "Crypto hash algorithm %s speed = %d MB/s\n",
+		       cfs_crypto_hash_name(hash_alg), err);
 }
 
 /**
  * hash speed in Mbytes per second for valid hash algorithm
  *
  * Return the performance of the specified \a hash_alg that was
- * computed using cfs_crypto_performance_test().  If the performance
- * has not yet been computed, do that when it is first requested.
- * That avoids computing the speed when it is not actually needed.
- * To avoid competing threads computing the checksum speed at the
- * same time, only compute a single checksum speed at one time.
+ * computed using cfs_crypto_performance_test(), or given in the
+ * crypto_speeds module parameter.  If the performance has not yet been
+ * computed, do that when it is first requested.  That avoids computing
+ * the speed when it is not actually needed.  To avoid competing threads
+ * computing the checksum speed at the same time, or with the background
+ * tests, only compute a single speed at one time.
  *
  * \param[in] hash_alg	hash algorithm id (CFS_HASH_ALG_*)
  *
@@ -399,12 +502,10 @@ int cfs_crypto_hash_speed(enum cfs_crypto_hash_alg hash_alg)
 {
 	if (hash_alg < CFS_HASH_ALG_MAX) {
 		if (unlikely(cfs_crypto_hash_speeds[hash_alg] == 0)) {
-			static DEFINE_MUTEX(crypto_hash_speed_mutex);
-
-			mutex_lock(&crypto_hash_speed_mutex);
+			mutex_lock(&cfs_crypto_speed_mutex);
 			if (cfs_crypto_hash_speeds[hash_alg] == 0)
 				cfs_crypto_performance_test(hash_alg);
-			mutex_unlock(&crypto_hash_speed_mutex);
+			mutex_unlock(&cfs_crypto_speed_mutex);
 		}
 		return cfs_crypto_hash_speeds[hash_alg];
 	}
@@ -414,33 +515,161 @@ int cfs_crypto_hash_speed(enum cfs_crypto_hash_alg hash_alg)
 EXPORT_SYMBOL(cfs_crypto_hash_speed);
 
 /**
- * Run the performance test for all hash algorithms.
+ * Hash speed in Mbytes per second if it is already known
+ *
+ * Unlike cfs_crypto_hash_speed(), never waits for cfs_crypto_speed_mutex,
+ * which the background tests hold for seconds, so this can be used for
+ * every RPC.
  *
- * Run the cfs_crypto_performance_test() benchmark for some of the available
- * hash functions at module load time.  This can't be reliably done at runtime
- * since the CPUs may be under load from thousands of connecting clients when
- * the first client connects and the checksum speeds are needed.
+ * \param[in] hash_alg	hash algorithm id (CFS_HASH_ALG_*)
+ *
+ * \retval		positive speed of the hash function in MB/s
+ * \retval		0 if the speed of \a hash_alg is not known yet
+ * \retval		-ENOENT if \a hash_alg is unsupported
+ * \retval		negative errno if \a hash_alg speed is unavailable
+ */
+int cfs_crypto_hash_speed_nowait(enum cfs_crypto_hash_alg hash_alg)
+{
+	if (hash_alg < CFS_HASH_ALG_MAX)
+		return ACCESS_ONCE(cfs_crypto_hash_speeds[hash_alg]);
+
+	return -ENOENT;
+}
+EXPORT_SYMBOL(cfs_crypto_hash_speed_nowait);
+
+/* Measure \a cst, its buffers only exist for the time of the measurement */
+static void cfs_crypto_speed_test(struct cfs_crypto_speed_test *cst)
+{
+	int rc = 0;
+
+	if (cst->cst_setup != NULL)
+		rc = cst->cst_setup(cst->cst_data);
+	if (rc == 0) {
+		cst->cst_speed = cfs_crypto_time_test(cst->cst_run,
+						      cst->cst_data);
+		if (cst->cst_cleanup != NULL)
+			cst->cst_cleanup(cst->cst_data);
+	} else {
+		cst->cst_speed = rc;
+	}
+
+	if (cst->cst_speed < 0)
+		CDEBUG(D_INFO, "Crypto algorithm %s test error: rc = %d\n",
+		       cst->cst_name, cst->cst_speed);
+	else
+		CDEBUG(D_CONFIG, "Crypto algorithm %s speed = %d MB/s\n",
+		       cst->cst_name, cst->cst_speed);
+}
+
+/**
+ * Measure the speeds still unknown
+ *
+ * The speeds of the checksums are needed as soon as the first client
+ * connects, when the CPUs may be under load from thousands of connecting
+ * clients, so they are measured in the background right after the module
+ * is loaded rather than when first requested.  Blocking module load for the
+ * tests, a quarter of a second for each algorithm, would delay every boot
+ * and mount of diskless nodes.
  *
  * Since the setup cost and computation speed of various hash algorithms is
  * a function of the buffer size (and possibly internal contention of offload
  * engines), this speed only represents an estimate of the actual speed under
  * actual usage, but is reasonable for comparing available algorithms.
+ */
+static void cfs_crypto_speed_work_fn(struct work_struct *work)
+{
+	struct cfs_crypto_speed_test	*cst;
+	enum cfs_crypto_hash_alg	 hash_alg;
+
+	for (hash_alg = 1; hash_alg < CFS_HASH_ALG_SPEED_MAX; hash_alg++)
+		cfs_crypto_hash_speed(hash_alg);
+
+	mutex_lock(&cfs_crypto_speed_mutex);
+	list_for_each_entry(cst, &cfs_crypto_speed_tests, cst_list)
+		if (cst->cst_speed == 0)
+			cfs_crypto_speed_test(cst);
+	mutex_unlock(&cfs_crypto_speed_mutex);
+}
+
+static DECLARE_WORK(cfs_crypto_speed_work, cfs_crypto_speed_work_fn);
+
+/**
+ * Register the speed test of an algorithm which is not a hash
  *
- * The actual speeds are available via cfs_crypto_hash_speed() for later
- * comparison.
+ * The speed of \a cst is taken from the crypto_speeds module parameter if
+ * it is known for this CPU model, otherwise it is measured once in the
+ * background.
  *
- * \retval		0 on success
- * \retval		-ENOMEM if no memory is available for test buffer
+ * \param[in] cst	speed test, with cst_name, cst_run and cst_data set
  */
-static int cfs_crypto_test_hashes(void)
+void cfs_crypto_speed_register(struct cfs_crypto_speed_test *cst)
 {
-	enum cfs_crypto_hash_alg hash_alg;
+	cst->cst_speed = cfs_crypto_cached_speed(cst->cst_name);
 
-	for (hash_alg = 1; hash_alg < CFS_HASH_ALG_SPEED_MAX; hash_alg++)
-		cfs_crypto_performance_test(hash_alg);
+	mutex_lock(&cfs_crypto_speed_mutex);
+	list_add_tail(&cst->cst_list, &cfs_crypto_speed_tests);
+	mutex_unlock(&cfs_crypto_speed_mutex);
 
-	return 0;
+	if (cst->cst_speed == 0)
+		queue_work(system_long_wq, &cfs_crypto_speed_work);
+}
+EXPORT_SYMBOL(cfs_crypto_speed_register);
+
+/**
+ * Unregister a speed test, waiting for it to complete if it is running
+ */
+void cfs_crypto_speed_unregister(struct cfs_crypto_speed_test *cst)
+{
+	mutex_lock(&cfs_crypto_speed_mutex);
+	list_del_init(&cst->cst_list);
+	mutex_unlock(&cfs_crypto_speed_mutex);
 }
+EXPORT_SYMBOL(cfs_crypto_speed_unregister);
+
+/**
+ * Print the speeds measured on this node
+ *
+ * The output is in the format of the crypto_speeds module parameter, so it
+ * can be saved and given back to the module on the nodes with the same CPU
+ * model, e.g. diskless clients, to avoid measuring the speeds again.  Only
+ * the speeds already measured are printed.
+ *
+ * \retval		length of the string in \a buf
+ * \retval		-EFBIG if \a buf is too small
+ */
+int cfs_crypto_speeds_print(char *buf, int len)
+{
+	struct cfs_crypto_speed_test	*cst;
+	enum cfs_crypto_hash_alg	 hash_alg;
+	int				 rc;
+
+	rc = snprintf(buf, len, "%s", cfs_crypto_cpu);
+	for (hash_alg = 1; hash_alg < CFS_HASH_ALG_MAX && rc < len;
+	     hash_alg++) {
+		if (cfs_crypto_hash_speeds[hash_alg] <= 0)
+			continue;
+		rc += snprintf(buf + rc, len - rc, ",%s=%d",
+			       cfs_crypto_hash_name(hash_alg),
+			       cfs_crypto_hash_speeds[hash_alg]);
+	}
+
+	mutex_lock(&cfs_crypto_speed_mutex);
+	list_for_each_entry(cst, &cfs_crypto_speed_tests, cst_list) {
+		if (rc >= len)
+			break;
+		if (cst->cst_speed <= 0)
+			continue;
+		rc += snprintf(buf + rc, len - rc, ",%s=%d",
+			       cst->cst_name, cst->cst_speed);
+	}
+	mutex_unlock(&cfs_crypto_speed_mutex);
+
+	if (rc < len)
+		rc += snprintf(buf + rc, len - rc, "\n");
+
+	return rc < len ? rc : -EFBIG;
+}
+EXPORT_SYMBOL(cfs_crypto_speeds_print);
 
 static int adler32;
 
@@ -463,6 +692,9 @@ static int crc32c_pclmul;
  */
 int cfs_crypto_register(void)
 {
+	enum cfs_crypto_hash_alg hash_alg;
+	bool untested = false;
+
 	request_module("crc32c");
 
 	adler32 = cfs_crypto_adler32_register();
@@ -479,8 +711,24 @@ int cfs_crypto_register(void)
 #endif
 #endif /* HAVE_PCLMULQDQ */
 
-	/* check all algorithms and do performance test */
-	cfs_crypto_test_hashes();
+#ifdef CONFIG_X86
+	snprintf(cfs_crypto_cpu, sizeof(cfs_crypto_cpu), "x86-%u-%u-%u",
+		 boot_cpu_data.x86_vendor, boot_cpu_data.x86,
+		 boot_cpu_data.x86_model);
+#else
+	snprintf(cfs_crypto_cpu, sizeof(cfs_crypto_cpu), "%s",
+		 utsname()->machine);
+#endif
+
+	/* use the speeds cached for this CPU model, test the others later */
+	for (hash_alg = 1; hash_alg < CFS_HASH_ALG_SPEED_MAX; hash_alg++) {
+		cfs_crypto_hash_speeds[hash_alg] =
+			cfs_crypto_cached_speed(cfs_crypto_hash_name(hash_alg));
+		if (cfs_crypto_hash_speeds[hash_alg] == 0)
+			untested = true;
+	}
+	if (untested)
+		queue_work(system_long_wq, &cfs_crypto_speed_work);
 
 	return 0;
 }
@@ -490,6 +738,8 @@ int cfs_crypto_register(void)
  */
 void cfs_crypto_unregister(void)
 {
+	cancel_work_sync(&cfs_crypto_speed_work);
+
 	if (adler32 == 0)
 		cfs_crypto_adler32_unregister();
 
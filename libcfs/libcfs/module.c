@@ -380,6 +380,42 @@ static int proc_cpt_distance(struct ctl_table *table, int write,
 				     __proc_cpt_distance);
 }
 
+static int __proc_crypto_speeds(void *data, int write,
+				loff_t pos, void __user *buffer, int nob)
+{
+	char *buf;
+	int   len = 4096;
+	int   rc;
+
+	if (write)
+		return -EPERM;
+
+	LIBCFS_ALLOC(buf, len);
+	if (buf == NULL)
+		return -ENOMEM;
+
+	rc = cfs_crypto_speeds_print(buf, len);
+	if (rc < 0)
+		goto out;
+
+	if (pos >= rc) {
+		rc = 0;
+		goto out;
+	}
+
+	rc = cfs_trace_copyout_string(buffer, nob, buf + pos, NULL);
+out:
+	LIBCFS_FREE(buf, len);
+	return rc;
+}
+
+static int proc_crypto_speeds(struct ctl_table *table, int write,
+			      void __user *buffer, size_t *lenp, loff_t *ppos)
+{
+	return lprocfs_call_handler(table->data, write, ppos, buffer, lenp,
+				    __proc_crypto_speeds);
+}
+
 static struct ctl_table lnet_table[] = {
 	{
 		INIT_CTL_NAME
@@ -419,6 +455,13 @@ static struct ctl_table lnet_table[] = {
 		.mode		= 0444,
 		.proc_handler	= &proc_cpt_distance,
 	},
+	{
+		INIT_CTL_NAME
+		.procname	= "crypto_speeds",
+		.maxlen		= 128,
+		.mode		= 0444,
+		.proc_handler	= &proc_crypto_speeds,
+	},
 	{
 		INIT_CTL_NAME
 		.procname	= "debug_log_upcall",
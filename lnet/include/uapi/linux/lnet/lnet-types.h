@@ -475,6 +475,9 @@ struct lnet_md {
 	 *   struct iovec.
 	 * - LNET_MD_MAX_SIZE: The max_size field is valid.
 	 * - LNET_MD_BULK_HANDLE: The bulk_handle field is valid.
+	 * - LNET_MD_SKIP_OVERSIZE: An incoming PUT larger than the memory
+	 *   descriptor accepts does not match it, and is offered to the next
+	 *   memory descriptor instead of being dropped.
 	 *
 	 * Note:
 	 * - LNET_MD_KIOV or LNET_MD_IOVEC allows for a scatter/gather
@@ -539,6 +542,8 @@ struct lnet_md {
 #define LNET_MD_KIOV		     (1 << 8)
 /** See struct lnet_md::options. */
 #define LNET_MD_BULK_HANDLE	     (1 << 9)
+/** See struct lnet_md::options. */
+#define LNET_MD_SKIP_OVERSIZE	     (1 << 10)
 
 /* For compatibility with Cray Portals */
 #define LNET_MD_PHYS			     0
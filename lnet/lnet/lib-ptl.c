@@ -183,6 +183,10 @@ lnet_try_match_md(struct lnet_libmd *md,
 	if (info->mi_rlength <= mlength) {	/* fits in allowed space */
 		mlength = info->mi_rlength;
 	} else if ((md->md_options & LNET_MD_TRUNCATE) == 0) {
+		/* leave it to a MD with more room */
+		if ((md->md_options & LNET_MD_SKIP_OVERSIZE) != 0)
+			return LNET_MATCHMD_NONE;
+
 		/* this packet _really_ is too big */
 		CERROR("Matching packet from %s, match %llu"
 		       " length %d too big: %d left, %d allowed\n",
@@ -300,6 +300,43 @@ crypto_hash, [
 ])
 ]) # LC_HAVE_CRYPTO_HASH
 
+#
+# LC_HAVE_AEAD_REQUEST_SET_AD
+#
+# Since 4.2 kernel the AEAD associated data is passed in the
+# scatterlists of the request and its length set by
+# aead_request_set_ad(), needed by the SK AES-256-GCM bulk mode.
+#
+AC_DEFUN([LC_HAVE_AEAD_REQUEST_SET_AD], [
+LB_CHECK_COMPILE([if 'aead_request_set_ad' exists],
+aead_request_set_ad, [
+	#include <crypto/aead.h>
+],[
+	aead_request_set_ad(NULL, 0);
+],[
+	AC_DEFINE(HAVE_AEAD_REQUEST_SET_AD, 1,
+		[aead_request_set_ad() exists])
+])
+]) # LC_HAVE_AEAD_REQUEST_SET_AD
+
+#
+# LC_HAVE_CRYPTO_SKCIPHER
+#
+# Since 4.3 kernel the synchronous block ciphers are accessed through the
+# skcipher API, blkcipher is deprecated and was removed in 4.19.
+#
+AC_DEFUN([LC_HAVE_CRYPTO_SKCIPHER], [
+LB_CHECK_COMPILE([if 'crypto_alloc_skcipher' exists],
+crypto_alloc_skcipher, [
+	#include <crypto/skcipher.h>
+],[
+	crypto_alloc_skcipher(NULL, 0, 0);
+],[
+	AC_DEFINE(HAVE_CRYPTO_SKCIPHER, 1,
+		[crypto_alloc_skcipher() exists])
+])
+]) # LC_HAVE_CRYPTO_SKCIPHER
+
 #
 # LC_CONFIG_GSS (default 'auto' (tests for dependencies, if found, enables))
 #
@@ -316,6 +353,8 @@ AC_MSG_RESULT([$enable_gss])
 AS_IF([test "x$enable_gss" != xno], [
 	LC_CONFIG_GSS_KEYRING
 	LC_HAVE_CRYPTO_HASH
+	LC_HAVE_AEAD_REQUEST_SET_AD
+	LC_HAVE_CRYPTO_SKCIPHER
 	LC_HAVE_CRED_TGCRED
 	LC_KEY_TYPE_INSTANTIATE_2ARGS
 	sunrpc_required=$enable_gss
@@ -411,6 +411,15 @@ struct cl_object_operations {
 	 * Get maximum size of the object.
 	 */
 	loff_t (*coo_maxbytes)(struct cl_object *obj);
+	/**
+	 * Check whether the size of the object is protected by granted DLM
+	 * locks cached on this client, i.e. no other client can change it
+	 * without a lock callback.
+	 *
+	 * \retval 1 the cached size is authoritative
+	 * \retval 0 a glimpse or lock enqueue is needed to know the size
+	 */
+	int (*coo_size_locked)(const struct lu_env *env, struct cl_object *obj);
 	/**
 	 * Set request attributes.
 	 */
@@ -2107,6 +2116,7 @@ int cl_object_fiemap(const struct lu_env *env, struct cl_object *obj,
 int cl_object_layout_get(const struct lu_env *env, struct cl_object *obj,
 			 struct cl_layout *cl);
 loff_t cl_object_maxbytes(struct cl_object *obj);
+int cl_object_size_locked(const struct lu_env *env, struct cl_object *obj);
 
 /**
  * Returns true, iff \a o0 and \a o1 are slices of the same object.
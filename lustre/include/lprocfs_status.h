@@ -331,6 +331,8 @@ enum {
         PTLRPC_REQACTIVE_CNTR,
         PTLRPC_TIMEOUT,
         PTLRPC_REQBUF_AVAIL_CNTR,
+	PTLRPC_REPBATCH_CNTR,
+	PTLRPC_REQHPWAIT_CNTR,
         PTLRPC_LAST_CNTR
 };
 
@@ -266,6 +266,8 @@ struct tgt_session_info {
 	 */
 	int			 tsi_reply_fail_id;
 	bool			 tsi_preprocessed;
+	/* grant of a multi-object write was claimed with its first object */
+	bool			 tsi_grant_claimed;
 	/* request JobID */
 	char                    *tsi_jobid;
 
@@ -296,6 +298,11 @@ static inline void tgt_vbr_obj_set(const struct lu_env *env,
 	}
 }
 
+static inline bool tgt_grant_claimed(const struct lu_env *env)
+{
+	return env->le_ses != NULL && tgt_ses_info(env)->tsi_grant_claimed;
+}
+
 static inline void tgt_opdata_set(const struct lu_env *env, __u64 flags)
 {
 	struct tgt_session_info	*tsi;
@@ -437,7 +444,9 @@ int tgt_extent_lock(struct ldlm_namespace *ns, struct ldlm_res_id *res_id,
 void tgt_extent_unlock(struct lustre_handle *lh, enum ldlm_mode mode);
 int tgt_brw_read(struct tgt_session_info *tsi);
 int tgt_brw_write(struct tgt_session_info *tsi);
+int tgt_batch(struct tgt_session_info *tsi);
 int tgt_hpreq_handler(struct ptlrpc_request *req);
+int tgt_ost_hpreq_handler(struct ptlrpc_request *req);
 void tgt_register_lfsck_in_notify_local(int (*notify)(const struct lu_env *,
 						      struct dt_device *,
 						      struct lfsck_req_local *,
@@ -642,6 +651,9 @@ static inline int is_serious(int rc)
 #define TGT_DLM_HDL(flags, name, fn)					\
 	TGT_RPC_HANDLER(LDLM_FIRST_OPC, flags, name, fn, &RQF_ ## name,	\
 			LUSTRE_DLM_VERSION)
+#define TGT_DLM_HDL_HP(flags, name, fn, hp)				\
+	TGT_RPC_HANDLER_HP(LDLM_FIRST_OPC, flags, name, fn, hp,		\
+			   &RQF_ ## name, LUSTRE_DLM_VERSION)
 
 /*
  * LLOG handler macros and generic functions.
@@ -52,6 +52,7 @@
  */
 #include <linux/kobject.h>
 #include <linux/uio.h>
+#include <linux/workqueue.h>
 #include <libcfs/libcfs.h>
 #include <lnet/api.h>
 #include <uapi/linux/lnet/nidstr.h>
@@ -99,6 +100,9 @@
 #define PTLRPC_MAX_BRW_BITS	(LNET_MTU_BITS + PTLRPC_BULK_OPS_BITS)
 #define PTLRPC_MAX_BRW_SIZE	(1U << PTLRPC_MAX_BRW_BITS)
 #define PTLRPC_MAX_BRW_PAGES	(PTLRPC_MAX_BRW_SIZE >> PAGE_SHIFT)
+/* Maximum number of objects (obd_ioobj) carried by a single BRW write when
+ * OBD_CONNECT2_MULTIOBJ_BRW was negotiated */
+#define PTLRPC_MAX_BRW_OBJS	16
 
 #define ONE_MB_BRW_SIZE		(1U << LNET_MTU_BITS)
 #define MD_MAX_BRW_SIZE		(1U << LNET_MTU_BITS)
@@ -124,6 +128,32 @@
 
 #define PTLRPC_NTHRS_INIT	2
 
+/**
+ * Default # of threads of each partition that normal requests cannot use
+ * on a service with high priority requests, so that lock cancels, glimpses
+ * and other high priority requests never wait for a bulk request to finish.
+ */
+#define PTLRPC_NTHRS_HP		1
+
+/**
+ * Default # of seconds a service thread above the minimum count stays idle
+ * before exiting.
+ */
+#define PTLRPC_THR_IDLE_TIMEOUT	300
+
+/**
+ * Reply batching.
+ *
+ * Replies without ACK or commit handling can be queued on their service
+ * partition and handed to LNet together, grouped by peer, when the queue
+ * is full, when no more requests are waiting, or when the oldest reply has
+ * waited PTLRPC_REPLY_BATCH_USEC, even if all the threads are busy.
+ * It is off by default; it trades a little reply latency for fewer,
+ * denser trips into LNet on services with very high rates of small RPCs.
+ */
+#define PTLRPC_REPLY_BATCH_MAX	256
+#define PTLRPC_REPLY_BATCH_USEC	50
+
 /**
  * Buffer Constants
  *
@@ -138,6 +168,11 @@
  *
  * Messages larger than ?_MAXREQSIZE are dropped.  Request buffers are
  * considered full when less than ?_MAXREQSIZE is left in them.
+ *
+ * A service can also have a pool of smaller buffers for its small requests,
+ * described by ?_SMALL_NBUFS, ?_SMALL_BUFSIZE and ?_SMALL_MAXREQSIZE.
+ * Requests up to ?_SMALL_MAXREQSIZE are then received in whichever buffer
+ * LNet finds first, larger ones skip the small buffers.
  */
 /**
  * Thread Constants
@@ -254,6 +289,8 @@
 #define LDLM_THR_FACTOR		8
 #define LDLM_NTHRS_INIT		PTLRPC_NTHRS_INIT
 #define LDLM_NTHRS_BASE		24
+/* cancels of contended locks are what conflicting enqueues are waiting on */
+#define LDLM_NTHRS_HP		2
 #define LDLM_NTHRS_MAX		(num_online_cpus() == 1 ? 64 : 128)
 
 #define LDLM_BL_THREADS   LDLM_NTHRS_AUTO_INIT
@@ -372,6 +409,14 @@
 #define OUT_MAXREQSIZE	(1000 * 1024)
 #define OUT_MAXREPSIZE	MDS_MAXREPSIZE
 
+/**
+ * MDS_REINT_BATCH carries several whole reint requests together, see
+ * struct reint_batch_header.  Each of them is small, the batch is limited
+ * so it still fits in the regular MDS request buffers.
+ */
+#define MDS_REINT_BATCH_MAXREQSIZE	(32 * 1024)
+#define MDS_REINT_BATCH_MAXREPSIZE	(64 * 1024)
+
 /** MDS_BUFSIZE = max_reqsize (w/o LOV EA) + max sptlrpc payload size */
 #define MDS_BUFSIZE		max(MDS_MAXREQSIZE + SPTLRPC_MAX_PAYLOAD, \
 				    8 * 1024)
@@ -403,6 +448,21 @@
 #define OUT_BUFSIZE		max(OUT_MAXREQSIZE + SPTLRPC_MAX_PAYLOAD, \
 				    24 * 1024)
 
+/**
+ * Small request buffers of the regular MDS and OUT portals.
+ *
+ * Most requests on these portals are below 1 KB, but share buffers sized for
+ * the largest setxattr or update request, and a buffer is only reused once
+ * all requests in it have been handled.  Small requests are received in
+ * these buffers instead, so that each of them pins less memory, and fewer
+ * of the large buffers are needed.
+ */
+#define MDS_SMALL_NBUFS		MDS_NBUFS
+#define MDS_SMALL_MAXREQSIZE	MDS_MAXREQSIZE
+#define MDS_SMALL_BUFSIZE	(32 * 1024)
+/** large buffers of the portals with small request buffers */
+#define MDS_LARGE_NBUFS		(MDS_NBUFS / 4)
+
 /** FLD_MAXREQSIZE == lustre_msg + __u32 padding + ptlrpc_body + opc */
 #define FLD_MAXREQSIZE  (160)
 
@@ -457,6 +517,8 @@
 				NUM_CACHEPAGES >> (28 - PAGE_SHIFT))
 #define OSS_NTHRS_INIT		(PTLRPC_NTHRS_INIT + 1)
 #define OSS_NTHRS_BASE		64
+/* glimpses are high priority requests of the main OST service */
+#define OSS_NTHRS_HP		2
 
 /* threads for handling "create" request */
 #define OSS_CR_THR_FACTOR	1
@@ -648,6 +710,35 @@ struct ptlrpc_cb_id {
 #define RS_MAX_LOCKS 8
 #define RS_DEBUG     0
 
+/**
+ * Phases of an RPC on a server, measured by the latency histograms of a
+ * service.
+ */
+enum ptlrpc_lat_phase {
+	/** from arrival to NRS enqueue, i.e. request preprocessing */
+	PTLRPC_LAT_REQ_IN = 0,
+	/** waiting in the NRS head */
+	PTLRPC_LAT_QUEUED,
+	/** from NRS dequeue to the end of the service handler */
+	PTLRPC_LAT_HANDLE,
+	/** from handing the reply to LNet to LNet being done with it */
+	PTLRPC_LAT_REPLY,
+	PTLRPC_LAT_PHASES,
+};
+
+/** Clients only measure the round trip time of their RPCs */
+#define PTLRPC_LAT_RTT		0
+
+/**
+ * Per-CPU log2 histograms of RPC latencies in usecs, one set of
+ * \a pls_nphases histograms of OBD_HIST_MAX buckets for each opcode.
+ */
+struct ptlrpc_lat_stats {
+	int				 pls_nphases;
+	/** indexed by opcode_offset(), allocated on first use */
+	unsigned long __percpu		*pls_hist[LUSTRE_MAX_OPCODES];
+};
+
 /**
  * Structure to define reply state on the server
  * Reply state holds various reply message information. Also for "difficult"
@@ -691,12 +782,18 @@ struct ptlrpc_reply_state {
         int                    rs_size;
         /** opcode */
         __u32                  rs_opc;
+	/** when the reply was handed to LNet, for the latency histograms */
+	ktime_t			rs_send_time;
         /** Transaction number */
         __u64                  rs_transno;
         /** xid */
         __u64                  rs_xid;
 	struct obd_export     *rs_export;
 	struct ptlrpc_service_part *rs_svcpt;
+	/** where a reply queued for batching is sent */
+	struct lnet_process_id	rs_peer;
+	lnet_nid_t		rs_self;
+	unsigned int		rs_reply_off;
 	/** Lnet metadata handle for the reply */
 	struct lnet_handle_md	rs_md_h;
 
@@ -926,6 +1023,8 @@ struct ptlrpc_srv_req {
 	/** @} nrs */
 	/** request arrival time */
 	struct timespec64		 sr_arrival_time;
+	/** when the request was added to the NRS head */
+	ktime_t				 sr_enqueue_time;
 	/** server's half ctx */
 	struct ptlrpc_svc_ctx		*sr_svc_ctx;
 	/** (server side), pointed directly into req buffer */
@@ -1019,7 +1118,8 @@ struct ptlrpc_request {
 	unsigned int
 		rq_hp:1,		/**< high priority RPC */
 		rq_at_linked:1,		/**< link into service's srv_at_array */
-		rq_packed_final:1;	/**< packed final reply */
+		rq_packed_final:1,	/**< packed final reply */
+		rq_batched:1;		/**< sub-request of an MDS_REINT_BATCH */
 	/** @} */
 
 	/** one of RQ_PHASE_* */
@@ -1455,6 +1555,8 @@ struct ptlrpc_bulk_desc {
 	unsigned long bd_failure:1;
 	/** client side */
 	unsigned long bd_registered:1;
+	/** bd_enc_vec refers to the pages of bd_vec, not to enc pool pages */
+	unsigned long bd_enc_inplace:1;
 	/** For serialization with callback */
 	spinlock_t bd_lock;
 	/** Import generation when request for this bulk was sent */
@@ -1475,6 +1577,7 @@ struct ptlrpc_bulk_desc {
 	int                    bd_max_iov;      /* allocated size of bd_iov */
 	int                    bd_nob;          /* # bytes covered */
 	int                    bd_nob_transferred; /* # bytes GOT/PUT */
+	int		       bd_enc_cpt;	/* enc pool of bd_enc_vec */
 
 	__u64                  bd_last_mbits;
 
@@ -1616,6 +1719,34 @@ static inline int thread_test_and_clear_flags(struct ptlrpc_thread *thread,
         return 0;
 }
 
+/**
+ * Size classes of the request buffers of a service.
+ */
+enum ptlrpc_rqbd_class {
+	/** small buffers, only for requests up to srv_small_max_req_size */
+	PTLRPC_RQBD_SMALL	= 0,
+	/** buffers of srv_buf_size, for any request */
+	PTLRPC_RQBD_REGULAR,
+	PTLRPC_RQBD_NCLASS,
+};
+
+/**
+ * Request buffers of one size class on a service partition, protected by
+ * ptlrpc_service_part::scp_lock.
+ */
+struct ptlrpc_rqbd_pool {
+	/** # req buffer descs of the class allocated */
+	int				rbp_nrqbds_total;
+	/** # posted request buffers of the class */
+	int				rbp_nrqbds_posted;
+	/** # requests received in buffers of the class */
+	__u64				rbp_nreqs;
+	/** # buffers of the class unlinked once full */
+	__u64				rbp_nretired;
+	/** # bytes used by requests in the buffers unlinked once full */
+	__u64				rbp_retired_bytes;
+};
+
 /**
  * Request buffer descriptor structure.
  * This is a structure that contains one posted request buffer for service.
@@ -1633,6 +1764,8 @@ struct ptlrpc_request_buffer_desc {
 	/** LNet descriptor */
 	struct lnet_handle_md		rqbd_md_h;
 	int				rqbd_refcount;
+	/** Size class of the buffer */
+	enum ptlrpc_rqbd_class		rqbd_class;
 	/** The buffer itself */
 	char				*rqbd_buffer;
 	struct ptlrpc_cb_id		rqbd_cbid;
@@ -1706,10 +1839,39 @@ struct ptlrpc_service {
 	int				srv_nthrs_cpt_init;
 	/** limit of threads number for each partition */
 	int				srv_nthrs_cpt_limit;
+	/**
+	 * threads of each partition that normal requests cannot use, kept
+	 * for high priority requests; 0 if the service has none
+	 */
+	int				srv_nthrs_cpt_hp;
+	/**
+	 * seconds a thread above srv_nthrs_cpt_init stays idle before
+	 * exiting, 0 to never stop idle threads
+	 */
+	int				srv_thrs_idle_timeout;
+	/**
+	 * msecs a request must have waited before threads are added beyond
+	 * srv_nthrs_cpt_init, 0 to add them as soon as all are busy
+	 */
+	int				srv_thrs_grow_wait;
+	/**
+	 * CPU utilization of a partition, in percent, above which no
+	 * threads are added beyond srv_nthrs_cpt_init
+	 */
+	int				srv_thrs_cpu_max;
+	/**
+	 * max # of plain replies queued on a partition before they are sent
+	 * together, 0 or 1 to send each reply when it is ready
+	 */
+	int				srv_reply_batch;
+	/** usecs a queued reply waits at most while requests are pending */
+	int				srv_reply_batch_usec;
         /** Root of /proc dir tree for this service */
 	struct proc_dir_entry           *srv_procroot;
         /** Pointer to statistic data for this service */
         struct lprocfs_stats           *srv_stats;
+	/** latency histograms of the phases of each opcode */
+	struct ptlrpc_lat_stats		*srv_lat_stats;
         /** # hp per lp reqs to handle */
         int                             srv_hpreq_ratio;
         /** biggest request to receive */
@@ -1720,6 +1882,12 @@ struct ptlrpc_service {
         int                             srv_buf_size;
         /** # buffers to allocate in 1 group */
         int                             srv_nbuf_per_group;
+	/** biggest request to receive in small buffers */
+	int				srv_small_max_req_size;
+	/** size of small buffers, 0 if the service has none */
+	int				srv_small_buf_size;
+	/** # small buffers to allocate in 1 group */
+	int				srv_small_nbuf_per_group;
         /** Local portal on which to receive requests */
         __u32                           srv_req_portal;
         /** Portal on the client to send replies to */
@@ -1787,6 +1955,14 @@ struct ptlrpc_service_part {
 	int				scp_nthrs_running;
 	/** service threads list */
 	struct list_head		scp_threads;
+	/** usecs the last request waited before being handled */
+	s64				scp_req_wait;
+	/** CPU utilization of the partition in percent, see scp_cpu_stamp */
+	int				scp_cpu_busy;
+	/** when scp_cpu_busy was sampled, in usecs */
+	u64				scp_cpu_stamp;
+	/** idle time of the CPUs of the partition at scp_cpu_stamp */
+	u64				scp_cpu_idle;
 
 	/**
 	 * serialize the following fields, used for protecting
@@ -1798,6 +1974,8 @@ struct ptlrpc_service_part {
 	int				scp_nrqbds_total;
 	/** # posted request buffers for receiving */
 	int				scp_nrqbds_posted;
+	/** request buffers of each size class */
+	struct ptlrpc_rqbd_pool	scp_rqbd_pools[PTLRPC_RQBD_NCLASS];
 	/** in progress of allocating rqbd */
 	int				scp_rqbd_allocating;
 	/** # incoming reqs */
@@ -1878,6 +2056,14 @@ struct ptlrpc_service_part {
 	wait_queue_head_t		scp_rep_waitq;
 	/** # 'difficult' replies */
 	atomic_t			scp_nreps_difficult;
+	/** replies waiting to be sent by ptlrpc_reply_batch_flush() */
+	struct list_head		scp_rep_batch;
+	/** # replies on scp_rep_batch */
+	int				scp_rep_batch_count;
+	/** when the oldest reply on scp_rep_batch was queued */
+	ktime_t				scp_rep_batch_start;
+	/** sends the queued replies if no service thread did it in time */
+	struct delayed_work		scp_rep_batch_work;
 };
 
 #define ptlrpc_service_for_each_part(part, i, svc)			\
@@ -2133,6 +2319,8 @@ struct ptlrpc_connection *ptlrpc_uuid_to_connection(struct obd_uuid *uuid,
 						    lnet_nid_t nid4refnet);
 
 int ptlrpc_queue_wait(struct ptlrpc_request *req);
+int ptlrpc_batch_subreq_reply(struct ptlrpc_request *req,
+			      struct lustre_msg *repmsg, int replen);
 int ptlrpc_replay_req(struct ptlrpc_request *req);
 void ptlrpc_restart_req(struct ptlrpc_request *req);
 void ptlrpc_abort_inflight(struct obd_import *imp);
@@ -2241,6 +2429,12 @@ struct ptlrpc_service_buf_conf {
 	unsigned int			bc_req_max_size;
 	/* maximum reply size this service can ever send */
 	unsigned int			bc_rep_max_size;
+	/* small buffers # to allocate when growing the pool, 0 if none */
+	unsigned int			bc_small_nbufs;
+	/* small buffer size to post */
+	unsigned int			bc_small_buf_size;
+	/* maximum request size to be received in small buffers */
+	unsigned int			bc_small_req_max_size;
 };
 
 struct ptlrpc_service_thr_conf {
@@ -2262,6 +2456,9 @@ struct ptlrpc_service_thr_conf {
 	/* user specified threads number, it will be validated due to
 	 * other members of this structure. */
 	unsigned int			tc_nthrs_user;
+	/* threads kept for high priority requests on each partition,
+	 * PTLRPC_NTHRS_HP if 0; ignored without so_hpreq_handler */
+	unsigned int			tc_nthrs_hp;
 	/* set NUMA node affinity for service threads */
 	unsigned int			tc_cpu_affinity;
 	/* Tags for lu_context associated with service thread */
@@ -2312,6 +2509,10 @@ int ptlrpc_start_threads(struct ptlrpc_service *svc);
 int ptlrpc_unregister_service(struct ptlrpc_service *service);
 int ptlrpc_service_health_check(struct ptlrpc_service *);
 void ptlrpc_server_drop_request(struct ptlrpc_request *req);
+struct ptlrpc_request *ptlrpc_batch_subreq_alloc(struct ptlrpc_request *req,
+						 struct lustre_msg *msg,
+						 int len, __u64 xid);
+void ptlrpc_batch_subreq_free(struct ptlrpc_request *sub);
 void ptlrpc_request_change_export(struct ptlrpc_request *req,
 				  struct obd_export *export);
 void ptlrpc_update_export_timer(struct obd_export *exp,
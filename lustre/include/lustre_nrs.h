@@ -676,6 +676,7 @@ enum {
 #include <lustre_nrs_crr.h>
 #include <lustre_nrs_orr.h>
 #include <lustre_nrs_delay.h>
+#include <lustre_nrs_wfs.h>
 
 /**
  * NRS request
@@ -726,6 +727,10 @@ struct ptlrpc_nrs_request {
 		 * Fields for the delay policy
 		 */
 		struct nrs_delay_req	delay;
+		/**
+		 * WFS request definition
+		 */
+		struct nrs_wfs_req	wfs;
 	} nr_u;
 	/**
 	 * Externally-registering policies may want to use this to allocate
@@ -75,7 +75,7 @@ struct nrs_tbf_client {
 	struct nrs_tbf_rule		*tc_rule;
 	/** Generation of the rule matched. */
 	__u64				 tc_rule_generation;
-	/** Limit of RPC rate. */
+	/** Limit of RPC rate, or of KiB/s for a bandwidth rule. */
 	__u64				 tc_rpc_rate;
 	/** Time to wait for next token. */
 	__u64				 tc_nsecs;
@@ -83,6 +83,8 @@ struct nrs_tbf_client {
 	__u64				 tc_ntoken;
 	/** Token bucket depth. */
 	__u64				 tc_depth;
+	/** Tokens are charged by bulk size, see nrs_tbf_rule::tr_bw_rate. */
+	bool				 tc_bandwidth;
 	/** Time check-point. */
 	__u64				 tc_check_time;
 	/** List of queued requests. */
@@ -128,8 +130,10 @@ struct nrs_tbf_rule {
 	struct list_head		tr_conds;
 	/** Generic condition string of the rule. */
 	char				*tr_conds_str;
-	/** RPC/s limit. */
+	/** RPC/s limit, or KiB/s limit for a bandwidth rule. */
 	__u64				 tr_rpc_rate;
+	/** MB/s limit as given by the user, 0 for a RPC/s rule. */
+	__u64				 tr_bw_rate;
 	/** Time to wait for next token. */
 	__u64				 tr_nsecs;
 	/** Token bucket depth. */
@@ -252,6 +256,25 @@ struct nrs_tbf_head {
 	 * Index of bucket on hash table while purging.
 	 */
 	int				 th_purge_start;
+	/**
+	 * Elevator stage of the requests TBF lets through, sorting OST I/O
+	 * by object and offset as ORR does; NULL unless the policy was
+	 * started with an "orr" stage, e.g. "tbf jobid>orr".
+	 */
+	struct cfs_binheap		*th_elv_heap;
+	/**
+	 * Maximum # of requests staged in the elevator.
+	 */
+	__u32				 th_elv_depth;
+	/**
+	 * Current sweep of the elevator.
+	 */
+	__u64				 th_elv_round;
+	/**
+	 * Object and offset of the last request the elevator dispatched.
+	 */
+	struct ost_id			 th_elv_oi;
+	__u64				 th_elv_offset;
 };
 
 enum nrs_tbf_cmd_type {
@@ -266,6 +289,7 @@ struct nrs_tbf_cmd {
 	union {
 		struct nrs_tbf_cmd_start {
 			__u64			 ts_rpc_rate;
+			__u64			 ts_bw_rate;
 			struct list_head	 ts_nids;
 			char			*ts_nids_str;
 			struct list_head	 ts_jobids;
@@ -280,6 +304,7 @@ struct nrs_tbf_cmd {
 		} tc_start;
 		struct nrs_tbf_cmd_change {
 			__u64			 tc_rpc_rate;
+			__u64			 tc_bw_rate;
 			char			*tc_next_name;
 		} tc_change;
 	} u;
@@ -319,6 +344,25 @@ struct nrs_tbf_req {
 	 * Sequence of the request.
 	 */
 	__u64			tr_sequence;
+	/**
+	 * Bulk size of the request in KiB, charged by bandwidth rules.
+	 */
+	__u32			tr_kbytes;
+	/**
+	 * Whether the request is an OST I/O the elevator can sort, and
+	 * whether it is currently staged in nrs_tbf_head::th_elv_heap.
+	 */
+	unsigned int		tr_elv_io:1,
+				tr_in_elv:1;
+	/**
+	 * Object and start offset of an OST I/O request.
+	 */
+	struct ost_id		tr_oi;
+	__u64			tr_offset;
+	/**
+	 * Elevator sweep the request is to be dispatched in.
+	 */
+	__u64			tr_round;
 };
 
 /**
@@ -0,0 +1,155 @@
+/*
+ * GPL HEADER START
+ *
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License version 2 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; If not, see
+ * http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * GPL HEADER END
+ */
+/*
+ *
+ * Network Request Scheduler (NRS) Weighted Fair Share (WFS) policy
+ *
+ */
+
+#ifndef _LUSTRE_NRS_WFS_H
+#define _LUSTRE_NRS_WFS_H
+
+/**
+ * \name WFS
+ *
+ * WFS, Weighted Fair Share over user, group or project IDs
+ * @{
+ */
+
+/** Maximum number of IDs with a non-default weight */
+#define NRS_WFS_WEIGHTS_MAX	64
+/** Weight of IDs that have none configured */
+#define NRS_WFS_WEIGHT_DEFAULT	1
+/** Class of the requests whose ID could not be found */
+#define NRS_WFS_ID_NONE		((__u32)-1)
+
+/**
+ * The credential a WFS policy instance schedules requests by.
+ */
+enum nrs_wfs_key {
+	NRS_WFS_KEY_UID = 0,
+	NRS_WFS_KEY_GID,
+	NRS_WFS_KEY_PROJID,
+};
+
+/**
+ * Weight configured for an ID.
+ */
+struct nrs_wfs_weight {
+	__u32				ww_id;
+	__u32				ww_weight;
+};
+
+/**
+ * Weights of a policy instance, as read through lprocfs.
+ */
+struct nrs_wfs_weights {
+	enum nrs_wfs_key		wws_key;
+	/** number of classes, i.e. of IDs with requests being handled */
+	__u64				wws_classes;
+	int				wws_count;
+	struct nrs_wfs_weight		wws_weights[NRS_WFS_WEIGHTS_MAX];
+};
+
+/**
+ * private data structure for WFS NRS
+ */
+struct nrs_wfs_head {
+	struct ptlrpc_nrs_resource	wh_res;
+	struct cfs_hash		       *wh_cls_hash;
+	/**
+	 * Classes with queued requests, in Deficit Round Robin order; the
+	 * class at the head of the list is the one being served.
+	 */
+	struct list_head		wh_active;
+	/**
+	 * ID the requests are classified by.
+	 */
+	enum nrs_wfs_key		wh_key;
+	/**
+	 * Deficit Round Robin quantum; the number of RPCs a class of weight 1
+	 * can have handled in each round.
+	 */
+	__u16				wh_quantum;
+	/**
+	 * IDs with a non-default weight; modified under ptlrpc_nrs::nrs_lock
+	 * and read locklessly when a class starts a new round.
+	 */
+	int				wh_nweights;
+	struct nrs_wfs_weight		wh_weights[NRS_WFS_WEIGHTS_MAX];
+};
+
+/**
+ * Object representing the requests of one user, group or project ID in WFS
+ */
+struct nrs_wfs_class {
+	struct ptlrpc_nrs_resource	wc_res;
+	struct hlist_node		wc_hnode;
+	__u32				wc_id;
+	atomic_t			wc_ref;
+	/**
+	 * Queued requests of the class, in arrival order.
+	 */
+	struct list_head		wc_list;
+	/**
+	 * Linkage into nrs_wfs_head::wh_active while requests are queued.
+	 */
+	struct list_head		wc_active;
+	/**
+	 * # of RPCs the class can still have handled in the current round.
+	 */
+	__u32				wc_deficit;
+};
+
+/**
+ * WFS NRS request definition
+ */
+struct nrs_wfs_req {
+	/**
+	 * Linkage into nrs_wfs_class::wc_list.
+	 */
+	struct list_head	wr_list;
+};
+
+/**
+ * WFS policy operations.
+ */
+enum nrs_ctl_wfs {
+	/**
+	 * Read the DRR quantum size of a WFS policy.
+	 */
+	NRS_CTL_WFS_RD_QUANTUM = PTLRPC_NRS_CTL_1ST_POL_SPEC,
+	/**
+	 * Write the DRR quantum size of a WFS policy.
+	 */
+	NRS_CTL_WFS_WR_QUANTUM,
+	/**
+	 * Read the weights of a WFS policy.
+	 */
+	NRS_CTL_WFS_RD_WEIGHTS,
+	/**
+	 * Set the weight of one ID of a WFS policy.
+	 */
+	NRS_CTL_WFS_WR_WEIGHT,
+};
+
+/** @} WFS */
+#endif
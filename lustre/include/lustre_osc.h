@@ -538,6 +538,10 @@ struct osc_page {
 	 * lru page list. See osc_lru_{del|use}() in osc_page.c for usage.
 	 */
 	struct list_head	ops_lru;
+	/**
+	 * CPU partition of client_obd::cl_lru_parts the page belongs to.
+	 */
+	int			ops_lru_cpt;
 	/**
 	 * Submit time - the time when the page is starting RPC. For debugging.
 	 */
@@ -175,6 +175,7 @@ extern struct req_format RQF_MDS_REINT_SETXATTR;
 extern struct req_format RQF_MDS_QUOTACTL;
 extern struct req_format RQF_QUOTA_DQACQ;
 extern struct req_format RQF_MDS_SWAP_LAYOUTS;
+extern struct req_format RQF_MDS_REINT_BATCH;
 extern struct req_format RQF_MDS_REINT_MIGRATE;
 extern struct req_format RQF_MDS_REINT_RESYNC;
 /* MDS hsm formats */
@@ -336,6 +337,11 @@ extern struct req_msg_field RMF_OUT_UPDATE_REPLY;
 extern struct req_msg_field RMF_OUT_UPDATE_HEADER;
 extern struct req_msg_field RMF_OUT_UPDATE_BUF;
 
+/* MDS batch format */
+extern struct req_msg_field RMF_REINT_BATCH_HEADER;
+extern struct req_msg_field RMF_REINT_BATCH_BUF;
+extern struct req_msg_field RMF_REINT_BATCH_REPLY;
+
 /* LFSCK format */
 extern struct req_msg_field RMF_LFSCK_REQUEST;
 extern struct req_msg_field RMF_LFSCK_REPLY;
@@ -855,6 +855,8 @@ struct ptlrpc_sec_policy {
  *
  * \see sptlrpc_import_sec_adapt().
  */
+struct ptlrpc_ctx_cache;
+
 struct ptlrpc_sec {
 	struct ptlrpc_sec_policy       *ps_policy;
 	atomic_t                        ps_refcount;
@@ -876,6 +878,9 @@ struct ptlrpc_sec {
 	struct list_head		ps_gc_list;
 	time64_t			ps_gc_interval;	/* in seconds */
 	time64_t			ps_gc_next;	/* in seconds */
+
+	/** per-CPU cache of the last context looked up, GSS only */
+	struct ptlrpc_ctx_cache __percpu *ps_ctx_cache;
 };
 
 static inline int flvr_is_rootonly(__u32 flavor)
@@ -1157,6 +1162,7 @@ int sptlrpc_cli_install_rvs_ctx(struct obd_import *imp,
 int sptlrpc_enc_pool_add_user(void);
 int sptlrpc_enc_pool_del_user(void);
 int  sptlrpc_enc_pool_get_pages(struct ptlrpc_bulk_desc *desc);
+int  sptlrpc_enc_pool_alias_pages(struct ptlrpc_bulk_desc *desc);
 void sptlrpc_enc_pool_put_pages(struct ptlrpc_bulk_desc *desc);
 int get_free_pages_in_pool(void);
 int pool_is_at_full_capacity(void);
@@ -159,6 +159,50 @@ enum obd_cl_sem_lock_class {
 
 struct mdc_rpc_lock;
 struct obd_import;
+/**
+ * Partition of the OSC page LRU. Each CPU partition keeps the LRU pages
+ * allocated on its NUMA node(s), so that adding and removing LRU pages does
+ * not bounce one lock between all CPUs, and reclaim frees memory of the
+ * local node first.
+ */
+struct cl_lru_part {
+	/** List of LRU pages of this partition */
+	struct list_head	clp_list;
+	/** Lock for clp_list */
+	spinlock_t		clp_lock;
+	/** # of pages in clp_list */
+	atomic_long_t		clp_in_list;
+};
+
+/**
+ * State of the adaptive RPC controller of an OSC, which tunes the number of
+ * RPCs in flight and the RPC size from the observed RPC latency, the server
+ * load and the amount of pending pages, see osc_rpc_ctrl_update().
+ * Protected by client_obd::cl_loi_list_lock.
+ */
+struct cl_rpc_ctrl {
+	/** controller is running */
+	bool			crc_enabled;
+	/** tunables set by the administrator, restored when disabled */
+	__u32			crc_saved_rif;
+	__u32			crc_saved_pages;
+	/** RPCs completed in the current round */
+	__u32			crc_acked;
+	/** smoothed RPC round-trip time */
+	__u64			crc_srtt_us;
+	/** lowest RTT of the previous period, uncongested estimate */
+	__u64			crc_base_rtt_us;
+	/** lowest RTT seen in the current period */
+	__u64			crc_probe_rtt_us;
+	/** start of the current period */
+	time64_t		crc_period_start;
+	/** lowest AT service estimate of the server */
+	unsigned int		crc_at_base;
+	/** number of window or RPC size changes */
+	__u64			crc_increases;
+	__u64			crc_decreases;
+};
+
 struct client_obd {
 	struct rw_semaphore	 cl_sem;
 	struct obd_uuid		 cl_target_uuid;
@@ -247,6 +291,9 @@ struct client_obd {
 	__u32			cl_max_pages_per_rpc;
 	__u32			cl_max_rpcs_in_flight;
 	__u32			cl_short_io_bytes;
+	/* max number of objects coalesced in one write RPC */
+	__u32			cl_max_objs_per_rpc;
+	struct cl_rpc_ctrl	cl_rpc_ctrl;
 	struct obd_histogram	cl_read_rpc_hist;
 	struct obd_histogram	cl_write_rpc_hist;
 	struct obd_histogram	cl_read_page_hist;
@@ -278,10 +325,10 @@ struct client_obd {
 	 * reclaim is sync, initiated by IO thread when the LRU slots are
 	 * in shortage. */
 	__u64                    cl_lru_reclaim;
-	/** List of LRU pages for this client_obd */
-	struct list_head         cl_lru_list;
-	/** Lock for LRU page list */
-	spinlock_t		 cl_lru_list_lock;
+	/** Per-CPT lists of LRU pages for this client_obd, a page is put on
+	 * the list of the CPU partition its memory node belongs to, see
+	 * struct cl_lru_part. */
+	struct cl_lru_part     **cl_lru_parts;
 	/** # of unstable pages in this client_obd.
 	 * An unstable page is a page state that WRITE RPC has finished but
 	 * the transaction has NOT yet committed. */
@@ -304,6 +351,10 @@ struct client_obd {
 	wait_queue_head_t	 cl_mod_rpcs_waitq;
 	unsigned long		*cl_mod_tag_bitmap;
 	struct obd_histogram	 cl_mod_rpcs_hist;
+	/* reints waiting to be sent together in an MDS_REINT_BATCH RPC, and the
+	 * maximum number of them in one RPC, protected by cl_mod_rpcs_lock */
+	struct list_head	 cl_batch_list;
+	__u16			 cl_max_batch_count;
 
         /* mgc datastruct */
 	struct mutex		  cl_mgc_mutex;
@@ -709,6 +760,7 @@ struct obd_device {
 	struct proc_dir_entry	*obd_proc_exports_entry;
 	struct proc_dir_entry	*obd_svc_procroot;
 	struct lprocfs_stats	*obd_svc_stats;
+	struct ptlrpc_lat_stats	*obd_svc_lat;
 	struct attribute_group		 obd_attrs_group;
 	struct attribute	       **obd_attrs;
 	struct lprocfs_vars	*obd_vars;
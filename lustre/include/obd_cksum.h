@@ -63,27 +63,40 @@ static inline unsigned char cksum_obd2cfs(enum cksum_types cksum_type)
  * because that is supported by all clients since 1.8
  *
  * In case multiple algorithms are supported the best one is used. */
+
+/* This is called for every BRW, so it doesn't wait for the speed tests
+ * running in the background.  A speed not known yet is replaced by \a guess,
+ * lower than any measured speed, which prefers CRC32C over CRC32 over ADLER
+ * until the tests are done. */
+static inline unsigned int cksum_type_speed(enum cksum_types cksum_type,
+					    unsigned int guess)
+{
+	int speed = cfs_crypto_hash_speed_nowait(cksum_obd2cfs(cksum_type));
+
+	return speed == 0 ? guess : speed;
+}
+
 static inline u32 cksum_type_pack(enum cksum_types cksum_type)
 {
 	unsigned int    performance = 0, tmp;
 	u32		flag = OBD_FL_CKSUM_ADLER;
 
 	if (cksum_type & OBD_CKSUM_CRC32) {
-		tmp = cfs_crypto_hash_speed(cksum_obd2cfs(OBD_CKSUM_CRC32));
+		tmp = cksum_type_speed(OBD_CKSUM_CRC32, 2);
 		if (tmp > performance) {
 			performance = tmp;
 			flag = OBD_FL_CKSUM_CRC32;
 		}
 	}
 	if (cksum_type & OBD_CKSUM_CRC32C) {
-		tmp = cfs_crypto_hash_speed(cksum_obd2cfs(OBD_CKSUM_CRC32C));
+		tmp = cksum_type_speed(OBD_CKSUM_CRC32C, 3);
 		if (tmp > performance) {
 			performance = tmp;
 			flag = OBD_FL_CKSUM_CRC32C;
 		}
 	}
 	if (cksum_type & OBD_CKSUM_ADLER) {
-		tmp = cfs_crypto_hash_speed(cksum_obd2cfs(OBD_CKSUM_ADLER));
+		tmp = cksum_type_speed(OBD_CKSUM_ADLER, 1);
 		if (tmp > performance) {
 			performance = tmp;
 			flag = OBD_FL_CKSUM_ADLER;
@@ -807,6 +807,8 @@ struct ptlrpc_body_v2 {
 /* ocd_connect_flags2 flags */
 #define OBD_CONNECT2_FILE_SECCTX	0x1ULL /* set file security context at create */
 #define OBD_CONNECT2_LOCKAHEAD	0x2ULL /* ladvise lockahead v2 */
+#define OBD_CONNECT2_MULTIOBJ_BRW 0x1000000000000ULL /* multi-object BRW */
+#define OBD_CONNECT2_REINT_BATCH 0x2000000000000ULL /* several reints per RPC */
 
 /* XXX README XXX:
  * Please DO NOT add flag values here before first ensuring that this same
@@ -857,7 +859,8 @@ struct ptlrpc_body_v2 {
 				OBD_CONNECT_GRANT_PARAM | \
 				OBD_CONNECT_FLAGS2)
 
-#define MDT_CONNECT_SUPPORTED2 OBD_CONNECT2_FILE_SECCTX
+#define MDT_CONNECT_SUPPORTED2 (OBD_CONNECT2_FILE_SECCTX | \
+				OBD_CONNECT2_REINT_BATCH)
 
 #define OST_CONNECT_SUPPORTED  (OBD_CONNECT_SRVLOCK | OBD_CONNECT_GRANT | \
 				OBD_CONNECT_REQPORTAL | OBD_CONNECT_VERSION | \
@@ -877,7 +880,8 @@ struct ptlrpc_body_v2 {
 				OBD_CONNECT_BULK_MBITS | \
 				OBD_CONNECT_GRANT_PARAM | OBD_CONNECT_FLAGS2)
 
-#define OST_CONNECT_SUPPORTED2 OBD_CONNECT2_LOCKAHEAD
+#define OST_CONNECT_SUPPORTED2 (OBD_CONNECT2_LOCKAHEAD | \
+				OBD_CONNECT2_MULTIOBJ_BRW)
 
 #define ECHO_CONNECT_SUPPORTED 0
 #define ECHO_CONNECT_SUPPORTED2 0
@@ -1573,6 +1577,9 @@ typedef enum {
 	MDS_HSM_CT_REGISTER	= 59,
 	MDS_HSM_CT_UNREGISTER	= 60,
 	MDS_SWAP_LAYOUTS	= 61,
+	MDS_RMFID		= 62, /* reserved, not handled */
+	MDS_BATCH		= 63, /* reserved, not handled */
+	MDS_REINT_BATCH		= 64,
 	MDS_LAST_OPC
 } mds_cmd_t;
 
@@ -3403,6 +3410,38 @@ struct out_update_buffer {
 	__u32	oub_padding;
 };
 
+#define REINT_BATCH_MAGIC	0x5EB0A001
+#define REINT_BATCH_REPLY_MAGIC	0x5EB0A002
+/* Maximum number of sub-requests carried by one MDS_REINT_BATCH RPC */
+#define REINT_BATCH_MAX_REQS	64
+/* Header of an MDS_REINT_BATCH request, several MDS_REINT in a single RPC */
+struct reint_batch_header {
+	__u32	rbh_magic;
+	__u32	rbh_count;	/* number of sub-requests in the buffer */
+	__u32	rbh_reply_size;	/* size of the reply buffer of the client */
+	__u32	rbh_padding;
+};
+
+/* Sub-request of an MDS_REINT_BATCH, followed by its message, 8-byte aligned */
+struct reint_batch_request {
+	__u64	rbq_xid;
+	__u32	rbq_reqlen;
+	__u32	rbq_padding;
+};
+
+/* Header of an MDS_REINT_BATCH reply */
+struct reint_batch_reply {
+	__u32	rbp_magic;
+	__u32	rbp_count;	/* number of sub-replies that follow */
+};
+
+/* Sub-reply of an MDS_REINT_BATCH, followed by its message, 8-byte aligned */
+struct reint_batch_result {
+	__u64	rbs_xid;
+	__u32	rbs_replen;
+	__u32	rbs_padding;
+};
+
 /* the result of object update */
 struct object_update_result {
 	__u32   our_rc;
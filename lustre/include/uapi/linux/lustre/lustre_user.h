@@ -1786,7 +1786,8 @@ enum sk_crypt_alg {
 	SK_CRYPT_INVALID	= -1,
 	SK_CRYPT_EMPTY		= 0,
 	SK_CRYPT_AES256_CTR	= 1,
-	SK_CRYPT_MAX		= 2,
+	SK_CRYPT_AES256_GCM	= 2,
+	SK_CRYPT_MAX		= 3,
 };
 
 enum sk_hmac_alg {
@@ -1794,7 +1795,8 @@ enum sk_hmac_alg {
 	SK_HMAC_EMPTY	= 0,
 	SK_HMAC_SHA256	= 1,
 	SK_HMAC_SHA512	= 2,
-	SK_HMAC_MAX	= 3,
+	SK_HMAC_SHA256_GMAC = 3,
+	SK_HMAC_MAX	= 4,
 };
 
 struct sk_crypt_type {
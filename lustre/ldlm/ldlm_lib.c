@@ -273,7 +273,9 @@ int client_obd_setup(struct obd_device *obddev, struct lustre_cfg *lcfg)
 	char *cli_name = lustre_cfg_buf(lcfg, 0);
 	struct ptlrpc_connection fake_conn = { .c_self = 0,
 					       .c_remote_uuid.uuid[0] = 0 };
+	struct cl_lru_part *part;
 	int rc;
+	int i;
 	ENTRY;
 
 	/* In a more perfect world, we would hang a ptlrpc_client off of
@@ -386,8 +388,15 @@ int client_obd_setup(struct obd_device *obddev, struct lustre_cfg *lcfg)
 	atomic_set(&cli->cl_lru_shrinkers, 0);
 	atomic_long_set(&cli->cl_lru_busy, 0);
 	atomic_long_set(&cli->cl_lru_in_list, 0);
-	INIT_LIST_HEAD(&cli->cl_lru_list);
-	spin_lock_init(&cli->cl_lru_list_lock);
+	cli->cl_lru_parts = cfs_percpt_alloc(cfs_cpt_table,
+					     sizeof(struct cl_lru_part));
+	if (cli->cl_lru_parts == NULL)
+		GOTO(err, rc = -ENOMEM);
+	cfs_percpt_for_each(part, i, cli->cl_lru_parts) {
+		INIT_LIST_HEAD(&part->clp_list);
+		spin_lock_init(&part->clp_lock);
+		atomic_long_set(&part->clp_in_list, 0);
+	}
 	atomic_long_set(&cli->cl_unstable_count, 0);
 	INIT_LIST_HEAD(&cli->cl_shrink_list);
 
@@ -414,6 +423,10 @@ int client_obd_setup(struct obd_device *obddev, struct lustre_cfg *lcfg)
 
 	cli->cl_short_io_bytes = OBD_MAX_SHORT_IO_BYTES;
 
+	/* only used if the OST supports OBD_CONNECT2_MULTIOBJ_BRW, off by
+	 * default until enabled through osc.*.max_objs_per_rpc */
+	cli->cl_max_objs_per_rpc = 1;
+
 	/* set cl_chunkbits default value to PAGE_SHIFT,
 	 * it will be updated at OSC connection time. */
 	cli->cl_chunkbits = PAGE_SHIFT;
@@ -440,11 +453,15 @@ int client_obd_setup(struct obd_device *obddev, struct lustre_cfg *lcfg)
 	cli->cl_close_rpcs_in_flight = 0;
 	init_waitqueue_head(&cli->cl_mod_rpcs_waitq);
 	cli->cl_mod_tag_bitmap = NULL;
+	INIT_LIST_HEAD(&cli->cl_batch_list);
+	/* only used if the MDT supports OBD_CONNECT2_REINT_BATCH */
+	cli->cl_max_batch_count = 0;
 
 	INIT_LIST_HEAD(&cli->cl_chg_dev_linkage);
 
 	if (connect_op == MDS_CONNECT) {
 		cli->cl_max_mod_rpcs_in_flight = cli->cl_max_rpcs_in_flight - 1;
+		cli->cl_max_batch_count = REINT_BATCH_MAX_REQS / 4;
 		OBD_ALLOC(cli->cl_mod_tag_bitmap,
 			  BITS_TO_LONGS(OBD_MAX_RIF_MAX) * sizeof(long));
 		if (cli->cl_mod_tag_bitmap == NULL)
@@ -526,6 +543,9 @@ err:
 		OBD_FREE(cli->cl_mod_tag_bitmap,
 			 BITS_TO_LONGS(OBD_MAX_RIF_MAX) * sizeof(long));
 	cli->cl_mod_tag_bitmap = NULL;
+	if (cli->cl_lru_parts != NULL)
+		cfs_percpt_free(cli->cl_lru_parts);
+	cli->cl_lru_parts = NULL;
         RETURN(rc);
 
 }
@@ -549,6 +569,10 @@ int client_obd_cleanup(struct obd_device *obddev)
 			 BITS_TO_LONGS(OBD_MAX_RIF_MAX) * sizeof(long));
 	cli->cl_mod_tag_bitmap = NULL;
 
+	if (cli->cl_lru_parts != NULL)
+		cfs_percpt_free(cli->cl_lru_parts);
+	cli->cl_lru_parts = NULL;
+
 	RETURN(0);
 }
 EXPORT_SYMBOL(client_obd_cleanup);
@@ -2975,12 +2999,14 @@ void target_send_reply(struct ptlrpc_request *req, int rc, int fail_id)
 
 	atomic_inc(&svcpt->scp_nreps_difficult);
 
-	if (netrc != 0) {
+	if (netrc != 0 || req->rq_batched) {
 		/* error sending: reply is off the net.  Also we need +1
 		 * reply ref until ptlrpc_handle_rs() is done
 		 * with the reply state (if the send was successful, there
 		 * would have been +1 ref for the net, which
-		 * reply_out_callback leaves alone) */
+		 * reply_out_callback leaves alone).  The reply of a batched
+		 * request never goes on the net by itself, it is handled as
+		 * if already acked. */
 		rs->rs_on_net = 0;
 		ptlrpc_rs_addref(rs);
 	}
@@ -1526,6 +1526,49 @@ ll_do_fast_read(struct kiocb *iocb, struct iov_iter *iter)
 	return result;
 }
 
+/**
+ * Check whether a fast read which stopped at the end of file is complete.
+ *
+ * A read reaching the cached end of file normally goes through the cl_io
+ * stack to verify the size with a glimpse, even when all its data was
+ * served from the page cache. This is avoided when the layout lock is held
+ * and every stripe of the file is covered by a granted extent lock up to
+ * OBD_OBJECT_EOF, as the size can't change without one of these locks being
+ * revoked. The inode size is then refreshed from the object attributes.
+ *
+ * \param env - lu_env
+ * \param iocb - kiocb from kernel
+ *
+ * \retval true if the read is complete at the end of file
+ * \retval false if the read must go through the normal read path
+ */
+static bool ll_fast_read_eof(const struct lu_env *env, struct kiocb *iocb)
+{
+	struct inode *inode = file_inode(iocb->ki_filp);
+	struct ll_sb_info *sbi = ll_i2sbi(inode);
+	struct cl_object *obj = ll_i2info(inode)->lli_clob;
+	__u64 bits = MDS_INODELOCK_LAYOUT;
+
+	if (!ll_sbi_has_fast_read(sbi) || obj == NULL ||
+	    iocb->ki_filp->f_flags & O_DIRECT)
+		return false;
+
+	if (iocb->ki_pos < i_size_read(inode))
+		return false;
+
+	if (sbi->ll_flags & LL_SBI_LAYOUT_LOCK &&
+	    !ll_have_md_lock(inode, &bits, LCK_MINMODE))
+		return false;
+
+	if (cl_object_size_locked(env, obj) <= 0)
+		return false;
+
+	if (ll_merge_attr(env, inode) != 0)
+		return false;
+
+	return iocb->ki_pos >= i_size_read(inode);
+}
+
 /*
  * Read from a file (through the page cache).
  */
@@ -1545,6 +1588,9 @@ static ssize_t ll_file_read_iter(struct kiocb *iocb, struct iov_iter *to)
 	if (IS_ERR(env))
 		return PTR_ERR(env);
 
+	if (ll_fast_read_eof(env, iocb))
+		GOTO(out_env, result);
+
 	args = ll_env_args(env, IO_NORMAL);
 	args->u.normal.via_iter = to;
 	args->u.normal.via_iocb = iocb;
@@ -1556,6 +1602,7 @@ static ssize_t ll_file_read_iter(struct kiocb *iocb, struct iov_iter *to)
 	else if (result == 0)
 		result = rc2;
 
+out_env:
 	cl_env_put(env, &refcheck);
 out:
 	return result;
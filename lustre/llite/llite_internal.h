@@ -233,6 +233,8 @@ struct ll_inode_info {
 	struct rw_semaphore		lli_xattrs_list_rwsem;
 	struct mutex			lli_xattrs_enq_lock;
 	struct list_head		lli_xattrs; /* ll_xattr_entry->xe_list */
+	struct hlist_head		*lli_xattrs_hash; /* ll_xattr_entry->xe_hash
+							   * buckets */
 };
 
 static inline __u32 ll_layout_version_get(struct ll_inode_info *lli)
@@ -293,6 +295,7 @@ int ll_xattr_cache_get(struct inode *inode,
 			char *buffer,
 			size_t size,
 			__u64 valid);
+int ll_xattr_cache_prefetch(struct inode *inode);
 
 int ll_dentry_init_security(struct dentry *dentry, int mode, struct qstr *name,
 			    const char **secctx_name, void **secctx,
@@ -431,6 +434,7 @@ enum stats_track_type {
 #define LL_SBI_FAST_READ     0x400000 /* fast read support */
 #define LL_SBI_FILE_SECCTX   0x800000 /* set file security context at create */
 #define LL_SBI_PIO          0x1000000 /* parallel IO support */
+#define LL_SBI_SA_XATTR     0x2000000 /* prefetch xattrs in statahead */
 
 #define LL_SBI_FLAGS { 	\
 	"nolck",	\
@@ -458,6 +462,7 @@ enum stats_track_type {
 	"fast_read",	\
 	"file_secctx",	\
 	"pio",		\
+	"sa_xattr",	\
 }
 
 /* This is embedded into llite super-blocks to keep track of connect
@@ -529,6 +534,8 @@ struct ll_sb_info {
 	atomic_t		  ll_sa_running; /* running statahead thread
 						  * count */
 	atomic_t		  ll_agl_total;  /* AGL thread started count */
+	atomic_t		  ll_sa_xattr_total; /* inodes whose xattrs were
+						      * prefetched by statahead */
 
 	dev_t			  ll_sdev_orig; /* save s_dev before assign for
 						 * clustred nfs */
@@ -1171,6 +1178,9 @@ void ll_ra_stats_inc(struct inode *inode, enum ra_stat which);
 #define LL_SA_CACHE_SIZE        (1 << LL_SA_CACHE_BIT)
 #define LL_SA_CACHE_MASK        (LL_SA_CACHE_SIZE - 1)
 
+/* max count of inodes queued for xattr prefetch by one statahead thread */
+#define LL_SA_XATTR_BATCH	32
+
 /* per inode struct, for dir only */
 struct ll_statahead_info {
 	struct dentry	       *sai_dentry;
@@ -1212,6 +1222,10 @@ struct ll_statahead_info {
 	struct list_head	sai_cache[LL_SA_CACHE_SIZE];
 	spinlock_t		sai_cache_lock[LL_SA_CACHE_SIZE];
 	atomic_t		sai_cache_count; /* entry count in cache */
+	/* instantiated inodes whose xattrs are to be prefetched, protected
+	 * by parent lli_sa_lock, each holds an inode reference */
+	unsigned int		sai_xattr_count;
+	struct inode	       *sai_xattr_inodes[LL_SA_XATTR_BATCH];
 };
 
 int ll_statahead(struct inode *dir, struct dentry **dentry, bool unplug);
@@ -737,6 +737,38 @@ static ssize_t ll_statahead_agl_seq_write(struct file *file,
 }
 LPROC_SEQ_FOPS(ll_statahead_agl);
 
+static int ll_statahead_xattr_seq_show(struct seq_file *m, void *v)
+{
+	struct super_block *sb = m->private;
+	struct ll_sb_info *sbi = ll_s2sbi(sb);
+
+	seq_printf(m, "%u\n",
+		   sbi->ll_flags & LL_SBI_SA_XATTR ? 1 : 0);
+	return 0;
+}
+
+static ssize_t ll_statahead_xattr_seq_write(struct file *file,
+					    const char __user *buffer,
+					    size_t count, loff_t *off)
+{
+	struct seq_file *m = file->private_data;
+	struct ll_sb_info *sbi = ll_s2sbi((struct super_block *)m->private);
+	int rc;
+	__s64 val;
+
+	rc = lprocfs_str_to_s64(buffer, count, &val);
+	if (rc)
+		return rc;
+
+	if (val)
+		sbi->ll_flags |= LL_SBI_SA_XATTR;
+	else
+		sbi->ll_flags &= ~LL_SBI_SA_XATTR;
+
+	return count;
+}
+LPROC_SEQ_FOPS(ll_statahead_xattr);
+
 static int ll_statahead_stats_seq_show(struct seq_file *m, void *v)
 {
 	struct super_block *sb = m->private;
@@ -744,10 +776,12 @@ static int ll_statahead_stats_seq_show(struct seq_file *m, void *v)
 
 	seq_printf(m, "statahead total: %u\n"
 		    "statahead wrong: %u\n"
-		    "agl total: %u\n",
+		    "agl total: %u\n"
+		    "xattr prefetch: %u\n",
 		    atomic_read(&sbi->ll_sa_total),
 		    atomic_read(&sbi->ll_sa_wrong),
-		    atomic_read(&sbi->ll_agl_total));
+		    atomic_read(&sbi->ll_agl_total),
+		    atomic_read(&sbi->ll_sa_xattr_total));
 	return 0;
 }
 LPROC_SEQ_FOPS_RO(ll_statahead_stats);
@@ -1121,6 +1155,8 @@ struct lprocfs_vars lprocfs_llite_obd_vars[] = {
 	  .fops	=	&ll_statahead_max_fops			},
 	{ .name	=	"statahead_agl",
 	  .fops	=	&ll_statahead_agl_fops			},
+	{ .name	=	"statahead_xattr",
+	  .fops	=	&ll_statahead_xattr_fops		},
 	{ .name	=	"statahead_stats",
 	  .fops	=	&ll_statahead_stats_fops		},
 	{ .name	=	"lazystatfs",
@@ -392,6 +392,78 @@ static void ll_agl_add(struct ll_statahead_info *sai,
 		wake_up(&sai->sai_agl_thread.t_ctl_waitq);
 }
 
+static inline int sa_xattr_should_run(struct ll_statahead_info *sai,
+				      struct inode *inode)
+{
+	struct ll_sb_info *sbi = ll_i2sbi(sai->sai_dentry->d_inode);
+
+	return inode != NULL && sbi->ll_xattr_cache_enabled &&
+	       sbi->ll_flags & LL_SBI_SA_XATTR;
+}
+
+static inline int sa_xattr_full(struct ll_statahead_info *sai)
+{
+	return sai->sai_xattr_count >= LL_SA_XATTR_BATCH;
+}
+
+/* queue inode for xattr prefetch, the batch is flushed by statahead thread */
+static void sa_xattr_add(struct ll_statahead_info *sai, struct inode *inode)
+{
+	struct ll_inode_info *plli = ll_i2info(sai->sai_dentry->d_inode);
+
+	if (ll_file_test_flag(ll_i2info(inode), LLIF_XATTR_CACHE))
+		return;
+
+	inode = igrab(inode);
+	if (inode == NULL)
+		return;
+
+	spin_lock(&plli->lli_sa_lock);
+	if (!sa_xattr_full(sai)) {
+		sai->sai_xattr_inodes[sai->sai_xattr_count++] = inode;
+		inode = NULL;
+	}
+	spin_unlock(&plli->lli_sa_lock);
+
+	/* batch is full, statahead thread is too busy to prefetch this one */
+	if (inode != NULL)
+		iput(inode);
+}
+
+/*
+ * fill the xattr cache of all queued inodes, if @prefetch is false, just
+ * drop the queued inodes, this is used when statahead thread quits.
+ */
+static void sa_xattr_flush(struct ll_statahead_info *sai, bool prefetch)
+{
+	struct ll_inode_info *plli = ll_i2info(sai->sai_dentry->d_inode);
+	struct ll_sb_info *sbi = ll_i2sbi(sai->sai_dentry->d_inode);
+	struct inode *inode;
+	int rc;
+
+	while (1) {
+		spin_lock(&plli->lli_sa_lock);
+		if (sai->sai_xattr_count == 0) {
+			spin_unlock(&plli->lli_sa_lock);
+			break;
+		}
+		inode = sai->sai_xattr_inodes[--sai->sai_xattr_count];
+		spin_unlock(&plli->lli_sa_lock);
+
+		if (prefetch) {
+			rc = ll_xattr_cache_prefetch(inode);
+			if (rc == 0)
+				atomic_inc(&sbi->ll_sa_xattr_total);
+			else
+				CDEBUG(D_READA, "%s: prefetch xattr for "DFID
+				       " failed: rc = %d\n",
+				       ll_get_fsname(inode->i_sb, NULL, 0),
+				       PFID(ll_inode2fid(inode)), rc);
+		}
+		iput(inode);
+	}
+}
+
 /* allocate sai */
 static struct ll_statahead_info *ll_sai_alloc(struct dentry *dentry)
 {
@@ -483,6 +555,7 @@ static void ll_sai_put(struct ll_statahead_info *sai)
 
 		LASSERT(atomic_read(&sai->sai_cache_count) == 0);
 		LASSERT(agl_list_empty(sai));
+		LASSERT(sai->sai_xattr_count == 0);
 
 		ll_sai_free(sai);
 		atomic_dec(&sbi->ll_sa_running);
@@ -620,6 +693,9 @@ static void sa_instantiate(struct ll_statahead_info *sai,
         if (agl_should_run(sai, child))
                 ll_agl_add(sai, child, entry->se_index);
 
+	if (sa_xattr_should_run(sai, child))
+		sa_xattr_add(sai, child);
+
         EXIT;
 
 out:
@@ -860,6 +936,8 @@ static void sa_statahead(struct dentry *parent, const char *name, int len,
 		rc = sa_revalidate(dir, entry, dentry);
 		if (rc == 1 && agl_should_run(sai, dentry->d_inode))
 			ll_agl_add(sai, dentry->d_inode, entry->se_index);
+		if (rc == 1 && sa_xattr_should_run(sai, dentry->d_inode))
+			sa_xattr_add(sai, dentry->d_inode);
 	}
 
 	if (dentry != NULL)
@@ -1114,6 +1192,10 @@ static int ll_statahead_thread(void *arg)
 					spin_lock(&lli->lli_agl_lock);
 				}
 				spin_unlock(&lli->lli_agl_lock);
+
+				/* prefetch xattrs while waiting for replies */
+				if (sa_sent_full(sai) || sa_xattr_full(sai))
+					sa_xattr_flush(sai, true);
 			} while (sa_sent_full(sai) &&
 				 thread_is_running(sa_thread));
 
@@ -1156,6 +1238,7 @@ static int ll_statahead_thread(void *arg)
 			     &lwi);
 
 		sa_handle_callback(sai);
+		sa_xattr_flush(sai, true);
 	}
 
 	EXIT;
@@ -1188,6 +1271,7 @@ out:
 
 	/* release resources held by statahead RPCs */
 	sa_handle_callback(sai);
+	sa_xattr_flush(sai, false);
 
 	spin_lock(&lli->lli_sa_lock);
 	thread_set_flags(sa_thread, SVC_STOPPED);
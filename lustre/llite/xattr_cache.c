@@ -39,12 +39,19 @@
 #include <lustre_dlm.h>
 #include "llite_internal.h"
 
-/* If we ever have hundreds of extended attributes, we might want to consider
- * using a hash or a tree structure instead of list for faster lookups.
- */
+/* Number of hash buckets of the per-inode xattr cache, must be power of 2.
+ * Most files carry only a handful of xattrs, but with SELinux, ACLs, LOV/LMA
+ * and user xattrs a single getfattr may look up a dozen names, so hash them
+ * rather than scanning the whole list for each lookup. */
+#define LL_XATTR_HASH_BITS	4
+#define LL_XATTR_HASH_SIZE	(1 << LL_XATTR_HASH_BITS)
+#define LL_XATTR_HASH_MASK	(LL_XATTR_HASH_SIZE - 1)
+
 struct ll_xattr_entry {
 	struct list_head	xe_list;    /* protected with
 					     * lli_xattrs_list_rwsem */
+	struct hlist_node	xe_hash;    /* lli_xattrs_hash[] chain, also
+					     * protected by lli_xattrs_list_rwsem */
 	char			*xe_name;   /* xattr name, \0-terminated */
 	char			*xe_value;  /* xattr value */
 	unsigned		xe_namelen; /* strlen(xe_name) + 1 */
@@ -73,42 +80,79 @@ void ll_xattr_fini(void)
 	lu_kmem_fini(xattr_caches);
 }
 
+static inline struct hlist_head *
+ll_xattr_cache_bucket(struct ll_inode_info *lli, const char *xattr_name,
+		      unsigned int namelen)
+{
+	return &lli->lli_xattrs_hash[cfs_hash_djb2_hash(xattr_name, namelen,
+							LL_XATTR_HASH_MASK)];
+}
+
 /**
  * Initializes xattr cache for an inode.
  *
- * This initializes the xattr list and marks cache presence.
+ * This initializes the xattr list and hash and marks cache presence.
+ *
+ * \retval 0       success
+ * \retval -ENOMEM if no memory could be allocated for the hash buckets
  */
-static void ll_xattr_cache_init(struct ll_inode_info *lli)
+static int ll_xattr_cache_init(struct ll_inode_info *lli)
 {
+	int i;
+
 	ENTRY;
 
 	LASSERT(lli != NULL);
 
+	if (lli->lli_xattrs_hash == NULL) {
+		OBD_ALLOC(lli->lli_xattrs_hash,
+			  sizeof(*lli->lli_xattrs_hash) * LL_XATTR_HASH_SIZE);
+		if (lli->lli_xattrs_hash == NULL)
+			RETURN(-ENOMEM);
+	}
+
+	for (i = 0; i < LL_XATTR_HASH_SIZE; i++)
+		INIT_HLIST_HEAD(&lli->lli_xattrs_hash[i]);
 	INIT_LIST_HEAD(&lli->lli_xattrs);
 	ll_file_set_flag(lli, LLIF_XATTR_CACHE);
+
+	RETURN(0);
 }
 
 /**
  *  This looks for a specific extended attribute.
  *
- *  Find in @cache and return @xattr_name attribute in @xattr,
+ *  Find in the cache of @lli and return @xattr_name attribute in @xattr,
  *  for the NULL @xattr_name return the first cached @xattr.
  *
  *  \retval 0        success
  *  \retval -ENODATA if not found
  */
-static int ll_xattr_cache_find(struct list_head *cache,
+static int ll_xattr_cache_find(struct ll_inode_info *lli,
 			       const char *xattr_name,
 			       struct ll_xattr_entry **xattr)
 {
 	struct ll_xattr_entry *entry;
+	unsigned int namelen;
 
 	ENTRY;
 
-	list_for_each_entry(entry, cache, xe_list) {
-		/* xattr_name == NULL means look for any entry */
-		if (xattr_name == NULL ||
-		    strcmp(xattr_name, entry->xe_name) == 0) {
+	/* xattr_name == NULL means look for any entry */
+	if (xattr_name == NULL) {
+		if (list_empty(&lli->lli_xattrs))
+			RETURN(-ENODATA);
+
+		*xattr = list_entry(lli->lli_xattrs.next,
+				    struct ll_xattr_entry, xe_list);
+		RETURN(0);
+	}
+
+	namelen = strlen(xattr_name) + 1;
+	hlist_for_each_entry(entry,
+			     ll_xattr_cache_bucket(lli, xattr_name, namelen),
+			     xe_hash) {
+		if (entry->xe_namelen == namelen &&
+		    memcmp(xattr_name, entry->xe_name, namelen) == 0) {
 			*xattr = entry;
 			CDEBUG(D_CACHE, "find: [%s]=%.*s\n",
 			       entry->xe_name, entry->xe_vallen,
@@ -129,7 +173,7 @@ static int ll_xattr_cache_find(struct list_head *cache,
  * \retval -ENOMEM if no memory could be allocated for the cached attr
  * \retval -EPROTO if duplicate xattr is being added
  */
-static int ll_xattr_cache_add(struct list_head *cache,
+static int ll_xattr_cache_add(struct ll_inode_info *lli,
 			      const char *xattr_name,
 			      const char *xattr_val,
 			      unsigned xattr_val_len)
@@ -138,7 +182,7 @@ static int ll_xattr_cache_add(struct list_head *cache,
 
 	ENTRY;
 
-	if (ll_xattr_cache_find(cache, xattr_name, &xattr) == 0) {
+	if (ll_xattr_cache_find(lli, xattr_name, &xattr) == 0) {
 		CDEBUG(D_CACHE, "duplicate xattr: [%s]\n", xattr_name);
 		RETURN(-EPROTO);
 	}
@@ -167,7 +211,10 @@ static int ll_xattr_cache_add(struct list_head *cache,
 	memcpy(xattr->xe_name, xattr_name, xattr->xe_namelen);
 	memcpy(xattr->xe_value, xattr_val, xattr_val_len);
 	xattr->xe_vallen = xattr_val_len;
-	list_add(&xattr->xe_list, cache);
+	list_add(&xattr->xe_list, &lli->lli_xattrs);
+	hlist_add_head(&xattr->xe_hash,
+		       ll_xattr_cache_bucket(lli, xattr->xe_name,
+					     xattr->xe_namelen));
 
 	CDEBUG(D_CACHE, "set: [%s]=%.*s\n", xattr_name,
 		xattr_val_len, xattr_val);
@@ -184,12 +231,12 @@ err_name:
 /**
  * This removes an extended attribute from cache.
  *
- * Remove @xattr_name attribute from @cache.
+ * Remove @xattr_name attribute from the cache of @lli.
  *
  * \retval 0        success
  * \retval -ENODATA if @xattr_name is not cached
  */
-static int ll_xattr_cache_del(struct list_head *cache,
+static int ll_xattr_cache_del(struct ll_inode_info *lli,
 			      const char *xattr_name)
 {
 	struct ll_xattr_entry *xattr;
@@ -198,8 +245,9 @@ static int ll_xattr_cache_del(struct list_head *cache,
 
 	CDEBUG(D_CACHE, "del xattr: %s\n", xattr_name);
 
-	if (ll_xattr_cache_find(cache, xattr_name, &xattr) == 0) {
+	if (ll_xattr_cache_find(lli, xattr_name, &xattr) == 0) {
 		list_del(&xattr->xe_list);
+		hlist_del(&xattr->xe_hash);
 		OBD_FREE(xattr->xe_name, xattr->xe_namelen);
 		OBD_FREE(xattr->xe_value, xattr->xe_vallen);
 		OBD_SLAB_FREE_PTR(xattr, xattr_kmem);
@@ -274,11 +322,15 @@ static int ll_xattr_cache_destroy_locked(struct ll_inode_info *lli)
 	if (!ll_xattr_cache_valid(lli))
 		RETURN(0);
 
-	while (ll_xattr_cache_del(&lli->lli_xattrs, NULL) == 0)
+	while (ll_xattr_cache_del(lli, NULL) == 0)
 		/* empty loop */ ;
 
 	ll_file_clear_flag(lli, LLIF_XATTR_CACHE);
 
+	OBD_FREE(lli->lli_xattrs_hash,
+		 sizeof(*lli->lli_xattrs_hash) * LL_XATTR_HASH_SIZE);
+	lli->lli_xattrs_hash = NULL;
+
 	RETURN(0);
 }
 
@@ -427,7 +479,9 @@ static int ll_xattr_cache_refill(struct inode *inode)
 
 	CDEBUG(D_CACHE, "caching: xdata=%p xtail=%p\n", xdata, xtail);
 
-	ll_xattr_cache_init(lli);
+	rc = ll_xattr_cache_init(lli);
+	if (rc < 0)
+		GOTO(err_cancel, rc);
 
 	for (i = 0; i < body->mbo_max_mdsize; i++) {
 		CDEBUG(D_CACHE, "caching [%s]=%.*s\n", xdata, *xsizes, xval);
@@ -446,12 +500,15 @@ static int ll_xattr_cache_refill(struct inode *inode)
 			       XATTR_NAME_ACL_ACCESS);
 			rc = 0;
 		} else if (!strcmp(xdata, "security.selinux")) {
-			/* Filter out security.selinux, it is cached in slab */
+			/* Filter out security.selinux, it is cached in slab:
+			 * SELinux answers getxattr from the label of the
+			 * inode security blob, which it reads once when the
+			 * inode is instantiated, before statahead could
+			 * prefetch it */
 			CDEBUG(D_CACHE, "not caching security.selinux\n");
 			rc = 0;
 		} else {
-			rc = ll_xattr_cache_add(&lli->lli_xattrs, xdata, xval,
-						*xsizes);
+			rc = ll_xattr_cache_add(lli, xdata, xval, *xsizes);
 		}
 		if (rc < 0) {
 			ll_xattr_cache_destroy_locked(lli);
@@ -526,7 +583,7 @@ int ll_xattr_cache_get(struct inode *inode,
 	if (valid & OBD_MD_FLXATTR) {
 		struct ll_xattr_entry *xattr;
 
-		rc = ll_xattr_cache_find(&lli->lli_xattrs, name, &xattr);
+		rc = ll_xattr_cache_find(lli, name, &xattr);
 		if (rc == 0) {
 			rc = xattr->xe_vallen;
 			/* zero size means we are only requested size in rc */
@@ -550,3 +607,36 @@ out:
 	RETURN(rc);
 }
 
+/**
+ * Prefetch all xattrs of @inode into the xattr cache.
+ *
+ * Called by the statahead thread for the entries it has instantiated, so
+ * that getxattr/listxattr calls of a tree walker ("getfattr -R", relabeling)
+ * which follows the statahead are served from the cache without a blocking
+ * RPC on each inode.
+ *
+ * \retval 0        cache is filled, or was already valid
+ * \retval negative error returned by ll_xattr_cache_refill()
+ */
+int ll_xattr_cache_prefetch(struct inode *inode)
+{
+	struct ll_inode_info *lli = ll_i2info(inode);
+	int rc;
+
+	ENTRY;
+
+	if (!ll_i2sbi(inode)->ll_xattr_cache_enabled)
+		RETURN(0);
+
+	down_read(&lli->lli_xattrs_list_rwsem);
+	rc = ll_xattr_cache_valid(lli);
+	up_read(&lli->lli_xattrs_list_rwsem);
+	if (rc)
+		RETURN(0);
+
+	rc = ll_xattr_cache_refill(inode);
+	if (rc == 0)
+		up_write(&lli->lli_xattrs_list_rwsem);
+
+	RETURN(rc);
+}
@@ -2042,6 +2042,60 @@ static loff_t lov_object_maxbytes(struct cl_object *obj)
 	return maxbytes;
 }
 
+/**
+ * Implementation of struct cl_object_operations::coo_size_locked() for lov
+ * layer.
+ *
+ * The size is locked if every instantiated stripe object is covered by a
+ * granted extent lock. Components that are not instantiated yet can't hold
+ * data without a layout change, which revokes the layout lock of the file.
+ * Mirrored and DoM layouts are not handled and always need a glimpse.
+ */
+static int lov_object_size_locked(const struct lu_env *env,
+				  struct cl_object *obj)
+{
+	struct lov_object *lov = cl2lov(obj);
+	struct lov_layout_entry *entry;
+	int rc = 1;
+	ENTRY;
+
+	down_read(&lov->lo_type_guard);
+	if (lov->lo_type != LLT_COMP || lov->lo_layout_invalid ||
+	    lov_is_flr(lov))
+		GOTO(out, rc = 0);
+
+	lov_foreach_layout_entry(lov, entry) {
+		struct lov_layout_raid0 *r0 = &entry->lle_raid0;
+		int index = lov_layout_entry_index(lov, entry);
+		int i;
+
+		if (!entry->lle_valid)
+			continue;
+
+		/* PFL: This component has not been init-ed. */
+		if (!lsm_entry_inited(lov->lo_lsm, index))
+			continue;
+
+		if (lsme_is_dom(lov_lse(lov, index)))
+			GOTO(out, rc = 0);
+
+		for (i = 0; i < r0->lo_nr; i++) {
+			struct lovsub_object *sub = r0->lo_sub[i];
+
+			if (sub == NULL)
+				GOTO(out, rc = 0);
+
+			rc = cl_object_size_locked(env, lovsub2cl(sub));
+			if (rc <= 0)
+				GOTO(out, rc);
+		}
+	}
+	EXIT;
+out:
+	up_read(&lov->lo_type_guard);
+	return rc;
+}
+
 static const struct cl_object_operations lov_ops = {
 	.coo_page_init    = lov_page_init,
 	.coo_lock_init    = lov_lock_init,
@@ -2053,6 +2107,7 @@ static const struct cl_object_operations lov_ops = {
 	.coo_layout_get   = lov_object_layout_get,
 	.coo_maxbytes     = lov_object_maxbytes,
 	.coo_fiemap       = lov_object_fiemap,
+	.coo_size_locked  = lov_object_size_locked,
 };
 
 static const struct lu_object_operations lov_lu_obj_ops = {
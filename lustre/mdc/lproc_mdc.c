@@ -302,6 +302,43 @@ static ssize_t mdc_max_mod_rpcs_in_flight_seq_write(struct file *file,
 }
 LPROC_SEQ_FOPS(mdc_max_mod_rpcs_in_flight);
 
+static int mdc_max_batch_count_seq_show(struct seq_file *m, void *v)
+{
+	struct obd_device *dev = m->private;
+	struct client_obd *cli = &dev->u.cli;
+
+	seq_printf(m, "%hu\n", cli->cl_max_batch_count);
+
+	return 0;
+}
+
+/* 0 or 1 disable batching of modify RPCs */
+static ssize_t mdc_max_batch_count_seq_write(struct file *file,
+					     const char __user *buffer,
+					     size_t count, loff_t *off)
+{
+	struct obd_device *dev;
+	struct client_obd *cli;
+	__s64 val;
+	int rc;
+
+	dev =  ((struct seq_file *)file->private_data)->private;
+	cli = &dev->u.cli;
+	rc = lprocfs_str_to_s64(buffer, count, &val);
+	if (rc)
+		return rc;
+
+	if (val < 0 || val > REINT_BATCH_MAX_REQS)
+		return -ERANGE;
+
+	spin_lock(&cli->cl_mod_rpcs_lock);
+	cli->cl_max_batch_count = val;
+	spin_unlock(&cli->cl_mod_rpcs_lock);
+
+	return count;
+}
+LPROC_SEQ_FOPS(mdc_max_batch_count);
+
 static ssize_t mdc_rpc_stats_seq_write(struct file *file,
 				       const char __user *buf,
 				       size_t len, loff_t *off)
@@ -477,6 +514,8 @@ struct lprocfs_vars lprocfs_mdc_obd_vars[] = {
 	  .fops	=	&mdc_max_rpcs_in_flight_fops	},
 	{ .name	=	"max_mod_rpcs_in_flight",
 	  .fops	=	&mdc_max_mod_rpcs_in_flight_fops },
+	{ .name	=	"max_batch_count",
+	  .fops	=	&mdc_max_batch_count_fops	},
 	{ .name	=	"max_dirty_mb",
 	  .fops	=	&mdc_max_dirty_mb_fops		},
 	{ .name	=	"mdc_cached_mb",
@@ -39,6 +39,350 @@
 #include "mdc_internal.h"
 #include <lustre_fid.h>
 
+/* a reint waiting to be sent in an MDS_REINT_BATCH RPC */
+struct mdc_batch_waiter {
+	struct list_head	 bw_list;
+	struct ptlrpc_request	*bw_req;
+	wait_queue_head_t	 bw_waitq;
+	int			 bw_rc;
+	/* the following are protected by cl_mod_rpcs_lock */
+	bool			 bw_leader;	/* sends the next batch */
+	bool			 bw_done;	/* request was sent */
+	bool			 bw_alone;	/* to be sent again alone */
+	bool			 bw_resend;	/* batch may have executed it */
+};
+
+/* Check if a reint can be sent together with others in one MDS_REINT_BATCH */
+static bool mdc_batch_eligible(struct client_obd *cli,
+			       struct ptlrpc_request *req)
+{
+	struct obd_import *imp = req->rq_import;
+	struct mdt_rec_reint *rec;
+
+	if (cli->cl_max_batch_count < 2 ||
+	    req->rq_send_state != LUSTRE_IMP_FULL ||
+	    req->rq_generation_set || req->rq_bulk != NULL ||
+	    !imp_connect_reint_batch(imp) ||
+	    !(imp->imp_connect_data.ocd_connect_flags &
+	      OBD_CONNECT_MULTIMODRPCS) ||
+	    SPTLRPC_FLVR_POLICY(req->rq_flvr.sf_rpc) == SPTLRPC_POLICY_GSS ||
+	    req->rq_reqlen > MDS_REINT_BATCH_MAXREQSIZE / 4)
+		return false;
+
+	rec = req_capsule_client_get(&req->rq_pill, &RMF_REC_REINT);
+	if (rec == NULL)
+		return false;
+
+	return rec->rr_opcode == REINT_SETATTR ||
+	       rec->rr_opcode == REINT_CREATE ||
+	       rec->rr_opcode == REINT_UNLINK;
+}
+
+/* Check if the waiter can go on, the lock makes sure that whoever woke it
+ * up is done with it */
+static bool mdc_batch_waiter_ready(struct client_obd *cli,
+				   struct mdc_batch_waiter *bw)
+{
+	bool ready;
+
+	spin_lock(&cli->cl_mod_rpcs_lock);
+	ready = bw->bw_done || bw->bw_leader;
+	spin_unlock(&cli->cl_mod_rpcs_lock);
+
+	return ready;
+}
+
+/**
+ * Parse the reply of an MDS_REINT_BATCH RPC and complete the requests it has a
+ * reply for.
+ *
+ * \retval		0 on success
+ * \retval		-EPROTO if the reply is malformed
+ */
+static int mdc_batch_interpret(struct ptlrpc_request *req,
+			       struct list_head *batch)
+{
+	struct reint_batch_reply	*rbp;
+	struct mdc_batch_waiter		*bw;
+	char				*buf;
+	int				 size;
+	int				 i;
+
+	ENTRY;
+
+	rbp = req_capsule_server_get(&req->rq_pill, &RMF_REINT_BATCH_REPLY);
+	if (rbp == NULL || rbp->rbp_magic != REINT_BATCH_REPLY_MAGIC)
+		RETURN(-EPROTO);
+
+	buf = (char *)(rbp + 1);
+	size = req_capsule_get_size(&req->rq_pill, &RMF_REINT_BATCH_REPLY,
+				    RCL_SERVER) - sizeof(*rbp);
+
+	for (i = 0; i < rbp->rbp_count; i++) {
+		struct reint_batch_result *rbs;
+		int len;
+
+		if (size < (int)sizeof(*rbs))
+			RETURN(-EPROTO);
+
+		rbs = (struct reint_batch_result *)buf;
+		if (ptlrpc_rep_need_swab(req)) {
+			__swab64s(&rbs->rbs_xid);
+			__swab32s(&rbs->rbs_replen);
+		}
+		buf += sizeof(*rbs);
+		size -= sizeof(*rbs);
+
+		len = rbs->rbs_replen;
+		if (len <= 0 || cfs_size_round(len) > size)
+			RETURN(-EPROTO);
+
+		list_for_each_entry(bw, batch, bw_list) {
+			if (bw->bw_req->rq_xid != rbs->rbs_xid ||
+			    !bw->bw_alone)
+				continue;
+
+			bw->bw_rc = ptlrpc_batch_subreq_reply(bw->bw_req,
+						(struct lustre_msg *)buf, len);
+			/* not completed on -EINPROGRESS or bad reply */
+			if (bw->bw_req->rq_replied)
+				bw->bw_alone = false;
+			/* not executed, and sent again with a new XID */
+			else if (bw->bw_rc == -EAGAIN)
+				bw->bw_resend = false;
+			break;
+		}
+		buf += cfs_size_round(len);
+		size -= cfs_size_round(len);
+	}
+
+	RETURN(0);
+}
+
+/**
+ * Send the reints of \a batch in one MDS_REINT_BATCH RPC.
+ *
+ * The requests are copied whole into the RPC, as if they were sent alone,
+ * and each of them is completed with its own reply from the batch reply.
+ * Requests left without reply are marked to be sent again alone.
+ *
+ * \param[in] cli	client obd
+ * \param[in] batch	list of mdc_batch_waiter
+ * \param[in] count	number of requests in \a batch
+ * \param[in] size	size of the batch buffer
+ * \param[in] tag	modify RPC slot of the batch
+ */
+static void mdc_batch_send(struct client_obd *cli, struct list_head *batch,
+			   int count, int size, __u16 tag)
+{
+	struct obd_import		*imp = cli->cl_import;
+	struct reint_batch_header	*rbh;
+	struct mdc_batch_waiter		*bw;
+	struct ptlrpc_request		*req;
+	char				*buf;
+	int				 repsize;
+	int				 rc;
+
+	ENTRY;
+
+	list_for_each_entry(bw, batch, bw_list) {
+		bw->bw_alone = true;
+		bw->bw_resend = true;
+	}
+
+	req = ptlrpc_request_alloc(imp, &RQF_MDS_REINT_BATCH);
+	if (req == NULL)
+		RETURN_EXIT;
+
+	req_capsule_set_size(&req->rq_pill, &RMF_REINT_BATCH_BUF, RCL_CLIENT, size);
+	rc = ptlrpc_request_pack(req, LUSTRE_MDS_VERSION, MDS_REINT_BATCH);
+	if (rc) {
+		ptlrpc_request_free(req);
+		RETURN_EXIT;
+	}
+
+	buf = req_capsule_client_get(&req->rq_pill, &RMF_REINT_BATCH_BUF);
+	repsize = sizeof(struct reint_batch_reply);
+	list_for_each_entry(bw, batch, bw_list) {
+		struct ptlrpc_request *sub = bw->bw_req;
+		struct reint_batch_request *rbq;
+
+		/* done by ptl_send_rpc() for a request sent alone */
+		lustre_msg_set_handle(sub->rq_reqmsg, &imp->imp_remote_handle);
+		lustre_msg_set_type(sub->rq_reqmsg, PTL_RPC_MSG_REQUEST);
+		lustre_msg_set_conn_cnt(sub->rq_reqmsg, imp->imp_conn_cnt);
+
+		rbq = (struct reint_batch_request *)buf;
+		rbq->rbq_xid = sub->rq_xid;
+		rbq->rbq_reqlen = sub->rq_reqlen;
+		rbq->rbq_padding = 0;
+		memcpy(rbq + 1, sub->rq_reqmsg, sub->rq_reqlen);
+		buf += sizeof(*rbq) + cfs_size_round(sub->rq_reqlen);
+
+		repsize += sizeof(struct reint_batch_result) +
+			   cfs_size_round(sub->rq_replen);
+	}
+
+	rbh = req_capsule_client_get(&req->rq_pill, &RMF_REINT_BATCH_HEADER);
+	rbh->rbh_magic = REINT_BATCH_MAGIC;
+	rbh->rbh_count = count;
+	rbh->rbh_reply_size = min(repsize, MDS_REINT_BATCH_MAXREPSIZE);
+	rbh->rbh_padding = 0;
+
+	req_capsule_set_size(&req->rq_pill, &RMF_REINT_BATCH_REPLY, RCL_SERVER,
+			     rbh->rbh_reply_size);
+	ptlrpc_request_set_replen(req);
+	lustre_msg_set_tag(req->rq_reqmsg, tag);
+
+	rc = ptlrpc_queue_wait(req);
+	if (rc == 0)
+		rc = mdc_batch_interpret(req, batch);
+	if (rc)
+		CDEBUG(D_INFO, "%s: batch of %d reints failed: rc = %d\n",
+		       imp->imp_obd->obd_name, count, rc);
+
+	/* requests without reply might have been executed, the server
+	 * reconstructs their reply when they are resent */
+	list_for_each_entry(bw, batch, bw_list) {
+		struct ptlrpc_request *sub = bw->bw_req;
+
+		if (!bw->bw_alone || !bw->bw_resend)
+			continue;
+
+		if (!sub->rq_generation_set) {
+			sub->rq_generation_set = 1;
+			sub->rq_import_generation = req->rq_import_generation;
+		}
+	}
+	ptlrpc_req_finished(req);
+	EXIT;
+}
+
+/**
+ * Lead the batch of reints the waiter \a leader is at the head of.
+ *
+ * Once a modify RPC slot is available, as many waiting requests as allowed
+ * are taken and the next waiter, if any, takes over the lead for the
+ * following batch.  A single request is sent alone.
+ */
+static void mdc_batch_lead(struct client_obd *cli,
+			   struct mdc_batch_waiter *leader)
+{
+	struct mdc_batch_waiter	*bw;
+	struct mdc_batch_waiter	*tmp;
+	struct list_head	 batch = LIST_HEAD_INIT(batch);
+	__u16			 tag;
+	int			 count = 0;
+	int			 size = 0;
+
+	ENTRY;
+
+	tag = obd_get_mod_rpc_slot(cli, MDS_REINT, NULL);
+
+	spin_lock(&cli->cl_mod_rpcs_lock);
+	LASSERT(cli->cl_batch_list.next == &leader->bw_list);
+	while (!list_empty(&cli->cl_batch_list) &&
+	       count < max_t(int, cli->cl_max_batch_count, 1)) {
+		int len;
+
+		bw = list_entry(cli->cl_batch_list.next,
+				struct mdc_batch_waiter, bw_list);
+		len = sizeof(struct reint_batch_request) +
+		      cfs_size_round(bw->bw_req->rq_reqlen);
+		if (count > 0 && size + len > MDS_REINT_BATCH_MAXREQSIZE)
+			break;
+
+		list_move_tail(&bw->bw_list, &batch);
+		size += len;
+		count++;
+	}
+	leader->bw_leader = false;
+	if (!list_empty(&cli->cl_batch_list)) {
+		bw = list_entry(cli->cl_batch_list.next,
+				struct mdc_batch_waiter, bw_list);
+		bw->bw_leader = true;
+		wake_up(&bw->bw_waitq);
+	}
+	spin_unlock(&cli->cl_mod_rpcs_lock);
+
+	if (count == 1) {
+		lustre_msg_set_tag(leader->bw_req->rq_reqmsg, tag);
+		leader->bw_rc = ptlrpc_queue_wait(leader->bw_req);
+		leader->bw_alone = false;
+	} else {
+		mdc_batch_send(cli, &batch, count, size, tag);
+	}
+	obd_put_mod_rpc_slot(cli, MDS_REINT, NULL, tag);
+
+	spin_lock(&cli->cl_mod_rpcs_lock);
+	list_for_each_entry_safe(bw, tmp, &batch, bw_list) {
+		list_del_init(&bw->bw_list);
+		bw->bw_done = true;
+		if (bw != leader)
+			wake_up(&bw->bw_waitq);
+	}
+	spin_unlock(&cli->cl_mod_rpcs_lock);
+	EXIT;
+}
+
+/**
+ * Send a reint in an MDS_REINT_BATCH RPC together with the other reints waiting
+ * for a modify RPC slot.
+ *
+ * Batching only starts when all the modify RPC slots are in use, so it
+ * does not delay anything: requests that would wait for a slot anyway
+ * share the next one.
+ *
+ * \param[in] req	reint request
+ * \param[out] rc	status of the request if it was sent
+ *
+ * \retval		true if the request was completed in a batch
+ * \retval		false if it has to be sent alone
+ */
+static bool mdc_batch_reint(struct ptlrpc_request *req, int *rc)
+{
+	struct client_obd	*cli = &req->rq_import->imp_obd->u.cli;
+	struct mdc_batch_waiter	 bw = { .bw_req = req };
+	struct l_wait_info	 lwi = { 0 };
+
+	if (!mdc_batch_eligible(cli, req))
+		return false;
+
+	INIT_LIST_HEAD(&bw.bw_list);
+	init_waitqueue_head(&bw.bw_waitq);
+	/* done by ptlrpc_set_add_req() for a request sent alone */
+	lustre_msg_set_jobid(req->rq_reqmsg, NULL);
+
+	spin_lock(&cli->cl_mod_rpcs_lock);
+	if (list_empty(&cli->cl_batch_list)) {
+		if (cli->cl_mod_rpcs_in_flight <
+		    cli->cl_max_mod_rpcs_in_flight) {
+			spin_unlock(&cli->cl_mod_rpcs_lock);
+			return false;
+		}
+		bw.bw_leader = true;
+	}
+	list_add_tail(&bw.bw_list, &cli->cl_batch_list);
+	spin_unlock(&cli->cl_mod_rpcs_lock);
+
+	while (1) {
+		l_wait_event(bw.bw_waitq, mdc_batch_waiter_ready(cli, &bw),
+			     &lwi);
+		if (bw.bw_done)
+			break;
+		mdc_batch_lead(cli, &bw);
+	}
+
+	if (bw.bw_alone) {
+		if (bw.bw_resend)
+			lustre_msg_add_flags(req->rq_reqmsg, MSG_RESENT);
+		return false;
+	}
+
+	*rc = bw.bw_rc;
+	return true;
+}
+
 /* mdc_setattr does its own semaphore handling */
 static int mdc_reint(struct ptlrpc_request *request, int level)
 {
@@ -46,9 +390,11 @@ static int mdc_reint(struct ptlrpc_request *request, int level)
 
         request->rq_send_state = level;
 
-	mdc_get_mod_rpc_slot(request, NULL);
-	rc = ptlrpc_queue_wait(request);
-	mdc_put_mod_rpc_slot(request, NULL);
+	if (!mdc_batch_reint(request, &rc)) {
+		mdc_get_mod_rpc_slot(request, NULL);
+		rc = ptlrpc_queue_wait(request);
+		mdc_put_mod_rpc_slot(request, NULL);
+	}
         if (rc)
                 CDEBUG(D_INFO, "error in handling %d\n", rc);
         else if (!req_capsule_server_get(&request->rq_pill, &RMF_MDT_BODY)) {
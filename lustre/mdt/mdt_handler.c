@@ -4850,6 +4850,7 @@ TGT_MDT_HDL(HABEO_CORPUS| HABEO_REFERO, MDS_HSM_REQUEST,
 TGT_MDT_HDL(HABEO_CLAVIS | HABEO_CORPUS | HABEO_REFERO | MUTABOR,
 	    MDS_SWAP_LAYOUTS,
 	    mdt_swap_layouts),
+TGT_MDT_HDL(0		| MUTABOR,	MDS_REINT_BATCH,	tgt_batch),
 };
 
 static struct tgt_handler mdt_io_ops[] = {
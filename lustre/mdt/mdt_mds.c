@@ -162,12 +162,15 @@ static int mds_start_ptlrpc_service(struct mds_device *m)
 		.psc_name		= LUSTRE_MDT_NAME,
 		.psc_watchdog_factor	= MDT_SERVICE_WATCHDOG_FACTOR,
 		.psc_buf		= {
-			.bc_nbufs		= MDS_NBUFS,
+			.bc_nbufs		= MDS_LARGE_NBUFS,
 			.bc_buf_size		= MDS_REG_BUFSIZE,
 			.bc_req_max_size	= MDS_REG_MAXREQSIZE,
 			.bc_rep_max_size	= MDS_REG_MAXREPSIZE,
 			.bc_req_portal		= MDS_REQUEST_PORTAL,
 			.bc_rep_portal		= MDC_REPLY_PORTAL,
+			.bc_small_nbufs		= MDS_SMALL_NBUFS,
+			.bc_small_buf_size	= MDS_SMALL_BUFSIZE,
+			.bc_small_req_max_size	= MDS_SMALL_MAXREQSIZE,
 		},
 		/*
 		 * We'd like to have a mechanism to set this on a per-device
@@ -299,12 +302,15 @@ static int mds_start_ptlrpc_service(struct mds_device *m)
 		.psc_name		= LUSTRE_MDT_NAME "_out",
 		.psc_watchdog_factor	= MDT_SERVICE_WATCHDOG_FACTOR,
 		.psc_buf		= {
-			.bc_nbufs		= MDS_NBUFS,
+			.bc_nbufs		= MDS_LARGE_NBUFS,
 			.bc_buf_size		= OUT_BUFSIZE,
 			.bc_req_max_size	= OUT_MAXREQSIZE,
 			.bc_rep_max_size	= OUT_MAXREPSIZE,
 			.bc_req_portal		= OUT_PORTAL,
 			.bc_rep_portal		= OSC_REPLY_PORTAL,
+			.bc_small_nbufs		= MDS_SMALL_NBUFS,
+			.bc_small_buf_size	= MDS_SMALL_BUFSIZE,
+			.bc_small_req_max_size	= MDS_SMALL_MAXREQSIZE,
 		},
 		/*
 		 * We'd like to have a mechanism to set this on a per-device
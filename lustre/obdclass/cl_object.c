@@ -422,6 +422,28 @@ loff_t cl_object_maxbytes(struct cl_object *obj)
 }
 EXPORT_SYMBOL(cl_object_maxbytes);
 
+/**
+ * Check whether the object size is covered by cached DLM locks.
+ *
+ * The first layer implementing the method answers; objects without such a
+ * layer are reported as unlocked.
+ *
+ * \see cl_object_operations::coo_size_locked()
+ */
+int cl_object_size_locked(const struct lu_env *env, struct cl_object *obj)
+{
+	struct lu_object_header *top = obj->co_lu.lo_header;
+	ENTRY;
+
+	list_for_each_entry(obj, &top->loh_layers, co_lu.lo_linkage) {
+		if (obj->co_ops->coo_size_locked != NULL)
+			RETURN(obj->co_ops->coo_size_locked(env, obj));
+	}
+
+	RETURN(0);
+}
+EXPORT_SYMBOL(cl_object_size_locked);
+
 /**
  * Helper function removing all object locks, and marking object for
  * deletion. All object pages must have been deleted at this point.
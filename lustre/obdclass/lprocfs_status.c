@@ -845,10 +845,11 @@ static const char *obd_connect_names[] = {
 	"bulk_mbits",
 	"compact_obdo",
 	"second_flags",
-	/* flags2 names */
-	"file_secctx",
-	"lockaheadv2",
-	NULL
+	/* flags2 names, unused bits have none */
+	[64 + 0]	= "file_secctx",
+	[64 + 1]	= "lockaheadv2",
+	[64 + 48]	= "multiobj_brw",
+	[64 + 49]	= "reint_batch",
 };
 
 static void obd_connect_seq_flags2str(struct seq_file *m, __u64 flags,
@@ -875,17 +876,19 @@ static void obd_connect_seq_flags2str(struct seq_file *m, __u64 flags,
 	if (!(flags & OBD_CONNECT_FLAGS2) || flags2 == 0)
 		return;
 
-	for (i = 64, mask = 1; obd_connect_names[i] != NULL; i++, mask <<= 1) {
-		if (flags2 & mask) {
+	for (i = 64, mask = 1; i < ARRAY_SIZE(obd_connect_names);
+	     i++, mask <<= 1) {
+		if ((flags2 & mask) && obd_connect_names[i] != NULL) {
 			seq_printf(m, "%s%s",
 				   first ? "" : sep, obd_connect_names[i]);
+			flags2 &= ~mask;
 			first = false;
 		}
 	}
 
-	if (flags2 & ~(mask - 1)) {
+	if (flags2 != 0) {
 		seq_printf(m, "%sunknown2_%#llx",
-			   first ? "" : sep, flags2 & ~(mask - 1));
+			   first ? "" : sep, flags2);
 		first = false;
 	}
 }
@@ -910,16 +913,19 @@ int obd_connect_flags2str(char *page, int count, __u64 flags, __u64 flags2,
 	if (!(flags & OBD_CONNECT_FLAGS2) || flags2 == 0)
 		return ret;
 
-	for (i = 64, mask = 1; obd_connect_names[i] != NULL; i++, mask <<= 1) {
-		if (flags2 & mask)
+	for (i = 64, mask = 1; i < ARRAY_SIZE(obd_connect_names);
+	     i++, mask <<= 1) {
+		if ((flags2 & mask) && obd_connect_names[i] != NULL) {
 			ret += snprintf(page + ret, count - ret, "%s%s",
 					ret ? sep : "", obd_connect_names[i]);
+			flags2 &= ~mask;
+		}
 	}
 
-	if (flags2 & ~(mask - 1))
+	if (flags2 != 0)
 		ret += snprintf(page + ret, count - ret,
 				"%sunknown2_%#llx",
-				ret ? sep : "", flags2 & ~(mask - 1));
+				ret ? sep : "", flags2);
 
 	return ret;
 }
@@ -2424,6 +2430,10 @@ ssize_t lprocfs_obd_max_pages_per_rpc_seq_write(struct file *file,
 	}
 	spin_lock(&cli->cl_loi_list_lock);
 	cli->cl_max_pages_per_rpc = val;
+	/* the adaptive controller goes on from there and restores this
+	 * value when it stops */
+	if (cli->cl_rpc_ctrl.crc_enabled)
+		cli->cl_rpc_ctrl.crc_saved_pages = val;
 	client_adjust_max_dirty(cli);
 	spin_unlock(&cli->cl_loi_list_lock);
 
@@ -122,6 +122,10 @@ static ssize_t osc_max_rpcs_in_flight_seq_write(struct file *file,
 
 	spin_lock(&cli->cl_loi_list_lock);
 	cli->cl_max_rpcs_in_flight = val;
+	/* the adaptive controller goes on from there and restores this
+	 * value when it stops */
+	if (cli->cl_rpc_ctrl.crc_enabled)
+		cli->cl_rpc_ctrl.crc_saved_rif = val;
 	client_adjust_max_dirty(cli);
 	spin_unlock(&cli->cl_loi_list_lock);
 
@@ -130,6 +134,58 @@ static ssize_t osc_max_rpcs_in_flight_seq_write(struct file *file,
 }
 LPROC_SEQ_FOPS(osc_max_rpcs_in_flight);
 
+static int osc_rpc_autotune_seq_show(struct seq_file *m, void *v)
+{
+	struct obd_device *dev = m->private;
+
+	seq_printf(m, "%d\n", dev->u.cli.cl_rpc_ctrl.crc_enabled ? 1 : 0);
+	return 0;
+}
+
+static ssize_t osc_rpc_autotune_seq_write(struct file *file,
+					  const char __user *buffer,
+					  size_t count, loff_t *off)
+{
+	struct obd_device *dev = ((struct seq_file *)file->private_data)->private;
+	int rc;
+	__s64 val;
+
+	rc = lprocfs_str_to_s64(buffer, count, &val);
+	if (rc)
+		return rc;
+
+	LPROCFS_CLIMP_CHECK(dev);
+	osc_rpc_ctrl_enable(&dev->u.cli, !!val);
+	LPROCFS_CLIMP_EXIT(dev);
+
+	return count;
+}
+LPROC_SEQ_FOPS(osc_rpc_autotune);
+
+static int osc_rpc_autotune_stats_seq_show(struct seq_file *m, void *v)
+{
+	struct obd_device *dev = m->private;
+	struct client_obd *cli = &dev->u.cli;
+	struct cl_rpc_ctrl *crc = &cli->cl_rpc_ctrl;
+
+	spin_lock(&cli->cl_loi_list_lock);
+	seq_printf(m, "enabled:            %d\n"
+		   "rpcs_in_flight:     %u\n"
+		   "pages_per_rpc:      %u\n"
+		   "srtt_us:            %llu\n"
+		   "base_rtt_us:        %llu\n"
+		   "at_base:            %u\n"
+		   "increases:          %llu\n"
+		   "decreases:          %llu\n",
+		   crc->crc_enabled ? 1 : 0, cli->cl_max_rpcs_in_flight,
+		   cli->cl_max_pages_per_rpc, crc->crc_srtt_us,
+		   crc->crc_base_rtt_us, crc->crc_at_base,
+		   crc->crc_increases, crc->crc_decreases);
+	spin_unlock(&cli->cl_loi_list_lock);
+	return 0;
+}
+LPROC_SEQ_FOPS_RO(osc_rpc_autotune_stats);
+
 static int osc_max_dirty_mb_seq_show(struct seq_file *m, void *v)
 {
 	struct obd_device *dev = m->private;
@@ -470,6 +526,36 @@ static ssize_t osc_resend_count_seq_write(struct file *file,
 }
 LPROC_SEQ_FOPS(osc_resend_count);
 
+static int osc_max_objs_per_rpc_seq_show(struct seq_file *m, void *v)
+{
+	struct obd_device *obd = m->private;
+
+	seq_printf(m, "%u\n", obd->u.cli.cl_max_objs_per_rpc);
+	return 0;
+}
+
+static ssize_t osc_max_objs_per_rpc_seq_write(struct file *file,
+					      const char __user *buffer,
+					      size_t count, loff_t *off)
+{
+	struct obd_device *obd = ((struct seq_file *)file->private_data)->private;
+	int rc;
+	__s64 val;
+
+	rc = lprocfs_str_to_s64(buffer, count, &val);
+	if (rc)
+		return rc;
+
+	/* 1 disables coalescing of several objects in one write RPC */
+	if (val < 1 || val > PTLRPC_MAX_BRW_OBJS)
+		return -ERANGE;
+
+	obd->u.cli.cl_max_objs_per_rpc = val;
+
+	return count;
+}
+LPROC_SEQ_FOPS(osc_max_objs_per_rpc);
+
 static int osc_checksum_dump_seq_show(struct seq_file *m, void *v)
 {
 	struct obd_device *obd = m->private;
@@ -620,8 +706,14 @@ struct lprocfs_vars lprocfs_osc_obd_vars[] = {
 	  .fops	=	&osc_obd_max_pages_per_rpc_fops	},
 	{ .name	=	"short_io_bytes",
 	  .fops	=	&osc_obd_short_io_bytes_fops	},
+	{ .name	=	"max_objs_per_rpc",
+	  .fops	=	&osc_max_objs_per_rpc_fops	},
 	{ .name	=	"max_rpcs_in_flight",
 	  .fops	=	&osc_max_rpcs_in_flight_fops	},
+	{ .name	=	"rpc_autotune",
+	  .fops	=	&osc_rpc_autotune_fops		},
+	{ .name	=	"rpc_autotune_stats",
+	  .fops	=	&osc_rpc_autotune_stats_fops	},
 	{ .name	=	"destroys_in_flight",
 	  .fops	=	&osc_destroys_in_flight_fops	},
 	{ .name	=	"max_dirty_mb",
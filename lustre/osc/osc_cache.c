@@ -2028,40 +2028,36 @@ static inline unsigned osc_max_write_chunks(const struct client_obd *cli)
  * 4. If urgent list is not empty, goto 2;
  * 5. Traverse the extent tree from the 1st extent;
  * 6. Above steps exit if there is no space in this RPC.
+ *
+ * \a data may already describe extents of other objects in the RPC, the
+ * total number of pages in the RPC is returned.
  */
 static unsigned int get_write_extents(struct osc_object *obj,
-				      struct list_head *rpclist)
+				      struct extent_rpc_data *data)
 {
 	struct client_obd *cli = osc_cli(obj);
 	struct osc_extent *ext;
-	struct extent_rpc_data data = {
-		.erd_rpc_list	= rpclist,
-		.erd_page_count	= 0,
-		.erd_max_pages	= cli->cl_max_pages_per_rpc,
-		.erd_max_chunks	= osc_max_write_chunks(cli),
-		.erd_max_extents = 256,
-	};
 
 	LASSERT(osc_object_is_locked(obj));
 	while (!list_empty(&obj->oo_hp_exts)) {
 		ext = list_entry(obj->oo_hp_exts.next, struct osc_extent,
 				 oe_link);
 		LASSERT(ext->oe_state == OES_CACHE);
-		if (!try_to_add_extent_for_io(cli, ext, &data))
-			return data.erd_page_count;
-		EASSERT(ext->oe_nr_pages <= data.erd_max_pages, ext);
+		if (!try_to_add_extent_for_io(cli, ext, data))
+			return data->erd_page_count;
+		EASSERT(ext->oe_nr_pages <= data->erd_max_pages, ext);
 	}
-	if (data.erd_page_count == data.erd_max_pages)
-		return data.erd_page_count;
+	if (data->erd_page_count == data->erd_max_pages)
+		return data->erd_page_count;
 
 	while (!list_empty(&obj->oo_urgent_exts)) {
 		ext = list_entry(obj->oo_urgent_exts.next,
 				 struct osc_extent, oe_link);
-		if (!try_to_add_extent_for_io(cli, ext, &data))
-			return data.erd_page_count;
+		if (!try_to_add_extent_for_io(cli, ext, data))
+			return data->erd_page_count;
 	}
-	if (data.erd_page_count == data.erd_max_pages)
-		return data.erd_page_count;
+	if (data->erd_page_count == data->erd_max_pages)
+		return data->erd_page_count;
 
 	/* One key difference between full extents and other extents: full
 	 * extents can usually only be added if the rpclist was empty, so if we
@@ -2071,11 +2067,11 @@ static unsigned int get_write_extents(struct osc_object *obj,
 	while (!list_empty(&obj->oo_full_exts)) {
 		ext = list_entry(obj->oo_full_exts.next,
 				 struct osc_extent, oe_link);
-		if (!try_to_add_extent_for_io(cli, ext, &data))
+		if (!try_to_add_extent_for_io(cli, ext, data))
 			break;
 	}
-	if (data.erd_page_count == data.erd_max_pages)
-		return data.erd_page_count;
+	if (data->erd_page_count == data->erd_max_pages)
+		return data->erd_page_count;
 
 	ext = first_extent(obj);
 	while (ext != NULL) {
@@ -2086,12 +2082,161 @@ static unsigned int get_write_extents(struct osc_object *obj,
 			continue;
 		}
 
-		if (!try_to_add_extent_for_io(cli, ext, &data))
-			return data.erd_page_count;
+		if (!try_to_add_extent_for_io(cli, ext, data))
+			return data->erd_page_count;
 
 		ext = next_extent(ext);
 	}
-	return data.erd_page_count;
+	return data->erd_page_count;
+}
+
+/* set the state of an extent just collected for a write RPC */
+static void osc_extent_rpc_start(struct osc_extent *ext)
+{
+	LASSERT(ext->oe_state == OES_CACHE ||
+		ext->oe_state == OES_LOCK_DONE);
+	if (ext->oe_state == OES_CACHE)
+		osc_extent_state_set(ext, OES_LOCKING);
+	else
+		osc_extent_state_set(ext, OES_RPC);
+}
+
+static inline bool osc_same_owner(const struct cl_attr *attr, uid_t uid,
+				  gid_t gid, __u32 projid)
+{
+	return attr->cat_uid == uid && attr->cat_gid == gid &&
+	       attr->cat_projid == projid;
+}
+
+/**
+ * Fill the remaining room of a write RPC with extents of other objects.
+ *
+ * Small writes spread over many files would otherwise cost one RPC per
+ * object.  If the OST supports it, extents of other objects with writes
+ * pending are added after those of \a osc, up to cl_max_objs_per_rpc
+ * objects.  Candidates are picked like osc_next_obj() does: objects ready
+ * for RPC, and those with queued writes if there are cache waiters.
+ *
+ * The OST applies the ownership sent with the first object for quota, so
+ * only objects with the same owner are coalesced.
+ *
+ * The extents of all objects are charged to \a data, so that the RPC stays
+ * within the page, chunk and extent limits as a whole.
+ *
+ * Called without any object lock held.
+ *
+ * \retval number of pages added to the RPC list of \a data
+ */
+static unsigned int osc_get_write_extents_multi(const struct lu_env *env,
+						struct client_obd *cli,
+						struct osc_object *osc,
+						struct extent_rpc_data *data)
+{
+	struct list_head *rpclist = data->erd_rpc_list;
+	struct osc_object *objs[PTLRPC_MAX_BRW_OBJS];
+	struct osc_object *tmp;
+	struct osc_extent *first;
+	struct cl_attr *attr = &osc_env_info(env)->oti_attr;
+	struct cl_object *top;
+	unsigned int max_objs = min_t(unsigned int, cli->cl_max_objs_per_rpc,
+				      PTLRPC_MAX_BRW_OBJS);
+	unsigned int added = 0;
+	unsigned int nr = 0;
+	unsigned int i;
+	uid_t uid;
+	gid_t gid;
+	__u32 projid;
+	int rc;
+	ENTRY;
+
+	if (max_objs <= 1 || data->erd_page_count >= data->erd_max_pages ||
+	    data->erd_max_extents == 0 || data->erd_max_chunks == 0 ||
+	    cli->cl_import == NULL || !imp_connect_multiobj_brw(cli->cl_import))
+		RETURN(0);
+
+	/* the OST locks the object of a lockless write itself and only does
+	 * so for single object RPCs; extents added below must match the
+	 * srvlock state of the RPC, so none of them can be lockless either */
+	first = list_entry(rpclist->next, struct osc_extent, oe_link);
+	if (first->oe_srvlock)
+		RETURN(0);
+
+	spin_lock(&cli->cl_loi_list_lock);
+	if (!list_empty(&cli->cl_loi_hp_ready_list)) {
+		/* lock cancels are pending, don't delay them */
+		spin_unlock(&cli->cl_loi_list_lock);
+		RETURN(0);
+	}
+	list_for_each_entry(tmp, &cli->cl_loi_ready_list, oo_ready_item) {
+		if (tmp == osc)
+			continue;
+		cl_object_get(osc2cl(tmp));
+		objs[nr] = tmp;
+		if (++nr == max_objs - 1)
+			break;
+	}
+	if (nr < max_objs - 1 && !list_empty(&cli->cl_cache_waiters)) {
+		list_for_each_entry(tmp, &cli->cl_loi_write_list,
+				    oo_write_item) {
+			if (tmp == osc || !list_empty(&tmp->oo_ready_item))
+				continue;
+			cl_object_get(osc2cl(tmp));
+			objs[nr] = tmp;
+			if (++nr == max_objs - 1)
+				break;
+		}
+	}
+	spin_unlock(&cli->cl_loi_list_lock);
+	if (nr == 0)
+		RETURN(0);
+
+	top = cl_object_top(osc2cl(osc));
+	cl_object_attr_lock(top);
+	rc = cl_object_attr_get(env, top, attr);
+	cl_object_attr_unlock(top);
+	uid = attr->cat_uid;
+	gid = attr->cat_gid;
+	projid = attr->cat_projid;
+
+	for (i = 0; i < nr; i++) {
+		struct osc_object *obj = objs[i];
+		unsigned int count;
+
+		if (rc != 0 || data->erd_page_count >= data->erd_max_pages ||
+		    data->erd_max_extents == 0 || data->erd_max_chunks == 0)
+			goto put;
+
+		top = cl_object_top(osc2cl(obj));
+		cl_object_attr_lock(top);
+		rc = cl_object_attr_get(env, top, attr);
+		cl_object_attr_unlock(top);
+		if (rc != 0 || !osc_same_owner(attr, uid, gid, projid)) {
+			rc = 0;
+			goto put;
+		}
+
+		osc_object_lock(obj);
+		count = data->erd_page_count;
+		count = get_write_extents(obj, data) - count;
+		if (count > 0) {
+			struct osc_extent *ext;
+
+			list_for_each_entry(ext, rpclist, oe_link) {
+				if (ext->oe_obj == obj)
+					osc_extent_rpc_start(ext);
+			}
+			osc_update_pending(obj, OBD_BRW_WRITE, -count);
+			added += count;
+			OSC_IO_DEBUG(obj, "%u pages added to RPC of %p\n",
+				     count, osc);
+		}
+		osc_object_unlock(obj);
+		osc_list_maint(cli, obj);
+put:
+		cl_object_put(env, osc2cl(obj));
+	}
+
+	RETURN(added);
 }
 
 static int
@@ -2103,6 +2248,13 @@ __must_hold(osc)
 	struct osc_extent *ext;
 	struct osc_extent *tmp;
 	struct osc_extent *first = NULL;
+	struct extent_rpc_data data = {
+		.erd_rpc_list	= &rpclist,
+		.erd_page_count	= 0,
+		.erd_max_pages	= cli->cl_max_pages_per_rpc,
+		.erd_max_chunks	= osc_max_write_chunks(cli),
+		.erd_max_extents = 256,
+	};
 	unsigned int page_count = 0;
 	int srvlock = 0;
 	int rc = 0;
@@ -2110,7 +2262,7 @@ __must_hold(osc)
 
 	LASSERT(osc_object_is_locked(osc));
 
-	page_count = get_write_extents(osc, &rpclist);
+	page_count = get_write_extents(osc, &data);
 	LASSERT(equi(page_count == 0, list_empty(&rpclist)));
 
 	if (list_empty(&rpclist))
@@ -2118,19 +2270,15 @@ __must_hold(osc)
 
 	osc_update_pending(osc, OBD_BRW_WRITE, -page_count);
 
-	list_for_each_entry(ext, &rpclist, oe_link) {
-		LASSERT(ext->oe_state == OES_CACHE ||
-			ext->oe_state == OES_LOCK_DONE);
-		if (ext->oe_state == OES_CACHE)
-			osc_extent_state_set(ext, OES_LOCKING);
-		else
-			osc_extent_state_set(ext, OES_RPC);
-	}
+	list_for_each_entry(ext, &rpclist, oe_link)
+		osc_extent_rpc_start(ext);
 
 	/* we're going to grab page lock, so release object lock because
 	 * lock order is page lock -> object lock. */
 	osc_object_unlock(osc);
 
+	page_count += osc_get_write_extents_multi(env, cli, osc, &data);
+
 	list_for_each_entry_safe(ext, tmp, &rpclist, oe_link) {
 		if (ext->oe_state == OES_LOCKING) {
 			rc = osc_extent_make_ready(env, ext);
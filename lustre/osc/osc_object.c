@@ -411,6 +411,33 @@ static void osc_req_attr_set(const struct lu_env *env, struct cl_object *obj,
 	}
 }
 
+/**
+ * Implementation of struct cl_object_operations::coo_size_locked() for osc
+ * layer. Other clients can't change the size of the object while this client
+ * holds a granted extent lock covering it up to OBD_OBJECT_EOF.
+ */
+static int osc_object_size_locked(const struct lu_env *env,
+				  struct cl_object *obj)
+{
+	struct osc_object *osc = cl2osc(obj);
+	struct osc_thread_info *info = osc_env_info(env);
+	struct ldlm_res_id *resname = &info->oti_resname;
+	union ldlm_policy_data *policy = &info->oti_policy;
+	struct lustre_handle lockh;
+	__u64 flags = LDLM_FL_BLOCK_GRANTED | LDLM_FL_TEST_LOCK;
+	int rc;
+
+	ostid_build_res_name(&osc->oo_oinfo->loi_oi, resname);
+	policy->l_extent.start = 0;
+	policy->l_extent.end = OBD_OBJECT_EOF;
+	policy->l_extent.gid = LDLM_GID_ANY;
+
+	rc = osc_match_base(osc_export(osc), resname, LDLM_EXTENT, policy,
+			    LCK_PR | LCK_PW | LCK_GROUP, &flags, NULL, &lockh,
+			    0);
+	return rc > 0;
+}
+
 static const struct cl_object_operations osc_ops = {
 	.coo_page_init    = osc_page_init,
 	.coo_lock_init    = osc_lock_init,
@@ -420,7 +447,8 @@ static const struct cl_object_operations osc_ops = {
 	.coo_glimpse      = osc_object_glimpse,
 	.coo_prune        = osc_object_prune,
 	.coo_fiemap       = osc_object_fiemap,
-	.coo_req_attr_set = osc_req_attr_set
+	.coo_req_attr_set = osc_req_attr_set,
+	.coo_size_locked  = osc_object_size_locked,
 };
 
 static const struct lu_object_operations osc_lu_obj_ops = {
@@ -42,6 +42,7 @@
 
 static void osc_lru_del(struct client_obd *cli, struct osc_page *opg);
 static void osc_lru_use(struct client_obd *cli, struct osc_page *opg);
+static int osc_lru_page_cpt(struct page *vmpage);
 static int osc_lru_alloc(const struct lu_env *env, struct client_obd *cli,
 			 struct osc_page *opg);
 
@@ -270,6 +271,7 @@ int osc_page_init(const struct lu_env *env, struct cl_object *obj,
 	opg->ops_to   = PAGE_SIZE;
 
 	INIT_LIST_HEAD(&opg->ops_lru);
+	opg->ops_lru_cpt = osc_lru_page_cpt(page->cp_vmpage);
 
 	result = osc_prep_async_page(osc, opg, page->cp_vmpage,
 				     cl_offset(obj, index));
@@ -424,40 +426,76 @@ int lru_queue_work(const struct lu_env *env, void *data)
 	RETURN(0);
 }
 
+/**
+ * Return the CPU partition of the LRU list a page is put on. Pages are kept
+ * on the partition of the memory node they were allocated from, so that
+ * reclaim from the local partition frees memory of the local node.
+ */
+static int osc_lru_page_cpt(struct page *vmpage)
+{
+	int cpt;
+
+	cpt = cfs_cpt_of_node(cfs_cpt_table, page_to_nid(vmpage));
+	if (cpt < 0)
+		cpt = cfs_cpt_current(cfs_cpt_table, 1);
+
+	return cpt;
+}
+
+static inline struct cl_lru_part *osc_lru_part(struct client_obd *cli,
+					       struct osc_page *opg)
+{
+	return cli->cl_lru_parts[opg->ops_lru_cpt];
+}
+
 void osc_lru_add_batch(struct client_obd *cli, struct list_head *plist)
 {
-	struct list_head lru = LIST_HEAD_INIT(lru);
+	struct cl_lru_part *part = NULL;
 	struct osc_async_page *oap;
 	long npages = 0;
 
+	/* pages of one RPC are usually allocated on the same node, so the
+	 * partition lock is only switched when it really changes */
 	list_for_each_entry(oap, plist, oap_pending_item) {
 		struct osc_page *opg = oap2osc_page(oap);
 
 		if (!opg->ops_in_lru)
 			continue;
 
+		if (part != osc_lru_part(cli, opg)) {
+			if (part != NULL)
+				spin_unlock(&part->clp_lock);
+			part = osc_lru_part(cli, opg);
+			spin_lock(&part->clp_lock);
+		}
+
 		++npages;
 		LASSERT(list_empty(&opg->ops_lru));
-		list_add(&opg->ops_lru, &lru);
+		list_add_tail(&opg->ops_lru, &part->clp_list);
+		atomic_long_inc(&part->clp_in_list);
 	}
+	if (part != NULL)
+		spin_unlock(&part->clp_lock);
 
 	if (npages > 0) {
-		spin_lock(&cli->cl_lru_list_lock);
-		list_splice_tail(&lru, &cli->cl_lru_list);
 		atomic_long_sub(npages, &cli->cl_lru_busy);
 		atomic_long_add(npages, &cli->cl_lru_in_list);
 		cli->cl_lru_last_used = ktime_get_real_seconds();
-		spin_unlock(&cli->cl_lru_list_lock);
 
 		if (waitqueue_active(&osc_lru_waitq))
 			(void)ptlrpcd_queue_work(cli->cl_lru_work);
 	}
 }
 
+/* must be called with the lock of the page's LRU partition held */
 static void __osc_lru_del(struct client_obd *cli, struct osc_page *opg)
 {
+	struct cl_lru_part *part = osc_lru_part(cli, opg);
+
+	LASSERT(atomic_long_read(&part->clp_in_list) > 0);
 	LASSERT(atomic_long_read(&cli->cl_lru_in_list) > 0);
 	list_del_init(&opg->ops_lru);
+	atomic_long_dec(&part->clp_in_list);
 	atomic_long_dec(&cli->cl_lru_in_list);
 }
 
@@ -468,14 +506,16 @@ static void __osc_lru_del(struct client_obd *cli, struct osc_page *opg)
 static void osc_lru_del(struct client_obd *cli, struct osc_page *opg)
 {
 	if (opg->ops_in_lru) {
-		spin_lock(&cli->cl_lru_list_lock);
+		struct cl_lru_part *part = osc_lru_part(cli, opg);
+
+		spin_lock(&part->clp_lock);
 		if (!list_empty(&opg->ops_lru)) {
 			__osc_lru_del(cli, opg);
 		} else {
 			LASSERT(atomic_long_read(&cli->cl_lru_busy) > 0);
 			atomic_long_dec(&cli->cl_lru_busy);
 		}
-		spin_unlock(&cli->cl_lru_list_lock);
+		spin_unlock(&part->clp_lock);
 
 		atomic_long_inc(cli->cl_lru_left);
 		/* this is a great place to release more LRU pages if
@@ -499,12 +539,14 @@ static void osc_lru_use(struct client_obd *cli, struct osc_page *opg)
 	/* If page is being transferred for the first time,
 	 * ops_lru should be empty */
 	if (opg->ops_in_lru) {
-		spin_lock(&cli->cl_lru_list_lock);
+		struct cl_lru_part *part = osc_lru_part(cli, opg);
+
+		spin_lock(&part->clp_lock);
 		if (!list_empty(&opg->ops_lru)) {
 			__osc_lru_del(cli, opg);
 			atomic_long_inc(&cli->cl_lru_busy);
 		}
-		spin_unlock(&cli->cl_lru_list_lock);
+		spin_unlock(&part->clp_lock);
 	}
 }
 
@@ -550,6 +592,9 @@ static inline bool lru_page_busy(struct client_obd *cli, struct cl_page *page)
 
 /**
  * Drop @target of pages from LRU at most.
+ *
+ * The LRU partition of the current CPU is scanned first, other partitions
+ * are only scanned if the local one can't satisfy @target.
  */
 long osc_lru_shrink(const struct lu_env *env, struct client_obd *cli,
 		   long target, bool force)
@@ -557,10 +602,14 @@ long osc_lru_shrink(const struct lu_env *env, struct client_obd *cli,
 	struct cl_io *io;
 	struct cl_object *clobj = NULL;
 	struct cl_page **pvec;
+	struct cl_lru_part *part;
 	struct osc_page *opg;
 	long count = 0;
 	int maxscan = 0;
 	int index = 0;
+	int ncpt;
+	int cpt;
+	int i;
 	int rc = 0;
 	ENTRY;
 
@@ -585,91 +634,105 @@ long osc_lru_shrink(const struct lu_env *env, struct client_obd *cli,
 	pvec = (struct cl_page **)osc_env_info(env)->oti_pvec;
 	io = osc_env_thread_io(env);
 
-	spin_lock(&cli->cl_lru_list_lock);
 	if (force)
 		cli->cl_lru_reclaim++;
-	maxscan = min(target << 1, atomic_long_read(&cli->cl_lru_in_list));
-	while (!list_empty(&cli->cl_lru_list)) {
-		struct cl_page *page;
-		bool will_free = false;
 
-		if (!force && atomic_read(&cli->cl_lru_shrinkers) > 1)
-			break;
-
-		if (--maxscan < 0)
-			break;
-
-		opg = list_entry(cli->cl_lru_list.next, struct osc_page,
-				 ops_lru);
-		page = opg->ops_cl.cpl_page;
-		if (lru_page_busy(cli, page)) {
-			list_move_tail(&opg->ops_lru, &cli->cl_lru_list);
+	ncpt = cfs_percpt_number(cli->cl_lru_parts);
+	cpt = cfs_cpt_current(cfs_cpt_table, 1) % ncpt;
+	for (i = 0; i < ncpt && count < target && rc == 0; i++) {
+		part = cli->cl_lru_parts[(cpt + i) % ncpt];
+		if (atomic_long_read(&part->clp_in_list) == 0)
 			continue;
-		}
 
-		LASSERT(page->cp_obj != NULL);
-		if (clobj != page->cp_obj) {
-			struct cl_object *tmp = page->cp_obj;
+		spin_lock(&part->clp_lock);
+		maxscan = min((target - count) << 1,
+			      atomic_long_read(&part->clp_in_list));
+		while (!list_empty(&part->clp_list)) {
+			struct cl_page *page;
+			bool will_free = false;
 
-			cl_object_get(tmp);
-			spin_unlock(&cli->cl_lru_list_lock);
+			if (!force && atomic_read(&cli->cl_lru_shrinkers) > 1)
+				break;
 
-			if (clobj != NULL) {
-				discard_pagevec(env, io, pvec, index);
-				index = 0;
+			if (--maxscan < 0)
+				break;
 
-				cl_io_fini(env, io);
-				cl_object_put(env, clobj);
-				clobj = NULL;
+			opg = list_entry(part->clp_list.next, struct osc_page,
+					 ops_lru);
+			page = opg->ops_cl.cpl_page;
+			if (lru_page_busy(cli, page)) {
+				list_move_tail(&opg->ops_lru, &part->clp_list);
+				continue;
 			}
 
-			clobj = tmp;
-			io->ci_obj = clobj;
-			io->ci_ignore_layout = 1;
-			rc = cl_io_init(env, io, CIT_MISC, clobj);
+			LASSERT(page->cp_obj != NULL);
+			if (clobj != page->cp_obj) {
+				struct cl_object *tmp = page->cp_obj;
 
-			spin_lock(&cli->cl_lru_list_lock);
+				cl_object_get(tmp);
+				spin_unlock(&part->clp_lock);
 
-			if (rc != 0)
-				break;
+				if (clobj != NULL) {
+					discard_pagevec(env, io, pvec, index);
+					index = 0;
 
-			++maxscan;
-			continue;
-		}
+					cl_io_fini(env, io);
+					cl_object_put(env, clobj);
+					clobj = NULL;
+				}
+
+				clobj = tmp;
+				io->ci_obj = clobj;
+				io->ci_ignore_layout = 1;
+				rc = cl_io_init(env, io, CIT_MISC, clobj);
+
+				spin_lock(&part->clp_lock);
 
-		if (cl_page_own_try(env, io, page) == 0) {
-			if (!lru_page_busy(cli, page)) {
-				/* remove it from lru list earlier to avoid
-				 * lock contention */
-				__osc_lru_del(cli, opg);
-				opg->ops_in_lru = 0; /* will be discarded */
-
-				cl_page_get(page);
-				will_free = true;
-			} else {
-				cl_page_disown(env, io, page);
+				if (rc != 0)
+					break;
+
+				++maxscan;
+				continue;
 			}
-		}
 
-		if (!will_free) {
-			list_move_tail(&opg->ops_lru, &cli->cl_lru_list);
-			continue;
-		}
+			if (cl_page_own_try(env, io, page) == 0) {
+				if (!lru_page_busy(cli, page)) {
+					/* remove it from lru list earlier to
+					 * avoid lock contention */
+					__osc_lru_del(cli, opg);
+					/* will be discarded */
+					opg->ops_in_lru = 0;
+
+					cl_page_get(page);
+					will_free = true;
+				} else {
+					cl_page_disown(env, io, page);
+				}
+			}
 
-		/* Don't discard and free the page with cl_lru_list held */
-		pvec[index++] = page;
-		if (unlikely(index == OTI_PVEC_SIZE)) {
-			spin_unlock(&cli->cl_lru_list_lock);
-			discard_pagevec(env, io, pvec, index);
-			index = 0;
+			if (!will_free) {
+				list_move_tail(&opg->ops_lru, &part->clp_list);
+				continue;
+			}
 
-			spin_lock(&cli->cl_lru_list_lock);
+			/* Don't discard and free the page with clp_lock held */
+			pvec[index++] = page;
+			if (unlikely(index == OTI_PVEC_SIZE)) {
+				spin_unlock(&part->clp_lock);
+				discard_pagevec(env, io, pvec, index);
+				index = 0;
+
+				spin_lock(&part->clp_lock);
+			}
+
+			if (++count >= target)
+				break;
 		}
+		spin_unlock(&part->clp_lock);
 
-		if (++count >= target)
+		if (!force && atomic_read(&cli->cl_lru_shrinkers) > 1)
 			break;
 	}
-	spin_unlock(&cli->cl_lru_list_lock);
 
 	if (clobj != NULL) {
 		discard_pagevec(env, io, pvec, index);
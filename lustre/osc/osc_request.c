@@ -1013,8 +1013,17 @@ static int check_write_rcs(struct ptlrpc_request *req,
         return (0);
 }
 
+static inline bool brw_page_same_obj(struct brw_page *p1, struct brw_page *p2)
+{
+	return brw_page2oap(p1)->oap_obj == brw_page2oap(p2)->oap_obj;
+}
+
 static inline int can_merge_pages(struct brw_page *p1, struct brw_page *p2)
 {
+	/* pages of different objects are never contiguous */
+	if (!brw_page_same_obj(p1, p2))
+		return 0;
+
         if (p1->flag != p2->flag) {
 		unsigned mask = ~(OBD_BRW_FROM_GRANT | OBD_BRW_NOCACHE |
 				  OBD_BRW_SYNC       | OBD_BRW_ASYNC   |
@@ -1197,6 +1206,7 @@ int compress_pga(struct brw_page **pga, u32 page_count, int* cs, struct chunk_de
  * \param[out] cs           number of chunks/niobufs
  * \param[in] algo          algorithm to be used for compression
  * \param[out] cdesc        chunk descriptor
+ * \param[out] cdesc_count  number of allocated chunk descriptors
  * \param[out] cmp_chunks   pointer array contains cmp_pool buffers
  *
  * \retval      number of physical pages on successful compression
@@ -1205,6 +1215,7 @@ int compress_pga(struct brw_page **pga, u32 page_count, int* cs, struct chunk_de
 int compress_cbuf(struct brw_page **pga, struct brw_page ***cpga,
 					u32 page_count, int* cs, enum l_compress algo,
 					struct chunk_desc **tmp_cdesc,
+					int *cdesc_count,
 					char*** cmp_chunks)
 {
 		int 			page, cpage;            /* index */
@@ -1231,6 +1242,8 @@ int compress_cbuf(struct brw_page **pga, struct brw_page ***cpga,
 		rc = calc_chunks(page_count, &chunksize, cs, pga, tmp_cdesc);
 		if (rc != 0)
 				return 0;
+		/* *cs may change below, *tmp_cdesc is freed with this size */
+		*cdesc_count = *cs;
 
 		chunks = *cs;
 		cdesc = *tmp_cdesc;
@@ -1390,6 +1403,7 @@ free:
  * \param[in] page_count    original page count
  * \param[out] cs           number of chunks/niobufs
  * \param[out] cdesc        chunk descriptor
+ * \param[out] cdesc_count  number of allocated chunk descriptors
  * \param[out] cmp_chunks   pointer array contains cmp_pool buffers
  *
  * \retval		0 on successful prepare
@@ -1398,6 +1412,7 @@ free:
 int compress_data(struct brw_page **pga, struct brw_page ***cpga,
 					u32 page_count, int* cs,
 					struct chunk_desc **cdesc,
+					int *cdesc_count,
 					char*** cmp_chunks)
 {
 	enum l_compress algo = L_COMPRESS_LZ4;
@@ -1412,7 +1427,9 @@ int compress_data(struct brw_page **pga, struct brw_page ***cpga,
 			return compress_pga(pga, page_count, cs, cdesc, cpga, algo);
 
 	if (CAN_CBUF(algo))
-			return compress_cbuf(pga, cpga, page_count, cs, algo, cdesc, cmp_chunks);
+			return compress_cbuf(pga, cpga, page_count, cs,
+					     algo, cdesc, cdesc_count,
+					     cmp_chunks);
 
 	return 0;
 }
@@ -1438,6 +1455,7 @@ compressed_osc_brw_prep_request(int cmd, struct client_obd *cli, struct obdo *oa
 		/* Additional stuff for compression */
 		struct chunk_desc    *cdesc     = NULL;     /* chunk descriptor to be sent */
 		struct chunk_desc    *tmp_cdesc = NULL;     /* tmp cdesc since pill ready after compression */
+		int tmp_cdesc_count = 0;                    /* allocated tmp_cdesc */
 		struct brw_page **cpga          = NULL;     /* outgoing compressed brw page array */
 		char **cmp_chunks   = NULL;                 /* pointer array for buffers loaned from cmp_pool */
 		int chunks          = 1;                    /* number of total chunk = niocount */
@@ -1460,10 +1478,24 @@ compressed_osc_brw_prep_request(int cmd, struct client_obd *cli, struct obdo *oa
 				if (req == NULL)
 				RETURN(-ENOMEM);
 
-				c_page_count = compress_data(pga, &cpga, page_count, &chunks, &tmp_cdesc, &cmp_chunks);
-
-				if (c_page_count == -ENOMEM || c_page_count <= 0 || cpga == NULL || chunks < 1) {
-						RETURN(-ENOMEM);
+				/* Compression is done here, before the request is
+				 * sent, while the bulk is only wrapped by sptlrpc
+				 * at send time (gss_cli_ctx_wrap_bulk()).  With a
+				 * privacy flavor the cipher thus only covers the
+				 * compressed psize bytes of every chunk. */
+				c_page_count = compress_data(pga, &cpga,
+						page_count, &chunks, &tmp_cdesc,
+						&tmp_cdesc_count, &cmp_chunks);
+
+				if (c_page_count <= 0 || cpga == NULL || chunks < 1) {
+						/* send the data uncompressed rather than
+						 * failing the write */
+						ptlrpc_request_free(req);
+						if (tmp_cdesc != NULL)
+								OBD_FREE(tmp_cdesc,
+									 tmp_cdesc_count *
+									 sizeof(*tmp_cdesc));
+						return 333;
 				}
 
 		} else {
@@ -1648,7 +1680,8 @@ compressed_osc_brw_prep_request(int cmd, struct client_obd *cli, struct obdo *oa
 		aa->aa_cmp_chunks = cmp_chunks;
 
 		if(tmp_cdesc != NULL)
-				OBD_FREE(tmp_cdesc, chunks * sizeof(struct chunk_desc));
+				OBD_FREE(tmp_cdesc, tmp_cdesc_count *
+					 sizeof(struct chunk_desc));
 
 		INIT_LIST_HEAD(&aa->aa_oaps);
 
@@ -1674,8 +1707,10 @@ osc_brw_prep_request(int cmd, struct client_obd *cli, struct obdo *oa,
         struct ptlrpc_bulk_desc *desc;
         struct ost_body         *body;
         struct obd_ioobj        *ioobj;
+	struct obd_ioobj	*ioo;
         struct niobuf_remote    *niobuf;
 	int niocount, i, requested_nob, opc, rc, short_io_size;
+	int objcount;
         struct osc_brw_async_args *aa;
         struct req_capsule      *pill;
         struct brw_page *pg_prev;
@@ -1688,14 +1723,26 @@ osc_brw_prep_request(int cmd, struct client_obd *cli, struct obdo *oa,
         if (OBD_FAIL_CHECK(OBD_FAIL_OSC_BRW_PREP_REQ2))
                 RETURN(-EINVAL); /* Fatal */
 
+	/* pages of each object are contiguous in pga, see osc_build_rpc() */
+	for (objcount = i = 1; i < page_count; i++) {
+		if (!brw_page_same_obj(pga[i - 1], pga[i]))
+			objcount++;
+	}
+	LASSERT(objcount == 1 || (cmd & OBD_BRW_WRITE) != 0);
+
 	if ((cmd & OBD_BRW_WRITE) != 0) {
 
 		/* TODO: for better debugging only. To be refactored. Remaining function is currently original */
 #ifdef COMPRESSION_ENABLED
 		/* TODO: handle short IO correctly, will be skipped like a min. threshold for compression */
-		rc = compressed_osc_brw_prep_request(cmd, cli, oa, page_count, pga, reqp, resend);
-		if (rc != 333)
-			return rc;
+		/* writes of several objects are never compressed */
+		if (objcount == 1) {
+			rc = compressed_osc_brw_prep_request(cmd, cli, oa,
+							     page_count, pga,
+							     reqp, resend);
+			if (rc != 333)
+				return rc;
+		}
 #endif
 
 		opc = OST_WRITE;
@@ -1716,7 +1763,7 @@ osc_brw_prep_request(int cmd, struct client_obd *cli, struct obdo *oa,
 
         pill = &req->rq_pill;
         req_capsule_set_size(pill, &RMF_OBD_IOOBJ, RCL_CLIENT,
-                             sizeof(*ioobj));
+			     objcount * sizeof(*ioobj));
         req_capsule_set_size(pill, &RMF_NIOBUF_REMOTE, RCL_CLIENT,
                              niocount * sizeof(*niobuf));
 
@@ -1772,7 +1819,6 @@ no_bulk:
 	lustre_set_wire_obdo(&req->rq_import->imp_connect_data, &body->oa, oa);
 
 	obdo_to_ioobj(oa, ioobj);
-	ioobj->ioo_bufcnt = niocount;
 	/* The high bits of ioo_max_brw tells server _maximum_ number of bulks
 	 * that might be send for this request.  The actual number is decided
 	 * when the RPC is finally sent in ptlrpc_register_bulk(). It sends
@@ -1800,20 +1846,33 @@ no_bulk:
 
 	LASSERT(page_count > 0);
 	pg_prev = pga[0];
+	ioo = ioobj;
+	ioo->ioo_bufcnt = 0;
         for (requested_nob = i = 0; i < page_count; i++, niobuf++) {
                 struct brw_page *pg = pga[i];
 		int poff = pg->off & ~PAGE_MASK;
+		bool first = i == 0 || !brw_page_same_obj(pg_prev, pg);
+		bool last = i == page_count - 1 ||
+			    !brw_page_same_obj(pg, pga[i + 1]);
+
+		if (i > 0 && first) {
+			/* next object of a multi-object write */
+			ioo++;
+			ioo->ioo_oid = brw_page2oap(pg)->oap_obj->oo_oinfo->loi_oi;
+			ioo->ioo_max_brw = ioobj->ioo_max_brw;
+			ioo->ioo_bufcnt = 0;
+		}
 
                 LASSERT(pg->count > 0);
                 /* make sure there is no gap in the middle of page array */
-		LASSERTF(page_count == 1 ||
-			 (ergo(i == 0, poff + pg->count == PAGE_SIZE) &&
-			  ergo(i > 0 && i < page_count - 1,
+		LASSERTF((first && last) ||
+			 (ergo(first, poff + pg->count == PAGE_SIZE) &&
+			  ergo(!first && !last,
 			       poff == 0 && pg->count == PAGE_SIZE)   &&
-			  ergo(i == page_count - 1, poff == 0)),
+			  ergo(last, poff == 0)),
 			 "i: %d/%d pg: %p off: %llu, count: %u\n",
 			 i, page_count, pg, pg->off, pg->count);
-                LASSERTF(i == 0 || pg->off > pg_prev->off,
+		LASSERTF(first || pg->off > pg_prev->off,
 			 "i %d p_c %u pg %p [pri %lu ind %lu] off %llu"
 			 " prev_pg %p [pri %lu ind %lu] off %llu\n",
                          i, page_count,
@@ -1843,9 +1902,11 @@ no_bulk:
 			niobuf->rnb_offset = pg->off;
 			niobuf->rnb_len    = pg->count;
 			niobuf->rnb_flags  = pg->flag;
+			ioo->ioo_bufcnt++;
                 }
                 pg_prev = pg;
         }
+	LASSERT(ioo - ioobj == objcount - 1);
 
         LASSERTF((void *)(niobuf - niocount) ==
                 req_capsule_client_get(&req->rq_pill, &RMF_NIOBUF_REMOTE),
@@ -2274,11 +2335,42 @@ static int osc_brw_redo_request(struct ptlrpc_request *request,
                                  "request %p != oap_request %p\n",
                                  request, oap->oap_request);
                         if (oap->oap_interrupted) {
+#ifdef COMPRESSION_ENABLED
+				/* the compressed buffers of the new request
+				 * are only released by its interpret callback,
+				 * which will never run */
+				new_aa = ptlrpc_req_async_args(new_req);
+				if (new_aa->aa_cppga != NULL)
+					osc_release_cppga(new_aa->aa_ppga,
+							  new_aa->aa_cppga,
+							  new_aa->aa_cmp_chunks,
+							  new_aa->aa_page_count,
+							  new_aa->aa_nio_count);
+#endif
                                 ptlrpc_req_finished(new_req);
                                 RETURN(-EINTR);
                         }
                 }
         }
+#ifdef COMPRESSION_ENABLED
+	/* The new request was compressed again from the original pages and
+	 * its bulk will be wrapped again when it is sent, keep its own
+	 * compressed buffers across the copy of the async args below and
+	 * release those of the old request. */
+	new_aa = ptlrpc_req_async_args(new_req);
+	if (aa->aa_cppga != NULL) {
+		osc_release_cppga(aa->aa_ppga, aa->aa_cppga, aa->aa_cmp_chunks,
+				  aa->aa_page_count, aa->aa_nio_count);
+		aa->aa_cppga = NULL;
+		aa->aa_cmp_chunks = NULL;
+	}
+	aa->aa_cppga = new_aa->aa_cppga;
+	aa->aa_cmp_chunks = new_aa->aa_cmp_chunks;
+	aa->aa_c_page_count = new_aa->aa_c_page_count;
+	aa->aa_nio_count = new_aa->aa_nio_count;
+	aa->aa_requested_nob = new_aa->aa_requested_nob;
+#endif
+
         /* New request takes over pga and oaps from old request.
          * Note that copying a list_head doesn't work, need to move it... */
         aa->aa_resends++;
@@ -2384,6 +2476,229 @@ static void osc_release_cppga(struct brw_page **ppga, struct brw_page **cppga,
 		OBD_FREE(cmp_chunks, sizeof(*cmp_chunks) * niocount);
 }
 
+/* bounds and thresholds of the adaptive RPC controller */
+#define OSC_RPC_CTRL_MIN_RIF	1
+#define OSC_RPC_CTRL_MAX_RIF	(OSC_MAX_RIF_MAX / 4)
+/* RPCs queued along the path below which the window may grow */
+#define OSC_RPC_CTRL_ALPHA	1
+/* RPCs queued along the path above which the window shrinks */
+#define OSC_RPC_CTRL_BETA	3
+/* seconds after which the base RTT is learnt again */
+#define OSC_RPC_CTRL_PERIOD	60
+
+static void osc_rpc_ctrl_set(struct client_obd *cli, __u32 rif, __u32 pages)
+{
+	if (rif == cli->cl_max_rpcs_in_flight &&
+	    pages == cli->cl_max_pages_per_rpc)
+		return;
+
+	CDEBUG(D_CACHE, "%s: rpcs_in_flight %u -> %u, pages_per_rpc %u -> %u\n",
+	       cli->cl_import->imp_obd->obd_name,
+	       cli->cl_max_rpcs_in_flight, rif,
+	       cli->cl_max_pages_per_rpc, pages);
+	cli->cl_max_rpcs_in_flight = rif;
+	cli->cl_max_pages_per_rpc = pages;
+	client_adjust_max_dirty(cli);
+}
+
+/**
+ * Start or stop the adaptive RPC controller of \a cli.
+ *
+ * The max_rpcs_in_flight and max_pages_per_rpc values set by the
+ * administrator are saved when the controller starts and restored when it
+ * stops.
+ */
+void osc_rpc_ctrl_enable(struct client_obd *cli, bool enable)
+{
+	struct cl_rpc_ctrl *crc = &cli->cl_rpc_ctrl;
+
+	spin_lock(&cli->cl_loi_list_lock);
+	if (enable && !crc->crc_enabled) {
+		crc->crc_saved_rif = cli->cl_max_rpcs_in_flight;
+		crc->crc_saved_pages = cli->cl_max_pages_per_rpc;
+		crc->crc_acked = 0;
+		crc->crc_srtt_us = 0;
+		crc->crc_base_rtt_us = 0;
+		crc->crc_probe_rtt_us = 0;
+		crc->crc_period_start = ktime_get_seconds();
+		crc->crc_at_base = 0;
+		crc->crc_enabled = true;
+	} else if (!enable && crc->crc_enabled) {
+		crc->crc_enabled = false;
+		osc_rpc_ctrl_set(cli, crc->crc_saved_rif,
+				 crc->crc_saved_pages);
+	}
+	spin_unlock(&cli->cl_loi_list_lock);
+}
+
+/**
+ * Adapt the RPC window and the RPC size of \a cli after a BRW completed.
+ *
+ * This works like delay-based TCP congestion control: the number of RPCs
+ * sitting in network and server queues is estimated once per round (one
+ * window of completed RPCs) from the smoothed RTT and the base RTT, the
+ * lowest RTT of the previous period.  The window grows by one RPC when
+ * there is little queueing and enough pending pages to use it, and shrinks
+ * by one when RPCs queue up or the server AT service estimate says the
+ * server is getting busy.  Timeouts and -EINPROGRESS halve the window at
+ * once.  RPCs grow up to the size advertised by the server in ocd_brw_size
+ * before the window does, and shrink only once the window is minimal.
+ *
+ * \param[in] cli	client obd
+ * \param[in] rtt_us	RTT of the RPC, including bulk transfer
+ * \param[in] at_est	AT service estimate of the server for the portal
+ * \param[in] rc	result of the RPC
+ */
+static void osc_rpc_ctrl_update(struct client_obd *cli, __u64 rtt_us,
+				unsigned int at_est, int rc)
+__must_hold(&cli->cl_loi_list_lock)
+{
+	struct cl_rpc_ctrl *crc = &cli->cl_rpc_ctrl;
+	struct obd_connect_data *ocd = &cli->cl_import->imp_connect_data;
+	__u32 chunk = 1 << (cli->cl_chunkbits - PAGE_SHIFT);
+	__u32 rif = cli->cl_max_rpcs_in_flight;
+	__u32 pages = cli->cl_max_pages_per_rpc;
+	__u32 min_pages = max_t(__u32, ONE_MB_BRW_SIZE >> PAGE_SHIFT, chunk);
+	__u32 max_pages = PTLRPC_MAX_BRW_PAGES;
+	time64_t now = ktime_get_seconds();
+	unsigned long pending;
+	__u64 queued;
+	bool busy;
+
+	assert_spin_locked(&cli->cl_loi_list_lock);
+
+	if (!crc->crc_enabled)
+		return;
+
+	if (ocd->ocd_brw_size != 0)
+		max_pages = min_t(__u32, max_pages,
+				  ocd->ocd_brw_size >> PAGE_SHIFT);
+	min_pages = min(min_pages, max_pages);
+
+	if (rc == -ETIMEDOUT || rc == -EINPROGRESS) {
+		crc->crc_acked = 0;
+		if (rif > OSC_RPC_CTRL_MIN_RIF) {
+			osc_rpc_ctrl_set(cli, max_t(__u32, rif / 2,
+						    OSC_RPC_CTRL_MIN_RIF),
+					 pages);
+			crc->crc_decreases++;
+		}
+		return;
+	}
+	if (rc != 0 || rtt_us == 0)
+		return;
+
+	crc->crc_srtt_us = crc->crc_srtt_us == 0 ? rtt_us :
+			   (crc->crc_srtt_us * 7 + rtt_us) >> 3;
+	if (crc->crc_probe_rtt_us == 0 || rtt_us < crc->crc_probe_rtt_us)
+		crc->crc_probe_rtt_us = rtt_us;
+	if (crc->crc_base_rtt_us == 0 ||
+	    crc->crc_probe_rtt_us < crc->crc_base_rtt_us)
+		crc->crc_base_rtt_us = crc->crc_probe_rtt_us;
+	if (crc->crc_at_base == 0 || at_est < crc->crc_at_base)
+		crc->crc_at_base = at_est;
+	if (now > crc->crc_period_start + OSC_RPC_CTRL_PERIOD) {
+		/* the path may have changed, learn the base values again */
+		crc->crc_base_rtt_us = crc->crc_probe_rtt_us;
+		crc->crc_probe_rtt_us = 0;
+		crc->crc_at_base = at_est;
+		crc->crc_period_start = now;
+	}
+
+	if (++crc->crc_acked < rif)
+		return;
+	crc->crc_acked = 0;
+
+	/* RPCs queued along the path: window * (1 - base / srtt) */
+	queued = crc->crc_srtt_us > crc->crc_base_rtt_us ?
+		 div64_u64((__u64)rif * (crc->crc_srtt_us -
+					 crc->crc_base_rtt_us),
+			   crc->crc_srtt_us) : 0;
+	busy = at_est > 2 * max(crc->crc_at_base, 1U);
+	pending = atomic_read(&cli->cl_pending_w_pages) +
+		  atomic_read(&cli->cl_pending_r_pages);
+
+	if (queued > OSC_RPC_CTRL_BETA || busy) {
+		if (rif > OSC_RPC_CTRL_MIN_RIF)
+			rif--;
+		else if (pages > min_pages)
+			pages = max(pages / 2, min_pages) & ~(chunk - 1);
+		else
+			return;
+		crc->crc_decreases++;
+	} else if (queued < OSC_RPC_CTRL_ALPHA &&
+		   pending >= (unsigned long)rif * pages) {
+		/* only grow if the pending pages can use the new window */
+		if (pages < max_pages)
+			pages = min(pages * 2, max_pages) & ~(chunk - 1);
+		else if (rif < OSC_RPC_CTRL_MAX_RIF)
+			rif++;
+		else
+			return;
+		crc->crc_increases++;
+	} else {
+		return;
+	}
+
+	osc_rpc_ctrl_set(cli, rif, pages);
+}
+
+/**
+ * Update the attributes of an object after a successful BRW.
+ *
+ * \param[in] oa	reply obdo if it describes this object, or NULL
+ * \param[in] last	last page of the object in the RPC
+ */
+static void osc_brw_update_attr(const struct lu_env *env,
+				struct ptlrpc_request *req, struct obdo *oa,
+				struct osc_async_page *last)
+{
+	struct cl_attr *attr = &osc_env_info(env)->oti_attr;
+	struct cl_object *obj = osc2cl(last->oap_obj);
+	unsigned long valid = 0;
+
+	cl_object_attr_lock(obj);
+	if (oa != NULL && oa->o_valid & OBD_MD_FLBLOCKS) {
+		attr->cat_blocks = oa->o_blocks;
+		valid |= CAT_BLOCKS;
+	}
+	if (oa != NULL && oa->o_valid & OBD_MD_FLMTIME) {
+		attr->cat_mtime = oa->o_mtime;
+		valid |= CAT_MTIME;
+	}
+	if (oa != NULL && oa->o_valid & OBD_MD_FLATIME) {
+		attr->cat_atime = oa->o_atime;
+		valid |= CAT_ATIME;
+	}
+	if (oa != NULL && oa->o_valid & OBD_MD_FLCTIME) {
+		attr->cat_ctime = oa->o_ctime;
+		valid |= CAT_CTIME;
+	}
+
+	if (lustre_msg_get_opc(req->rq_reqmsg) == OST_WRITE) {
+		struct lov_oinfo *loi = cl2osc(obj)->oo_oinfo;
+		loff_t last_off = last->oap_count + last->oap_obj_off +
+			last->oap_page_off;
+
+		/* Change file size if this is an out of quota or
+		 * direct IO write and it extends the file size */
+		if (loi->loi_lvb.lvb_size < last_off) {
+			attr->cat_size = last_off;
+			valid |= CAT_SIZE;
+		}
+		/* Extend KMS if it's not a lockless write */
+		if (loi->loi_kms < last_off &&
+		    oap2osc_page(last)->ops_srvlock == 0) {
+			attr->cat_kms = last_off;
+			valid |= CAT_KMS;
+		}
+	}
+
+	if (valid != 0)
+		cl_object_attr_update(env, obj, attr, valid);
+	cl_object_attr_unlock(obj);
+}
+
 static int brw_interpret(const struct lu_env *env,
                          struct ptlrpc_request *req, void *data, int rc)
 {
@@ -2392,8 +2707,21 @@ static int brw_interpret(const struct lu_env *env,
 	struct osc_extent *tmp;
 	struct client_obd *cli = aa->aa_cli;
 	unsigned long		transferred = 0;
+	unsigned int		at_est = 0;
+	__u64			rtt_us;
+	bool			rpc_ctrl_done = false;
+	int			i;
         ENTRY;
 
+	rtt_us = ktime_us_delta(ktime_get_real(), req->rq_sent_ns);
+	if (cli->cl_rpc_ctrl.crc_enabled) {
+		struct obd_import *imp = req->rq_import;
+
+		at_est = at_get(&imp->imp_at.iat_service_estimate[
+				import_at_get_index(imp,
+						    req->rq_request_portal)]);
+	}
+
         rc = osc_brw_fini_request(req, rc);
         CDEBUG(D_INODE, "request %p aa %p rc %d\n", req, aa, rc);
         /* When server return -EINPROGRESS, client should always retry
@@ -2407,9 +2735,12 @@ static int brw_interpret(const struct lu_env *env,
 			       POSTID(&aa->aa_oa->o_oi), rc);
 		} else if (rc == -EINPROGRESS ||
 		    client_should_resend(aa->aa_resends, aa->aa_cli)) {
+			spin_lock(&cli->cl_loi_list_lock);
+			osc_rpc_ctrl_update(cli, rtt_us, at_est, rc);
+			spin_unlock(&cli->cl_loi_list_lock);
+			/* this RPC is accounted even if the redo fails */
+			rpc_ctrl_done = true;
 
-			/* TODO: redo for compressed case. The recoverable error is not caused by
-			compression, so we should be able to reuse compressed buffers. */
 			rc = osc_brw_redo_request(req, aa, rc);
 		} else {
 			CERROR("%s: too many resent retries for object: "
@@ -2425,55 +2756,19 @@ static int brw_interpret(const struct lu_env *env,
 	}
 
 	if (rc == 0) {
-		struct obdo *oa = aa->aa_oa;
-		struct cl_attr *attr = &osc_env_info(env)->oti_attr;
-		unsigned long valid = 0;
-		struct cl_object *obj;
-		struct osc_async_page *last;
-
-		last = brw_page2oap(aa->aa_ppga[aa->aa_page_count - 1]);
-		obj = osc2cl(last->oap_obj);
-
-		cl_object_attr_lock(obj);
-		if (oa->o_valid & OBD_MD_FLBLOCKS) {
-			attr->cat_blocks = oa->o_blocks;
-			valid |= CAT_BLOCKS;
-		}
-		if (oa->o_valid & OBD_MD_FLMTIME) {
-			attr->cat_mtime = oa->o_mtime;
-			valid |= CAT_MTIME;
-		}
-		if (oa->o_valid & OBD_MD_FLATIME) {
-			attr->cat_atime = oa->o_atime;
-			valid |= CAT_ATIME;
+		struct brw_page **pga = aa->aa_ppga;
+
+		/* the reply describes the first object, others of a
+		 * multi-object write only get their size updated */
+		for (i = 0; i < aa->aa_page_count; i++) {
+			if (i < aa->aa_page_count - 1 &&
+			    brw_page_same_obj(pga[i], pga[i + 1]))
+				continue;
+			osc_brw_update_attr(env, req,
+					    brw_page_same_obj(pga[0], pga[i]) ?
+					    aa->aa_oa : NULL,
+					    brw_page2oap(pga[i]));
 		}
-		if (oa->o_valid & OBD_MD_FLCTIME) {
-			attr->cat_ctime = oa->o_ctime;
-			valid |= CAT_CTIME;
-		}
-
-		if (lustre_msg_get_opc(req->rq_reqmsg) == OST_WRITE) {
-			struct lov_oinfo *loi = cl2osc(obj)->oo_oinfo;
-			loff_t last_off = last->oap_count + last->oap_obj_off +
-				last->oap_page_off;
-
-			/* Change file size if this is an out of quota or
-			 * direct IO write and it extends the file size */
-			if (loi->loi_lvb.lvb_size < last_off) {
-				attr->cat_size = last_off;
-				valid |= CAT_SIZE;
-			}
-			/* Extend KMS if it's not a lockless write */
-			if (loi->loi_kms < last_off &&
-			    oap2osc_page(last)->ops_srvlock == 0) {
-				attr->cat_kms = last_off;
-				valid |= CAT_KMS;
-			}
-		}
-
-		if (valid != 0)
-			cl_object_attr_update(env, obj, attr, valid);
-		cl_object_attr_unlock(obj);
 	}
 	OBDO_FREE(aa->aa_oa);
 
@@ -2500,6 +2795,8 @@ static int brw_interpret(const struct lu_env *env,
 	ptlrpc_lprocfs_brw(req, transferred);
 
 	spin_lock(&cli->cl_loi_list_lock);
+	if (!rpc_ctrl_done)
+		osc_rpc_ctrl_update(cli, rtt_us, at_est, rc);
 	/* We need to decrement before osc_ap_completion->osc_wake_cache_waiters
 	 * is called so we know whether to go to sync BRWs or wait for more
 	 * RPCs to complete */
@@ -2550,13 +2847,15 @@ int osc_build_rpc(const struct lu_env *env, struct client_obd *cli,
 	struct cl_req_attr		*crattr = NULL;
 	loff_t				starting_offset = OBD_OBJECT_EOF;
 	loff_t				ending_offset = 0;
+	loff_t				rpc_offset = OBD_OBJECT_EOF;
+	struct osc_object		*cur = NULL;
 	int				mpflag = 0;
 	int				mem_tight = 0;
 	int				page_count = 0;
 	bool				soft_sync = false;
 	bool				interrupted = false;
 	bool				ndelay = false;
-	int				i;
+	int				i, j;
 	int				grant = 0;
 	int				rc;
 	__u32				layout_version = 0;
@@ -2590,6 +2889,12 @@ int osc_build_rpc(const struct lu_env *env, struct client_obd *cli,
 
 	i = 0;
 	list_for_each_entry(ext, ext_list, oe_link) {
+		/* extents of a multi-object write are grouped per object */
+		if (ext->oe_obj != cur) {
+			cur = ext->oe_obj;
+			starting_offset = OBD_OBJECT_EOF;
+			ending_offset = 0;
+		}
 		list_for_each_entry(oap, &ext->oe_pages, oap_pending_item) {
 			if (mem_tight)
 				oap->oap_brw_flags |= OBD_BRW_MEMALLOC;
@@ -2611,6 +2916,9 @@ int osc_build_rpc(const struct lu_env *env, struct client_obd *cli,
 			else
 				LASSERT(oap->oap_page_off + oap->oap_count ==
 					PAGE_SIZE);
+			if (rpc_offset == OBD_OBJECT_EOF ||
+			    rpc_offset > oap->oap_obj_off)
+				rpc_offset = oap->oap_obj_off;
 			if (oap->oap_interrupted)
 				interrupted = true;
 		}
@@ -2640,7 +2948,13 @@ int osc_build_rpc(const struct lu_env *env, struct client_obd *cli,
 		}
 	}
 
-	sort_brw_pages(pga, page_count);
+	/* sort the pages of each object, objects keep the ext_list order */
+	for (i = 0, j = 1; j <= page_count; j++) {
+		if (j < page_count && brw_page_same_obj(pga[i], pga[j]))
+			continue;
+		sort_brw_pages(pga + i, j - i);
+		i = j;
+	}
 
 	rc = osc_brw_prep_request(cmd, cli, oa, page_count, pga, &req, 0);
 	if (rc != 0) {
@@ -2680,7 +2994,7 @@ int osc_build_rpc(const struct lu_env *env, struct client_obd *cli,
 	list_splice_init(ext_list, &aa->aa_exts);
 
 	spin_lock(&cli->cl_loi_list_lock);
-	starting_offset >>= PAGE_SHIFT;
+	starting_offset = rpc_offset >> PAGE_SHIFT;
 	if (cmd == OBD_BRW_READ) {
 		cli->cl_r_in_flight++;
 		lprocfs_oh_tally_log2(&cli->cl_read_page_hist, page_count);
@@ -3781,6 +4095,90 @@ static struct obd_ops osc_obd_ops = {
         .o_quotactl             = osc_quotactl,
 };
 
+/* LZ4 speed test, measured and cached with the checksum speeds */
+struct osc_lz4_speed_test {
+	struct cfs_crypto_speed_test	 olst_cst;
+	char				*olst_src;
+	char				*olst_dst;
+	void				*olst_wrkmem;
+};
+
+static struct osc_lz4_speed_test osc_lz4_speed;
+
+static int osc_lz4_speed_run(void *data)
+{
+	struct osc_lz4_speed_test *olst = data;
+	int rc;
+
+	rc = LZ4_compress_default(olst->olst_src, olst->olst_dst,
+				  CFS_CRYPTO_SPEED_TEST_SIZE,
+				  LZ4_compressBound(CFS_CRYPTO_SPEED_TEST_SIZE),
+				  olst->olst_wrkmem);
+
+	return rc > 0 ? 0 : -EIO;
+}
+
+static void osc_lz4_speed_cleanup(void *data)
+{
+	struct osc_lz4_speed_test *olst = data;
+
+	if (olst->olst_src != NULL)
+		OBD_FREE_LARGE(olst->olst_src, CFS_CRYPTO_SPEED_TEST_SIZE);
+	if (olst->olst_dst != NULL)
+		OBD_FREE_LARGE(olst->olst_dst,
+			       LZ4_compressBound(CFS_CRYPTO_SPEED_TEST_SIZE));
+	if (olst->olst_wrkmem != NULL)
+		OBD_FREE_LARGE(olst->olst_wrkmem, LZ4_MEM_COMPRESS);
+	olst->olst_src = NULL;
+	olst->olst_dst = NULL;
+	olst->olst_wrkmem = NULL;
+}
+
+/* the buffers only exist while the speed is measured */
+static int osc_lz4_speed_setup(void *data)
+{
+	struct osc_lz4_speed_test *olst = data;
+	int i;
+
+	OBD_ALLOC_LARGE(olst->olst_src, CFS_CRYPTO_SPEED_TEST_SIZE);
+	OBD_ALLOC_LARGE(olst->olst_dst,
+			LZ4_compressBound(CFS_CRYPTO_SPEED_TEST_SIZE));
+	OBD_ALLOC_LARGE(olst->olst_wrkmem, LZ4_MEM_COMPRESS);
+	if (olst->olst_src == NULL || olst->olst_dst == NULL ||
+	    olst->olst_wrkmem == NULL) {
+		osc_lz4_speed_cleanup(olst);
+		return -ENOMEM;
+	}
+
+	/* compressible about 2:1, speeds of LZ4 on all-zero or random data
+	 * are far from those seen on file data */
+	for (i = 0; i < CFS_CRYPTO_SPEED_TEST_SIZE; i += 64)
+		cfs_get_random_bytes(olst->olst_src + i, 32);
+
+	return 0;
+}
+
+static void osc_lz4_speed_fini(void)
+{
+	struct osc_lz4_speed_test *olst = &osc_lz4_speed;
+
+	if (olst->olst_cst.cst_name != NULL)
+		cfs_crypto_speed_unregister(&olst->olst_cst);
+	memset(olst, 0, sizeof(*olst));
+}
+
+static void osc_lz4_speed_init(void)
+{
+	struct osc_lz4_speed_test *olst = &osc_lz4_speed;
+
+	olst->olst_cst.cst_name = "lz4";
+	olst->olst_cst.cst_run = osc_lz4_speed_run;
+	olst->olst_cst.cst_setup = osc_lz4_speed_setup;
+	olst->olst_cst.cst_cleanup = osc_lz4_speed_cleanup;
+	olst->olst_cst.cst_data = olst;
+	cfs_crypto_speed_register(&olst->olst_cst);
+}
+
 static struct shrinker *osc_cache_shrinker;
 struct list_head osc_shrink_list = LIST_HEAD_INIT(osc_shrink_list);
 DEFINE_SPINLOCK(osc_shrink_lock);
@@ -3860,8 +4258,10 @@ static int __init osc_init(void)
 	osc_rq_pool = ptlrpc_init_rq_pool(0, OST_IO_MAXREQSIZE,
 					  ptlrpc_add_rqs_to_pool);
 
-	if (osc_rq_pool != NULL)
+	if (osc_rq_pool != NULL) {
+		osc_lz4_speed_init();
 		GOTO(out, rc);
+	}
 	rc = -ENOMEM;
 out_type:
 	class_unregister_type(LUSTRE_OSC_NAME);
@@ -3873,6 +4273,7 @@ out:
 
 static void __exit osc_exit(void)
 {
+	osc_lz4_speed_fini();
 	remove_shrinker(osc_cache_shrinker);
 	class_unregister_type(LUSTRE_OSC_NAME);
 	lu_kmem_fini(osc_caches);
@@ -100,6 +100,7 @@ static int ost_setup(struct obd_device *obd, struct lustre_cfg* lcfg)
 			.tc_nthrs_base		= OSS_NTHRS_BASE,
 			.tc_nthrs_max		= oss_max_threads,
 			.tc_nthrs_user		= oss_num_threads,
+			.tc_nthrs_hp		= OSS_NTHRS_HP,
 			.tc_cpu_affinity	= 1,
 			.tc_ctx_tags		= LCT_DT_THREAD,
 		},
@@ -109,7 +110,7 @@ static int ost_setup(struct obd_device *obd, struct lustre_cfg* lcfg)
 		.psc_ops		= {
 			.so_req_handler		= tgt_request_handle,
 			.so_req_printer		= target_print_req,
-			.so_hpreq_handler	= ptlrpc_hpreq_handler,
+			.so_hpreq_handler	= tgt_ost_hpreq_handler,
 		},
 	};
 	ost->ost_service = ptlrpc_register_service(&svc_conf,
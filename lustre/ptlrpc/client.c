@@ -1104,9 +1104,12 @@ EXPORT_SYMBOL(ptlrpc_set_add_req);
  * Add a request to a request with dedicated server thread
  * and wake the thread to make any necessary processing.
  * Currently only used for ptlrpcd.
+ *
+ * \retval	number of requests waiting in the new request queue of \a pc,
+ *		including \a req
  */
-void ptlrpc_set_add_new_req(struct ptlrpcd_ctl *pc,
-                           struct ptlrpc_request *req)
+int ptlrpc_set_add_new_req(struct ptlrpcd_ctl *pc,
+			   struct ptlrpc_request *req)
 {
         struct ptlrpc_request_set *set = pc->pc_set;
         int count, i;
@@ -1134,6 +1137,8 @@ void ptlrpc_set_add_new_req(struct ptlrpcd_ctl *pc,
 		for (i = 0; i < pc->pc_npartners; i++)
 			wake_up(&pc->pc_partners[i]->pc_set->set_waitq);
 	}
+
+	return count;
 }
 
 /**
@@ -1318,6 +1323,73 @@ __u64 ptlrpc_known_replied_xid(struct obd_import *imp)
 	return req->rq_xid - 1;
 }
 
+/**
+ * Store the transno of the reply of \a req and keep the request for replay
+ * if it is not committed yet, then free the requests the server committed.
+ */
+static void ptlrpc_reply_retain(struct ptlrpc_request *req)
+{
+	struct obd_import *imp = req->rq_import;
+	u64 committed;
+
+        /*
+         * Store transno in reqmsg for replay.
+         */
+        if (!(lustre_msg_get_flags(req->rq_reqmsg) & MSG_REPLAY)) {
+                req->rq_transno = lustre_msg_get_transno(req->rq_repmsg);
+                lustre_msg_set_transno(req->rq_reqmsg, req->rq_transno);
+        }
+
+        if (imp->imp_replayable) {
+		spin_lock(&imp->imp_lock);
+                /*
+                 * No point in adding already-committed requests to the replay
+                 * list, we will just remove them immediately. b=9829
+                 */
+                if (req->rq_transno != 0 &&
+                    (req->rq_transno >
+                     lustre_msg_get_last_committed(req->rq_repmsg) ||
+                     req->rq_replay)) {
+                        /** version recovery */
+                        ptlrpc_save_versions(req);
+                        ptlrpc_retain_replayable_request(req, imp);
+		} else if (req->rq_commit_cb != NULL &&
+			   list_empty(&req->rq_replay_list)) {
+			/* NB: don't call rq_commit_cb if it's already on
+			 * rq_replay_list, ptlrpc_free_committed() will call
+			 * it later, see LU-3618 for details */
+			spin_unlock(&imp->imp_lock);
+			req->rq_commit_cb(req);
+			spin_lock(&imp->imp_lock);
+                }
+
+                /*
+                 * Replay-enabled imports return commit-status information.
+                 */
+		committed = lustre_msg_get_last_committed(req->rq_repmsg);
+		if (likely(committed > imp->imp_peer_committed_transno))
+			imp->imp_peer_committed_transno = committed;
+
+		ptlrpc_free_committed(imp);
+
+		if (!list_empty(&imp->imp_replay_list)) {
+			struct ptlrpc_request *last;
+
+			last = list_entry(imp->imp_replay_list.prev,
+					  struct ptlrpc_request,
+					  rq_replay_list);
+			/*
+			 * Requests with rq_replay stay on the list even if no
+			 * commit is expected.
+			 */
+			if (last->rq_transno > imp->imp_peer_committed_transno)
+				ptlrpc_pinger_commit_expected(imp);
+		}
+
+		spin_unlock(&imp->imp_lock);
+	}
+}
+
 /**
  * Callback function called when client receives RPC reply for \a req.
  * Returns 0 on success or error code.
@@ -1330,7 +1402,6 @@ static int after_reply(struct ptlrpc_request *req)
 	struct obd_import *imp = req->rq_import;
 	struct obd_device *obd = req->rq_import->imp_obd;
 	ktime_t work_start;
-	u64 committed;
 	s64 timediff;
 	int rc;
 
@@ -1457,65 +1528,95 @@ static int after_reply(struct ptlrpc_request *req)
                 ldlm_cli_update_pool(req);
         }
 
-        /*
-         * Store transno in reqmsg for replay.
-         */
-        if (!(lustre_msg_get_flags(req->rq_reqmsg) & MSG_REPLAY)) {
-                req->rq_transno = lustre_msg_get_transno(req->rq_repmsg);
-                lustre_msg_set_transno(req->rq_reqmsg, req->rq_transno);
-        }
+	ptlrpc_reply_retain(req);
 
-        if (imp->imp_replayable) {
-		spin_lock(&imp->imp_lock);
-                /*
-                 * No point in adding already-committed requests to the replay
-                 * list, we will just remove them immediately. b=9829
-                 */
-                if (req->rq_transno != 0 &&
-                    (req->rq_transno >
-                     lustre_msg_get_last_committed(req->rq_repmsg) ||
-                     req->rq_replay)) {
-                        /** version recovery */
-                        ptlrpc_save_versions(req);
-                        ptlrpc_retain_replayable_request(req, imp);
-		} else if (req->rq_commit_cb != NULL &&
-			   list_empty(&req->rq_replay_list)) {
-			/* NB: don't call rq_commit_cb if it's already on
-			 * rq_replay_list, ptlrpc_free_committed() will call
-			 * it later, see LU-3618 for details */
-			spin_unlock(&imp->imp_lock);
-			req->rq_commit_cb(req);
-			spin_lock(&imp->imp_lock);
-                }
+	RETURN(rc);
+}
 
-                /*
-                 * Replay-enabled imports return commit-status information.
-                 */
-		committed = lustre_msg_get_last_committed(req->rq_repmsg);
-		if (likely(committed > imp->imp_peer_committed_transno))
-			imp->imp_peer_committed_transno = committed;
+/**
+ * Complete a request that was sent inside an MDS_REINT_BATCH RPC.
+ *
+ * The reply \a repmsg found in the batch reply is copied into a reply buffer
+ * of \a req, so that the caller can use the request as if it had been sent
+ * alone, and the request is kept for replay like any other.
+ *
+ * \param[in] req	request sent in the batch
+ * \param[in] repmsg	reply of \a req in the MDS_REINT_BATCH reply
+ * \param[in] replen	length of \a repmsg
+ *
+ * \retval		status of the request
+ * \retval		-EAGAIN if the request has to be sent again alone
+ */
+int ptlrpc_batch_subreq_reply(struct ptlrpc_request *req,
+			      struct lustre_msg *repmsg, int replen)
+{
+	struct obd_import *imp = req->rq_import;
+	int rc;
 
-		ptlrpc_free_committed(imp);
+	ENTRY;
+	LASSERT(req->rq_phase == RQ_PHASE_NEW);
 
-		if (!list_empty(&imp->imp_replay_list)) {
-			struct ptlrpc_request *last;
+	rc = sptlrpc_cli_alloc_repbuf(req, max(replen, req->rq_replen));
+	if (rc)
+		RETURN(rc);
 
-			last = list_entry(imp->imp_replay_list.prev,
-					  struct ptlrpc_request,
-					  rq_replay_list);
-			/*
-			 * Requests with rq_replay stay on the list even if no
-			 * commit is expected.
-			 */
-			if (last->rq_transno > imp->imp_peer_committed_transno)
-				ptlrpc_pinger_commit_expected(imp);
-		}
+	memcpy(req->rq_repbuf, repmsg, replen);
+	req->rq_reply_off = 0;
+	req->rq_nob_received = replen;
+	req->rq_repdata = (struct lustre_msg *)req->rq_repbuf;
+	req->rq_repdata_len = replen;
+	req->rq_repmsg = req->rq_repdata;
+
+	rc = ptlrpc_unpack_rep_msg(req, replen);
+	if (rc == 0)
+		rc = lustre_unpack_rep_ptlrpc_body(req, MSG_PTLRPC_BODY_OFF);
+	if (rc == 0 &&
+	    lustre_msg_get_type(req->rq_repmsg) != PTL_RPC_MSG_REPLY &&
+	    lustre_msg_get_type(req->rq_repmsg) != PTL_RPC_MSG_ERR)
+		rc = -EPROTO;
+	if (rc) {
+		DEBUG_REQ(D_ERROR, req, "bad batched reply: rc = %d", rc);
+		GOTO(out, rc = -EPROTO);
+	}
 
+	if (lustre_msg_get_status(req->rq_repmsg) == -EINPROGRESS &&
+	    !req->rq_no_retry_einprogress) {
+		/* sent alone with a new XID to avoid reply reconstruction */
+		DEBUG_REQ(D_RPCTRACE, req, "resending batched request alone");
+		spin_lock(&imp->imp_lock);
+		list_del_init(&req->rq_unreplied_list);
+		ptlrpc_assign_next_xid_nolock(req);
 		spin_unlock(&imp->imp_lock);
+		/* a new request for the server, not a resend */
+		lustre_msg_clear_flags(req->rq_reqmsg, MSG_RESENT);
+		GOTO(out, rc = -EAGAIN);
 	}
 
+	rc = ptlrpc_check_status(req);
+	if (rc == 0)
+		ldlm_cli_update_pool(req);
+
+	ptlrpc_reply_retain(req);
+
+	spin_lock(&req->rq_lock);
+	req->rq_replied = 1;
+	spin_unlock(&req->rq_lock);
+	req->rq_status = rc;
+
+	spin_lock(&imp->imp_lock);
+	list_del_init(&req->rq_unreplied_list);
+	spin_unlock(&imp->imp_lock);
+
+	ptlrpc_rqphase_move(req, RQ_PHASE_COMPLETE);
+	RETURN(rc);
+out:
+	sptlrpc_cli_free_repbuf(req);
+	req->rq_repmsg = NULL;
+	req->rq_repdata = NULL;
+	req->rq_nob_received = 0;
 	RETURN(rc);
 }
+EXPORT_SYMBOL(ptlrpc_batch_subreq_reply);
 
 /**
  * Helper function to send request \a req over the network for the first time
@@ -290,14 +290,16 @@ void request_in_callback(struct lnet_event *ev)
 	struct ptlrpc_request_buffer_desc *rqbd = cbid->cbid_arg;
 	struct ptlrpc_service_part	  *svcpt = rqbd->rqbd_svcpt;
 	struct ptlrpc_service             *service = svcpt->scp_service;
+	struct ptlrpc_rqbd_pool		  *pool;
         struct ptlrpc_request             *req;
         ENTRY;
 
         LASSERT (ev->type == LNET_EVENT_PUT ||
                  ev->type == LNET_EVENT_UNLINK);
-        LASSERT ((char *)ev->md.start >= rqbd->rqbd_buffer);
-        LASSERT ((char *)ev->md.start + ev->offset + ev->mlength <=
-                 rqbd->rqbd_buffer + service->srv_buf_size);
+	LASSERT((char *)ev->md.start >= rqbd->rqbd_buffer);
+	LASSERT((char *)ev->md.start + ev->offset + ev->mlength <=
+		rqbd->rqbd_buffer +
+		ptlrpc_rqbd_buf_size(service, rqbd->rqbd_class));
 
         CDEBUG((ev->status == 0) ? D_NET : D_ERROR,
                "event type %d, status %d, service %s\n",
@@ -353,8 +355,19 @@ void request_in_callback(struct lnet_event *ev)
 
 	ptlrpc_req_add_history(svcpt, req);
 
+	pool = &svcpt->scp_rqbd_pools[rqbd->rqbd_class];
+	if (ev->type == LNET_EVENT_PUT) {
+		pool->rbp_nreqs++;
+		/* buffer full, account for how much of it was used */
+		if (ev->unlinked) {
+			pool->rbp_nretired++;
+			pool->rbp_retired_bytes += ev->offset + ev->mlength;
+		}
+	}
+
 	if (ev->unlinked) {
 		svcpt->scp_nrqbds_posted--;
+		pool->rbp_nrqbds_posted--;
 		CDEBUG(D_INFO, "Buffer complete: %d buffers still posted\n",
 		       svcpt->scp_nrqbds_posted);
 
@@ -397,6 +410,14 @@ void reply_out_callback(struct lnet_event *ev)
                  ev->type == LNET_EVENT_ACK ||
                  ev->type == LNET_EVENT_UNLINK);
 
+	/* histograms of the opcode were set up by the earlier phases */
+	if (ev->unlinked)
+		ptlrpc_lprocfs_lat_tally(svcpt->scp_service->srv_lat_stats,
+					 rs->rs_opc, PTLRPC_LAT_REPLY,
+					 ktime_us_delta(ktime_get(),
+							rs->rs_send_time),
+					 false);
+
         if (!rs->rs_difficult) {
                 /* 'Easy' replies have no further processing so I drop the
                  * net's ref on 'rs' */
@@ -107,6 +107,9 @@ struct gss_api_mech {
 	struct gss_api_ops     *gm_ops;
 	int			gm_sf_num;
 	struct subflavor_desc  *gm_sfs;
+	/* gss_unwrap_bulk() can decrypt the pages of the bulk in place,
+	 * when gss_prep_bulk() left their encrypted offset and size alike */
+	unsigned int		gm_bulk_inplace:1;
 };
 
 /* and must provide the following operations: */
@@ -62,6 +62,7 @@ int gss_cli_ctx_wrap_bulk(struct ptlrpc_cli_ctx *ctx,
 	struct lustre_msg               *msg;
 	struct ptlrpc_bulk_sec_desc     *bsd;
 	rawobj_t                         token;
+	ktime_t                          start;
 	__u32                            maj;
 	int                              offset;
 	int                              rc;
@@ -149,11 +150,13 @@ int gss_cli_ctx_wrap_bulk(struct ptlrpc_cli_ctx *ctx,
 			token.len = lustre_msg_buflen(msg, offset) -
 				    sizeof(*bsd);
 
+			start = ktime_get();
 			maj = lgss_wrap_bulk(gctx->gc_mechctx, desc, &token, 0);
 			if (maj != GSS_S_COMPLETE) {
 				CWARN("fail to encrypt bulk data: %x\n", maj);
 				RETURN(-EACCES);
 			}
+			gss_stat_bulk_record(GSS_BULK_STAT_CLI_ENCRYPT, start);
 		}
 	}
 
@@ -168,6 +171,7 @@ int gss_cli_ctx_unwrap_bulk(struct ptlrpc_cli_ctx *ctx,
         struct lustre_msg               *rmsg, *vmsg;
         struct ptlrpc_bulk_sec_desc     *bsdr, *bsdv;
         rawobj_t                         token;
+        ktime_t                          start;
         __u32                            maj;
         int                              roff, voff;
         ENTRY;
@@ -282,6 +286,7 @@ int gss_cli_ctx_unwrap_bulk(struct ptlrpc_cli_ctx *ctx,
                         token.len = lustre_msg_buflen(vmsg, voff) -
                                     sizeof(*bsdr);
 
+			start = ktime_get();
                         maj = lgss_unwrap_bulk(gctx->gc_mechctx, desc,
                                                &token, 1);
                         if (maj != GSS_S_COMPLETE) {
@@ -289,6 +294,7 @@ int gss_cli_ctx_unwrap_bulk(struct ptlrpc_cli_ctx *ctx,
                                        maj);
                                 RETURN(-EACCES);
                         }
+			gss_stat_bulk_record(GSS_BULK_STAT_CLI_DECRYPT, start);
 
                         desc->bd_nob_transferred = desc->bd_nob;
                 }
@@ -336,6 +342,50 @@ int gss_cli_prep_bulk(struct ptlrpc_request *req,
         RETURN(rc);
 }
 
+/*
+ * Receive the cipher text of a bulk write directly in the pages of the bulk,
+ * i.e. the pages prepared by the OSD, and decrypt it in place there.  This
+ * saves taking pages from the enc pool and copying the whole bulk.  If the
+ * transfer or the decryption fails the write is aborted, as after any
+ * failed bulk transfer.
+ *
+ * \retval	0 if the bulk will be decrypted in place
+ * \retval	-EOPNOTSUPP if the mechanism or the layout of the bulk doesn't
+ *		allow it
+ * \retval	other negative errno on failure
+ */
+static int gss_svc_prep_bulk_inplace(struct ptlrpc_bulk_desc *desc,
+				     struct gss_ctx *mechctx)
+{
+	int rc;
+	int i;
+
+	if (!mechctx->mech_type->gm_bulk_inplace || desc->bd_iov_count == 0)
+		return -EOPNOTSUPP;
+
+	rc = sptlrpc_enc_pool_alias_pages(desc);
+	if (rc)
+		return rc;
+
+	if (lgss_prep_bulk(mechctx, desc) != GSS_S_COMPLETE)
+		GOTO(out, rc = -EACCES);
+
+	/* the cipher text of every page must fit exactly in place */
+	for (i = 0; i < desc->bd_iov_count; i++) {
+		lnet_kiov_t *kiov = &BD_GET_KIOV(desc, i);
+		lnet_kiov_t *ekiov = &BD_GET_ENC_KIOV(desc, i);
+
+		if (ekiov->kiov_offset != kiov->kiov_offset ||
+		    ekiov->kiov_len != kiov->kiov_len)
+			GOTO(out, rc = -EOPNOTSUPP);
+	}
+
+	return 0;
+out:
+	sptlrpc_enc_pool_put_pages(desc);
+	return rc;
+}
+
 int gss_svc_prep_bulk(struct ptlrpc_request *req,
                       struct ptlrpc_bulk_desc *desc)
 {
@@ -358,7 +408,12 @@ int gss_svc_prep_bulk(struct ptlrpc_request *req,
         if (bsd->bsd_svc != SPTLRPC_BULK_SVC_PRIV)
                 RETURN(0);
 
+	rc = gss_svc_prep_bulk_inplace(desc, grctx->src_ctx->gsc_mechctx);
+	if (rc != -EOPNOTSUPP)
+		GOTO(out, rc);
+
         rc = gss_prep_bulk(desc, grctx->src_ctx->gsc_mechctx);
+out:
         if (rc)
                 CERROR("bulk write: failed to prepare encryption "
                        "pages: %d\n", rc);
@@ -372,6 +427,7 @@ int gss_svc_unwrap_bulk(struct ptlrpc_request *req,
         struct gss_svc_reqctx        *grctx;
         struct ptlrpc_bulk_sec_desc  *bsdr, *bsdv;
         rawobj_t                      token;
+        ktime_t                       start;
         __u32                         maj;
         ENTRY;
 
@@ -426,6 +482,7 @@ int gss_svc_unwrap_bulk(struct ptlrpc_request *req,
                 token.data = bsdr->bsd_data;
                 token.len = grctx->src_reqbsd_size - sizeof(*bsdr);
 
+		start = ktime_get();
                 maj = lgss_unwrap_bulk(grctx->src_ctx->gsc_mechctx,
                                        desc, &token, 0);
                 if (maj != GSS_S_COMPLETE) {
@@ -433,6 +490,7 @@ int gss_svc_unwrap_bulk(struct ptlrpc_request *req,
                         CERROR("failed decrypt bulk data: %x\n", maj);
                         RETURN(-EACCES);
                 }
+		gss_stat_bulk_record(GSS_BULK_STAT_SVC_DECRYPT, start);
 
 		/* mimic gss_cli_ctx_unwrap_bulk */
 		desc->bd_nob_transferred = desc->bd_nob;
@@ -449,6 +507,7 @@ int gss_svc_wrap_bulk(struct ptlrpc_request *req,
         struct gss_svc_reqctx        *grctx;
         struct ptlrpc_bulk_sec_desc  *bsdr, *bsdv;
         rawobj_t                      token;
+        ktime_t                       start;
         __u32                         maj;
         int                           rc;
         ENTRY;
@@ -507,6 +566,7 @@ int gss_svc_wrap_bulk(struct ptlrpc_request *req,
                 token.data = bsdv->bsd_data;
                 token.len = grctx->src_repbsd_size - sizeof(*bsdv);
 
+		start = ktime_get();
                 maj = lgss_wrap_bulk(grctx->src_ctx->gsc_mechctx,
                                      desc, &token, 1);
                 if (maj != GSS_S_COMPLETE) {
@@ -514,6 +574,7 @@ int gss_svc_wrap_bulk(struct ptlrpc_request *req,
                         CERROR("failed to encrypt bulk data: %x\n", maj);
                         RETURN(-EACCES);
                 }
+		gss_stat_bulk_record(GSS_BULK_STAT_SVC_ENCRYPT, start);
                 break;
         }
 
@@ -505,8 +505,17 @@ int  __init gss_init_svc_upcall(void);
 void gss_exit_svc_upcall(void);
 
 /* lproc_gss.c */
+enum gss_bulk_stat {
+	GSS_BULK_STAT_CLI_ENCRYPT = 0,
+	GSS_BULK_STAT_CLI_DECRYPT,
+	GSS_BULK_STAT_SVC_ENCRYPT,
+	GSS_BULK_STAT_SVC_DECRYPT,
+	GSS_BULK_STAT_NR,
+};
+
 void gss_stat_oos_record_cli(int behind);
 void gss_stat_oos_record_svc(int phase, int replay);
+void gss_stat_bulk_record(enum gss_bulk_stat op, ktime_t start);
 
 int  __init gss_init_lproc(void);
 void gss_exit_lproc(void);
@@ -35,6 +35,14 @@
 #include <linux/crypto.h>
 #include <linux/mutex.h>
 #include <crypto/ctr.h>
+#ifdef HAVE_AEAD_REQUEST_SET_AD
+#include <crypto/aead.h>
+#endif
+#ifdef HAVE_CRYPTO_SKCIPHER
+#include <crypto/skcipher.h>
+#endif
+#include <libcfs/libcfs_crypto.h>
+#include <libcfs/libcfs_ptask.h>
 
 #include <obd.h>
 #include <obd_class.h>
@@ -50,6 +58,14 @@
 #define SK_MSG_VERSION 1
 #define SK_MIN_SIZE 8
 #define SK_IV_SIZE 16
+/* GCM authentication tag, carried in the HMAC slot of the bulk token */
+#define SK_GCM_TAG_SIZE 16
+/* bulk GMAC token: the counter of the nonce followed by the tag */
+#define SK_GMAC_TOKEN_SIZE (sizeof(__u64) + SK_GCM_TAG_SIZE)
+/* labels of the keys derived for the bulk, see sk_derive_key() */
+#define SK_BULK_MAC_LABEL	"Bulk MAC"
+#define SK_BULK_CRYPT_LABEL	"Bulk cipher"
+#define SK_DERIVED_KEY_MAX	64
 
 /* Starting number for reverse contexts.  It is critical to security
  * that reverse contexts use a different range of numbers than regular
@@ -60,6 +76,26 @@
  * information about the plaintext. */
 #define SK_IV_REV_START (1ULL << 63)
 
+/* Bulk pages are transformed through the skcipher API where the kernel has
+ * it, RPC messages still go through the blkcipher of sc_session_kb */
+#ifdef HAVE_CRYPTO_SKCIPHER
+#define sk_bulk_tfm			crypto_skcipher
+#define sk_bulk_alloc_tfm(name)		\
+	crypto_alloc_skcipher(name, 0, CRYPTO_ALG_ASYNC)
+#define sk_bulk_free_tfm(tfm)		crypto_free_skcipher(tfm)
+#define sk_bulk_setkey(tfm, key, len)	crypto_skcipher_setkey(tfm, key, len)
+#define sk_bulk_blocksize(tfm)		crypto_skcipher_blocksize(tfm)
+#define sk_bulk_ivsize(tfm)		crypto_skcipher_ivsize(tfm)
+#else
+#define sk_bulk_tfm			crypto_blkcipher
+#define sk_bulk_alloc_tfm(name)		\
+	crypto_alloc_blkcipher(name, 0, 0)
+#define sk_bulk_free_tfm(tfm)		crypto_free_blkcipher(tfm)
+#define sk_bulk_setkey(tfm, key, len)	crypto_blkcipher_setkey(tfm, key, len)
+#define sk_bulk_blocksize(tfm)		crypto_blkcipher_blocksize(tfm)
+#define sk_bulk_ivsize(tfm)		crypto_blkcipher_ivsize(tfm)
+#endif
+
 struct sk_ctx {
 	__u16			sc_hmac;
 	__u16			sc_crypt;
@@ -69,6 +105,14 @@ struct sk_ctx {
 	atomic64_t		sc_iv;
 	rawobj_t		sc_hmac_key;
 	struct gss_keyblock	sc_session_kb;
+#ifdef HAVE_CRYPTO_SKCIPHER
+	/* bulk CTR transform keyed with sc_session_kb */
+	struct crypto_skcipher *sc_bulk_tfm;
+#endif
+	/* bulk AEAD transform, only for SK_CRYPT_AES256_GCM */
+	struct crypto_aead     *sc_aead;
+	/* bulk integrity transform, only for SK_HMAC_SHA256_GMAC */
+	struct crypto_aead     *sc_bulk_mac;
 };
 
 struct sk_hdr {
@@ -92,6 +136,10 @@ static struct sk_crypt_type sk_crypt_types[] = {
 		.sct_name = "ctr(aes)",
 		.sct_bytes = 32,
 	},
+	[SK_CRYPT_AES256_GCM] = {
+		.sct_name = "gcm(aes)",
+		.sct_bytes = 32,
+	},
 };
 
 static struct sk_hmac_type sk_hmac_types[] = {
@@ -103,6 +151,11 @@ static struct sk_hmac_type sk_hmac_types[] = {
 		.sht_name = "hmac(sha512)",
 		.sht_bytes = 64,
 	},
+	/* messages use HMAC, bulk pages GMAC, see sk_make_bulk_gmac() */
+	[SK_HMAC_SHA256_GMAC] = {
+		.sht_name = "hmac(sha256)",
+		.sht_bytes = 32,
+	},
 };
 
 static inline unsigned long sk_block_mask(unsigned long len, int blocksize)
@@ -147,10 +200,123 @@ void sk_construct_rfc3686_iv(__u8 *iv, __u32 nonce, __u64 partial_iv)
 	memcpy(iv, &ctr, sizeof(ctr));
 }
 
+#ifdef HAVE_AEAD_REQUEST_SET_AD
+static int sk_derive_key(struct sk_ctx *skc, rawobj_t *secret,
+			 const char *label, __u8 *key);
+
+/* The GCM key is derived from the session key rather than being the key
+ * of the CTR message cipher, so the two modes never share a key stream */
+static int sk_init_aead(struct sk_ctx *skc)
+{
+	struct sk_crypt_type *sct = &sk_crypt_types[skc->sc_crypt];
+	struct crypto_aead *tfm;
+	__u8 *key;
+	int rc;
+
+	OBD_ALLOC(key, SK_DERIVED_KEY_MAX);
+	if (key == NULL)
+		return -ENOMEM;
+
+	rc = sk_derive_key(skc, &skc->sc_session_kb.kb_key,
+			   SK_BULK_CRYPT_LABEL, key);
+	if (rc) {
+		CERROR("failed to derive %s key: rc = %d\n", sct->sct_name,
+		       rc);
+		goto out;
+	}
+
+	/* bulk is transformed synchronously by the calling thread */
+	tfm = crypto_alloc_aead(sct->sct_name, 0, CRYPTO_ALG_ASYNC);
+	if (IS_ERR(tfm)) {
+		rc = PTR_ERR(tfm);
+		CERROR("failed to alloc aead: %s: rc = %d\n", sct->sct_name,
+		       rc);
+		goto out;
+	}
+	skc->sc_aead = tfm;
+
+	rc = crypto_aead_setkey(tfm, key, sct->sct_bytes);
+	if (rc) {
+		CERROR("failed to set %s key, len %d: rc = %d\n",
+		       sct->sct_name, sct->sct_bytes, rc);
+		goto out;
+	}
+
+	rc = crypto_aead_setauthsize(tfm, SK_GCM_TAG_SIZE);
+	if (rc)
+		CERROR("failed to set %s tag size %d: rc = %d\n",
+		       sct->sct_name, SK_GCM_TAG_SIZE, rc);
+out:
+	memset(key, 0, SK_DERIVED_KEY_MAX);
+	OBD_FREE(key, SK_DERIVED_KEY_MAX);
+	return rc;
+}
+#else
+static int sk_init_aead(struct sk_ctx *skc)
+{
+	CERROR("%s is not supported by this kernel\n",
+	       sk_crypt_types[skc->sc_crypt].sct_name);
+	return -EOPNOTSUPP;
+}
+#endif
+
+#ifdef HAVE_CRYPTO_SKCIPHER
+static int sk_init_bulk_tfm(struct sk_ctx *skc)
+{
+	char *alg_name = sk_crypt_types[SK_CRYPT_AES256_CTR].sct_name;
+	struct crypto_skcipher *tfm;
+	int rc;
+
+	tfm = sk_bulk_alloc_tfm(alg_name);
+	if (IS_ERR(tfm)) {
+		rc = PTR_ERR(tfm);
+		CERROR("failed to alloc skcipher: %s: rc = %d\n", alg_name, rc);
+		return rc;
+	}
+	skc->sc_bulk_tfm = tfm;
+
+	rc = sk_bulk_setkey(tfm, skc->sc_session_kb.kb_key.data,
+			    skc->sc_session_kb.kb_key.len);
+	if (rc)
+		CERROR("failed to set %s key, len %d: rc = %d\n", alg_name,
+		       skc->sc_session_kb.kb_key.len, rc);
+	return rc;
+}
+
+static inline struct sk_bulk_tfm *sk_ctx_bulk_tfm(struct sk_ctx *skc)
+{
+	return skc->sc_bulk_tfm;
+}
+#else
+static int sk_init_bulk_tfm(struct sk_ctx *skc)
+{
+	return 0;
+}
+
+static inline struct sk_bulk_tfm *sk_ctx_bulk_tfm(struct sk_ctx *skc)
+{
+	return skc->sc_session_kb.kb_tfm;
+}
+#endif
+
 static int sk_init_keys(struct sk_ctx *skc)
 {
-	return gss_keyblock_init(&skc->sc_session_kb,
-				 sk_crypt_types[skc->sc_crypt].sct_name, 0);
+	int rc;
+
+	/* With GCM only the bulk is transformed by the AEAD, RPC messages
+	 * are still encrypted in CTR mode with the session key.  The AEAD
+	 * has its own key derived from it, see sk_init_aead() */
+	rc = gss_keyblock_init(&skc->sc_session_kb,
+			       sk_crypt_types[SK_CRYPT_AES256_CTR].sct_name, 0);
+	if (rc)
+		return rc;
+
+	/* the bulk block size is taken from the CTR transform in GCM too */
+	rc = sk_init_bulk_tfm(skc);
+	if (rc || skc->sc_crypt != SK_CRYPT_AES256_GCM)
+		return rc;
+
+	return sk_init_aead(skc);
 }
 
 static int sk_fill_context(rawobj_t *inbuf, struct sk_ctx *skc)
@@ -231,6 +397,8 @@ static int sk_fill_context(rawobj_t *inbuf, struct sk_ctx *skc)
 	return 0;
 }
 
+static int sk_init_bulk_mac(struct sk_ctx *skc);
+
 static void sk_delete_context(struct sk_ctx *skc)
 {
 	if (!skc)
@@ -238,6 +406,16 @@ static void sk_delete_context(struct sk_ctx *skc)
 
 	rawobj_free(&skc->sc_hmac_key);
 	gss_keyblock_free(&skc->sc_session_kb);
+#ifdef HAVE_CRYPTO_SKCIPHER
+	if (skc->sc_bulk_tfm)
+		sk_bulk_free_tfm(skc->sc_bulk_tfm);
+#endif
+#ifdef HAVE_AEAD_REQUEST_SET_AD
+	if (skc->sc_aead)
+		crypto_free_aead(skc->sc_aead);
+	if (skc->sc_bulk_mac)
+		crypto_free_aead(skc->sc_bulk_mac);
+#endif
 	OBD_FREE_PTR(skc);
 }
 
@@ -259,6 +437,9 @@ __u32 gss_import_sec_context_sk(rawobj_t *inbuf, struct gss_ctx *gss_context)
 	if (sk_fill_context(inbuf, skc))
 		goto out_err;
 
+	if (skc->sc_hmac == SK_HMAC_SHA256_GMAC && sk_init_bulk_mac(skc))
+		goto out_err;
+
 	/* Only privacy mode needs to initialize keys */
 	if (skc->sc_session_kb.kb_key.len > 0) {
 		privacy = true;
@@ -298,6 +479,9 @@ __u32 gss_copy_reverse_context_sk(struct gss_ctx *gss_context_old,
 
 	if (rawobj_dup(&skc_new->sc_hmac_key, &skc_old->sc_hmac_key))
 		goto out_err;
+	if (skc_new->sc_hmac == SK_HMAC_SHA256_GMAC &&
+	    sk_init_bulk_mac(skc_new))
+		goto out_err;
 	if (gss_keyblock_dup(&skc_new->sc_session_kb, &skc_old->sc_session_kb))
 		goto out_err;
 
@@ -347,6 +531,278 @@ __u32 sk_make_hmac(char *alg_name, rawobj_t *key, int msg_count, rawobj_t *msgs,
 	return rc;
 }
 
+#ifdef HAVE_AEAD_REQUEST_SET_AD
+/* Copy the entries of \a src to \a sg and the entries following it, return
+ * the last entry set */
+static struct scatterlist *sk_sg_append(struct scatterlist *sg,
+					struct sg_table *src)
+{
+	struct scatterlist *last = NULL;
+	struct scatterlist *s;
+	int i;
+
+	for_each_sg(src->sgl, s, src->nents, i) {
+		if (last != NULL)
+			sg = sg_next(last);
+		sg_set_page(sg, sg_page(s), s->length, s->offset);
+		last = sg;
+	}
+
+	return last;
+}
+
+/* Number of entries gss_setup_sgtable() sets up for \a buf */
+static int sk_sg_nents(const void *buf, unsigned int len)
+{
+	if (!is_vmalloc_addr(buf))
+		return 1;
+
+	return PAGE_ALIGN(offset_in_page(buf) + len) >> PAGE_SHIFT;
+}
+
+/* Append the scatterlist of \a len bytes at \a buf to \a sg, return the
+ * last entry set */
+static struct scatterlist *sk_sg_append_buf(struct scatterlist *sg,
+					    void *buf, unsigned int len)
+{
+	struct scatterlist prealloc_sg;
+	struct sg_table sgt;
+	struct scatterlist *last;
+
+	if (gss_setup_sgtable(&sgt, &prealloc_sg, buf, len) != 0)
+		return NULL;
+
+	last = sk_sg_append(sg, &sgt);
+	gss_teardown_sgtable(&sgt);
+	return last;
+}
+
+/**
+ * Derive the key of a bulk transform as HMAC(\a secret, \a label) with the
+ * HMAC of the context, so that no two transforms share a key.  \a key must
+ * have room for SK_DERIVED_KEY_MAX bytes and not be on the stack.
+ */
+static int sk_derive_key(struct sk_ctx *skc, rawobj_t *secret,
+			 const char *label, __u8 *key)
+{
+	struct sk_hmac_type *sht = &sk_hmac_types[skc->sc_hmac];
+	rawobj_t label_obj;
+	rawobj_t key_obj;
+	int rc = 0;
+
+	LASSERT(sht->sht_bytes <= SK_DERIVED_KEY_MAX);
+
+	/* the label is hashed through a scatterlist, keep it off rodata */
+	label_obj.len = strlen(label);
+	OBD_ALLOC(label_obj.data, label_obj.len);
+	if (label_obj.data == NULL)
+		return -ENOMEM;
+	memcpy(label_obj.data, label, label_obj.len);
+
+	key_obj.data = key;
+	key_obj.len = sht->sht_bytes;
+	if (sk_make_hmac(sht->sht_name, secret, 1, &label_obj, 0, NULL,
+			 &key_obj))
+		rc = -EINVAL;
+
+	OBD_FREE(label_obj.data, label_obj.len);
+	return rc;
+}
+
+/*
+ * The integrity of bulk pages is checked with GMAC (GCM authenticating
+ * associated data only) rather than HMAC: it reads every page once with the
+ * carry-less multiply instruction, at a cost close to the CRC32C of the
+ * page checksums.  Unlike a MAC over a vector of per-page CRCs, a keyed
+ * universal hash doesn't let a page be changed to another one with the same
+ * CRC.  Its key is derived from the HMAC key.
+ */
+static int sk_init_bulk_mac(struct sk_ctx *skc)
+{
+	struct crypto_aead *tfm;
+	__u8 *buf;
+	int rc;
+
+	OBD_ALLOC(buf, SK_DERIVED_KEY_MAX);
+	if (buf == NULL)
+		return -ENOMEM;
+
+	rc = sk_derive_key(skc, &skc->sc_hmac_key, SK_BULK_MAC_LABEL, buf);
+	if (rc)
+		goto out;
+
+	tfm = crypto_alloc_aead("gcm(aes)", 0, CRYPTO_ALG_ASYNC);
+	if (IS_ERR(tfm)) {
+		rc = PTR_ERR(tfm);
+		CERROR("failed to alloc bulk mac: rc = %d\n", rc);
+		goto out;
+	}
+	skc->sc_bulk_mac = tfm;
+
+	rc = crypto_aead_setkey(tfm, buf, 32);
+	if (rc == 0)
+		rc = crypto_aead_setauthsize(tfm, SK_GCM_TAG_SIZE);
+	if (rc)
+		CERROR("failed to set up bulk mac: rc = %d\n", rc);
+out:
+	memset(buf, 0, SK_DERIVED_KEY_MAX);
+	OBD_FREE(buf, SK_DERIVED_KEY_MAX);
+	return rc;
+}
+
+/**
+ * Compute or verify the GMAC \a tag of \a msgs followed by \a iovs, with
+ * the nonce made of \a nonce and \a counter.  The messages and the tag may
+ * be in vmalloc'ed buffers but not on the stack.
+ *
+ * \retval	0 on success
+ * \retval	-EBADMSG if the tag doesn't match on verification
+ * \retval	other negative errno on failure
+ */
+static int sk_bulk_gmac(struct crypto_aead *tfm, __u32 nonce, __u64 counter,
+			int msgcnt, rawobj_t *msgs, int iovcnt,
+			lnet_kiov_t *iovs, __u8 *tag, int verify)
+{
+	__u8 iv[SK_IV_SIZE];
+	struct aead_request *req;
+	struct sg_table sgt;
+	struct scatterlist *sg;
+	unsigned int assoclen = 0;
+	int nents = sk_sg_nents(tag, SK_GCM_TAG_SIZE);
+	int i;
+	int rc;
+
+	for (i = 0; i < msgcnt; i++)
+		if (msgs[i].len != 0)
+			nents += sk_sg_nents(msgs[i].data, msgs[i].len);
+	for (i = 0; i < iovcnt; i++)
+		if (iovs[i].kiov_len != 0)
+			nents++;
+
+	rc = sg_alloc_table(&sgt, nents, GFP_NOFS);
+	if (rc)
+		return rc;
+
+	/* everything is associated data, the tag follows it */
+	sg = sgt.sgl;
+	for (i = 0; i < msgcnt; i++) {
+		if (msgs[i].len == 0)
+			continue;
+		sg = sk_sg_append_buf(sg, msgs[i].data, msgs[i].len);
+		if (sg == NULL) {
+			rc = -ENOMEM;
+			goto out;
+		}
+		assoclen += msgs[i].len;
+		sg = sg_next(sg);
+	}
+	for (i = 0; i < iovcnt; i++) {
+		if (iovs[i].kiov_len == 0)
+			continue;
+		sg_set_page(sg, iovs[i].kiov_page, iovs[i].kiov_len,
+			    iovs[i].kiov_offset);
+		assoclen += iovs[i].kiov_len;
+		sg = sg_next(sg);
+	}
+	if (sk_sg_append_buf(sg, tag, SK_GCM_TAG_SIZE) == NULL) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	req = aead_request_alloc(tfm, GFP_NOFS);
+	if (!req) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	sk_construct_rfc3686_iv(iv, nonce, counter);
+	aead_request_set_callback(req, 0, NULL, NULL);
+	aead_request_set_ad(req, assoclen);
+	aead_request_set_crypt(req, sgt.sgl, sgt.sgl,
+			       verify ? SK_GCM_TAG_SIZE : 0, iv);
+	rc = verify ? crypto_aead_decrypt(req) : crypto_aead_encrypt(req);
+
+	aead_request_free(req);
+out:
+	sg_free_table(&sgt);
+	return rc;
+}
+
+static
+__u32 sk_make_bulk_gmac(struct sk_ctx *skc, int msgcnt, rawobj_t *msgs,
+			int iovcnt, lnet_kiov_t *iovs, rawobj_t *token)
+{
+	struct sk_hdr skh;
+	int rc;
+
+	if (token->len < SK_GMAC_TOKEN_SIZE)
+		return GSS_S_FAILURE;
+
+	memset(token->data, 0, token->len);
+	if (sk_fill_header(skc, &skh) != GSS_S_COMPLETE)
+		return GSS_S_FAILURE;
+
+	memcpy(token->data, &skh.skh_iv, sizeof(skh.skh_iv));
+	rc = sk_bulk_gmac(skc->sc_bulk_mac, skc->sc_host_random, skh.skh_iv,
+			  msgcnt, msgs, iovcnt, iovs,
+			  token->data + sizeof(skh.skh_iv), 0);
+	if (rc) {
+		CERROR("failed to sign bulk data: rc = %d\n", rc);
+		return GSS_S_FAILURE;
+	}
+
+	return GSS_S_COMPLETE;
+}
+
+static
+__u32 sk_verify_bulk_gmac(struct sk_ctx *skc, int msgcnt, rawobj_t *msgs,
+			  int iovcnt, lnet_kiov_t *iovs, rawobj_t *token)
+{
+	__u64 counter;
+	int rc;
+
+	if (token->len < SK_GMAC_TOKEN_SIZE) {
+		CDEBUG(D_SEC, "Token received too short, expected %d "
+		       "received %d\n", (int)SK_GMAC_TOKEN_SIZE, token->len);
+		return GSS_S_DEFECTIVE_TOKEN;
+	}
+
+	memcpy(&counter, token->data, sizeof(counter));
+	/* the tag is only read, check it in place rather than on the stack */
+	rc = sk_bulk_gmac(skc->sc_bulk_mac, skc->sc_peer_random, counter,
+			  msgcnt, msgs, iovcnt, iovs,
+			  token->data + sizeof(counter), 1);
+	if (rc == -EBADMSG)
+		return GSS_S_BAD_SIG;
+	if (rc) {
+		CERROR("failed to verify bulk data: rc = %d\n", rc);
+		return GSS_S_FAILURE;
+	}
+
+	return GSS_S_COMPLETE;
+}
+#else /* !HAVE_AEAD_REQUEST_SET_AD */
+static int sk_init_bulk_mac(struct sk_ctx *skc)
+{
+	CERROR("bulk GMAC is not supported by this kernel\n");
+	return -EOPNOTSUPP;
+}
+
+static
+__u32 sk_make_bulk_gmac(struct sk_ctx *skc, int msgcnt, rawobj_t *msgs,
+			int iovcnt, lnet_kiov_t *iovs, rawobj_t *token)
+{
+	return GSS_S_FAILURE;
+}
+
+static
+__u32 sk_verify_bulk_gmac(struct sk_ctx *skc, int msgcnt, rawobj_t *msgs,
+			  int iovcnt, lnet_kiov_t *iovs, rawobj_t *token)
+{
+	return GSS_S_FAILURE;
+}
+#endif /* HAVE_AEAD_REQUEST_SET_AD */
+
 static
 __u32 gss_get_mic_sk(struct gss_ctx *gss_context,
 		     int message_count,
@@ -356,6 +812,11 @@ __u32 gss_get_mic_sk(struct gss_ctx *gss_context,
 		     rawobj_t *token)
 {
 	struct sk_ctx *skc = gss_context->internal_ctx_id;
+
+	if (iov_count > 0 && skc->sc_bulk_mac)
+		return sk_make_bulk_gmac(skc, message_count, messages,
+					 iov_count, iovs, token);
+
 	return sk_make_hmac(sk_hmac_types[skc->sc_hmac].sht_name,
 			    &skc->sc_hmac_key, message_count, messages,
 			    iov_count, iovs, token);
@@ -506,6 +967,11 @@ __u32 gss_verify_mic_sk(struct gss_ctx *gss_context,
 			rawobj_t *token)
 {
 	struct sk_ctx *skc = gss_context->internal_ctx_id;
+
+	if (iov_count > 0 && skc->sc_bulk_mac)
+		return sk_verify_bulk_gmac(skc, message_count, messages,
+					   iov_count, iovs, token);
+
 	return sk_verify_hmac(&sk_hmac_types[skc->sc_hmac], &skc->sc_hmac_key,
 			      message_count, messages, iov_count, iovs, token);
 }
@@ -640,47 +1106,494 @@ __u32 gss_prep_bulk_sk(struct gss_ctx *gss_context,
 	return GSS_S_COMPLETE;
 }
 
-static __u32 sk_encrypt_bulk(struct crypto_blkcipher *tfm, __u8 *iv,
-			     struct ptlrpc_bulk_desc *desc, rawobj_t *cipher,
-			     int adj_nob)
+/* Maximum number of bulk pages transformed by a single cipher call */
+#define SK_BULK_SG_MAX		256
+/* Minimum number of bulk pages in a segment transformed in parallel */
+#define SK_BULK_SEG_MIN_PAGES	64
+/* Maximum number of segments a bulk is split into */
+#define SK_BULK_SEG_MAX		16
+
+/* engine transforming large bulks in parallel, NULL if not available */
+static struct cfs_ptask_engine *sk_bulk_engine;
+
+/* a segment of a bulk transformed by one thread */
+struct sk_bulk_seg {
+	struct cfs_ptask	 sbs_task;
+	struct sk_bulk_tfm	*sbs_tfm;
+	struct ptlrpc_bulk_desc	*sbs_desc;
+	int			 sbs_start;
+	int			 sbs_end;
+	int			 sbs_decrypt;
+	__u8			 sbs_iv[SK_IV_SIZE];
+};
+
+/**
+ * Set up a scatterlist for up to \a count bulk pages, falling back to the
+ * single preallocated entry @prealloc_sg if memory is short.
+ *
+ * Dispose of @sgt with gss_teardown_sgtable().
+ */
+static void sk_setup_bulk_sgtable(struct sg_table *sgt,
+				  struct scatterlist *prealloc_sg, int count)
+{
+	count = min(count, SK_BULK_SG_MAX);
+	if (count > 1 && sg_alloc_table(sgt, count, GFP_NOFS) == 0)
+		return;
+
+	sg_init_table(prealloc_sg, 1);
+	sgt->sgl = prealloc_sg;
+	sgt->nents = sgt->orig_nents = 1;
+}
+
+/* Advance a big endian CTR counter block by \a blocks */
+static void sk_iv_add(__u8 *iv, __u64 blocks)
+{
+	int i;
+
+	for (i = SK_IV_SIZE - 1; i >= 0 && blocks != 0; i--) {
+		blocks += iv[i];
+		iv[i] = blocks & 0xff;
+		blocks >>= 8;
+	}
+}
+
+/* cipher request of a bulk transform, the counter block \a iv is advanced
+ * in place by every call so consecutive calls continue the key stream */
+struct sk_bulk_req {
+	struct sk_bulk_tfm	*sbr_tfm;
+	__u8			*sbr_iv;
+#ifdef HAVE_CRYPTO_SKCIPHER
+	struct skcipher_request	*sbr_req;
+#endif
+};
+
+static int sk_bulk_req_init(struct sk_bulk_req *breq, struct sk_bulk_tfm *tfm,
+			    __u8 *iv, gfp_t gfp)
 {
+	breq->sbr_tfm = tfm;
+	breq->sbr_iv = iv;
+#ifdef HAVE_CRYPTO_SKCIPHER
+	breq->sbr_req = skcipher_request_alloc(tfm, gfp);
+	if (breq->sbr_req == NULL)
+		return -ENOMEM;
+	skcipher_request_set_callback(breq->sbr_req, 0, NULL, NULL);
+#endif
+	return 0;
+}
+
+static void sk_bulk_req_fini(struct sk_bulk_req *breq)
+{
+#ifdef HAVE_CRYPTO_SKCIPHER
+	skcipher_request_free(breq->sbr_req);
+	breq->sbr_req = NULL;
+#endif
+}
+
+/* Transform \a nob bytes from \a src to \a dst */
+static int sk_bulk_req_crypt(struct sk_bulk_req *breq, struct scatterlist *src,
+			     struct scatterlist *dst, int nob, int decrypt)
+{
+#ifdef HAVE_CRYPTO_SKCIPHER
+	skcipher_request_set_crypt(breq->sbr_req, src, dst, nob, breq->sbr_iv);
+	return decrypt ? crypto_skcipher_decrypt(breq->sbr_req) :
+			 crypto_skcipher_encrypt(breq->sbr_req);
+#else
 	struct blkcipher_desc cdesc = {
-		.tfm = tfm,
-		.info = iv,
+		.tfm = breq->sbr_tfm,
+		.info = breq->sbr_iv,
 		.flags = 0,
 	};
-	struct scatterlist ptxt;
-	struct scatterlist ctxt;
+
+	return decrypt ? crypto_blkcipher_decrypt_iv(&cdesc, dst, src, nob) :
+			 crypto_blkcipher_encrypt_iv(&cdesc, dst, src, nob);
+#endif
+}
+
+/* Transform a batch of bulk pages [\a first, \a last] set up in \a ptxt and
+ * \a ctxt.  When decrypting, pages whose plain text size is not a multiple of
+ * the block size were decrypted in place and are copied to the plain text
+ * page afterwards. */
+static int sk_crypt_bulk_batch(struct sk_bulk_req *breq,
+			       struct ptlrpc_bulk_desc *desc,
+			       struct sg_table *ptxt, struct sg_table *ctxt,
+			       int first, int last, int nob, int decrypt)
+{
+	int blocksize = sk_bulk_blocksize(breq->sbr_tfm);
+	int rc;
+	int i;
+
+	if (!decrypt) {
+		rc = sk_bulk_req_crypt(breq, ptxt->sgl, ctxt->sgl, nob, 0);
+		if (rc)
+			CERROR("failed to encrypt pages %d-%d: %d\n",
+			       first, last, rc);
+		return rc;
+	}
+
+	rc = sk_bulk_req_crypt(breq, ctxt->sgl, ptxt->sgl, nob, 1);
+	if (rc) {
+		CERROR("Decryption failed for pages %d-%d: %d\n",
+		       first, last, rc);
+		return rc;
+	}
+
+	for (i = first; i <= last; i++) {
+		lnet_kiov_t *piov = &BD_GET_KIOV(desc, i);
+		lnet_kiov_t *ciov = &BD_GET_ENC_KIOV(desc, i);
+
+		if (ciov->kiov_len == 0 || piov->kiov_len % blocksize == 0 ||
+		    ciov->kiov_page == piov->kiov_page)
+			continue;
+
+		memcpy(page_address(piov->kiov_page) + piov->kiov_offset,
+		       page_address(ciov->kiov_page) + ciov->kiov_offset,
+		       piov->kiov_len);
+	}
+
+	return 0;
+}
+
+/*
+ * Bulk pages are transformed in batches of consecutive pages with a single
+ * cipher call, so the CTR implementation can stream across page boundaries
+ * instead of being set up again for every page.
+ *
+ * A cipher call advances the counter by whole counter blocks, while within
+ * a call the key stream is continuous.  To produce exactly the same cipher
+ * text as a transform done page by page, which keeps the wire format
+ * unchanged, a batch is closed after every page whose length is not a
+ * multiple of the counter block size.
+ *
+ * The encrypted page lengths must have been set up by the caller.
+ */
+static int sk_crypt_bulk_range(struct sk_bulk_tfm *tfm, __u8 *iv,
+			       struct ptlrpc_bulk_desc *desc, int start,
+			       int end, int decrypt)
+{
+	struct sk_bulk_req breq;
+	struct scatterlist ptxt_one;
+	struct scatterlist ctxt_one;
+	struct sg_table ptxt;
+	struct sg_table ctxt;
+	struct scatterlist *psg;
+	struct scatterlist *csg;
 	int blocksize;
+	int ctrsize;
+	int nents = 0;
+	int first = start;
+	int max;
 	int i;
-	int rc;
-	int nob = 0;
+	int rc = 0;
+	int batch_nob = 0;
 
-	blocksize = crypto_blkcipher_blocksize(tfm);
+	rc = sk_bulk_req_init(&breq, tfm, iv, GFP_NOFS);
+	if (rc)
+		return rc;
 
-	sg_init_table(&ptxt, 1);
-	sg_init_table(&ctxt, 1);
+	blocksize = sk_bulk_blocksize(tfm);
+	ctrsize = max_t(int, sk_bulk_ivsize(tfm), blocksize);
 
-	for (i = 0; i < desc->bd_iov_count; i++) {
-		sg_set_page(&ptxt, BD_GET_KIOV(desc, i).kiov_page,
-			    sk_block_mask(BD_GET_KIOV(desc, i).kiov_len,
-					  blocksize),
-			    BD_GET_KIOV(desc, i).kiov_offset);
-		nob += ptxt.length;
+	sk_setup_bulk_sgtable(&ptxt, &ptxt_one, end - start);
+	sk_setup_bulk_sgtable(&ctxt, &ctxt_one, end - start);
+	max = min(ptxt.orig_nents, ctxt.orig_nents);
+	psg = ptxt.sgl;
+	csg = ctxt.sgl;
 
-		sg_set_page(&ctxt, BD_GET_ENC_KIOV(desc, i).kiov_page,
-			    ptxt.length, ptxt.offset);
+	for (i = start; i < end; i++) {
+		lnet_kiov_t *piov = &BD_GET_KIOV(desc, i);
+		lnet_kiov_t *ciov = &BD_GET_ENC_KIOV(desc, i);
 
-		BD_GET_ENC_KIOV(desc, i).kiov_offset = ctxt.offset;
-		BD_GET_ENC_KIOV(desc, i).kiov_len = ctxt.length;
+		if (ciov->kiov_len == 0)
+			continue;
 
-		rc = crypto_blkcipher_encrypt_iv(&cdesc, &ctxt, &ptxt,
-						 ptxt.length);
-		if (rc) {
-			CERROR("failed to encrypt page: %d\n", rc);
-			return rc;
+		if (nents == 0)
+			first = i;
+
+		sg_set_page(csg, ciov->kiov_page, ciov->kiov_len,
+			    ciov->kiov_offset);
+
+		/* In the event the plain text size is not a multiple
+		 * of blocksize we decrypt in place and copy the result
+		 * after the decryption */
+		sg_set_page(psg, !decrypt || piov->kiov_len % blocksize == 0 ?
+				 piov->kiov_page : ciov->kiov_page,
+			    ciov->kiov_len, ciov->kiov_offset);
+
+		batch_nob += ciov->kiov_len;
+		nents++;
+
+		if (nents < max && ciov->kiov_len % ctrsize == 0 &&
+		    i < end - 1) {
+			psg = sg_next(psg);
+			csg = sg_next(csg);
+			continue;
+		}
+
+		rc = sk_crypt_bulk_batch(&breq, desc, &ptxt, &ctxt, first, i,
+					 batch_nob, decrypt);
+		if (rc)
+			goto out;
+
+		psg = ptxt.sgl;
+		csg = ctxt.sgl;
+		nents = 0;
+		batch_nob = 0;
+	}
+
+	/* trailing empty pages may have left a batch open */
+	if (nents > 0)
+		rc = sk_crypt_bulk_batch(&breq, desc, &ptxt, &ctxt, first,
+					 end - 1, batch_nob, decrypt);
+out:
+	gss_teardown_sgtable(&ctxt);
+	gss_teardown_sgtable(&ptxt);
+	sk_bulk_req_fini(&breq);
+	return rc;
+}
+
+static int sk_crypt_bulk_seg(struct cfs_ptask *ptask)
+{
+	struct sk_bulk_seg *seg = ptask->pt_cbdata;
+
+	return sk_crypt_bulk_range(seg->sbs_tfm, seg->sbs_iv, seg->sbs_desc,
+				   seg->sbs_start, seg->sbs_end,
+				   seg->sbs_decrypt);
+}
+
+/**
+ * Encrypt or decrypt the first \a count pages of a bulk.
+ *
+ * Large bulks are split into segments transformed concurrently on
+ * sk_bulk_engine.  In CTR mode the counter block of every segment is the
+ * initial one advanced by the number of counter blocks of the pages before
+ * it, so the result is the same as a sequential transform and the peer
+ * doesn't need to know how the bulk was split.  The first segment is
+ * transformed by the calling thread.
+ */
+static int sk_crypt_bulk(struct sk_bulk_tfm *tfm, __u8 *iv,
+			 struct ptlrpc_bulk_desc *desc, int count, int decrypt)
+{
+	struct sk_bulk_seg *segs;
+	__u64 blocks = 0;
+	int ctrsize;
+	int nsegs;
+	int per_seg;
+	int i, s;
+	int rc = 0;
+
+	nsegs = count / SK_BULK_SEG_MIN_PAGES;
+	if (sk_bulk_engine != NULL)
+		nsegs = min(nsegs, cfs_ptengine_weight(sk_bulk_engine));
+	nsegs = min(nsegs, SK_BULK_SEG_MAX);
+	if (sk_bulk_engine == NULL || nsegs < 2)
+		return sk_crypt_bulk_range(tfm, iv, desc, 0, count, decrypt);
+
+	OBD_ALLOC(segs, nsegs * sizeof(*segs));
+	if (segs == NULL)
+		return sk_crypt_bulk_range(tfm, iv, desc, 0, count, decrypt);
+
+	ctrsize = max_t(int, sk_bulk_ivsize(tfm), sk_bulk_blocksize(tfm));
+	per_seg = DIV_ROUND_UP(count, nsegs);
+
+	for (i = s = 0; s < nsegs && i < count; s++) {
+		struct sk_bulk_seg *seg = &segs[s];
+
+		seg->sbs_tfm = tfm;
+		seg->sbs_desc = desc;
+		seg->sbs_decrypt = decrypt;
+		seg->sbs_start = i;
+		seg->sbs_end = min(i + per_seg, count);
+		memcpy(seg->sbs_iv, iv, SK_IV_SIZE);
+		sk_iv_add(seg->sbs_iv, blocks);
+
+		for (; i < seg->sbs_end; i++)
+			blocks += DIV_ROUND_UP(BD_GET_ENC_KIOV(desc, i).kiov_len,
+					       ctrsize);
+
+		if (s == 0)
+			continue;
+
+		/* ordered tasks complete from the padata serial callback,
+		 * after which padata no longer touches \a segs */
+		if (cfs_ptask_init(&seg->sbs_task, sk_crypt_bulk_seg, seg,
+				   PTF_ORDERED | PTF_COMPLETE | PTF_RETRY,
+				   smp_processor_id()) != 0 ||
+		    cfs_ptask_submit(&seg->sbs_task, sk_bulk_engine) != 0) {
+			/* transform it here after the first segment */
+			seg->sbs_task.pt_flags = 0;
 		}
 	}
+	nsegs = s;
+
+	rc = sk_crypt_bulk_seg(&segs[0].sbs_task);
+
+	for (s = 1; s < nsegs; s++) {
+		struct sk_bulk_seg *seg = &segs[s];
+		int rc2;
+
+		if (cfs_ptask_need_complete(&seg->sbs_task)) {
+			cfs_ptask_wait_for(&seg->sbs_task);
+			rc2 = cfs_ptask_result(&seg->sbs_task);
+		} else {
+			rc2 = sk_crypt_bulk_range(tfm, seg->sbs_iv, desc,
+						  seg->sbs_start, seg->sbs_end,
+						  decrypt);
+		}
+		if (rc == 0)
+			rc = rc2;
+	}
+
+	/* leave the counter block past the bulk, as a sequential transform */
+	sk_iv_add(iv, blocks);
+
+	OBD_FREE(segs, nsegs * sizeof(*segs));
+	return rc;
+}
+
+#ifdef HAVE_AEAD_REQUEST_SET_AD
+/**
+ * Encrypt or decrypt and authenticate the first \a count pages of a bulk
+ * in a single AEAD pass.
+ *
+ * The SK header is authenticated as associated data, the tag is written to
+ * or read from the first SK_GCM_TAG_SIZE bytes of \a tag.  The encrypted
+ * page lengths must have been set up by the caller.
+ *
+ * \retval	0 on success
+ * \retval	-EBADMSG if the tag doesn't match on decryption
+ * \retval	other negative errno on failure
+ */
+static int sk_aead_bulk(struct crypto_aead *tfm, __u8 *iv,
+			struct ptlrpc_bulk_desc *desc, int count,
+			rawobj_t *header, rawobj_t *tag, int decrypt)
+{
+	struct aead_request *req;
+	struct sg_table ptxt;
+	struct sg_table ctxt;
+	struct sg_table hdr;
+	struct sg_table tsg;
+	struct scatterlist hdr_sg;
+	struct scatterlist tag_sg;
+	struct scatterlist *psg;
+	struct scatterlist *csg;
+	int nents = 0;
+	int nob = 0;
+	int i;
+	int rc;
+
+	if (tag->len < SK_GCM_TAG_SIZE)
+		return -EPROTO;
+
+	/* the header and the tag may be vmalloc'ed reply buffers */
+	rc = gss_setup_sgtable(&hdr, &hdr_sg, header->data, header->len);
+	if (rc)
+		return rc;
+	rc = gss_setup_sgtable(&tsg, &tag_sg, tag->data, SK_GCM_TAG_SIZE);
+	if (rc)
+		goto out_hdr;
+
+	for (i = 0; i < count; i++)
+		if (BD_GET_ENC_KIOV(desc, i).kiov_len != 0)
+			nents++;
+
+	/* associated data, pages, and the tag on the cipher text side */
+	rc = sg_alloc_table(&ptxt, hdr.nents + nents, GFP_NOFS);
+	if (rc)
+		goto out_tag;
+	rc = sg_alloc_table(&ctxt, hdr.nents + nents + tsg.nents, GFP_NOFS);
+	if (rc)
+		goto out_ptxt;
+
+	psg = sk_sg_append(ptxt.sgl, &hdr);
+	csg = sk_sg_append(ctxt.sgl, &hdr);
+
+	for (i = 0; i < count; i++) {
+		lnet_kiov_t *piov = &BD_GET_KIOV(desc, i);
+		lnet_kiov_t *ciov = &BD_GET_ENC_KIOV(desc, i);
+
+		if (ciov->kiov_len == 0)
+			continue;
+
+		psg = sg_next(psg);
+		csg = sg_next(csg);
+		sg_set_page(psg, piov->kiov_page, ciov->kiov_len,
+			    ciov->kiov_offset);
+		sg_set_page(csg, ciov->kiov_page, ciov->kiov_len,
+			    ciov->kiov_offset);
+		nob += ciov->kiov_len;
+	}
+	sk_sg_append(sg_next(csg), &tsg);
+
+	req = aead_request_alloc(tfm, GFP_NOFS);
+	if (!req) {
+		rc = -ENOMEM;
+		goto out_ctxt;
+	}
+
+	aead_request_set_callback(req, 0, NULL, NULL);
+	aead_request_set_ad(req, header->len);
+	if (!decrypt) {
+		aead_request_set_crypt(req, ptxt.sgl, ctxt.sgl, nob, iv);
+		rc = crypto_aead_encrypt(req);
+		if (rc)
+			CERROR("failed to encrypt %d bulk bytes: rc = %d\n",
+			       nob, rc);
+	} else {
+		aead_request_set_crypt(req, ctxt.sgl, ptxt.sgl,
+				       nob + SK_GCM_TAG_SIZE, iv);
+		rc = crypto_aead_decrypt(req);
+		if (rc && rc != -EBADMSG)
+			CERROR("failed to decrypt %d bulk bytes: rc = %d\n",
+			       nob, rc);
+	}
+
+	aead_request_free(req);
+out_ctxt:
+	sg_free_table(&ctxt);
+out_ptxt:
+	sg_free_table(&ptxt);
+out_tag:
+	gss_teardown_sgtable(&tsg);
+out_hdr:
+	gss_teardown_sgtable(&hdr);
+	return rc;
+}
+#else
+static int sk_aead_bulk(struct crypto_aead *tfm, __u8 *iv,
+			struct ptlrpc_bulk_desc *desc, int count,
+			rawobj_t *header, rawobj_t *tag, int decrypt)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
+static __u32 sk_encrypt_bulk(struct sk_ctx *skc, __u8 *iv,
+			     struct ptlrpc_bulk_desc *desc, struct sk_wire *skw,
+			     int adj_nob)
+{
+	struct sk_bulk_tfm *tfm = sk_ctx_bulk_tfm(skc);
+	int blocksize;
+	int i;
+	int rc;
+	int nob = 0;
+
+	blocksize = sk_bulk_blocksize(tfm);
+
+	for (i = 0; i < desc->bd_iov_count; i++) {
+		BD_GET_ENC_KIOV(desc, i).kiov_offset =
+			BD_GET_KIOV(desc, i).kiov_offset;
+		BD_GET_ENC_KIOV(desc, i).kiov_len =
+			sk_block_mask(BD_GET_KIOV(desc, i).kiov_len, blocksize);
+		nob += BD_GET_ENC_KIOV(desc, i).kiov_len;
+	}
+
+	if (skc->sc_aead)
+		rc = sk_aead_bulk(skc->sc_aead, iv, desc, desc->bd_iov_count,
+				  &skw->skw_header, &skw->skw_hmac, 0);
+	else
+		rc = sk_crypt_bulk(tfm, iv, desc, desc->bd_iov_count, 0);
+	if (rc)
+		return GSS_S_FAILURE;
 
 	if (adj_nob)
 		desc->bd_nob = nob;
@@ -688,27 +1601,19 @@ static __u32 sk_encrypt_bulk(struct crypto_blkcipher *tfm, __u8 *iv,
 	return 0;
 }
 
-static __u32 sk_decrypt_bulk(struct crypto_blkcipher *tfm, __u8 *iv,
-			     struct ptlrpc_bulk_desc *desc, rawobj_t *cipher,
+static __u32 sk_decrypt_bulk(struct sk_ctx *skc, __u8 *iv,
+			     struct ptlrpc_bulk_desc *desc, struct sk_wire *skw,
 			     int adj_nob)
 {
-	struct blkcipher_desc cdesc = {
-		.tfm = tfm,
-		.info = iv,
-		.flags = 0,
-	};
-	struct scatterlist ptxt;
-	struct scatterlist ctxt;
+	struct sk_bulk_tfm *tfm = sk_ctx_bulk_tfm(skc);
 	int blocksize;
 	int i;
-	int rc;
+	int count;
 	int pnob = 0;
 	int cnob = 0;
+	int rc;
 
-	sg_init_table(&ptxt, 1);
-	sg_init_table(&ctxt, 1);
-
-	blocksize = crypto_blkcipher_blocksize(tfm);
+	blocksize = sk_bulk_blocksize(tfm);
 	if (desc->bd_nob_transferred % blocksize != 0) {
 		CERROR("Transfer not a multiple of block size: %d\n",
 		       desc->bd_nob_transferred);
@@ -750,38 +1655,10 @@ static __u32 sk_decrypt_bulk(struct crypto_blkcipher *tfm, __u8 *iv,
 			}
 		}
 
-		if (ciov->kiov_len == 0)
-			continue;
-
-		sg_init_table(&ctxt, 1);
-		sg_set_page(&ctxt, ciov->kiov_page, ciov->kiov_len,
-			    ciov->kiov_offset);
-		ptxt = ctxt;
-
-		/* In the event the plain text size is not a multiple
-		 * of blocksize we decrypt in place and copy the result
-		 * after the decryption */
-		if (piov->kiov_len % blocksize == 0)
-			sg_assign_page(&ptxt, piov->kiov_page);
-
-		rc = crypto_blkcipher_decrypt_iv(&cdesc, &ptxt, &ctxt,
-						 ctxt.length);
-		if (rc) {
-			CERROR("Decryption failed for page: %d\n", rc);
-			return GSS_S_FAILURE;
-		}
-
-		if (piov->kiov_len % blocksize != 0) {
-			memcpy(page_address(piov->kiov_page) +
-			       piov->kiov_offset,
-			       page_address(ciov->kiov_page) +
-			       ciov->kiov_offset,
-			       piov->kiov_len);
-		}
-
 		cnob += ciov->kiov_len;
 		pnob += piov->kiov_len;
 	}
+	count = i;
 
 	/* if needed, clear up the rest unused iovs */
 	if (adj_nob)
@@ -800,6 +1677,17 @@ static __u32 sk_decrypt_bulk(struct crypto_blkcipher *tfm, __u8 *iv,
 		return GSS_S_FAILURE;
 	}
 
+	if (skc->sc_aead) {
+		rc = sk_aead_bulk(skc->sc_aead, iv, desc, count,
+				  &skw->skw_header, &skw->skw_hmac, 1);
+		if (rc == -EBADMSG)
+			return GSS_S_BAD_SIG;
+	} else {
+		rc = sk_crypt_bulk(tfm, iv, desc, count, 1);
+	}
+	if (rc)
+		return GSS_S_FAILURE;
+
 	return 0;
 }
 
@@ -827,13 +1715,14 @@ __u32 gss_wrap_bulk_sk(struct gss_ctx *gss_context,
 	sk_construct_rfc3686_iv(local_iv, skc->sc_host_random, skh.skh_iv);
 	skw.skw_cipher.data = skw.skw_header.data + skw.skw_header.len;
 	skw.skw_cipher.len = token->len - skw.skw_header.len - sht->sht_bytes;
-	if (sk_encrypt_bulk(skc->sc_session_kb.kb_tfm, local_iv,
-			    desc, &skw.skw_cipher, adj_nob))
-		return GSS_S_FAILURE;
-
 	skw.skw_hmac.data = skw.skw_cipher.data + skw.skw_cipher.len;
 	skw.skw_hmac.len = sht->sht_bytes;
-	if (sk_make_hmac(sht->sht_name, &skc->sc_hmac_key, 1, &skw.skw_cipher,
+	if (sk_encrypt_bulk(skc, local_iv, desc, &skw, adj_nob))
+		return GSS_S_FAILURE;
+
+	/* the GCM tag already authenticates the cipher text */
+	if (!skc->sc_aead &&
+	    sk_make_hmac(sht->sht_name, &skc->sc_hmac_key, 1, &skw.skw_cipher,
 			 desc->bd_iov_count, GET_ENC_KIOV(desc), &skw.skw_hmac))
 		return GSS_S_FAILURE;
 
@@ -869,16 +1758,18 @@ __u32 gss_unwrap_bulk_sk(struct gss_ctx *gss_context,
 	if (rc != GSS_S_COMPLETE)
 		return rc;
 
-	rc = sk_verify_bulk_hmac(&sk_hmac_types[skc->sc_hmac],
-				 &skc->sc_hmac_key, 1, &skw.skw_cipher,
-				 desc->bd_iov_count, GET_ENC_KIOV(desc),
-				 desc->bd_nob, &skw.skw_hmac);
-	if (rc)
-		return rc;
+	/* with GCM the tag is verified by the decryption itself */
+	if (!skc->sc_aead) {
+		rc = sk_verify_bulk_hmac(&sk_hmac_types[skc->sc_hmac],
+					 &skc->sc_hmac_key, 1, &skw.skw_cipher,
+					 desc->bd_iov_count, GET_ENC_KIOV(desc),
+					 desc->bd_nob, &skw.skw_hmac);
+		if (rc)
+			return rc;
+	}
 
 	sk_construct_rfc3686_iv(local_iv, skc->sc_peer_random, skh->skh_iv);
-	rc = sk_decrypt_bulk(skc->sc_session_kb.kb_tfm, local_iv,
-			     desc, &skw.skw_cipher, adj_nob);
+	rc = sk_decrypt_bulk(skc, local_iv, desc, &skw, adj_nob);
 	if (rc)
 		return rc;
 
@@ -949,20 +1840,227 @@ static struct gss_api_mech gss_sk_mech = {
 	.gm_ops         = &gss_sk_ops,
 	.gm_sf_num      = 4,
 	.gm_sfs         = gss_sk_sfs,
+	.gm_bulk_inplace = 1,
 };
 
+/* speed test of a bulk cipher, the transform and buffers are only set up
+ * while the speed is measured, see cfs_crypto_speed_register() */
+struct sk_speed_test {
+	struct cfs_crypto_speed_test	 sst_cst;
+	int				 sst_type;
+	struct sk_bulk_tfm		*sst_tfm;
+#ifdef HAVE_AEAD_REQUEST_SET_AD
+	struct crypto_aead		*sst_aead;
+#endif
+	struct page			*sst_page;
+	/* CFS_CRYPTO_SPEED_TEST_SIZE bytes of data, then the tag */
+	struct sg_table			 sst_sgt;
+	__u8				 sst_iv[SK_IV_SIZE];
+	/* in a scatterlist, so not in this static module struct */
+	__u8				*sst_tag;
+};
+
+static struct sk_speed_test sk_speed_ctr;
+#ifdef HAVE_AEAD_REQUEST_SET_AD
+static struct sk_speed_test sk_speed_gcm;
+#endif
+
+static int sk_speed_ctr_run(void *data)
+{
+	struct sk_speed_test *sst = data;
+	struct sk_bulk_req breq;
+	int rc;
+
+	rc = sk_bulk_req_init(&breq, sst->sst_tfm, sst->sst_iv, GFP_KERNEL);
+	if (rc)
+		return rc;
+
+	rc = sk_bulk_req_crypt(&breq, sst->sst_sgt.sgl, sst->sst_sgt.sgl,
+			       CFS_CRYPTO_SPEED_TEST_SIZE, 0);
+	sk_bulk_req_fini(&breq);
+
+	return rc;
+}
+
+#ifdef HAVE_AEAD_REQUEST_SET_AD
+static int sk_speed_gcm_run(void *data)
+{
+	struct sk_speed_test *sst = data;
+	struct aead_request *req;
+	int rc;
+
+	req = aead_request_alloc(sst->sst_aead, GFP_KERNEL);
+	if (!req)
+		return -ENOMEM;
+
+	aead_request_set_callback(req, 0, NULL, NULL);
+	aead_request_set_ad(req, 0);
+	aead_request_set_crypt(req, sst->sst_sgt.sgl, sst->sst_sgt.sgl,
+			       CFS_CRYPTO_SPEED_TEST_SIZE, sst->sst_iv);
+	rc = crypto_aead_encrypt(req);
+	aead_request_free(req);
+
+	return rc;
+}
+#endif
+
+static void sk_speed_test_cleanup(void *data)
+{
+	struct sk_speed_test *sst = data;
+
+	if (sst->sst_tfm) {
+		sk_bulk_free_tfm(sst->sst_tfm);
+		sst->sst_tfm = NULL;
+	}
+#ifdef HAVE_AEAD_REQUEST_SET_AD
+	if (sst->sst_aead) {
+		crypto_free_aead(sst->sst_aead);
+		sst->sst_aead = NULL;
+	}
+#endif
+	if (sst->sst_sgt.sgl != NULL)
+		sg_free_table(&sst->sst_sgt);
+	sst->sst_sgt.sgl = NULL;
+	if (sst->sst_tag != NULL)
+		OBD_FREE(sst->sst_tag, SK_GCM_TAG_SIZE);
+	sst->sst_tag = NULL;
+	if (sst->sst_page != NULL)
+		__free_page(sst->sst_page);
+	sst->sst_page = NULL;
+}
+
+static int sk_speed_test_setup(void *data)
+{
+	struct sk_speed_test *sst = data;
+	struct sk_crypt_type *sct = &sk_crypt_types[sst->sst_type];
+	struct scatterlist *sg;
+	__u8 key[32];
+	int npages = CFS_CRYPTO_SPEED_TEST_SIZE >> PAGE_SHIFT;
+	int rc;
+	int i;
+
+	LASSERT(sct->sct_bytes <= sizeof(key));
+	sst->sst_page = alloc_page(GFP_KERNEL | __GFP_ZERO);
+	OBD_ALLOC(sst->sst_tag, SK_GCM_TAG_SIZE);
+	if (sst->sst_page == NULL || sst->sst_tag == NULL) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	rc = sg_alloc_table(&sst->sst_sgt, npages + 1, GFP_KERNEL);
+	if (rc) {
+		sst->sst_sgt.sgl = NULL;
+		goto out;
+	}
+	for_each_sg(sst->sst_sgt.sgl, sg, npages, i)
+		sg_set_page(sg, sst->sst_page, PAGE_SIZE, 0);
+	sg_set_buf(sg, sst->sst_tag, SK_GCM_TAG_SIZE);
+
+	cfs_get_random_bytes(key, sct->sct_bytes);
+	cfs_get_random_bytes(sst->sst_iv, sizeof(sst->sst_iv));
+#ifdef HAVE_AEAD_REQUEST_SET_AD
+	if (sst->sst_type == SK_CRYPT_AES256_GCM) {
+		sst->sst_aead = crypto_alloc_aead(sct->sct_name, 0,
+						  CRYPTO_ALG_ASYNC);
+		if (IS_ERR(sst->sst_aead)) {
+			rc = PTR_ERR(sst->sst_aead);
+			sst->sst_aead = NULL;
+			goto out;
+		}
+		rc = crypto_aead_setkey(sst->sst_aead, key, sct->sct_bytes);
+		if (rc == 0)
+			rc = crypto_aead_setauthsize(sst->sst_aead,
+						     SK_GCM_TAG_SIZE);
+	} else
+#endif
+	{
+		sst->sst_tfm = sk_bulk_alloc_tfm(sct->sct_name);
+		if (IS_ERR(sst->sst_tfm)) {
+			rc = PTR_ERR(sst->sst_tfm);
+			sst->sst_tfm = NULL;
+			goto out;
+		}
+		rc = sk_bulk_setkey(sst->sst_tfm, key, sct->sct_bytes);
+	}
+out:
+	memset(key, 0, sizeof(key));
+	if (rc) {
+		CDEBUG(D_SEC, "no speed test for %s: rc = %d\n",
+		       sct->sct_name, rc);
+		sk_speed_test_cleanup(sst);
+	}
+	return rc;
+}
+
+/**
+ * Register the speed test of a bulk cipher \a type, so that its speed is
+ * measured and cached along with the checksum speeds.
+ */
+static void sk_speed_test_init(struct sk_speed_test *sst, int type,
+			       int (*run)(void *data))
+{
+	sst->sst_type = type;
+	sst->sst_cst.cst_name = sk_crypt_types[type].sct_name;
+	sst->sst_cst.cst_run = run;
+	sst->sst_cst.cst_setup = sk_speed_test_setup;
+	sst->sst_cst.cst_cleanup = sk_speed_test_cleanup;
+	sst->sst_cst.cst_data = sst;
+	cfs_crypto_speed_register(&sst->sst_cst);
+}
+
+static void sk_speed_test_fini(struct sk_speed_test *sst)
+{
+	if (sst->sst_cst.cst_name == NULL)
+		return;
+
+	cfs_crypto_speed_unregister(&sst->sst_cst);
+	sst->sst_cst.cst_name = NULL;
+}
+
+static void sk_speed_tests_init(void)
+{
+	sk_speed_test_init(&sk_speed_ctr, SK_CRYPT_AES256_CTR,
+			   sk_speed_ctr_run);
+#ifdef HAVE_AEAD_REQUEST_SET_AD
+	sk_speed_test_init(&sk_speed_gcm, SK_CRYPT_AES256_GCM,
+			   sk_speed_gcm_run);
+#endif
+}
+
+static void sk_speed_tests_fini(void)
+{
+	sk_speed_test_fini(&sk_speed_ctr);
+#ifdef HAVE_AEAD_REQUEST_SET_AD
+	sk_speed_test_fini(&sk_speed_gcm);
+#endif
+}
+
 int __init init_sk_module(void)
 {
 	int status;
 
 	status = lgss_mech_register(&gss_sk_mech);
-	if (status)
+	if (status) {
 		CERROR("Failed to register sk gss mechanism!\n");
+		return status;
+	}
+
+	sk_bulk_engine = cfs_ptengine_init("sk_bulk", cpu_online_mask);
+	if (IS_ERR(sk_bulk_engine)) {
+		/* large bulks are transformed by the calling thread only */
+		CWARN("cannot start parallel bulk encryption: rc = %ld\n",
+		      PTR_ERR(sk_bulk_engine));
+		sk_bulk_engine = NULL;
+	}
+
+	sk_speed_tests_init();
 
-	return status;
+	return 0;
 }
 
 void cleanup_sk_module(void)
 {
+	sk_speed_tests_fini();
+	cfs_ptengine_fini(sk_bulk_engine);
+	sk_bulk_engine = NULL;
 	lgss_mech_unregister(&gss_sk_mech);
 }
@@ -89,6 +89,27 @@ void gss_stat_oos_record_svc(int phase, int replay)
 		atomic_inc(&gss_stat_oos.oos_svc_pass[phase]);
 }
 
+/*
+ * time spent to encrypt or decrypt the bulk of privacy RPCs, in usec
+ */
+static struct lprocfs_stats *gss_bulk_stats;
+
+static const char * const gss_bulk_stat_names[GSS_BULK_STAT_NR] = {
+	[GSS_BULK_STAT_CLI_ENCRYPT]	= "cli_encrypt",
+	[GSS_BULK_STAT_CLI_DECRYPT]	= "cli_decrypt",
+	[GSS_BULK_STAT_SVC_ENCRYPT]	= "svc_encrypt",
+	[GSS_BULK_STAT_SVC_DECRYPT]	= "svc_decrypt",
+};
+
+void gss_stat_bulk_record(enum gss_bulk_stat op, ktime_t start)
+{
+	LASSERT(op >= 0 && op < GSS_BULK_STAT_NR);
+
+	if (gss_bulk_stats != NULL)
+		lprocfs_counter_add(gss_bulk_stats, op,
+				    ktime_us_delta(ktime_get(), start));
+}
+
 static int gss_proc_oos_seq_show(struct seq_file *m, void *v)
 {
 	seq_printf(m, "seqwin:		   %u\n"
@@ -191,11 +212,15 @@ void gss_exit_lproc(void)
                 lprocfs_remove(&gss_proc_root);
                 gss_proc_root = NULL;
         }
+
+	if (gss_bulk_stats)
+		lprocfs_free_stats(&gss_bulk_stats);
 }
 
 int gss_init_lproc(void)
 {
 	int	rc;
+	int	i;
 
 	spin_lock_init(&gss_stat_oos.oos_lock);
 
@@ -215,6 +240,20 @@ int gss_init_lproc(void)
 		GOTO(out, rc);
 	}
 
+	gss_bulk_stats = lprocfs_alloc_stats(GSS_BULK_STAT_NR,
+					     LPROCFS_STATS_FLAG_NONE);
+	if (gss_bulk_stats == NULL)
+		GOTO(out, rc = -ENOMEM);
+
+	for (i = 0; i < GSS_BULK_STAT_NR; i++)
+		lprocfs_counter_init(gss_bulk_stats, i, LPROCFS_CNTR_AVGMINMAX,
+				     gss_bulk_stat_names[i], "usec");
+
+	rc = lprocfs_register_stats(gss_proc_root, "bulk_crypt_stats",
+				    gss_bulk_stats);
+	if (rc)
+		GOTO(out, rc);
+
 	return 0;
 
 out:
@@ -559,6 +559,17 @@ static const struct req_msg_field *mds_update_server[] = {
 	&RMF_OUT_UPDATE_REPLY,
 };
 
+static const struct req_msg_field *mds_reint_batch_client[] = {
+	&RMF_PTLRPC_BODY,
+	&RMF_REINT_BATCH_HEADER,
+	&RMF_REINT_BATCH_BUF,
+};
+
+static const struct req_msg_field *mds_reint_batch_server[] = {
+	&RMF_PTLRPC_BODY,
+	&RMF_REINT_BATCH_REPLY,
+};
+
 static const struct req_msg_field *llog_origin_handle_create_client[] = {
         &RMF_PTLRPC_BODY,
         &RMF_LLOGD_BODY,
@@ -792,6 +803,7 @@ static struct req_format *req_formats[] = {
 	&RQF_MDS_HSM_ACTION,
 	&RQF_MDS_HSM_REQUEST,
 	&RQF_MDS_SWAP_LAYOUTS,
+	&RQF_MDS_REINT_BATCH,
 	&RQF_OUT_UPDATE,
         &RQF_OST_CONNECT,
         &RQF_OST_DISCONNECT,
@@ -1282,6 +1294,22 @@ struct req_msg_field RMF_OUT_UPDATE_BUF = DEFINE_MSGF("update_buf",
 			lustre_swab_out_update_buffer, NULL);
 EXPORT_SYMBOL(RMF_OUT_UPDATE_BUF);
 
+struct req_msg_field RMF_REINT_BATCH_HEADER =
+	DEFINE_MSGF("reint_batch_header", 0,
+		    sizeof(struct reint_batch_header),
+		    lustre_swab_reint_batch_header, NULL);
+EXPORT_SYMBOL(RMF_REINT_BATCH_HEADER);
+
+/* reint_batch_request entries, each followed by a whole lustre_msg */
+struct req_msg_field RMF_REINT_BATCH_BUF =
+	DEFINE_MSGF("reint_batch_buf", 0, -1, NULL, NULL);
+EXPORT_SYMBOL(RMF_REINT_BATCH_BUF);
+
+struct req_msg_field RMF_REINT_BATCH_REPLY =
+	DEFINE_MSGF("reint_batch_reply", 0, -1,
+		    lustre_swab_reint_batch_reply, NULL);
+EXPORT_SYMBOL(RMF_REINT_BATCH_REPLY);
+
 /*
  * Request formats.
  */
@@ -1635,6 +1663,11 @@ struct req_format RQF_MDS_SWAP_LAYOUTS =
 			mdt_swap_layouts, empty);
 EXPORT_SYMBOL(RQF_MDS_SWAP_LAYOUTS);
 
+struct req_format RQF_MDS_REINT_BATCH =
+	DEFINE_REQ_FMT0("MDS_REINT_BATCH", mds_reint_batch_client,
+			mds_reint_batch_server);
+EXPORT_SYMBOL(RQF_MDS_REINT_BATCH);
+
 struct req_format RQF_LLOG_ORIGIN_HANDLE_CREATE =
         DEFINE_REQ_FMT0("LLOG_ORIGIN_HANDLE_CREATE",
                         llog_origin_handle_create_client, llogd_body_only);
@@ -95,6 +95,9 @@ static struct ll_rpc_opcode {
 	{ MDS_HSM_CT_REGISTER, "mds_hsm_ct_register" },
 	{ MDS_HSM_CT_UNREGISTER, "mds_hsm_ct_unregister" },
 	{ MDS_SWAP_LAYOUTS,	"mds_swap_layouts" },
+	{ MDS_RMFID,		"mds_rmfid" },
+	{ MDS_BATCH,		"mds_batch" },
+	{ MDS_REINT_BATCH,	"mds_reint_batch" },
         { LDLM_ENQUEUE,     "ldlm_enqueue" },
         { LDLM_CONVERT,     "ldlm_convert" },
         { LDLM_CANCEL,      "ldlm_cancel" },
@@ -232,6 +235,10 @@ static void ptlrpc_lprocfs_register(struct proc_dir_entry *root, char *dir,
                              svc_counter_config, "req_timeout", "sec");
         lprocfs_counter_init(svc_stats, PTLRPC_REQBUF_AVAIL_CNTR,
                              svc_counter_config, "reqbuf_avail", "bufs");
+	lprocfs_counter_init(svc_stats, PTLRPC_REPBATCH_CNTR,
+			     svc_counter_config, "rep_batch", "reps");
+	lprocfs_counter_init(svc_stats, PTLRPC_REQHPWAIT_CNTR,
+			     svc_counter_config, "req_hp_waittime", "usec");
         for (i = 0; i < EXTRA_LAST_OPC; i++) {
                 char *units;
 
@@ -338,6 +345,86 @@ ptlrpc_lprocfs_req_history_max_seq_write(struct file *file,
 }
 LPROC_SEQ_FOPS(ptlrpc_lprocfs_req_history_max);
 
+static int
+ptlrpc_lprocfs_req_buffers_seq_show(struct seq_file *m, void *v)
+{
+	static const char * const names[PTLRPC_RQBD_NCLASS] = {
+		[PTLRPC_RQBD_SMALL]	= "small",
+		[PTLRPC_RQBD_REGULAR]	= "regular",
+	};
+	struct ptlrpc_service		*svc = m->private;
+	struct ptlrpc_service_part	*svcpt;
+	struct ptlrpc_rqbd_pool		 sum;
+	struct ptlrpc_rqbd_pool		*pool;
+	__u64				 size;
+	int				 cls;
+	int				 i;
+
+	for (cls = 0; cls < PTLRPC_RQBD_NCLASS; cls++) {
+		if (ptlrpc_rqbd_nbufs(svc, cls) == 0)
+			continue;
+
+		memset(&sum, 0, sizeof(sum));
+		ptlrpc_service_for_each_part(svcpt, i, svc) {
+			pool = &svcpt->scp_rqbd_pools[cls];
+			spin_lock(&svcpt->scp_lock);
+			sum.rbp_nrqbds_total += pool->rbp_nrqbds_total;
+			sum.rbp_nrqbds_posted += pool->rbp_nrqbds_posted;
+			sum.rbp_nreqs += pool->rbp_nreqs;
+			sum.rbp_nretired += pool->rbp_nretired;
+			sum.rbp_retired_bytes += pool->rbp_retired_bytes;
+			spin_unlock(&svcpt->scp_lock);
+		}
+
+		size = ptlrpc_rqbd_buf_size(svc, cls);
+		seq_printf(m, "%s:\n"
+			   "  buffer_size: %llu\n"
+			   "  max_request_size: %d\n"
+			   "  buffers: %d\n"
+			   "  posted: %d\n"
+			   "  requests: %llu\n"
+			   "  retired: %llu\n"
+			   "  utilization_pct: %llu\n",
+			   names[cls], size,
+			   ptlrpc_rqbd_max_req_size(svc, cls),
+			   sum.rbp_nrqbds_total, sum.rbp_nrqbds_posted,
+			   sum.rbp_nreqs, sum.rbp_nretired,
+			   sum.rbp_nretired == 0 ? 0 :
+			   div64_u64(sum.rbp_retired_bytes * 100,
+				     sum.rbp_nretired * size));
+	}
+
+	return 0;
+}
+
+/* any write clears the request and utilization counters */
+static ssize_t
+ptlrpc_lprocfs_req_buffers_seq_write(struct file *file,
+				     const char __user *buffer,
+				     size_t count, loff_t *off)
+{
+	struct seq_file			*m = file->private_data;
+	struct ptlrpc_service		*svc = m->private;
+	struct ptlrpc_service_part	*svcpt;
+	struct ptlrpc_rqbd_pool		*pool;
+	int				 cls;
+	int				 i;
+
+	ptlrpc_service_for_each_part(svcpt, i, svc) {
+		spin_lock(&svcpt->scp_lock);
+		for (cls = 0; cls < PTLRPC_RQBD_NCLASS; cls++) {
+			pool = &svcpt->scp_rqbd_pools[cls];
+			pool->rbp_nreqs = 0;
+			pool->rbp_nretired = 0;
+			pool->rbp_retired_bytes = 0;
+		}
+		spin_unlock(&svcpt->scp_lock);
+	}
+
+	return count;
+}
+LPROC_SEQ_FOPS(ptlrpc_lprocfs_req_buffers);
+
 static ssize_t threads_min_show(struct kobject *kobj, struct attribute *attr,
 				char *buf)
 {
@@ -363,7 +450,8 @@ static ssize_t threads_min_store(struct kobject *kobj, struct attribute *attr,
 		return -ERANGE;
 
 	spin_lock(&svc->srv_lock);
-	if (val > svc->srv_nthrs_cpt_limit * svc->srv_ncpts) {
+	if (val > svc->srv_nthrs_cpt_limit * svc->srv_ncpts ||
+	    val / svc->srv_ncpts < PTLRPC_NTHRS_INIT + svc->srv_nthrs_cpt_hp) {
 		spin_unlock(&svc->srv_lock);
 		return -ERANGE;
 	}
@@ -431,6 +519,216 @@ static ssize_t threads_max_store(struct kobject *kobj, struct attribute *attr,
 }
 LUSTRE_RW_ATTR(threads_max);
 
+static ssize_t threads_idle_timeout_show(struct kobject *kobj,
+					 struct attribute *attr, char *buf)
+{
+	struct ptlrpc_service *svc = container_of(kobj, struct ptlrpc_service,
+						  srv_kobj);
+
+	return sprintf(buf, "%d\n", svc->srv_thrs_idle_timeout);
+}
+
+static ssize_t threads_idle_timeout_store(struct kobject *kobj,
+					  struct attribute *attr,
+					  const char *buffer, size_t count)
+{
+	struct ptlrpc_service *svc = container_of(kobj, struct ptlrpc_service,
+						  srv_kobj);
+	unsigned long val;
+	int rc;
+
+	rc = kstrtoul(buffer, 10, &val);
+	if (rc < 0)
+		return rc;
+
+	if (val > INT_MAX / HZ)
+		return -ERANGE;
+
+	spin_lock(&svc->srv_lock);
+	svc->srv_thrs_idle_timeout = val;
+	spin_unlock(&svc->srv_lock);
+
+	return count;
+}
+LUSTRE_RW_ATTR(threads_idle_timeout);
+
+static ssize_t threads_grow_wait_ms_show(struct kobject *kobj,
+					 struct attribute *attr, char *buf)
+{
+	struct ptlrpc_service *svc = container_of(kobj, struct ptlrpc_service,
+						  srv_kobj);
+
+	return sprintf(buf, "%d\n", svc->srv_thrs_grow_wait);
+}
+
+static ssize_t threads_grow_wait_ms_store(struct kobject *kobj,
+					  struct attribute *attr,
+					  const char *buffer, size_t count)
+{
+	struct ptlrpc_service *svc = container_of(kobj, struct ptlrpc_service,
+						  srv_kobj);
+	unsigned long val;
+	int rc;
+
+	rc = kstrtoul(buffer, 10, &val);
+	if (rc < 0)
+		return rc;
+
+	if (val > INT_MAX)
+		return -ERANGE;
+
+	spin_lock(&svc->srv_lock);
+	svc->srv_thrs_grow_wait = val;
+	spin_unlock(&svc->srv_lock);
+
+	return count;
+}
+LUSTRE_RW_ATTR(threads_grow_wait_ms);
+
+static ssize_t threads_cpu_max_show(struct kobject *kobj,
+				    struct attribute *attr, char *buf)
+{
+	struct ptlrpc_service *svc = container_of(kobj, struct ptlrpc_service,
+						  srv_kobj);
+
+	return sprintf(buf, "%d\n", svc->srv_thrs_cpu_max);
+}
+
+static ssize_t threads_cpu_max_store(struct kobject *kobj,
+				     struct attribute *attr,
+				     const char *buffer, size_t count)
+{
+	struct ptlrpc_service *svc = container_of(kobj, struct ptlrpc_service,
+						  srv_kobj);
+	unsigned long val;
+	int rc;
+
+	rc = kstrtoul(buffer, 10, &val);
+	if (rc < 0)
+		return rc;
+
+	if (val == 0 || val > 100)
+		return -ERANGE;
+
+	spin_lock(&svc->srv_lock);
+	svc->srv_thrs_cpu_max = val;
+	spin_unlock(&svc->srv_lock);
+
+	return count;
+}
+LUSTRE_RW_ATTR(threads_cpu_max);
+
+static ssize_t threads_hp_reserved_show(struct kobject *kobj,
+					struct attribute *attr, char *buf)
+{
+	struct ptlrpc_service *svc = container_of(kobj, struct ptlrpc_service,
+						  srv_kobj);
+
+	return sprintf(buf, "%d\n", svc->srv_nthrs_cpt_hp);
+}
+
+static ssize_t threads_hp_reserved_store(struct kobject *kobj,
+					 struct attribute *attr,
+					 const char *buffer, size_t count)
+{
+	struct ptlrpc_service *svc = container_of(kobj, struct ptlrpc_service,
+						  srv_kobj);
+	unsigned long val;
+	int init;
+	int rc;
+
+	if (svc->srv_ops.so_hpreq_handler == NULL)
+		return -EOPNOTSUPP;
+
+	rc = kstrtoul(buffer, 10, &val);
+	if (rc < 0)
+		return rc;
+
+	if (val == 0 || val > svc->srv_nthrs_cpt_limit)
+		return -ERANGE;
+
+	spin_lock(&svc->srv_lock);
+	/* the reserved threads are kept running on top of the others, or
+	 * idle threads would exit down to a floor without normal threads */
+	init = svc->srv_nthrs_cpt_init + (int)val - svc->srv_nthrs_cpt_hp;
+	init = max_t(int, init, PTLRPC_NTHRS_INIT + (int)val);
+	if (init > svc->srv_nthrs_cpt_limit) {
+		spin_unlock(&svc->srv_lock);
+		return -ERANGE;
+	}
+	svc->srv_nthrs_cpt_hp = val;
+	svc->srv_nthrs_cpt_init = init;
+	spin_unlock(&svc->srv_lock);
+
+	return count;
+}
+LUSTRE_RW_ATTR(threads_hp_reserved);
+
+static ssize_t reply_batch_show(struct kobject *kobj, struct attribute *attr,
+				char *buf)
+{
+	struct ptlrpc_service *svc = container_of(kobj, struct ptlrpc_service,
+						  srv_kobj);
+
+	return sprintf(buf, "%d\n", svc->srv_reply_batch);
+}
+
+static ssize_t reply_batch_store(struct kobject *kobj, struct attribute *attr,
+				 const char *buffer, size_t count)
+{
+	struct ptlrpc_service *svc = container_of(kobj, struct ptlrpc_service,
+						  srv_kobj);
+	unsigned long val;
+	int rc;
+
+	rc = kstrtoul(buffer, 10, &val);
+	if (rc < 0)
+		return rc;
+
+	if (val > PTLRPC_REPLY_BATCH_MAX)
+		return -ERANGE;
+
+	spin_lock(&svc->srv_lock);
+	svc->srv_reply_batch = val;
+	spin_unlock(&svc->srv_lock);
+
+	return count;
+}
+LUSTRE_RW_ATTR(reply_batch);
+
+static ssize_t reply_batch_usec_show(struct kobject *kobj,
+				     struct attribute *attr, char *buf)
+{
+	struct ptlrpc_service *svc = container_of(kobj, struct ptlrpc_service,
+						  srv_kobj);
+
+	return sprintf(buf, "%d\n", svc->srv_reply_batch_usec);
+}
+
+static ssize_t reply_batch_usec_store(struct kobject *kobj,
+				      struct attribute *attr,
+				      const char *buffer, size_t count)
+{
+	struct ptlrpc_service *svc = container_of(kobj, struct ptlrpc_service,
+						  srv_kobj);
+	unsigned long val;
+	int rc;
+
+	rc = kstrtoul(buffer, 10, &val);
+	if (rc < 0)
+		return rc;
+
+	if (val > USEC_PER_SEC)
+		return -ERANGE;
+
+	spin_lock(&svc->srv_lock);
+	svc->srv_reply_batch_usec = val;
+	spin_unlock(&svc->srv_lock);
+
+	return count;
+}
+LUSTRE_RW_ATTR(reply_batch_usec);
+
 /**
  * Translates \e ptlrpc_nrs_pol_state values to human-readable strings.
  *
@@ -1101,6 +1399,12 @@ static struct attribute *ptlrpc_svc_attrs[] = {
 	&lustre_attr_threads_min.attr,
 	&lustre_attr_threads_started.attr,
 	&lustre_attr_threads_max.attr,
+	&lustre_attr_threads_idle_timeout.attr,
+	&lustre_attr_threads_grow_wait_ms.attr,
+	&lustre_attr_threads_cpu_max.attr,
+	&lustre_attr_threads_hp_reserved.attr,
+	&lustre_attr_reply_batch.attr,
+	&lustre_attr_reply_batch_usec.attr,
 	&lustre_attr_high_priority_ratio.attr,
 	NULL,
 };
@@ -1137,6 +1441,273 @@ int ptlrpc_sysfs_register_service(struct kset *parent,
 				    &parent->kobj, "%s", svc->srv_name);
 }
 
+/**
+ * Names of the phases in the latency histograms of services.
+ */
+static const char *ptlrpc_lat_phase_names[PTLRPC_LAT_PHASES] = {
+	[PTLRPC_LAT_REQ_IN]	= "req_in",
+	[PTLRPC_LAT_QUEUED]	= "queued",
+	[PTLRPC_LAT_HANDLE]	= "handle",
+	[PTLRPC_LAT_REPLY]	= "reply",
+};
+
+static const char *ptlrpc_lat_rtt_names[] = {
+	[PTLRPC_LAT_RTT]	= "rtt",
+};
+
+static struct ptlrpc_lat_stats *ptlrpc_lat_stats_alloc(int nphases)
+{
+	struct ptlrpc_lat_stats *pls;
+
+	OBD_ALLOC_PTR(pls);
+	if (pls != NULL)
+		pls->pls_nphases = nphases;
+
+	return pls;
+}
+
+static void ptlrpc_lat_stats_free(struct ptlrpc_lat_stats **plsp)
+{
+	struct ptlrpc_lat_stats *pls = *plsp;
+	int i;
+
+	if (pls == NULL)
+		return;
+
+	for (i = 0; i < LUSTRE_MAX_OPCODES; i++)
+		if (pls->pls_hist[i] != NULL)
+			free_percpu(pls->pls_hist[i]);
+	OBD_FREE_PTR(pls);
+	*plsp = NULL;
+}
+
+static unsigned long __percpu *
+ptlrpc_lat_hist_alloc(struct ptlrpc_lat_stats *pls, int opc)
+{
+	unsigned long __percpu	*hist;
+	unsigned int		 noio;
+
+	/* clients tally from ptlrpcd, which must not recurse into the fs */
+	noio = memalloc_noio_save();
+	hist = __alloc_percpu(pls->pls_nphases * OBD_HIST_MAX *
+			      sizeof(unsigned long), sizeof(unsigned long));
+	memalloc_noio_restore(noio);
+	if (hist == NULL)
+		return NULL;
+
+	if (cmpxchg(&pls->pls_hist[opc], NULL, hist) != NULL) {
+		free_percpu(hist);
+		hist = pls->pls_hist[opc];
+	}
+
+	return hist;
+}
+
+/**
+ * Accounts the latency of one phase of an RPC.
+ *
+ * The histograms of an opcode are allocated the first time it is seen,
+ * when \a alloc allows it; callers that may not sleep pass false, and only
+ * account opcodes already seen in a phase allowed to allocate.
+ *
+ * \param[in] pls	latency histograms
+ * \param[in] op	opcode of the RPC
+ * \param[in] phase	phase of the RPC, enum ptlrpc_lat_phase on servers
+ * \param[in] usecs	latency of the phase
+ * \param[in] alloc	whether the histograms may be allocated
+ */
+void ptlrpc_lprocfs_lat_tally(struct ptlrpc_lat_stats *pls, __u32 op,
+			      int phase, s64 usecs, bool alloc)
+{
+	unsigned long __percpu	*hist;
+	int			 opc = opcode_offset(op);
+	int			 bucket = 0;
+
+	if (pls == NULL || opc < 0)
+		return;
+
+	LASSERT(opc < LUSTRE_MAX_OPCODES);
+	LASSERT(phase < pls->pls_nphases);
+
+	hist = ACCESS_ONCE(pls->pls_hist[opc]);
+	if (unlikely(hist == NULL)) {
+		if (!alloc)
+			return;
+		hist = ptlrpc_lat_hist_alloc(pls, opc);
+		if (hist == NULL)
+			return;
+	}
+
+	/* bucket i counts latencies of up to 2^i usecs */
+	if (usecs > 1)
+		bucket = min_t(int, fls64(usecs - 1), OBD_HIST_MAX - 1);
+
+	this_cpu_inc(hist[phase * OBD_HIST_MAX + bucket]);
+}
+
+/**
+ * Smallest bucket holding at least \a pct percent of the samples.
+ */
+static int ptlrpc_lat_percentile(unsigned long *buckets, unsigned long total,
+				 int pct)
+{
+	unsigned long	want = div_u64((u64)total * pct + 99, 100);
+	unsigned long	sum = 0;
+	int		i;
+
+	for (i = 0; i < OBD_HIST_MAX - 1; i++) {
+		sum += buckets[i];
+		if (sum >= want)
+			break;
+	}
+
+	return i;
+}
+
+/**
+ * Dumps latency histograms in YAML, with the samples of all CPUs summed.
+ * Only the opcodes and phases with samples are shown; the percentiles are
+ * the upper bounds of the buckets they fall in.
+ */
+static int ptlrpc_lprocfs_lat_show(struct seq_file *m,
+				   struct ptlrpc_lat_stats *pls,
+				   const char **names)
+{
+	unsigned long		 buckets[OBD_HIST_MAX];
+	unsigned long __percpu	*hist;
+	unsigned long		 total;
+	struct timespec64	 now;
+	bool			 shown;
+	int			 opc;
+	int			 phase;
+	int			 cpu;
+	int			 i;
+
+	ktime_get_real_ts64(&now);
+	seq_printf(m, "snapshot_time: %lld.%09lu\n",
+		   (s64)now.tv_sec, now.tv_nsec);
+
+	if (pls == NULL)
+		return 0;
+
+	for (opc = 0; opc < LUSTRE_MAX_OPCODES; opc++) {
+		hist = ACCESS_ONCE(pls->pls_hist[opc]);
+		if (hist == NULL)
+			continue;
+
+		shown = false;
+		for (phase = 0; phase < pls->pls_nphases; phase++) {
+			memset(buckets, 0, sizeof(buckets));
+			total = 0;
+			for_each_possible_cpu(cpu) {
+				unsigned long *cpu_hist = per_cpu_ptr(hist,
+								      cpu);
+
+				for (i = 0; i < OBD_HIST_MAX; i++)
+					buckets[i] +=
+					  cpu_hist[phase * OBD_HIST_MAX + i];
+			}
+			for (i = 0; i < OBD_HIST_MAX; i++)
+				total += buckets[i];
+			if (total == 0)
+				continue;
+
+			if (!shown) {
+				seq_printf(m, "%s:\n", ll_opcode2str(
+					   ll_rpc_opcode_table[opc].opcode));
+				shown = true;
+			}
+			seq_printf(m, "  %s:\n"
+				   "    samples: %lu\n"
+				   "    p50_usec: %lu\n"
+				   "    p90_usec: %lu\n"
+				   "    p99_usec: %lu\n"
+				   "    usec: {",
+				   names[phase], total,
+				   1UL << ptlrpc_lat_percentile(buckets, total,
+								50),
+				   1UL << ptlrpc_lat_percentile(buckets, total,
+								90),
+				   1UL << ptlrpc_lat_percentile(buckets, total,
+								99));
+			for (i = 0; i < OBD_HIST_MAX; i++) {
+				if (buckets[i] == 0)
+					continue;
+				seq_printf(m, " %lu: %lu,", 1UL << i,
+					   buckets[i]);
+			}
+			seq_printf(m, " }\n");
+		}
+	}
+
+	return 0;
+}
+
+static void ptlrpc_lprocfs_lat_clear(struct ptlrpc_lat_stats *pls)
+{
+	unsigned long __percpu	*hist;
+	int			 opc;
+	int			 cpu;
+
+	if (pls == NULL)
+		return;
+
+	for (opc = 0; opc < LUSTRE_MAX_OPCODES; opc++) {
+		hist = ACCESS_ONCE(pls->pls_hist[opc]);
+		if (hist == NULL)
+			continue;
+		for_each_possible_cpu(cpu)
+			memset(per_cpu_ptr(hist, cpu), 0,
+			       pls->pls_nphases * OBD_HIST_MAX *
+			       sizeof(unsigned long));
+	}
+}
+
+static int ptlrpc_lprocfs_req_latency_seq_show(struct seq_file *m, void *v)
+{
+	struct ptlrpc_service *svc = m->private;
+
+	return ptlrpc_lprocfs_lat_show(m, svc->srv_lat_stats,
+				       ptlrpc_lat_phase_names);
+}
+
+/* any write clears the histograms */
+static ssize_t
+ptlrpc_lprocfs_req_latency_seq_write(struct file *file,
+				     const char __user *buffer,
+				     size_t count, loff_t *off)
+{
+	struct seq_file		*m = file->private_data;
+	struct ptlrpc_service	*svc = m->private;
+
+	ptlrpc_lprocfs_lat_clear(svc->srv_lat_stats);
+
+	return count;
+}
+LPROC_SEQ_FOPS(ptlrpc_lprocfs_req_latency);
+
+static int ptlrpc_lprocfs_rpc_latency_seq_show(struct seq_file *m, void *v)
+{
+	struct obd_device *obd = m->private;
+
+	return ptlrpc_lprocfs_lat_show(m, obd->obd_svc_lat,
+				       ptlrpc_lat_rtt_names);
+}
+
+static ssize_t
+ptlrpc_lprocfs_rpc_latency_seq_write(struct file *file,
+				     const char __user *buffer,
+				     size_t count, loff_t *off)
+{
+	struct seq_file		*m = file->private_data;
+	struct obd_device	*obd = m->private;
+
+	ptlrpc_lprocfs_lat_clear(obd->obd_svc_lat);
+
+	return count;
+}
+LPROC_SEQ_FOPS(ptlrpc_lprocfs_rpc_latency);
+
 void ptlrpc_lprocfs_register_service(struct proc_dir_entry *entry,
                                      struct ptlrpc_service *svc)
 {
@@ -1147,12 +1718,18 @@ void ptlrpc_lprocfs_register_service(struct proc_dir_entry *entry,
 		{ .name = "req_buffer_history_max",
 		  .fops	= &ptlrpc_lprocfs_req_history_max_fops,
 		  .data	= svc },
+		{ .name = "req_buffers",
+		  .fops	= &ptlrpc_lprocfs_req_buffers_fops,
+		  .data	= svc },
 		{ .name = "timeouts",
 		  .fops = &ptlrpc_lprocfs_timeouts_fops,
 		  .data = svc },
 		{ .name = "nrs_policies",
 		  .fops = &ptlrpc_lprocfs_nrs_fops,
 		  .data = svc },
+		{ .name = "req_latency",
+		  .fops = &ptlrpc_lprocfs_req_latency_fops,
+		  .data = svc },
 		{ NULL }
         };
         static struct file_operations req_history_fops = {
@@ -1171,6 +1748,7 @@ void ptlrpc_lprocfs_register_service(struct proc_dir_entry *entry,
 	if (svc->srv_procroot == NULL)
 		return;
 
+	svc->srv_lat_stats = ptlrpc_lat_stats_alloc(PTLRPC_LAT_PHASES);
 	lprocfs_add_vars(svc->srv_procroot, lproc_vars, NULL);
 
 	rc = lprocfs_seq_create(svc->srv_procroot, "req_history",
@@ -1181,9 +1759,20 @@ void ptlrpc_lprocfs_register_service(struct proc_dir_entry *entry,
 
 void ptlrpc_lprocfs_register_obd(struct obd_device *obddev)
 {
+	int rc;
+
         ptlrpc_lprocfs_register(obddev->obd_proc_entry, NULL, "stats",
                                 &obddev->obd_svc_procroot,
                                 &obddev->obd_svc_stats);
+	if (obddev->obd_svc_procroot == NULL)
+		return;
+
+	obddev->obd_svc_lat = ptlrpc_lat_stats_alloc(1);
+	rc = lprocfs_seq_create(obddev->obd_svc_procroot, "rpc_latency",
+				0644, &ptlrpc_lprocfs_rpc_latency_fops,
+				obddev);
+	if (rc)
+		CWARN("Error adding the rpc_latency file\n");
 }
 EXPORT_SYMBOL(ptlrpc_lprocfs_register_obd);
 
@@ -1199,6 +1788,8 @@ void ptlrpc_lprocfs_rpc_sent(struct ptlrpc_request *req, long amount)
         LASSERT(opc < LUSTRE_MAX_OPCODES);
         if (!(op == LDLM_ENQUEUE || op == MDS_REINT))
                 lprocfs_counter_add(svc_stats, opc + EXTRA_MAX_OPCODES, amount);
+	ptlrpc_lprocfs_lat_tally(req->rq_import->imp_obd->obd_svc_lat, op,
+				 PTLRPC_LAT_RTT, amount, true);
 }
 
 void ptlrpc_lprocfs_brw(struct ptlrpc_request *req, int bytes)
@@ -1236,6 +1827,8 @@ void ptlrpc_lprocfs_unregister_service(struct ptlrpc_service *svc)
 
         if (svc->srv_stats)
                 lprocfs_free_stats(&svc->srv_stats);
+
+	ptlrpc_lat_stats_free(&svc->srv_lat_stats);
 }
 
 void ptlrpc_lprocfs_unregister_obd(struct obd_device *obd)
@@ -1245,6 +1838,8 @@ void ptlrpc_lprocfs_unregister_obd(struct obd_device *obd)
 
         if (obd->obd_svc_stats)
                 lprocfs_free_stats(&obd->obd_svc_stats);
+
+	ptlrpc_lat_stats_free(&obd->obd_svc_lat);
 }
 EXPORT_SYMBOL(ptlrpc_lprocfs_unregister_obd);
 
@@ -551,6 +551,145 @@ static void ptlrpc_at_set_reply(struct ptlrpc_request *req, int flags)
 	}
 }
 
+/**
+ * Hand a reply queued by ptlrpc_reply_batch_add() to LNet.
+ */
+static void ptlrpc_send_rs(struct ptlrpc_reply_state *rs)
+{
+	struct ptlrpc_service *svc = rs->rs_svcpt->scp_service;
+	int rc;
+
+	rs->rs_send_time = ktime_get();
+	rc = ptl_send_buf(&rs->rs_md_h, rs->rs_repbuf, rs->rs_repdata_len,
+			  LNET_NOACK_REQ, &rs->rs_cb_id, rs->rs_self,
+			  rs->rs_peer, svc->srv_rep_portal, rs->rs_xid,
+			  rs->rs_reply_off, NULL);
+	if (unlikely(rc != 0)) {
+		CERROR("%s: cannot send reply x%llu to %s: rc = %d\n",
+		       svc->srv_name, rs->rs_xid, libcfs_id2str(rs->rs_peer),
+		       rc);
+		/* drop the reference of the network */
+		ptlrpc_rs_decref(rs);
+	}
+}
+
+/**
+ * Send all replies queued on service partition \a svcpt.
+ *
+ * The replies to one peer are sent back to back, in the order they were
+ * queued, before moving on to the next peer.
+ */
+void ptlrpc_reply_batch_flush(struct ptlrpc_service_part *svcpt)
+{
+	struct ptlrpc_service *svc = svcpt->scp_service;
+	struct ptlrpc_reply_state *rs;
+	struct ptlrpc_reply_state *tmp;
+	struct list_head batch;
+	int count;
+
+	INIT_LIST_HEAD(&batch);
+	spin_lock(&svcpt->scp_rep_lock);
+	list_splice_init(&svcpt->scp_rep_batch, &batch);
+	count = svcpt->scp_rep_batch_count;
+	svcpt->scp_rep_batch_count = 0;
+	spin_unlock(&svcpt->scp_rep_lock);
+
+	if (count == 0)
+		return;
+
+	if (likely(svc->srv_stats != NULL))
+		lprocfs_counter_add(svc->srv_stats, PTLRPC_REPBATCH_CNTR,
+				    count);
+
+	while (!list_empty(&batch)) {
+		lnet_nid_t nid;
+
+		rs = list_entry(batch.next, struct ptlrpc_reply_state,
+				rs_list);
+		/* the reply may be gone once it is sent */
+		nid = rs->rs_peer.nid;
+		list_for_each_entry_safe(rs, tmp, &batch, rs_list) {
+			if (rs->rs_peer.nid != nid)
+				continue;
+			list_del_init(&rs->rs_list);
+			ptlrpc_send_rs(rs);
+		}
+	}
+}
+
+/**
+ * Sends the replies queued on a service partition srv_reply_batch_usec
+ * after the first of them, in case the service threads are all busy or
+ * blocked in handlers and none of them flushes the queue meanwhile.
+ */
+void ptlrpc_reply_batch_work(struct work_struct *work)
+{
+	struct ptlrpc_service_part *svcpt;
+
+	svcpt = container_of(work, struct ptlrpc_service_part,
+			     scp_rep_batch_work.work);
+	ptlrpc_reply_batch_flush(svcpt);
+}
+
+/**
+ * Queue the reply of \a req on its service partition instead of sending it,
+ * if the service batches replies.
+ *
+ * Only the replies sent by the service thread that handled the request are
+ * queued; replies needing an ACK or commit handling and early replies are
+ * always sent right away.  The first reply queued arms scp_rep_batch_work,
+ * so none waits much longer than srv_reply_batch_usec.
+ *
+ * \param[in] req	request being replied to, reply already wrapped
+ * \param[in] flags	PTLRPC_REPLY_* flags of ptlrpc_send_reply()
+ *
+ * \retval true		the reply is queued
+ * \retval false	the reply must be sent by the caller
+ */
+static bool ptlrpc_reply_batch_add(struct ptlrpc_request *req, int flags)
+{
+	struct ptlrpc_reply_state *rs = req->rq_reply_state;
+	struct ptlrpc_service_part *svcpt = rs->rs_svcpt;
+	struct ptlrpc_thread *thread = req->rq_svc_thread;
+	int max = ACCESS_ONCE(svcpt->scp_service->srv_reply_batch);
+	int usec;
+	bool first;
+	bool flush;
+
+	if (max <= 1 || rs->rs_difficult || (flags & PTLRPC_REPLY_EARLY))
+		return false;
+
+	if (thread == NULL || thread->t_svcpt != svcpt ||
+	    thread->t_pid != current_pid())
+		return false;
+
+	LASSERT(list_empty(&rs->rs_list));
+	rs->rs_xid = req->rq_xid;
+	rs->rs_peer = req->rq_source;
+	rs->rs_self = req->rq_self;
+	rs->rs_reply_off = req->rq_reply_off;
+
+	spin_lock(&svcpt->scp_rep_lock);
+	first = svcpt->scp_rep_batch_count++ == 0;
+	if (first)
+		svcpt->scp_rep_batch_start = ktime_get();
+	list_add_tail(&rs->rs_list, &svcpt->scp_rep_batch);
+	flush = svcpt->scp_rep_batch_count >= max;
+	spin_unlock(&svcpt->scp_rep_lock);
+
+	if (flush) {
+		ptlrpc_reply_batch_flush(svcpt);
+	} else if (first) {
+		/* a work still pending from an earlier batch only fires
+		 * sooner, which does no harm */
+		usec = ACCESS_ONCE(svcpt->scp_service->srv_reply_batch_usec);
+		schedule_delayed_work(&svcpt->scp_rep_batch_work,
+				      max_t(long, usecs_to_jiffies(usec), 1));
+	}
+
+	return true;
+}
+
 /**
  * Send request reply from request \a req reply buffer.
  * \a flags defines reply types
@@ -612,6 +751,10 @@ int ptlrpc_send_reply(struct ptlrpc_request *req, int flags)
 
         ptlrpc_at_set_reply(req, flags);
 
+	/* the reply of a batched request is sent with the MDS_REINT_BATCH reply */
+	if (req->rq_batched)
+		return 0;
+
         if (req->rq_export == NULL || req->rq_export->exp_connection == NULL)
                 conn = ptlrpc_connection_get(req->rq_peer, req->rq_self, NULL);
         else
@@ -629,6 +772,11 @@ int ptlrpc_send_reply(struct ptlrpc_request *req, int flags)
 
 	req->rq_sent = ktime_get_real_seconds();
 
+	rs->rs_opc = lustre_msg_get_opc(req->rq_reqmsg);
+	if (ptlrpc_reply_batch_add(req, flags))
+		goto out;
+
+	rs->rs_send_time = ktime_get();
 	rc = ptl_send_buf(&rs->rs_md_h, rs->rs_repbuf, rs->rs_repdata_len,
 			  (rs->rs_difficult && !rs->rs_no_ack) ?
 			  LNET_ACK_REQ : LNET_NOACK_REQ,
@@ -973,11 +1121,14 @@ int ptlrpc_register_rqbd(struct ptlrpc_request_buffer_desc *rqbd)
         LASSERT(rqbd->rqbd_refcount == 0);
         rqbd->rqbd_refcount = 1;
 
-        md.start     = rqbd->rqbd_buffer;
-        md.length    = service->srv_buf_size;
-        md.max_size  = service->srv_max_req_size;
-        md.threshold = LNET_MD_THRESH_INF;
-        md.options   = PTLRPC_MD_OPTIONS | LNET_MD_OP_PUT | LNET_MD_MAX_SIZE;
+	md.start     = rqbd->rqbd_buffer;
+	md.length    = ptlrpc_rqbd_buf_size(service, rqbd->rqbd_class);
+	md.max_size  = ptlrpc_rqbd_max_req_size(service, rqbd->rqbd_class);
+	md.threshold = LNET_MD_THRESH_INF;
+	md.options   = PTLRPC_MD_OPTIONS | LNET_MD_OP_PUT | LNET_MD_MAX_SIZE;
+	/* requests too big for a small buffer go to a regular one */
+	if (rqbd->rqbd_class == PTLRPC_RQBD_SMALL)
+		md.options |= LNET_MD_SKIP_OVERSIZE;
         md.user_ptr  = &rqbd->rqbd_cbid;
         md.eq_handle = ptlrpc_eq_h;
 
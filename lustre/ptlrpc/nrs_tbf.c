@@ -66,6 +66,29 @@ static int tbf_depth = 3;
 module_param(tbf_depth, int, 0644);
 MODULE_PARM_DESC(tbf_depth, "How many tokens that a client can save up");
 
+static unsigned int tbf_elv_depth = 32;
+module_param(tbf_elv_depth, uint, 0644);
+MODULE_PARM_DESC(tbf_elv_depth,
+		 "How many requests the elevator stage of TBF sorts at once");
+
+/** Separates the TBF type from the stage fed by TBF in the policy argument */
+#define NRS_TBF_STAGE_DELIM	'>'
+/** Name of the elevator stage, which orders I/O the way ORR does */
+#define NRS_TBF_STAGE_ORR	"orr"
+
+/** Bandwidth rules count tokens in units of 1 << NRS_TBF_BW_SHIFT bytes */
+#define NRS_TBF_BW_SHIFT	10
+
+static inline __u64 nrs_tbf_rule_rate(struct nrs_tbf_rule *rule)
+{
+	return rule->tr_bw_rate ? rule->tr_bw_rate : rule->tr_rpc_rate;
+}
+
+static inline const char *nrs_tbf_rule_unit(struct nrs_tbf_rule *rule)
+{
+	return rule->tr_bw_rate ? "MB/s" : "";
+}
+
 static enum hrtimer_restart nrs_tbf_timer_cb(struct hrtimer *timer)
 {
 	struct nrs_tbf_head *head = container_of(timer, struct nrs_tbf_head,
@@ -123,18 +146,33 @@ nrs_tbf_cli_rule_put(struct nrs_tbf_client *cli)
 	cli->tc_rule = NULL;
 }
 
+/*
+ * Take the values of the rule of \a cli.  When only the rate of the same
+ * rule changed, \a rate_only keeps the tokens and the check time, which may
+ * be in the future while the client pays for a large request, so that
+ * changing a rule doesn't wipe the debt of its clients.
+ */
 static void
 nrs_tbf_cli_reset_value(struct nrs_tbf_head *head,
-			struct nrs_tbf_client *cli)
+			struct nrs_tbf_client *cli, bool rate_only)
 
 {
 	struct nrs_tbf_rule *rule = cli->tc_rule;
 
+	/* the tokens of bandwidth rules are in other units */
+	if (cli->tc_bandwidth != (rule->tr_bw_rate != 0))
+		rate_only = false;
+
 	cli->tc_rpc_rate = rule->tr_rpc_rate;
 	cli->tc_nsecs = rule->tr_nsecs;
 	cli->tc_depth = rule->tr_depth;
-	cli->tc_ntoken = rule->tr_depth;
-	cli->tc_check_time = ktime_to_ns(ktime_get());
+	cli->tc_bandwidth = rule->tr_bw_rate != 0;
+	if (rate_only) {
+		cli->tc_ntoken = min(cli->tc_ntoken, cli->tc_depth);
+	} else {
+		cli->tc_ntoken = rule->tr_depth;
+		cli->tc_check_time = ktime_to_ns(ktime_get());
+	}
 	cli->tc_rule_sequence = atomic_read(&head->th_rule_sequence);
 	cli->tc_rule_generation = rule->tr_generation;
 
@@ -161,7 +199,7 @@ nrs_tbf_cli_reset(struct nrs_tbf_head *head,
 	list_add_tail(&cli->tc_linkage, &rule->tr_cli_list);
 	spin_unlock(&rule->tr_rule_lock);
 	spin_unlock(&cli->tc_rule_lock);
-	nrs_tbf_cli_reset_value(head, cli);
+	nrs_tbf_cli_reset_value(head, cli, false);
 }
 
 static int
@@ -277,6 +315,33 @@ nrs_tbf_cli_fini(struct nrs_tbf_client *cli)
 	OBD_FREE_PTR(cli);
 }
 
+/**
+ * Set the token rate of a rule.
+ *
+ * A RPC/s rule charges one token per request and lets a client save up
+ * tbf_depth tokens. A bandwidth rule counts tokens in KiB of bulk data, the
+ * bucket holds one second worth of transfer so that a client can burst up to
+ * its full rate after being idle.
+ *
+ * \param[in] rule	the rule to update
+ * \param[in] rpc_rate	RPC/s limit, used if \a bw_rate is 0
+ * \param[in] bw_rate	MB/s limit
+ */
+static void nrs_tbf_rule_set_rate(struct nrs_tbf_rule *rule, __u64 rpc_rate,
+				  __u64 bw_rate)
+{
+	rule->tr_bw_rate = bw_rate;
+	if (bw_rate != 0) {
+		rule->tr_rpc_rate = bw_rate << (20 - NRS_TBF_BW_SHIFT);
+		rule->tr_depth = rule->tr_rpc_rate;
+	} else {
+		rule->tr_rpc_rate = rpc_rate;
+		rule->tr_depth = tbf_depth;
+	}
+	rule->tr_nsecs = NSEC_PER_SEC;
+	do_div(rule->tr_nsecs, rule->tr_rpc_rate);
+}
+
 static int
 nrs_tbf_rule_start(struct ptlrpc_nrs_policy *policy,
 		   struct nrs_tbf_head *head,
@@ -299,10 +364,8 @@ nrs_tbf_rule_start(struct ptlrpc_nrs_policy *policy,
 		return -ENOMEM;
 
 	memcpy(rule->tr_name, start->tc_name, strlen(start->tc_name));
-	rule->tr_rpc_rate = start->u.tc_start.ts_rpc_rate;
-	rule->tr_nsecs = NSEC_PER_SEC;
-	do_div(rule->tr_nsecs, rule->tr_rpc_rate);
-	rule->tr_depth = tbf_depth;
+	nrs_tbf_rule_set_rate(rule, start->u.tc_start.ts_rpc_rate,
+			      start->u.tc_start.ts_bw_rate);
 	atomic_set(&rule->tr_ref, 1);
 	INIT_LIST_HEAD(&rule->tr_cli_list);
 	INIT_LIST_HEAD(&rule->tr_nids);
@@ -348,8 +411,9 @@ nrs_tbf_rule_start(struct ptlrpc_nrs_policy *policy,
 		head->th_rule = rule;
 	}
 
-	CDEBUG(D_RPCTRACE, "TBF starts rule@%p rate %llu gen %llu\n",
-	       rule, rule->tr_rpc_rate, rule->tr_generation);
+	CDEBUG(D_RPCTRACE, "TBF starts rule@%p rate %llu%s gen %llu\n",
+	       rule, nrs_tbf_rule_rate(rule), nrs_tbf_rule_unit(rule),
+	       rule->tr_generation);
 
 	return 0;
 }
@@ -404,7 +468,7 @@ static int
 nrs_tbf_rule_change_rate(struct ptlrpc_nrs_policy *policy,
 			 struct nrs_tbf_head *head,
 			 char *name,
-			 __u64 rate)
+			 __u64 rate, __u64 bw_rate)
 {
 	struct nrs_tbf_rule *rule;
 
@@ -414,9 +478,7 @@ nrs_tbf_rule_change_rate(struct ptlrpc_nrs_policy *policy,
 	if (rule == NULL)
 		return -ENOENT;
 
-	rule->tr_rpc_rate = rate;
-	rule->tr_nsecs = NSEC_PER_SEC;
-	do_div(rule->tr_nsecs, rule->tr_rpc_rate);
+	nrs_tbf_rule_set_rate(rule, rate, bw_rate);
 	rule->tr_generation++;
 	nrs_tbf_rule_put(rule);
 
@@ -429,12 +491,13 @@ nrs_tbf_rule_change(struct ptlrpc_nrs_policy *policy,
 		    struct nrs_tbf_cmd *change)
 {
 	__u64	 rate = change->u.tc_change.tc_rpc_rate;
+	__u64	 bw_rate = change->u.tc_change.tc_bw_rate;
 	char	*next_name = change->u.tc_change.tc_next_name;
 	int	 rc;
 
-	if (rate != 0) {
+	if (rate != 0 || bw_rate != 0) {
 		rc = nrs_tbf_rule_change_rate(policy, head, change->tc_name,
-					      rate);
+					      rate, bw_rate);
 		if (rc)
 			return rc;
 	}
@@ -546,6 +609,69 @@ static struct cfs_binheap_ops nrs_tbf_heap_ops = {
 	.hop_compare	= tbf_cli_compare,
 };
 
+/**
+ * Compares two disk positions, object first and then offset within the
+ * object, the same way ORR orders the requests of an object.
+ *
+ * \retval <0 position 1 comes before position 2
+ * \retval  0 positions are the same
+ * \retval >0 position 1 comes after position 2
+ */
+static int nrs_tbf_elv_pos_cmp(const struct ost_id *oi1, __u64 off1,
+			       const struct ost_id *oi2, __u64 off2)
+{
+	if (ostid_seq(oi1) != ostid_seq(oi2))
+		return ostid_seq(oi1) < ostid_seq(oi2) ? -1 : 1;
+	if (ostid_id(oi1) != ostid_id(oi2))
+		return ostid_id(oi1) < ostid_id(oi2) ? -1 : 1;
+	if (off1 != off2)
+		return off1 < off2 ? -1 : 1;
+	return 0;
+}
+
+/**
+ * Binary heap predicate of the elevator stage.
+ *
+ * Requests are dispatched in sweeps of increasing object and offset; a
+ * request behind the current position of the elevator waits for the next
+ * sweep, so that a stream of requests ahead cannot starve it.
+ *
+ * \param[in] e1 the first binheap node to compare
+ * \param[in] e2 the second binheap node to compare
+ *
+ * \retval 0 e1 > e2
+ * \retval 1 e1 < e2
+ */
+static int
+tbf_elv_compare(struct cfs_binheap_node *e1, struct cfs_binheap_node *e2)
+{
+	struct nrs_tbf_req *tr1;
+	struct nrs_tbf_req *tr2;
+	int		    rc;
+
+	tr1 = &container_of(e1, struct ptlrpc_nrs_request, nr_node)->nr_u.tbf;
+	tr2 = &container_of(e2, struct ptlrpc_nrs_request, nr_node)->nr_u.tbf;
+
+	if (tr1->tr_round != tr2->tr_round)
+		return tr1->tr_round < tr2->tr_round;
+
+	rc = nrs_tbf_elv_pos_cmp(&tr1->tr_oi, tr1->tr_offset,
+				 &tr2->tr_oi, tr2->tr_offset);
+	if (rc != 0)
+		return rc < 0;
+
+	return tr1->tr_sequence < tr2->tr_sequence;
+}
+
+/**
+ * TBF elevator binary heap operations
+ */
+static struct cfs_binheap_ops nrs_tbf_elv_heap_ops = {
+	.hop_enter	= NULL,
+	.hop_exit	= NULL,
+	.hop_compare	= tbf_elv_compare,
+};
+
 static unsigned nrs_tbf_jobid_hop_hash(struct cfs_hash *hs, const void *key,
 				  unsigned mask)
 {
@@ -1004,8 +1130,9 @@ static int nrs_tbf_jobid_rule_init(struct ptlrpc_nrs_policy *policy,
 static int
 nrs_tbf_jobid_rule_dump(struct nrs_tbf_rule *rule, struct seq_file *m)
 {
-	seq_printf(m, "%s {%s} %llu, ref %d\n", rule->tr_name,
-		   rule->tr_jobids_str, rule->tr_rpc_rate,
+	seq_printf(m, "%s {%s} %llu%s, ref %d\n", rule->tr_name,
+		   rule->tr_jobids_str, nrs_tbf_rule_rate(rule),
+		   nrs_tbf_rule_unit(rule),
 		   atomic_read(&rule->tr_ref) - 1);
 	return 0;
 }
@@ -1214,8 +1341,9 @@ static int nrs_tbf_nid_rule_init(struct ptlrpc_nrs_policy *policy,
 static int
 nrs_tbf_nid_rule_dump(struct nrs_tbf_rule *rule, struct seq_file *m)
 {
-	seq_printf(m, "%s {%s} %llu, ref %d\n", rule->tr_name,
-		   rule->tr_nids_str, rule->tr_rpc_rate,
+	seq_printf(m, "%s {%s} %llu%s, ref %d\n", rule->tr_name,
+		   rule->tr_nids_str, nrs_tbf_rule_rate(rule),
+		   nrs_tbf_rule_unit(rule),
 		   atomic_read(&rule->tr_ref) - 1);
 	return 0;
 }
@@ -1809,8 +1937,9 @@ nrs_tbf_rule_init(struct ptlrpc_nrs_policy *policy,
 static int
 nrs_tbf_generic_rule_dump(struct nrs_tbf_rule *rule, struct seq_file *m)
 {
-	seq_printf(m, "%s %s %llu, ref %d\n", rule->tr_name,
-		   rule->tr_conds_str, rule->tr_rpc_rate,
+	seq_printf(m, "%s %s %llu%s, ref %d\n", rule->tr_name,
+		   rule->tr_conds_str, nrs_tbf_rule_rate(rule),
+		   nrs_tbf_rule_unit(rule),
 		   atomic_read(&rule->tr_ref) - 1);
 	return 0;
 }
@@ -2108,8 +2237,9 @@ static int nrs_tbf_opcode_rule_init(struct ptlrpc_nrs_policy *policy,
 static int
 nrs_tbf_opcode_rule_dump(struct nrs_tbf_rule *rule, struct seq_file *m)
 {
-	seq_printf(m, "%s {%s} %llu, ref %d\n", rule->tr_name,
-		   rule->tr_opcodes_str, rule->tr_rpc_rate,
+	seq_printf(m, "%s {%s} %llu%s, ref %d\n", rule->tr_name,
+		   rule->tr_opcodes_str, nrs_tbf_rule_rate(rule),
+		   nrs_tbf_rule_unit(rule),
 		   atomic_read(&rule->tr_ref) - 1);
 	return 0;
 }
@@ -2169,17 +2299,32 @@ static int nrs_tbf_start(struct ptlrpc_nrs_policy *policy, char *arg)
 	struct nrs_tbf_head	*head;
 	struct nrs_tbf_ops	*ops;
 	__u32			 type;
+	char			 buf[NRS_TBF_TYPE_MAX_LEN];
 	char			*name;
+	char			*stage;
+	bool			 elv = false;
 	int found = 0;
 	int i;
 	int rc = 0;
 
-	if (arg == NULL)
+	if (arg == NULL) {
 		name = NRS_TBF_TYPE_GENERIC;
-	else if (strlen(arg) < NRS_TBF_TYPE_MAX_LEN)
-		name = arg;
-	else
+	} else if (strlen(arg) < NRS_TBF_TYPE_MAX_LEN) {
+		/* "<type>[>orr]", an empty type being the generic one */
+		strcpy(buf, arg);
+		name = buf;
+		stage = strchr(buf, NRS_TBF_STAGE_DELIM);
+		if (stage != NULL) {
+			*stage++ = '\0';
+			if (strcmp(stage, NRS_TBF_STAGE_ORR) != 0)
+				GOTO(out, rc = -ENOTSUPP);
+			elv = true;
+			if (*name == '\0')
+				name = NRS_TBF_TYPE_GENERIC;
+		}
+	} else {
 		GOTO(out, rc = -EINVAL);
+	}
 
 	for (i = 0; i < ARRAY_SIZE(nrs_tbf_types); i++) {
 		if (strcmp(name, nrs_tbf_types[i].ntt_name) == 0) {
@@ -2208,6 +2353,18 @@ static int nrs_tbf_start(struct ptlrpc_nrs_policy *policy, char *arg)
 	if (head->th_binheap == NULL)
 		GOTO(out_free_head, rc = -ENOMEM);
 
+	if (elv) {
+		head->th_elv_heap = cfs_binheap_create(&nrs_tbf_elv_heap_ops,
+						       CBH_FLAG_ATOMIC_GROW,
+						       4096, NULL,
+						       nrs_pol2cptab(policy),
+						       nrs_pol2cptid(policy));
+		if (head->th_elv_heap == NULL)
+			GOTO(out_free_heap, rc = -ENOMEM);
+		head->th_elv_depth = max_t(unsigned int,
+					   ACCESS_ONCE(tbf_elv_depth), 1);
+	}
+
 	atomic_set(&head->th_rule_sequence, 0);
 	spin_lock_init(&head->th_rule_lock);
 	INIT_LIST_HEAD(&head->th_list);
@@ -2220,6 +2377,8 @@ static int nrs_tbf_start(struct ptlrpc_nrs_policy *policy, char *arg)
 	policy->pol_private = head;
 	return 0;
 out_free_heap:
+	if (head->th_elv_heap != NULL)
+		cfs_binheap_destroy(head->th_elv_heap);
 	cfs_binheap_destroy(head->th_binheap);
 out_free_head:
 	OBD_FREE_PTR(head);
@@ -2255,6 +2414,10 @@ static void nrs_tbf_stop(struct ptlrpc_nrs_policy *policy)
 	LASSERT(head->th_binheap != NULL);
 	LASSERT(cfs_binheap_is_empty(head->th_binheap));
 	cfs_binheap_destroy(head->th_binheap);
+	if (head->th_elv_heap != NULL) {
+		LASSERT(cfs_binheap_is_empty(head->th_elv_heap));
+		cfs_binheap_destroy(head->th_elv_heap);
+	}
 	OBD_FREE_PTR(head);
 	nrs->nrs_throttling = 0;
 	wake_up(&policy->pol_nrs->nrs_svcpt->scp_waitq);
@@ -2380,13 +2543,15 @@ static int nrs_tbf_res_get(struct ptlrpc_nrs_policy *policy,
 			if (rule != cli->tc_rule) {
 				nrs_tbf_cli_reset(head, rule, cli);
 			} else {
-				if (cli->tc_rule_generation != rule->tr_generation)
-					nrs_tbf_cli_reset_value(head, cli);
+				if (cli->tc_rule_generation !=
+				    rule->tr_generation)
+					nrs_tbf_cli_reset_value(head, cli,
+								true);
 				nrs_tbf_rule_put(rule);
 			}
 		} else if (cli->tc_rule_generation !=
 			   cli->tc_rule->tr_generation) {
-			nrs_tbf_cli_reset_value(head, cli);
+			nrs_tbf_cli_reset_value(head, cli, true);
 		}
 		spin_unlock(&policy->pol_nrs->nrs_svcpt->scp_req_lock);
 		goto out;
@@ -2436,27 +2601,21 @@ static void nrs_tbf_res_put(struct ptlrpc_nrs_policy *policy,
 }
 
 /**
- * Called when getting a request from the TBF policy for handling, or just
- * peeking; removes the request from the policy when it is to be handled.
+ * Takes the next request TBF lets through, or just peeks at it; the client
+ * it belongs to is charged for it, and the policy starts throttling when no
+ * client has tokens left.
  *
  * \param[in] policy The policy
- * \param[in] peek   When set, signifies that we just want to examine the
- *		     request, and not handle it, so the request is not removed
- *		     from the policy.
- * \param[in] force  Force the policy to return a request; unused in this
- *		     policy
- *
- * \retval The request to be handled; this is the next request in the TBF
- *	   rule
+ * \param[in] head   The policy private data
+ * \param[in] peek   When set, the request is not removed from the policy.
  *
- * \see ptlrpc_nrs_req_get_nolock()
- * \see nrs_request_get()
+ * \retval The next request in the TBF rule, or NULL if there is none or if
+ *	   the clients are out of tokens
  */
-static
-struct ptlrpc_nrs_request *nrs_tbf_req_get(struct ptlrpc_nrs_policy *policy,
-					   bool peek, bool force)
+static struct ptlrpc_nrs_request *
+nrs_tbf_req_get_token(struct ptlrpc_nrs_policy *policy,
+		      struct nrs_tbf_head *head, bool peek)
 {
-	struct nrs_tbf_head	  *head = policy->pol_private;
 	struct ptlrpc_nrs_request *nrq = NULL;
 	struct nrs_tbf_client     *cli;
 	struct cfs_binheap_node	  *node;
@@ -2484,24 +2643,41 @@ struct ptlrpc_nrs_request *nrs_tbf_req_get(struct ptlrpc_nrs_policy *policy,
 
 		deadline = cli->tc_check_time +
 			  cli->tc_nsecs;
-		LASSERT(now >= cli->tc_check_time);
-		passed = now - cli->tc_check_time;
-		ntoken = passed * cli->tc_rpc_rate;
-		do_div(ntoken, NSEC_PER_SEC);
-		ntoken += cli->tc_ntoken;
-		if (ntoken > cli->tc_depth)
+		if (now < cli->tc_check_time) {
+			/* still paying for a request larger than the bucket */
+			ntoken = 0;
+		} else if (cli->tc_bandwidth &&
+			   now - cli->tc_check_time >= NSEC_PER_SEC) {
+			/* bandwidth buckets fill up in one second */
 			ntoken = cli->tc_depth;
+		} else {
+			passed = now - cli->tc_check_time;
+			ntoken = passed * cli->tc_rpc_rate;
+			do_div(ntoken, NSEC_PER_SEC);
+			ntoken += cli->tc_ntoken;
+			if (ntoken > cli->tc_depth)
+				ntoken = cli->tc_depth;
+		}
 		if (ntoken > 0) {
-			struct ptlrpc_request *req;
+			__u64 cost = 1;
+
 			nrq = list_entry(cli->tc_list.next,
 					     struct ptlrpc_nrs_request,
 					     nr_u.tbf.tr_list);
-			req = container_of(nrq,
-					   struct ptlrpc_request,
-					   rq_nrq);
-			ntoken--;
-			cli->tc_ntoken = ntoken;
-			cli->tc_check_time = now;
+			if (cli->tc_bandwidth)
+				cost = nrq->nr_u.tbf.tr_kbytes;
+			if (cost <= ntoken) {
+				cli->tc_ntoken = ntoken - cost;
+				cli->tc_check_time = now;
+			} else {
+				/* let the client go into debt, it gets no
+				 * token until the whole request is paid */
+				cost -= ntoken;
+				cost *= NSEC_PER_SEC;
+				do_div(cost, cli->tc_rpc_rate);
+				cli->tc_ntoken = 0;
+				cli->tc_check_time = now + cost;
+			}
 			list_del_init(&nrq->nr_u.tbf.tr_list);
 			if (list_empty(&cli->tc_list)) {
 				cfs_binheap_remove(head->th_binheap,
@@ -2532,6 +2708,214 @@ struct ptlrpc_nrs_request *nrs_tbf_req_get(struct ptlrpc_nrs_policy *policy,
 	return nrq;
 }
 
+/**
+ * Stages an OST I/O request TBF let through in the elevator. The request
+ * goes to the current sweep if it is ahead of the elevator position, and to
+ * the next one otherwise.
+ *
+ * \param[in] head The policy private data
+ * \param[in] nrq  The request
+ *
+ * \retval 0	success
+ * \retval -ve	the request could not be staged
+ */
+static int nrs_tbf_elv_add(struct nrs_tbf_head *head,
+			   struct ptlrpc_nrs_request *nrq)
+{
+	struct nrs_tbf_req *tr = &nrq->nr_u.tbf;
+	int		    rc;
+
+	tr->tr_round = head->th_elv_round;
+	if (nrs_tbf_elv_pos_cmp(&tr->tr_oi, tr->tr_offset,
+				&head->th_elv_oi, head->th_elv_offset) < 0)
+		tr->tr_round++;
+
+	rc = cfs_binheap_insert(head->th_elv_heap, &nrq->nr_node);
+	if (rc == 0)
+		tr->tr_in_elv = 1;
+
+	return rc;
+}
+
+/**
+ * Gets a request from a TBF policy chained to the elevator stage.
+ *
+ * The elevator is refilled with the requests TBF lets through, up to
+ * nrs_tbf_head::th_elv_depth requests, and the request at the elevator
+ * position is dispatched. Requests that are not OST I/O bypass the elevator.
+ *
+ * \param[in] policy The policy
+ * \param[in] head   The policy private data
+ * \param[in] peek   When set, the request is not removed from the policy.
+ *
+ * \retval The request to be handled, or NULL
+ */
+static struct ptlrpc_nrs_request *
+nrs_tbf_elv_get(struct ptlrpc_nrs_policy *policy, struct nrs_tbf_head *head,
+		bool peek)
+{
+	struct ptlrpc_nrs_request *nrq;
+	struct cfs_binheap_node	  *node;
+
+	if (peek) {
+		node = cfs_binheap_root(head->th_elv_heap);
+		if (node != NULL)
+			return container_of(node, struct ptlrpc_nrs_request,
+					    nr_node);
+		return nrs_tbf_req_get_token(policy, head, true);
+	}
+
+	while (cfs_binheap_size(head->th_elv_heap) < head->th_elv_depth) {
+		nrq = nrs_tbf_req_get_token(policy, head, false);
+		if (nrq == NULL)
+			break;
+		if (!nrq->nr_u.tbf.tr_elv_io || nrs_tbf_elv_add(head, nrq))
+			return nrq;
+	}
+
+	node = cfs_binheap_root(head->th_elv_heap);
+	if (node == NULL)
+		return NULL;
+
+	/**
+	 * The staged requests were already charged by TBF, do not let the
+	 * service wait for the TBF timer before handling them.
+	 */
+	policy->pol_nrs->nrs_throttling = 0;
+
+	nrq = container_of(node, struct ptlrpc_nrs_request, nr_node);
+	cfs_binheap_remove(head->th_elv_heap, node);
+	nrq->nr_u.tbf.tr_in_elv = 0;
+	head->th_elv_round = nrq->nr_u.tbf.tr_round;
+	head->th_elv_oi = nrq->nr_u.tbf.tr_oi;
+	head->th_elv_offset = nrq->nr_u.tbf.tr_offset;
+
+	CDEBUG(D_RPCTRACE, "TBF elevator dispatches "DOSTID" offset %llu "
+	       "round %llu\n", POSTID(&head->th_elv_oi), head->th_elv_offset,
+	       head->th_elv_round);
+
+	return nrq;
+}
+
+/**
+ * Called when getting a request from the TBF policy for handling, or just
+ * peeking; removes the request from the policy when it is to be handled.
+ *
+ * \param[in] policy The policy
+ * \param[in] peek   When set, signifies that we just want to examine the
+ *		     request, and not handle it, so the request is not removed
+ *		     from the policy.
+ * \param[in] force  Force the policy to return a request; unused in this
+ *		     policy
+ *
+ * \retval The request to be handled; this is the next request in the TBF
+ *	   rule, or in the elevator stage when there is one
+ *
+ * \see ptlrpc_nrs_req_get_nolock()
+ * \see nrs_request_get()
+ */
+static
+struct ptlrpc_nrs_request *nrs_tbf_req_get(struct ptlrpc_nrs_policy *policy,
+					   bool peek, bool force)
+{
+	struct nrs_tbf_head *head = policy->pol_private;
+
+	assert_spin_locked(&policy->pol_nrs->nrs_svcpt->scp_req_lock);
+
+	if (head->th_elv_heap != NULL)
+		return nrs_tbf_elv_get(policy, head, peek);
+
+	return nrs_tbf_req_get_token(policy, head, peek);
+}
+
+/**
+ * Size of the bulk data moved by a request, in units charged by bandwidth
+ * rules.
+ *
+ * The size is taken from the remote niobufs of OST_READ and OST_WRITE
+ * requests, or from the chunk descriptors when the data is compressed, as
+ * only the compressed bytes go over the wire. The request pill of these
+ * requests is already initialized by the ost_io service's hpreq handler.
+ * Requests without bulk are charged a single unit.
+ *
+ * \param[in] req the request
+ *
+ * \retval bulk size in units of 1 << NRS_TBF_BW_SHIFT bytes, at least 1
+ */
+static __u32 nrs_tbf_req_kbytes(struct ptlrpc_request *req)
+{
+	struct niobuf_remote	*nb;
+	struct chunk_desc	*cdesc;
+	__u32			 opc;
+	__u64			 bytes = 0;
+	int			 count;
+	int			 i;
+
+	opc = lustre_msg_get_opc(req->rq_reqmsg);
+	if ((opc != OST_READ && opc != OST_WRITE) ||
+	    req->rq_pill.rc_fmt == NULL)
+		return 1;
+
+	if (req_capsule_has_field(&req->rq_pill, &RMF_CHUNK_DESC,
+				  RCL_CLIENT)) {
+		count = req_capsule_get_size(&req->rq_pill, &RMF_CHUNK_DESC,
+					     RCL_CLIENT) / sizeof(*cdesc);
+		cdesc = count > 0 ? req_capsule_client_get(&req->rq_pill,
+							   &RMF_CHUNK_DESC) :
+				    NULL;
+		if (cdesc != NULL) {
+			for (i = 0; i < count; i++)
+				bytes += cdesc[i].psize;
+			goto out;
+		}
+	}
+
+	count = req_capsule_get_size(&req->rq_pill, &RMF_NIOBUF_REMOTE,
+				     RCL_CLIENT) / sizeof(*nb);
+	nb = req_capsule_client_get(&req->rq_pill, &RMF_NIOBUF_REMOTE);
+	if (nb == NULL)
+		return 1;
+
+	for (i = 0; i < count; i++)
+		bytes += nb[i].rnb_len;
+out:
+	bytes >>= NRS_TBF_BW_SHIFT;
+	return bytes > 0 ? min_t(__u64, bytes, UINT_MAX) : 1;
+}
+
+/**
+ * Records the object and start offset of an OST I/O request, which the
+ * elevator stage sorts requests by. Only logical file offsets are used, as
+ * looking up the physical ones the way ORR does may sleep.
+ *
+ * \param[in] nrq the request
+ */
+static void nrs_tbf_req_elv_fill(struct ptlrpc_nrs_request *nrq)
+{
+	struct ptlrpc_request	*req = container_of(nrq, struct ptlrpc_request,
+						    rq_nrq);
+	struct nrs_tbf_req	*tr = &nrq->nr_u.tbf;
+	struct obd_ioobj	*ioo;
+	struct niobuf_remote	*nb;
+	__u32			 opc;
+
+	tr->tr_elv_io = 0;
+
+	opc = lustre_msg_get_opc(req->rq_reqmsg);
+	if ((opc != OST_READ && opc != OST_WRITE) ||
+	    req->rq_pill.rc_fmt == NULL)
+		return;
+
+	ioo = req_capsule_client_get(&req->rq_pill, &RMF_OBD_IOOBJ);
+	nb = req_capsule_client_get(&req->rq_pill, &RMF_NIOBUF_REMOTE);
+	if (ioo == NULL || nb == NULL)
+		return;
+
+	tr->tr_oi = ioo->ioo_oid;
+	tr->tr_offset = nb[0].rnb_offset;
+	tr->tr_elv_io = 1;
+}
+
 /**
  * Adds request \a nrq to \a policy's list of queued requests
  *
@@ -2554,6 +2938,12 @@ static int nrs_tbf_req_add(struct ptlrpc_nrs_policy *policy,
 			   struct nrs_tbf_client, tc_res);
 	head = container_of(nrs_request_resource(nrq)->res_parent,
 			    struct nrs_tbf_head, th_res);
+	nrq->nr_u.tbf.tr_kbytes =
+		nrs_tbf_req_kbytes(container_of(nrq, struct ptlrpc_request,
+						rq_nrq));
+	nrq->nr_u.tbf.tr_in_elv = 0;
+	if (head->th_elv_heap != NULL)
+		nrs_tbf_req_elv_fill(nrq);
 	if (list_empty(&cli->tc_list)) {
 		LASSERT(!cli->tc_in_heap);
 		rc = cfs_binheap_insert(head->th_binheap, &cli->tc_node);
@@ -2615,6 +3005,13 @@ static void nrs_tbf_req_del(struct ptlrpc_nrs_policy *policy,
 	head = container_of(nrs_request_resource(nrq)->res_parent,
 			    struct nrs_tbf_head, th_res);
 
+	/* already charged and out of the client queue */
+	if (nrq->nr_u.tbf.tr_in_elv) {
+		cfs_binheap_remove(head->th_elv_heap, &nrq->nr_node);
+		nrq->nr_u.tbf.tr_in_elv = 0;
+		return;
+	}
+
 	LASSERT(!list_empty(&nrq->nr_u.tbf.tr_list));
 	list_del_init(&nrq->nr_u.tbf.tr_list);
 	if (list_empty(&cli->tc_list)) {
@@ -2795,6 +3192,20 @@ nrs_tbf_parse_value_pair(struct nrs_tbf_cmd *cmd, char *buffer)
 			cmd->u.tc_change.tc_rpc_rate = rate;
 		else
 			return -EINVAL;
+	} else if (strcmp(key, "bw") == 0) {
+		rc = kstrtoull(val, 10, &rate);
+		if (rc)
+			return rc;
+
+		if (rate <= 0 || rate >= LPROCFS_NRS_RATE_MAX)
+			return -EINVAL;
+
+		if (cmd->tc_cmd == NRS_CTL_TBF_START_RULE)
+			cmd->u.tc_start.ts_bw_rate = rate;
+		else if (cmd->tc_cmd == NRS_CTL_TBF_CHANGE_RULE)
+			cmd->u.tc_change.tc_bw_rate = rate;
+		else
+			return -EINVAL;
 	}  else if (strcmp(key, "rank") == 0) {
 		if (!name_is_valid(val))
 			return -EINVAL;
@@ -2828,11 +3239,19 @@ nrs_tbf_parse_value_pairs(struct nrs_tbf_cmd *cmd, char *buffer)
 
 	switch (cmd->tc_cmd) {
 	case NRS_CTL_TBF_START_RULE:
+		/* a rule limits either RPCs or bandwidth, not both */
+		if (cmd->u.tc_start.ts_rpc_rate != 0 &&
+		    cmd->u.tc_start.ts_bw_rate != 0)
+			return -EINVAL;
 		if (cmd->u.tc_start.ts_rpc_rate == 0)
 			cmd->u.tc_start.ts_rpc_rate = tbf_rate;
 		break;
 	case NRS_CTL_TBF_CHANGE_RULE:
+		if (cmd->u.tc_change.tc_rpc_rate != 0 &&
+		    cmd->u.tc_change.tc_bw_rate != 0)
+			return -EINVAL;
 		if (cmd->u.tc_change.tc_rpc_rate == 0 &&
+		    cmd->u.tc_change.tc_bw_rate == 0 &&
 		    cmd->u.tc_change.tc_next_name == NULL)
 			return -EINVAL;
 		break;
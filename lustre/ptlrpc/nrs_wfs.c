@@ -0,0 +1,1214 @@
+/*
+ * GPL HEADER START
+ *
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 only,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License version 2 for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; If not, see
+ * http://www.gnu.org/licenses/gpl-2.0.html
+ *
+ * GPL HEADER END
+ */
+/*
+ * lustre/ptlrpc/nrs_wfs.c
+ *
+ * Network Request Scheduler (NRS) WFS policy
+ *
+ * Weighted fair sharing of a service between user, group or project IDs,
+ * using Deficit Round Robin.
+ */
+/**
+ * \addtogoup nrs
+ * @{
+ */
+#ifdef HAVE_SERVER_SUPPORT
+
+#define DEBUG_SUBSYSTEM S_RPC
+#include <obd_support.h>
+#include <obd_class.h>
+#include <lustre_net.h>
+#include <lprocfs_status.h>
+#include "ptlrpc_internal.h"
+
+/**
+ * \name WFS policy
+ *
+ * Weighted Fair Share scheduling over user, group or project IDs
+ *
+ * Requests are sorted into classes by the ID found in the request body,
+ * e.g. the fsuid of a metadata operation or the owner of the object an OST
+ * I/O is done on. Classes with queued requests are served in Deficit Round
+ * Robin order: at the beginning of each of its rounds, a class is given
+ * nrs_wfs_head::wh_quantum times its weight RPCs to handle before the next
+ * class is served. A user with thousands of processes thus gets the same
+ * share of the service threads as a user with a single one, unless it is
+ * given a larger weight.
+ *
+ * The ID is only a hint for scheduling; it is not authenticated, as the
+ * request has not been through the credential checks of the target yet.
+ *
+ * @{
+ */
+
+#define NRS_POL_NAME_WFS	"wfs"
+
+static const char *nrs_wfs_key_names[] = {
+	[NRS_WFS_KEY_UID]	= "uid",
+	[NRS_WFS_KEY_GID]	= "gid",
+	[NRS_WFS_KEY_PROJID]	= "projid",
+};
+
+/**
+ * libcfs_hash operations for nrs_wfs_head::wh_cls_hash
+ *
+ * This uses the user, group or project ID of the requests as its key, in
+ * order to hash nrs_wfs_class objects.
+ */
+#define NRS_WFS_BKT_BITS	8
+#define NRS_WFS_BITS		16
+
+static unsigned nrs_wfs_hop_hash(struct cfs_hash *hs, const void *key,
+				 unsigned mask)
+{
+	return cfs_hash_djb2_hash(key, sizeof(__u32), mask);
+}
+
+static int nrs_wfs_hop_keycmp(const void *key, struct hlist_node *hnode)
+{
+	__u32			*id = (__u32 *)key;
+	struct nrs_wfs_class	*cls = hlist_entry(hnode, struct nrs_wfs_class,
+						   wc_hnode);
+	return *id == cls->wc_id;
+}
+
+static void *nrs_wfs_hop_key(struct hlist_node *hnode)
+{
+	struct nrs_wfs_class	*cls = hlist_entry(hnode, struct nrs_wfs_class,
+						   wc_hnode);
+	return &cls->wc_id;
+}
+
+static void *nrs_wfs_hop_object(struct hlist_node *hnode)
+{
+	return hlist_entry(hnode, struct nrs_wfs_class, wc_hnode);
+}
+
+static void nrs_wfs_hop_get(struct cfs_hash *hs, struct hlist_node *hnode)
+{
+	struct nrs_wfs_class	*cls = hlist_entry(hnode, struct nrs_wfs_class,
+						   wc_hnode);
+	atomic_inc(&cls->wc_ref);
+}
+
+/**
+ * Drops a reference on a class, and frees the class when only the reference
+ * of the hash itself is left, so that the hash does not keep a class for
+ * every ID that has ever been seen; the IDs come from the requests and are
+ * not authenticated.
+ */
+static void nrs_wfs_hop_put_free(struct cfs_hash *hs,
+				 struct hlist_node *hnode)
+{
+	struct nrs_wfs_class	*cls = hlist_entry(hnode, struct nrs_wfs_class,
+						   wc_hnode);
+	struct cfs_hash_bd	 bd;
+
+	cfs_hash_bd_get_and_lock(hs, &cls->wc_id, &bd, 1);
+
+	if (atomic_dec_return(&cls->wc_ref) > 1) {
+		cfs_hash_bd_unlock(hs, &bd, 1);
+
+		return;
+	}
+	LASSERT(atomic_read(&cls->wc_ref) == 1);
+	LASSERT(list_empty(&cls->wc_list));
+	LASSERT(list_empty(&cls->wc_active));
+
+	cfs_hash_bd_del_locked(hs, &bd, hnode);
+	cfs_hash_bd_unlock(hs, &bd, 1);
+
+	OBD_FREE_PTR(cls);
+}
+
+static void nrs_wfs_hop_put(struct cfs_hash *hs, struct hlist_node *hnode)
+{
+	struct nrs_wfs_class	*cls = hlist_entry(hnode, struct nrs_wfs_class,
+						   wc_hnode);
+	atomic_dec(&cls->wc_ref);
+}
+
+static void nrs_wfs_hop_exit(struct cfs_hash *hs, struct hlist_node *hnode)
+{
+	struct nrs_wfs_class	*cls = hlist_entry(hnode, struct nrs_wfs_class,
+						   wc_hnode);
+	LASSERTF(atomic_read(&cls->wc_ref) == 0,
+		 "Busy WFS class for ID %u, with %d refs\n",
+		 cls->wc_id, atomic_read(&cls->wc_ref));
+	LASSERT(list_empty(&cls->wc_list));
+
+	OBD_FREE_PTR(cls);
+}
+
+static struct cfs_hash_ops nrs_wfs_hash_ops = {
+	.hs_hash	= nrs_wfs_hop_hash,
+	.hs_keycmp	= nrs_wfs_hop_keycmp,
+	.hs_key		= nrs_wfs_hop_key,
+	.hs_object	= nrs_wfs_hop_object,
+	.hs_get		= nrs_wfs_hop_get,
+	.hs_put		= nrs_wfs_hop_put_free,
+	.hs_put_locked	= nrs_wfs_hop_put,
+	.hs_exit	= nrs_wfs_hop_exit,
+};
+
+/**
+ * Returns the weight of ID \a id.
+ *
+ * The weight table is read without ptlrpc_nrs::nrs_lock; a weight being
+ * changed concurrently is only applied one round late. An entry being
+ * rewritten has NRS_WFS_ID_NONE as its ID, which never matches here.
+ */
+static __u32 nrs_wfs_weight_get(struct nrs_wfs_head *head, __u32 id)
+{
+	int count = ACCESS_ONCE(head->wh_nweights);
+	int i;
+
+	if (id == NRS_WFS_ID_NONE)
+		return NRS_WFS_WEIGHT_DEFAULT;
+
+	for (i = 0; i < count; i++) {
+		if (ACCESS_ONCE(head->wh_weights[i].ww_id) == id) {
+			smp_rmb();
+			return ACCESS_ONCE(head->wh_weights[i].ww_weight);
+		}
+	}
+
+	return NRS_WFS_WEIGHT_DEFAULT;
+}
+
+/**
+ * Rewrites weight table entry \a ww, so that lockless readers see either
+ * the old or the new entry, or no match at all, but never the ID of one
+ * with the weight of the other.
+ */
+static void nrs_wfs_weight_store(struct nrs_wfs_weight *ww, __u32 id,
+				 __u32 weight)
+{
+	ACCESS_ONCE(ww->ww_id) = NRS_WFS_ID_NONE;
+	smp_wmb();
+	ACCESS_ONCE(ww->ww_weight) = weight;
+	smp_wmb();
+	ACCESS_ONCE(ww->ww_id) = id;
+}
+
+/**
+ * Sets the weight of ID \a id; setting the default weight removes the ID
+ * from the table.
+ *
+ * \param[in] head	the policy instance
+ * \param[in] id	user, group or project ID
+ * \param[in] weight	the new weight
+ *
+ * \retval 0		success
+ * \retval -ENOSPC	too many IDs with a non-default weight
+ */
+static int nrs_wfs_weight_set(struct nrs_wfs_head *head, __u32 id,
+			      __u32 weight)
+{
+	struct nrs_wfs_weight	*last;
+	int			 i;
+
+	for (i = 0; i < head->wh_nweights; i++) {
+		if (head->wh_weights[i].ww_id == id)
+			break;
+	}
+
+	if (weight == NRS_WFS_WEIGHT_DEFAULT) {
+		if (i == head->wh_nweights)
+			return 0;
+		/* the last entry stays valid until the count is lowered */
+		last = &head->wh_weights[head->wh_nweights - 1];
+		nrs_wfs_weight_store(&head->wh_weights[i], last->ww_id,
+				     last->ww_weight);
+		smp_wmb();
+		ACCESS_ONCE(head->wh_nweights) = head->wh_nweights - 1;
+		return 0;
+	}
+
+	if (i < head->wh_nweights) {
+		ACCESS_ONCE(head->wh_weights[i].ww_weight) = weight;
+		return 0;
+	}
+
+	if (head->wh_nweights == NRS_WFS_WEIGHTS_MAX)
+		return -ENOSPC;
+
+	nrs_wfs_weight_store(&head->wh_weights[i], id, weight);
+	smp_wmb();
+	ACCESS_ONCE(head->wh_nweights) = head->wh_nweights + 1;
+
+	return 0;
+}
+
+/**
+ * Reads a 32-bit field of request buffer \a index, in CPU byte order.
+ *
+ * The request buffers used here may or may not have been swabbed already,
+ * depending on whether the service initialized the request pill before the
+ * request was handed to NRS.
+ */
+static inline __u32 nrs_wfs_req_u32(struct ptlrpc_request *req, int index,
+				    __u32 val)
+{
+	if (ptlrpc_req_need_swab(req) && !lustre_req_swabbed(req, index))
+		__swab32s(&val);
+	return val;
+}
+
+static inline __u64 nrs_wfs_req_u64(struct ptlrpc_request *req, int index,
+				    __u64 val)
+{
+	if (ptlrpc_req_need_swab(req) && !lustre_req_swabbed(req, index))
+		__swab64s(&val);
+	return val;
+}
+
+static __u32 nrs_wfs_ost_body_id(struct nrs_wfs_head *head,
+				 struct ptlrpc_request *req, int index)
+{
+	struct ost_body	*body;
+	__u64		 valid;
+
+	body = lustre_msg_buf(req->rq_reqmsg, index, sizeof(*body));
+	if (body == NULL)
+		return NRS_WFS_ID_NONE;
+
+	valid = nrs_wfs_req_u64(req, index, body->oa.o_valid);
+	switch (head->wh_key) {
+	case NRS_WFS_KEY_UID:
+		if (valid & OBD_MD_FLUID)
+			return nrs_wfs_req_u32(req, index, body->oa.o_uid);
+		break;
+	case NRS_WFS_KEY_GID:
+		if (valid & OBD_MD_FLGID)
+			return nrs_wfs_req_u32(req, index, body->oa.o_gid);
+		break;
+	case NRS_WFS_KEY_PROJID:
+		if (valid & OBD_MD_FLPROJID)
+			return nrs_wfs_req_u32(req, index, body->oa.o_projid);
+		break;
+	}
+
+	return NRS_WFS_ID_NONE;
+}
+
+static __u32 nrs_wfs_mdt_body_id(struct nrs_wfs_head *head,
+				 struct ptlrpc_request *req, int index)
+{
+	struct mdt_body	*body;
+	__u64		 valid;
+
+	body = lustre_msg_buf(req->rq_reqmsg, index, sizeof(*body));
+	if (body == NULL)
+		return NRS_WFS_ID_NONE;
+
+	switch (head->wh_key) {
+	case NRS_WFS_KEY_UID:
+		return nrs_wfs_req_u32(req, index, body->mbo_fsuid);
+	case NRS_WFS_KEY_GID:
+		return nrs_wfs_req_u32(req, index, body->mbo_fsgid);
+	case NRS_WFS_KEY_PROJID:
+		valid = nrs_wfs_req_u64(req, index, body->mbo_valid);
+		if (valid & OBD_MD_FLPROJID)
+			return nrs_wfs_req_u32(req, index, body->mbo_projid);
+		break;
+	}
+
+	return NRS_WFS_ID_NONE;
+}
+
+static __u32 nrs_wfs_mdt_rec_id(struct nrs_wfs_head *head,
+				struct ptlrpc_request *req, int index)
+{
+	struct mdt_rec_reint *rec;
+
+	/* all reint records start with the same credential fields */
+	rec = lustre_msg_buf(req->rq_reqmsg, index, sizeof(*rec));
+	if (rec == NULL)
+		return NRS_WFS_ID_NONE;
+
+	switch (head->wh_key) {
+	case NRS_WFS_KEY_UID:
+		return nrs_wfs_req_u32(req, index, rec->rr_fsuid);
+	case NRS_WFS_KEY_GID:
+		return nrs_wfs_req_u32(req, index, rec->rr_fsgid);
+	default:
+		break;
+	}
+
+	return NRS_WFS_ID_NONE;
+}
+
+/**
+ * Finds the user, group or project ID of a request.
+ *
+ * The ID is taken from the OST body of I/O requests, from the record of
+ * metadata updates and from the MDT body of other metadata requests,
+ * including intent locks. Requests that carry none of these, e.g. connect,
+ * ping or statfs, or that do not have the required ID, are all put in the
+ * NRS_WFS_ID_NONE class.
+ *
+ * \param[in] head the policy instance
+ * \param[in] req  the request
+ *
+ * \retval the ID of the class of \a req
+ */
+static __u32 nrs_wfs_req_id(struct nrs_wfs_head *head,
+			    struct ptlrpc_request *req)
+{
+	struct ldlm_intent	*it;
+	__u64			 it_opc;
+	__u32			 id = NRS_WFS_ID_NONE;
+
+	switch (lustre_msg_get_opc(req->rq_reqmsg)) {
+	case OST_READ:
+	case OST_WRITE:
+	case OST_PUNCH:
+	case OST_SETATTR:
+	case OST_GETATTR:
+	case OST_SYNC:
+		id = nrs_wfs_ost_body_id(head, req, REQ_REC_OFF);
+		break;
+	case MDS_REINT:
+		id = nrs_wfs_mdt_rec_id(head, req, REQ_REC_OFF);
+		break;
+	case MDS_GETATTR:
+	case MDS_GETATTR_NAME:
+	case MDS_GETXATTR:
+	case MDS_READPAGE:
+	case MDS_SYNC:
+		id = nrs_wfs_mdt_body_id(head, req, REQ_REC_OFF);
+		break;
+	case LDLM_ENQUEUE:
+		if (lustre_msg_bufcount(req->rq_reqmsg) <= DLM_INTENT_REC_OFF)
+			break;
+		it = lustre_msg_buf(req->rq_reqmsg, DLM_INTENT_IT_OFF,
+				    sizeof(*it));
+		if (it == NULL)
+			break;
+		it_opc = nrs_wfs_req_u64(req, DLM_INTENT_IT_OFF, it->opc);
+		if (it_opc & (IT_OPEN | IT_CREAT))
+			id = nrs_wfs_mdt_rec_id(head, req, DLM_INTENT_REC_OFF);
+		else if (it_opc & (IT_GETATTR | IT_LOOKUP | IT_GETXATTR))
+			id = nrs_wfs_mdt_body_id(head, req,
+						 DLM_INTENT_REC_OFF);
+		break;
+	default:
+		break;
+	}
+
+	return id;
+}
+
+/**
+ * Called when a WFS policy instance is started.
+ *
+ * \param[in] policy the policy
+ * \param[in] arg    "uid", "gid" or "projid"; the default is "uid"
+ *
+ * \retval -EINVAL unknown argument
+ * \retval -ENOMEM OOM error
+ * \retval 0	   success
+ */
+static int nrs_wfs_start(struct ptlrpc_nrs_policy *policy, char *arg)
+{
+	struct nrs_wfs_head	*head;
+	enum nrs_wfs_key	 key = NRS_WFS_KEY_UID;
+	int			 rc = 0;
+	ENTRY;
+
+	if (arg != NULL) {
+		for (key = 0; key < ARRAY_SIZE(nrs_wfs_key_names); key++)
+			if (strcmp(arg, nrs_wfs_key_names[key]) == 0)
+				break;
+		if (key == ARRAY_SIZE(nrs_wfs_key_names))
+			RETURN(-EINVAL);
+	}
+
+	OBD_CPT_ALLOC_PTR(head, nrs_pol2cptab(policy), nrs_pol2cptid(policy));
+	if (head == NULL)
+		RETURN(-ENOMEM);
+
+	head->wh_cls_hash = cfs_hash_create("nrs_wfs_hash",
+					    NRS_WFS_BITS, NRS_WFS_BITS,
+					    NRS_WFS_BKT_BITS, 0,
+					    CFS_HASH_MIN_THETA,
+					    CFS_HASH_MAX_THETA,
+					    &nrs_wfs_hash_ops,
+					    CFS_HASH_RW_BKTLOCK |
+					    CFS_HASH_COUNTER);
+	if (head->wh_cls_hash == NULL)
+		GOTO(out_head, rc = -ENOMEM);
+
+	INIT_LIST_HEAD(&head->wh_active);
+	head->wh_key = key;
+	/**
+	 * As for CRR-N, let a class of default weight have a full window of
+	 * RPCs of one client handled in each round.
+	 */
+	head->wh_quantum = OBD_MAX_RIF_DEFAULT;
+
+	policy->pol_private = head;
+
+	RETURN(rc);
+
+out_head:
+	OBD_FREE_PTR(head);
+
+	RETURN(rc);
+}
+
+/**
+ * Called when a WFS policy instance is stopped.
+ *
+ * Called when the policy has been instructed to transition to the
+ * ptlrpc_nrs_pol_state::NRS_POL_STATE_STOPPED state and has no more pending
+ * requests to serve.
+ *
+ * \param[in] policy the policy
+ */
+static void nrs_wfs_stop(struct ptlrpc_nrs_policy *policy)
+{
+	struct nrs_wfs_head	*head = policy->pol_private;
+	ENTRY;
+
+	LASSERT(head != NULL);
+	LASSERT(head->wh_cls_hash != NULL);
+	LASSERT(list_empty(&head->wh_active));
+
+	cfs_hash_putref(head->wh_cls_hash);
+
+	OBD_FREE_PTR(head);
+}
+
+/**
+ * Performs a policy-specific ctl function on WFS policy instances; similar
+ * to ioctl.
+ *
+ * \param[in]	  policy the policy instance
+ * \param[in]	  opc	 the opcode
+ * \param[in,out] arg	 used for passing parameters and information
+ *
+ * \pre assert_spin_locked(&policy->pol_nrs->->nrs_lock)
+ * \post assert_spin_locked(&policy->pol_nrs->->nrs_lock)
+ *
+ * \retval 0   operation carried out successfully
+ * \retval -ve error
+ */
+static int nrs_wfs_ctl(struct ptlrpc_nrs_policy *policy,
+		       enum ptlrpc_nrs_ctl opc, void *arg)
+{
+	struct nrs_wfs_head	*head = policy->pol_private;
+	int			 rc = 0;
+
+	assert_spin_locked(&policy->pol_nrs->nrs_lock);
+
+	switch ((enum nrs_ctl_wfs)opc) {
+	default:
+		RETURN(-EINVAL);
+
+	/**
+	 * Read DRR quantum size of a policy instance.
+	 */
+	case NRS_CTL_WFS_RD_QUANTUM:
+		*(__u16 *)arg = head->wh_quantum;
+		break;
+
+	/**
+	 * Write DRR quantum size of a policy instance.
+	 */
+	case NRS_CTL_WFS_WR_QUANTUM:
+		head->wh_quantum = *(__u16 *)arg;
+		LASSERT(head->wh_quantum != 0);
+		break;
+
+	/**
+	 * Read the weights and the class count of a policy instance.
+	 */
+	case NRS_CTL_WFS_RD_WEIGHTS: {
+		struct nrs_wfs_weights *wws = arg;
+
+		wws->wws_key = head->wh_key;
+		wws->wws_classes = cfs_hash_size_get(head->wh_cls_hash);
+		wws->wws_count = head->wh_nweights;
+		memcpy(wws->wws_weights, head->wh_weights,
+		       head->wh_nweights * sizeof(head->wh_weights[0]));
+		}
+		break;
+
+	/**
+	 * Set the weight of an ID for a policy instance.
+	 */
+	case NRS_CTL_WFS_WR_WEIGHT: {
+		struct nrs_wfs_weight *ww = arg;
+
+		rc = nrs_wfs_weight_set(head, ww->ww_id, ww->ww_weight);
+		}
+		break;
+	}
+
+	RETURN(rc);
+}
+
+/**
+ * Obtains resources from WFS policy instances. The top-level resource lives
+ * inside \e nrs_wfs_head and the second-level resource inside
+ * \e nrs_wfs_class object instances.
+ *
+ * \param[in]  policy	  the policy for which resources are being taken for
+ *			  request \a nrq
+ * \param[in]  nrq	  the request for which resources are being taken
+ * \param[in]  parent	  parent resource, embedded in nrs_wfs_head for the
+ *			  WFS policy
+ * \param[out] resp	  resources references are placed in this array
+ * \param[in]  moving_req signifies limited caller context; used to perform
+ *			  memory allocations in an atomic context in this
+ *			  policy
+ *
+ * \retval 0   we are returning a top-level, parent resource, one that is
+ *	       embedded in an nrs_wfs_head object
+ * \retval 1   we are returning a bottom-level resource, one that is embedded
+ *	       in an nrs_wfs_class object
+ *
+ * \see nrs_resource_get_safe()
+ */
+static int nrs_wfs_res_get(struct ptlrpc_nrs_policy *policy,
+			   struct ptlrpc_nrs_request *nrq,
+			   const struct ptlrpc_nrs_resource *parent,
+			   struct ptlrpc_nrs_resource **resp, bool moving_req)
+{
+	struct nrs_wfs_head	*head;
+	struct nrs_wfs_class	*cls;
+	struct nrs_wfs_class	*tmp;
+	struct ptlrpc_request	*req;
+	__u32			 id;
+
+	if (parent == NULL) {
+		*resp = &((struct nrs_wfs_head *)policy->pol_private)->wh_res;
+		return 0;
+	}
+
+	head = container_of(parent, struct nrs_wfs_head, wh_res);
+	req = container_of(nrq, struct ptlrpc_request, rq_nrq);
+	id = nrs_wfs_req_id(head, req);
+
+	cls = cfs_hash_lookup(head->wh_cls_hash, &id);
+	if (cls != NULL)
+		goto out;
+
+	OBD_CPT_ALLOC_GFP(cls, nrs_pol2cptab(policy), nrs_pol2cptid(policy),
+			  sizeof(*cls), moving_req ? GFP_ATOMIC : GFP_NOFS);
+	if (cls == NULL)
+		return -ENOMEM;
+
+	cls->wc_id = id;
+	INIT_LIST_HEAD(&cls->wc_list);
+	INIT_LIST_HEAD(&cls->wc_active);
+
+	atomic_set(&cls->wc_ref, 1);
+	tmp = cfs_hash_findadd_unique(head->wh_cls_hash, &cls->wc_id,
+				      &cls->wc_hnode);
+	if (tmp != cls) {
+		OBD_FREE_PTR(cls);
+		cls = tmp;
+	}
+out:
+	*resp = &cls->wc_res;
+
+	return 1;
+}
+
+/**
+ * Called when releasing references to the resource hierachy obtained for a
+ * request for scheduling using the WFS policy.
+ *
+ * \param[in] policy   the policy the resource belongs to
+ * \param[in] res      the resource to be released
+ */
+static void nrs_wfs_res_put(struct ptlrpc_nrs_policy *policy,
+			    const struct ptlrpc_nrs_resource *res)
+{
+	struct nrs_wfs_head	*head;
+	struct nrs_wfs_class	*cls;
+
+	/**
+	 * Do nothing for freeing parent, nrs_wfs_head resources
+	 */
+	if (res->res_parent == NULL)
+		return;
+
+	cls = container_of(res, struct nrs_wfs_class, wc_res);
+	head = container_of(res->res_parent, struct nrs_wfs_head, wh_res);
+
+	cfs_hash_put(head->wh_cls_hash, &cls->wc_hnode);
+}
+
+/**
+ * Removes \a nrq from its class, and takes the class off the round robin
+ * when it has no more queued requests.
+ */
+static void nrs_wfs_req_unlink(struct nrs_wfs_class *cls,
+			       struct ptlrpc_nrs_request *nrq)
+{
+	list_del_init(&nrq->nr_u.wfs.wr_list);
+	if (list_empty(&cls->wc_list)) {
+		list_del_init(&cls->wc_active);
+		cls->wc_deficit = 0;
+	}
+}
+
+/**
+ * Called when getting a request from the WFS policy for handling, or just
+ * peeking; removes the request from the policy when it is to be handled.
+ *
+ * The class at the head of nrs_wfs_head::wh_active is served until it
+ * has used up its deficit, and is then moved to the tail.
+ *
+ * \param[in] policy the policy being polled
+ * \param[in] peek   when set, signifies that we just want to examine the
+ *		     request, and not handle it, so the request is not removed
+ *		     from the policy.
+ * \param[in] force  force the policy to return a request; unused in this policy
+ *
+ * \retval the request to be handled
+ * \retval NULL no request available
+ *
+ * \see ptlrpc_nrs_req_get_nolock()
+ * \see nrs_request_get()
+ */
+static
+struct ptlrpc_nrs_request *nrs_wfs_req_get(struct ptlrpc_nrs_policy *policy,
+					   bool peek, bool force)
+{
+	struct nrs_wfs_head	  *head = policy->pol_private;
+	struct nrs_wfs_class	  *cls;
+	struct ptlrpc_nrs_request *nrq;
+	struct ptlrpc_request	  *req;
+
+	if (unlikely(list_empty(&head->wh_active)))
+		return NULL;
+
+	cls = list_entry(head->wh_active.next, struct nrs_wfs_class,
+			 wc_active);
+
+	LASSERT(!list_empty(&cls->wc_list));
+	nrq = list_entry(cls->wc_list.next, struct ptlrpc_nrs_request,
+			 nr_u.wfs.wr_list);
+	if (peek)
+		return nrq;
+
+	/** A new round starts for this class */
+	if (cls->wc_deficit == 0)
+		cls->wc_deficit = head->wh_quantum *
+				  nrs_wfs_weight_get(head, cls->wc_id);
+
+	nrs_wfs_req_unlink(cls, nrq);
+	if (!list_empty(&cls->wc_list) && --cls->wc_deficit == 0)
+		list_move_tail(&cls->wc_active, &head->wh_active);
+
+	req = container_of(nrq, struct ptlrpc_request, rq_nrq);
+	CDEBUG(D_RPCTRACE,
+	       "NRS: starting to handle %s request from %s, for %s %u, "
+	       "deficit %u\n", NRS_POL_NAME_WFS,
+	       libcfs_id2str(req->rq_peer), nrs_wfs_key_names[head->wh_key],
+	       cls->wc_id, cls->wc_deficit);
+
+	return nrq;
+}
+
+/**
+ * Adds request \a nrq to a WFS \a policy instance's set of queued requests
+ *
+ * A class that had no queued request joins the tail of the round robin,
+ * with its deficit given when it is first served.
+ *
+ * \param[in] policy the policy
+ * \param[in] nrq    the request to add
+ *
+ * \retval 0	request successfully added
+ */
+static int nrs_wfs_req_add(struct ptlrpc_nrs_policy *policy,
+			   struct ptlrpc_nrs_request *nrq)
+{
+	struct nrs_wfs_head	*head;
+	struct nrs_wfs_class	*cls;
+
+	cls = container_of(nrs_request_resource(nrq),
+			   struct nrs_wfs_class, wc_res);
+	head = container_of(nrs_request_resource(nrq)->res_parent,
+			    struct nrs_wfs_head, wh_res);
+
+	if (list_empty(&cls->wc_list)) {
+		LASSERT(list_empty(&cls->wc_active));
+		list_add_tail(&cls->wc_active, &head->wh_active);
+	}
+	list_add_tail(&nrq->nr_u.wfs.wr_list, &cls->wc_list);
+
+	return 0;
+}
+
+/**
+ * Removes request \a nrq from a WFS \a policy instance's set of queued
+ * requests.
+ *
+ * \param[in] policy the policy
+ * \param[in] nrq    the request to remove
+ */
+static void nrs_wfs_req_del(struct ptlrpc_nrs_policy *policy,
+			    struct ptlrpc_nrs_request *nrq)
+{
+	struct nrs_wfs_class	*cls;
+
+	cls = container_of(nrs_request_resource(nrq),
+			   struct nrs_wfs_class, wc_res);
+
+	LASSERT(!list_empty(&nrq->nr_u.wfs.wr_list));
+	nrs_wfs_req_unlink(cls, nrq);
+}
+
+/**
+ * Called right after the request \a nrq finishes being handled by WFS policy
+ * instance \a policy.
+ *
+ * \param[in] policy the policy that handled the request
+ * \param[in] nrq    the request that was handled
+ */
+static void nrs_wfs_req_stop(struct ptlrpc_nrs_policy *policy,
+			     struct ptlrpc_nrs_request *nrq)
+{
+	struct ptlrpc_request *req = container_of(nrq, struct ptlrpc_request,
+						  rq_nrq);
+	struct nrs_wfs_class  *cls = container_of(nrs_request_resource(nrq),
+						  struct nrs_wfs_class,
+						  wc_res);
+
+	CDEBUG(D_RPCTRACE,
+	       "NRS: finished handling %s request from %s, for ID %u\n",
+	       NRS_POL_NAME_WFS, libcfs_id2str(req->rq_peer), cls->wc_id);
+}
+
+#ifdef CONFIG_PROC_FS
+
+/**
+ * lprocfs interface
+ */
+
+/**
+ * Retrieves the value of the DRR quantum for WFS policy instances on both
+ * the regular and high-priority NRS head of a service, as long as a policy
+ * instance is not in the ptlrpc_nrs_pol_state::NRS_POL_STATE_STOPPED state;
+ * policy instances in this state are skipped later by nrs_wfs_ctl().
+ *
+ * Quantum values are in # of RPCs, and output is in YAML format.
+ *
+ * For example:
+ *
+ *	reg_quantum:8
+ *	hp_quantum:4
+ */
+static int
+ptlrpc_lprocfs_nrs_wfs_quantum_seq_show(struct seq_file *m, void *data)
+{
+	struct ptlrpc_service	*svc = m->private;
+	__u16			quantum;
+	int			rc;
+
+	rc = ptlrpc_nrs_policy_control(svc, PTLRPC_NRS_QUEUE_REG,
+				       NRS_POL_NAME_WFS,
+				       NRS_CTL_WFS_RD_QUANTUM,
+				       true, &quantum);
+	if (rc == 0) {
+		seq_printf(m, NRS_LPROCFS_QUANTUM_NAME_REG
+			   "%-5d\n", quantum);
+		/**
+		 * Ignore -ENODEV as the regular NRS head's policy may be in the
+		 * ptlrpc_nrs_pol_state::NRS_POL_STATE_STOPPED state.
+		 */
+	} else if (rc != -ENODEV) {
+		return rc;
+	}
+
+	if (!nrs_svc_has_hp(svc))
+		goto no_hp;
+
+	rc = ptlrpc_nrs_policy_control(svc, PTLRPC_NRS_QUEUE_HP,
+				       NRS_POL_NAME_WFS,
+				       NRS_CTL_WFS_RD_QUANTUM,
+				       true, &quantum);
+	if (rc == 0) {
+		seq_printf(m, NRS_LPROCFS_QUANTUM_NAME_HP"%-5d\n", quantum);
+		/**
+		 * Ignore -ENODEV as the high priority NRS head's policy may be
+		 * in the ptlrpc_nrs_pol_state::NRS_POL_STATE_STOPPED state.
+		 */
+	} else if (rc != -ENODEV) {
+		return rc;
+	}
+
+no_hp:
+	return rc;
+}
+
+/**
+ * Sets the value of the DRR quantum for WFS policy instances of a service.
+ * The user can set the quantum size for the regular or high priority NRS
+ * head individually by specifying each value, or both together in a single
+ * invocation.
+ *
+ * For example:
+ *
+ * lctl set_param *.*.*.nrs_wfs_quantum=reg_quantum:32, to set the regular
+ * request quantum size on all PTLRPC services to 32
+ *
+ * lctl set_param *.*.mdt.nrs_wfs_quantum=16, to set both the regular and
+ * high priority request quantum sizes of the mdt service to 16.
+ *
+ * policy instances in the ptlrpc_nrs_pol_state::NRS_POL_STATE_STOPPED state
+ * are skipped later by nrs_wfs_ctl().
+ */
+static ssize_t
+ptlrpc_lprocfs_nrs_wfs_quantum_seq_write(struct file *file,
+					 const char __user *buffer,
+					 size_t count,
+					 loff_t *off)
+{
+	struct ptlrpc_service	    *svc = ((struct seq_file *)file->private_data)->private;
+	enum ptlrpc_nrs_queue_type   queue = 0;
+	char			     kernbuf[LPROCFS_NRS_WR_QUANTUM_MAX_CMD];
+	char			    *val;
+	long			     quantum_reg;
+	long			     quantum_hp;
+	/** lprocfs_find_named_value() modifies its argument, so keep a copy */
+	size_t			     count_copy;
+	int			     rc = 0;
+	int			     rc2 = 0;
+
+	if (count > (sizeof(kernbuf) - 1))
+		return -EINVAL;
+
+	if (copy_from_user(kernbuf, buffer, count))
+		return -EFAULT;
+
+	kernbuf[count] = '\0';
+
+	count_copy = count;
+
+	/**
+	 * Check if the regular quantum value has been specified
+	 */
+	val = lprocfs_find_named_value(kernbuf, NRS_LPROCFS_QUANTUM_NAME_REG,
+				       &count_copy);
+	if (val != kernbuf) {
+		quantum_reg = simple_strtol(val, NULL, 10);
+
+		queue |= PTLRPC_NRS_QUEUE_REG;
+	}
+
+	count_copy = count;
+
+	/**
+	 * Check if the high priority quantum value has been specified
+	 */
+	val = lprocfs_find_named_value(kernbuf, NRS_LPROCFS_QUANTUM_NAME_HP,
+				       &count_copy);
+	if (val != kernbuf) {
+		if (!nrs_svc_has_hp(svc))
+			return -ENODEV;
+
+		quantum_hp = simple_strtol(val, NULL, 10);
+
+		queue |= PTLRPC_NRS_QUEUE_HP;
+	}
+
+	/**
+	 * If none of the queues has been specified, look for a valid numerical
+	 * value
+	 */
+	if (queue == 0) {
+		if (!isdigit(kernbuf[0]))
+			return -EINVAL;
+
+		quantum_reg = simple_strtol(kernbuf, NULL, 10);
+
+		queue = PTLRPC_NRS_QUEUE_REG;
+
+		if (nrs_svc_has_hp(svc)) {
+			queue |= PTLRPC_NRS_QUEUE_HP;
+			quantum_hp = quantum_reg;
+		}
+	}
+
+	if ((((queue & PTLRPC_NRS_QUEUE_REG) != 0) &&
+	    ((quantum_reg > LPROCFS_NRS_QUANTUM_MAX || quantum_reg <= 0))) ||
+	    (((queue & PTLRPC_NRS_QUEUE_HP) != 0) &&
+	    ((quantum_hp > LPROCFS_NRS_QUANTUM_MAX || quantum_hp <= 0))))
+		return -EINVAL;
+
+	if ((queue & PTLRPC_NRS_QUEUE_REG) != 0) {
+		rc = ptlrpc_nrs_policy_control(svc, PTLRPC_NRS_QUEUE_REG,
+					       NRS_POL_NAME_WFS,
+					       NRS_CTL_WFS_WR_QUANTUM, false,
+					       &quantum_reg);
+		if ((rc < 0 && rc != -ENODEV) ||
+		    (rc == -ENODEV && queue == PTLRPC_NRS_QUEUE_REG))
+			return rc;
+	}
+
+	if ((queue & PTLRPC_NRS_QUEUE_HP) != 0) {
+		rc2 = ptlrpc_nrs_policy_control(svc, PTLRPC_NRS_QUEUE_HP,
+						NRS_POL_NAME_WFS,
+						NRS_CTL_WFS_WR_QUANTUM, false,
+						&quantum_hp);
+		if ((rc2 < 0 && rc2 != -ENODEV) ||
+		    (rc2 == -ENODEV && queue == PTLRPC_NRS_QUEUE_HP))
+			return rc2;
+	}
+
+	return rc == -ENODEV && rc2 == -ENODEV ? -ENODEV : count;
+}
+LPROC_SEQ_FOPS(ptlrpc_lprocfs_nrs_wfs_quantum);
+
+/**
+ * Max size of a nrs_wfs_weights write; enough for a handful of
+ * "<id>=<weight>" pairs.
+ */
+#define LPROCFS_NRS_WFS_WEIGHTS_MAX_CMD		512
+/** Weights are bounded by this, so that quantum * weight fits in 32 bits */
+#define LPROCFS_NRS_WFS_WEIGHT_MAX		65535
+
+static void nrs_wfs_weights_show(struct seq_file *m, const char *name,
+				 struct nrs_wfs_weights *wws)
+{
+	int i;
+
+	seq_printf(m, "%s\n  key: %s\n  classes: %llu\n  weights:", name,
+		   nrs_wfs_key_names[wws->wws_key], wws->wws_classes);
+	for (i = 0; i < wws->wws_count; i++)
+		seq_printf(m, " %u=%u", wws->wws_weights[i].ww_id,
+			   wws->wws_weights[i].ww_weight);
+	seq_printf(m, "\n");
+}
+
+/**
+ * Retrieves the ID weights of WFS policy instances on both the regular and
+ * high-priority NRS head of a service. IDs not listed have weight
+ * NRS_WFS_WEIGHT_DEFAULT. The number of classes allocated is shown too;
+ * classes are freed once their requests are handled.
+ *
+ * For example:
+ *
+ *	regular_requests:
+ *	  key: uid
+ *	  classes: 3
+ *	  weights: 500=4 1000=2
+ */
+static int
+ptlrpc_lprocfs_nrs_wfs_weights_seq_show(struct seq_file *m, void *data)
+{
+	struct ptlrpc_service	*svc = m->private;
+	struct nrs_wfs_weights	*wws;
+	int			 rc;
+
+	OBD_ALLOC_PTR(wws);
+	if (wws == NULL)
+		return -ENOMEM;
+
+	rc = ptlrpc_nrs_policy_control(svc, PTLRPC_NRS_QUEUE_REG,
+				       NRS_POL_NAME_WFS,
+				       NRS_CTL_WFS_RD_WEIGHTS,
+				       true, wws);
+	if (rc == 0)
+		nrs_wfs_weights_show(m, "regular_requests:", wws);
+	else if (rc != -ENODEV)
+		GOTO(out, rc);
+
+	if (!nrs_svc_has_hp(svc))
+		GOTO(out, rc);
+
+	rc = ptlrpc_nrs_policy_control(svc, PTLRPC_NRS_QUEUE_HP,
+				       NRS_POL_NAME_WFS,
+				       NRS_CTL_WFS_RD_WEIGHTS,
+				       true, wws);
+	if (rc == 0)
+		nrs_wfs_weights_show(m, "high_priority_requests:", wws);
+out:
+	OBD_FREE_PTR(wws);
+
+	return rc;
+}
+
+/**
+ * Sets the weight of user, group or project IDs on both the regular and
+ * high-priority NRS head of a service, as a list of "<id>=<weight>" pairs.
+ * Setting a weight of 1 restores the default.
+ *
+ * For example:
+ *
+ * lctl set_param mds.MDS.mdt.nrs_wfs_weights="500=4 1000=2", to give user
+ * (or group, or project) 500 four times the share of the service of IDs with
+ * no weight set, and ID 1000 twice this share.
+ */
+static ssize_t
+ptlrpc_lprocfs_nrs_wfs_weights_seq_write(struct file *file,
+					 const char __user *buffer,
+					 size_t count, loff_t *off)
+{
+	struct ptlrpc_service	*svc = ((struct seq_file *)file->private_data)->private;
+	struct nrs_wfs_weight	 ww;
+	char			*kernbuf;
+	char			*val;
+	char			*token;
+	char			*id;
+	int			 rc = 0;
+	int			 rc2;
+
+	if (count > LPROCFS_NRS_WFS_WEIGHTS_MAX_CMD - 1)
+		return -EINVAL;
+
+	OBD_ALLOC(kernbuf, LPROCFS_NRS_WFS_WEIGHTS_MAX_CMD);
+	if (kernbuf == NULL)
+		return -ENOMEM;
+
+	if (copy_from_user(kernbuf, buffer, count))
+		GOTO(out, rc = -EFAULT);
+
+	val = strim(kernbuf);
+	while (val != NULL && *val != '\0') {
+		token = strsep(&val, " \n");
+		if (*token == '\0')
+			continue;
+
+		id = strsep(&token, "=");
+		if (token == NULL)
+			GOTO(out, rc = -EINVAL);
+
+		rc = kstrtouint(id, 10, &ww.ww_id);
+		if (rc == 0)
+			rc = kstrtouint(token, 10, &ww.ww_weight);
+		if (rc != 0)
+			GOTO(out, rc = -EINVAL);
+
+		if (ww.ww_id == NRS_WFS_ID_NONE || ww.ww_weight == 0 ||
+		    ww.ww_weight > LPROCFS_NRS_WFS_WEIGHT_MAX)
+			GOTO(out, rc = -EINVAL);
+
+		rc = ptlrpc_nrs_policy_control(svc, PTLRPC_NRS_QUEUE_REG,
+					       NRS_POL_NAME_WFS,
+					       NRS_CTL_WFS_WR_WEIGHT, false,
+					       &ww);
+		if (rc < 0 && rc != -ENODEV)
+			GOTO(out, rc);
+
+		if (!nrs_svc_has_hp(svc))
+			continue;
+
+		rc2 = ptlrpc_nrs_policy_control(svc, PTLRPC_NRS_QUEUE_HP,
+						NRS_POL_NAME_WFS,
+						NRS_CTL_WFS_WR_WEIGHT, false,
+						&ww);
+		if (rc2 < 0 && rc2 != -ENODEV)
+			GOTO(out, rc = rc2);
+		/* success if the weight was set on at least one head */
+		if (rc2 == 0)
+			rc = 0;
+	}
+out:
+	OBD_FREE(kernbuf, LPROCFS_NRS_WFS_WEIGHTS_MAX_CMD);
+
+	return rc < 0 ? rc : count;
+}
+LPROC_SEQ_FOPS(ptlrpc_lprocfs_nrs_wfs_weights);
+
+/**
+ * Initializes a WFS policy's lprocfs interface for service \a svc
+ *
+ * \param[in] svc the service
+ *
+ * \retval 0	success
+ * \retval != 0	error
+ */
+static int nrs_wfs_lprocfs_init(struct ptlrpc_service *svc)
+{
+	struct lprocfs_vars nrs_wfs_lprocfs_vars[] = {
+		{ .name		= "nrs_wfs_quantum",
+		  .fops		= &ptlrpc_lprocfs_nrs_wfs_quantum_fops,
+		  .data = svc },
+		{ .name		= "nrs_wfs_weights",
+		  .fops		= &ptlrpc_lprocfs_nrs_wfs_weights_fops,
+		  .data = svc },
+		{ NULL }
+	};
+
+	if (svc->srv_procroot == NULL)
+		return 0;
+
+	return lprocfs_add_vars(svc->srv_procroot, nrs_wfs_lprocfs_vars, NULL);
+}
+
+/**
+ * Cleans up a WFS policy's lprocfs interface for service \a svc
+ *
+ * \param[in] svc the service
+ */
+static void nrs_wfs_lprocfs_fini(struct ptlrpc_service *svc)
+{
+	if (svc->srv_procroot == NULL)
+		return;
+
+	lprocfs_remove_proc_entry("nrs_wfs_quantum", svc->srv_procroot);
+	lprocfs_remove_proc_entry("nrs_wfs_weights", svc->srv_procroot);
+}
+
+#endif /* CONFIG_PROC_FS */
+
+/**
+ * WFS policy operations
+ */
+static const struct ptlrpc_nrs_pol_ops nrs_wfs_ops = {
+	.op_policy_start	= nrs_wfs_start,
+	.op_policy_stop		= nrs_wfs_stop,
+	.op_policy_ctl		= nrs_wfs_ctl,
+	.op_res_get		= nrs_wfs_res_get,
+	.op_res_put		= nrs_wfs_res_put,
+	.op_req_get		= nrs_wfs_req_get,
+	.op_req_enqueue		= nrs_wfs_req_add,
+	.op_req_dequeue		= nrs_wfs_req_del,
+	.op_req_stop		= nrs_wfs_req_stop,
+#ifdef CONFIG_PROC_FS
+	.op_lprocfs_init	= nrs_wfs_lprocfs_init,
+	.op_lprocfs_fini	= nrs_wfs_lprocfs_fini,
+#endif
+};
+
+/**
+ * WFS policy configuration
+ */
+struct ptlrpc_nrs_pol_conf nrs_conf_wfs = {
+	.nc_name		= NRS_POL_NAME_WFS,
+	.nc_ops			= &nrs_wfs_ops,
+	.nc_compat		= nrs_policy_compat_all,
+};
+
+/** @} WFS policy */
+
+/** @} nrs */
+
+#endif /* HAVE_SERVER_SUPPORT */
@@ -2762,6 +2762,22 @@ void lustre_swab_out_update_buffer(struct out_update_buffer *oub)
 }
 EXPORT_SYMBOL(lustre_swab_out_update_buffer);
 
+void lustre_swab_reint_batch_header(struct reint_batch_header *rbh)
+{
+	__swab32s(&rbh->rbh_magic);
+	__swab32s(&rbh->rbh_count);
+	__swab32s(&rbh->rbh_reply_size);
+	__swab32s(&rbh->rbh_padding);
+}
+EXPORT_SYMBOL(lustre_swab_reint_batch_header);
+
+void lustre_swab_reint_batch_reply(struct reint_batch_reply *rbp)
+{
+	__swab32s(&rbp->rbp_magic);
+	__swab32s(&rbp->rbp_count);
+}
+EXPORT_SYMBOL(lustre_swab_reint_batch_reply);
+
 void lustre_swab_swap_layouts(struct mdc_swap_layouts *msl)
 {
 	__swab64s(&msl->msl_flags);
@@ -52,6 +52,7 @@ extern struct ptlrpc_nrs_pol_conf nrs_conf_orr;
 extern struct ptlrpc_nrs_pol_conf nrs_conf_trr;
 extern struct ptlrpc_nrs_pol_conf nrs_conf_tbf;
 extern struct ptlrpc_nrs_pol_conf nrs_conf_delay;
+extern struct ptlrpc_nrs_pol_conf nrs_conf_wfs;
 #endif /* HAVE_SERVER_SUPPORT */
 
 /**
@@ -80,8 +81,8 @@ void ptlrpc_request_cache_fini(void);
 struct ptlrpc_request *ptlrpc_request_cache_alloc(gfp_t flags);
 void ptlrpc_request_cache_free(struct ptlrpc_request *req);
 void ptlrpc_init_xid(void);
-void ptlrpc_set_add_new_req(struct ptlrpcd_ctl *pc,
-			    struct ptlrpc_request *req);
+int ptlrpc_set_add_new_req(struct ptlrpcd_ctl *pc,
+			   struct ptlrpc_request *req);
 int ptlrpc_expired_set(void *data);
 time64_t ptlrpc_set_next_timeout(struct ptlrpc_request_set *);
 void ptlrpc_resend_req(struct ptlrpc_request *request);
@@ -94,6 +95,10 @@ void ptlrpc_add_unreplied(struct ptlrpc_request *req);
 int ptlrpc_init_portals(void);
 void ptlrpc_exit_portals(void);
 
+/* niobuf.c */
+void ptlrpc_reply_batch_flush(struct ptlrpc_service_part *svcpt);
+void ptlrpc_reply_batch_work(struct work_struct *work);
+
 void ptlrpc_request_handle_notconn(struct ptlrpc_request *);
 void lustre_assert_wire_constants(void);
 int ptlrpc_import_in_recovery(struct obd_import *imp);
@@ -116,10 +121,13 @@ void ptlrpc_lprocfs_unregister_service(struct ptlrpc_service *svc);
 void ptlrpc_lprocfs_rpc_sent(struct ptlrpc_request *req, long amount);
 void ptlrpc_lprocfs_do_request_stat (struct ptlrpc_request *req,
                                      long q_usec, long work_usec);
+void ptlrpc_lprocfs_lat_tally(struct ptlrpc_lat_stats *pls, __u32 op,
+			      int phase, s64 usecs, bool alloc);
 #else
 #define ptlrpc_lprocfs_register_service(params...) do{}while(0)
 #define ptlrpc_lprocfs_unregister_service(params...) do{}while(0)
 #define ptlrpc_lprocfs_rpc_sent(params...) do{}while(0)
+#define ptlrpc_lprocfs_lat_tally(params...) do{}while(0)
 #define ptlrpc_lprocfs_do_request_stat(params...) do{}while(0)
 #endif /* CONFIG_PROC_FS */
 
@@ -312,6 +320,10 @@ void sptlrpc_conf_fini(void);
 /* sec.c */
 int  sptlrpc_init(void);
 void sptlrpc_fini(void);
+void sptlrpc_sec_ctx_cache_flush(struct ptlrpc_sec *sec, uid_t uid,
+				 bool stale_only);
+void sptlrpc_sec_ctx_cache_stats(struct ptlrpc_sec *sec, unsigned long *hits,
+				 unsigned long *misses);
 
 /* layout.c */
 __u32 __req_capsule_offset(const struct req_capsule *pill,
@@ -395,6 +407,30 @@ static inline void ptlrpc_srv_req_init(struct ptlrpc_request *req)
 	INIT_LIST_HEAD(&sr->sr_hist_list);
 }
 
+/** size of the request buffers of class \a cls of \a svc */
+static inline int ptlrpc_rqbd_buf_size(struct ptlrpc_service *svc,
+				       enum ptlrpc_rqbd_class cls)
+{
+	return cls == PTLRPC_RQBD_SMALL ? svc->srv_small_buf_size :
+					  svc->srv_buf_size;
+}
+
+/** biggest request received in the request buffers of class \a cls */
+static inline int ptlrpc_rqbd_max_req_size(struct ptlrpc_service *svc,
+					   enum ptlrpc_rqbd_class cls)
+{
+	return cls == PTLRPC_RQBD_SMALL ? svc->srv_small_max_req_size :
+					  svc->srv_max_req_size;
+}
+
+/** # request buffers of class \a cls to keep posted, 0 if none */
+static inline int ptlrpc_rqbd_nbufs(struct ptlrpc_service *svc,
+				    enum ptlrpc_rqbd_class cls)
+{
+	return cls == PTLRPC_RQBD_SMALL ? svc->srv_small_nbuf_per_group :
+					  svc->srv_nbuf_per_group;
+}
+
 static inline bool ptlrpc_req_is_connect(struct ptlrpc_request *req)
 {
 	if (lustre_msg_get_opc(req->rq_reqmsg) == MDS_CONNECT ||
@@ -69,8 +69,17 @@ struct ptlrpcd {
 	int			pd_index;
 	int			pd_cpt;
 	int			pd_cursor;
+	int			pd_thief_cursor;
 	int			pd_nthreads;
 	int			pd_groupsize;
+	/* requests queued to the threads of this CPT */
+	atomic_long_t		pd_queued;
+	/* requests moved to a partner thread on this CPT */
+	atomic_long_t		pd_partner_stolen;
+	/* requests taken from the threads of other CPTs */
+	atomic_long_t		pd_remote_stolen_in;
+	/* requests of this CPT taken by threads of other CPTs */
+	atomic_long_t		pd_remote_stolen_out;
 	struct ptlrpcd_ctl	pd_threads[0];
 };
 
@@ -116,6 +125,18 @@ module_param(ptlrpcd_partner_group_size, int, 0644);
 MODULE_PARM_DESC(ptlrpcd_partner_group_size,
 		 "Number of ptlrpcd threads in a partner group.");
 
+/*
+ * ptlrpcd_steal_threshold: The number of requests waiting in the queue
+ * of a ptlrpcd thread from which idle ptlrpcd threads on other CPTs
+ * may take some of them. Such requests complete away from the CPT that
+ * issued them, so this should only happen when the local threads are
+ * overloaded. A value of 0 disables stealing across CPTs.
+ */
+static int ptlrpcd_steal_threshold = 16;
+module_param(ptlrpcd_steal_threshold, int, 0644);
+MODULE_PARM_DESC(ptlrpcd_steal_threshold,
+		 "Queued requests before other CPTs steal from a ptlrpcd.");
+
 /*
  * ptlrpcd_cpts: A CPT string describing the CPU partitions that
  * ptlrpcd threads should run on. Used to make ptlrpcd threads run on
@@ -156,6 +177,14 @@ static struct ptlrpcd_ctl ptlrpcd_rcv;
 struct mutex ptlrpcd_mutex;
 static int ptlrpcd_users = 0;
 
+static struct proc_dir_entry *ptlrpcd_proc_root;
+
+/* Only valid for the regular threads, not for ptlrpcd_rcv. */
+static inline struct ptlrpcd *ptlrpcd_pc2pd(struct ptlrpcd_ctl *pc)
+{
+	return container_of(pc - pc->pc_index, struct ptlrpcd, pd_threads[0]);
+}
+
 void ptlrpcd_wake(struct ptlrpc_request *req)
 {
 	struct ptlrpc_request_set *set = req->rq_set;
@@ -191,6 +220,68 @@ ptlrpcd_select_pc(struct ptlrpc_request *req)
 	return &pd->pd_threads[idx];
 }
 
+/**
+ * Wake up one idle ptlrpcd thread on another CPT, so that it can take
+ * some of the requests queued on \a pd.
+ *
+ * The CPTs are tried in turn, starting after the one woken last time.
+ */
+static void ptlrpcd_wake_thief(struct ptlrpcd *pd)
+{
+	struct ptlrpcd_ctl		*pc;
+	struct ptlrpc_request_set	*set;
+	struct ptlrpcd			*tpd;
+	int				 start = pd->pd_thief_cursor;
+	int				 i;
+	int				 j;
+
+	for (i = 0; i < ptlrpcds_num - 1; i++) {
+		tpd = ptlrpcds[(pd->pd_index + 1 +
+				(start + i) % (ptlrpcds_num - 1)) %
+			       ptlrpcds_num];
+		if (tpd == NULL)
+			continue;
+
+		for (j = 0; j < tpd->pd_nthreads; j++) {
+			pc = &tpd->pd_threads[j];
+			spin_lock(&pc->pc_lock);
+			set = pc->pc_set;
+			if (set != NULL &&
+			    atomic_read(&set->set_remaining) == 0 &&
+			    atomic_read(&set->set_new_count) == 0) {
+				wake_up(&set->set_waitq);
+				spin_unlock(&pc->pc_lock);
+				pd->pd_thief_cursor = (start + i + 1) %
+						      (ptlrpcds_num - 1);
+				return;
+			}
+			spin_unlock(&pc->pc_lock);
+		}
+	}
+}
+
+/**
+ * Account \a nr requests just queued on \a pc, which now has \a count
+ * requests waiting, and call for help from other CPTs when this crosses
+ * ptlrpcd_steal_threshold.
+ */
+static void ptlrpcd_queued(struct ptlrpcd_ctl *pc, int count, int nr)
+{
+	struct ptlrpcd	*pd;
+	int		 threshold;
+
+	if (test_bit(LIOD_RECOVERY, &pc->pc_flags))
+		return;
+
+	pd = ptlrpcd_pc2pd(pc);
+	atomic_long_add(nr, &pd->pd_queued);
+
+	threshold = ACCESS_ONCE(ptlrpcd_steal_threshold);
+	if (threshold > 0 && ptlrpcds_num > 1 &&
+	    count >= threshold && count - nr < threshold)
+		ptlrpcd_wake_thief(pd);
+}
+
 /**
  * Move all request from an existing request set to the ptlrpcd queue.
  * All requests from the set must be in phase RQ_PHASE_NEW.
@@ -221,6 +312,7 @@ void ptlrpcd_add_rqset(struct ptlrpc_request_set *set)
 	count = atomic_add_return(i, &new->set_new_count);
 	atomic_set(&set->set_remaining, 0);
 	spin_unlock(&new->set_new_req_lock);
+	ptlrpcd_queued(pc, count, i);
 	if (count == i) {
 		wake_up(&new->set_waitq);
 
@@ -232,11 +324,18 @@ void ptlrpcd_add_rqset(struct ptlrpc_request_set *set)
 	}
 }
 
+static inline void ptlrpc_reqset_get(struct ptlrpc_request_set *set)
+{
+	atomic_inc(&set->set_refcount);
+}
+
 /**
+ * Move at most \a max of the oldest new requests of \a src to \a des.
+ *
  * Return transferred RPCs count.
  */
 static int ptlrpcd_steal_rqset(struct ptlrpc_request_set *des,
-                               struct ptlrpc_request_set *src)
+			       struct ptlrpc_request_set *src, int max)
 {
 	struct list_head *tmp, *pos;
 	struct ptlrpc_request *req;
@@ -245,20 +344,84 @@ static int ptlrpcd_steal_rqset(struct ptlrpc_request_set *des,
 	spin_lock(&src->set_new_req_lock);
 	if (likely(!list_empty(&src->set_new_requests))) {
 		list_for_each_safe(pos, tmp, &src->set_new_requests) {
+			if (rc >= max)
+				break;
 			req = list_entry(pos, struct ptlrpc_request,
 					 rq_set_chain);
 			req->rq_set = des;
+			list_move_tail(&req->rq_set_chain, &des->set_requests);
+			rc++;
 		}
-		list_splice_init(&src->set_new_requests,
-				 &des->set_requests);
-		rc = atomic_read(&src->set_new_count);
 		atomic_add(rc, &des->set_remaining);
-		atomic_set(&src->set_new_count, 0);
+		atomic_sub(rc, &src->set_new_count);
 	}
 	spin_unlock(&src->set_new_req_lock);
 	return rc;
 }
 
+/**
+ * Take work for the idle thread \a pc from the overloaded threads of
+ * other CPTs.
+ *
+ * Only threads with at least ptlrpcd_steal_threshold new requests are
+ * robbed, and only of half of them, so that most requests still complete
+ * on the CPT that issued them.
+ *
+ * \retval	number of requests moved to the set of \a pc
+ */
+static int ptlrpcd_steal_remote(struct ptlrpcd_ctl *pc)
+{
+	struct ptlrpcd			*pd = ptlrpcd_pc2pd(pc);
+	struct ptlrpcd			*vpd;
+	struct ptlrpcd_ctl		*victim;
+	struct ptlrpc_request_set	*ps;
+	int				 threshold;
+	int				 count;
+	int				 rc = 0;
+	int				 i;
+	int				 j;
+
+	threshold = ACCESS_ONCE(ptlrpcd_steal_threshold);
+	if (threshold <= 0)
+		return 0;
+
+	for (i = 1; i < ptlrpcds_num && rc == 0; i++) {
+		vpd = ptlrpcds[(pd->pd_index + i) % ptlrpcds_num];
+		if (vpd == NULL)
+			continue;
+
+		for (j = 0; j < vpd->pd_nthreads && rc == 0; j++) {
+			victim = &vpd->pd_threads[j];
+			spin_lock(&victim->pc_lock);
+			ps = victim->pc_set;
+			if (ps == NULL) {
+				spin_unlock(&victim->pc_lock);
+				continue;
+			}
+			ptlrpc_reqset_get(ps);
+			spin_unlock(&victim->pc_lock);
+
+			count = atomic_read(&ps->set_new_count);
+			if (count >= threshold) {
+				rc = ptlrpcd_steal_rqset(pc->pc_set, ps,
+							 (count + 1) / 2);
+				if (rc > 0) {
+					atomic_long_add(rc,
+						&vpd->pd_remote_stolen_out);
+					atomic_long_add(rc,
+						&pd->pd_remote_stolen_in);
+					CDEBUG(D_RPCTRACE, "steal %d async RPCs"
+					       " [%s->%s]\n", rc,
+					       victim->pc_name, pc->pc_name);
+				}
+			}
+			ptlrpc_reqset_put(ps);
+		}
+	}
+
+	return rc;
+}
+
 /**
  * Requests that are added to the ptlrpcd queue are sent via
  * ptlrpcd_check->ptlrpc_check_set().
@@ -298,15 +461,10 @@ void ptlrpcd_add_req(struct ptlrpc_request *req)
 	DEBUG_REQ(D_INFO, req, "add req [%p] to pc [%s:%d]",
 		  req, pc->pc_name, pc->pc_index);
 
-	ptlrpc_set_add_new_req(pc, req);
+	ptlrpcd_queued(pc, ptlrpc_set_add_new_req(pc, req), 1);
 }
 EXPORT_SYMBOL(ptlrpcd_add_req);
 
-static inline void ptlrpc_reqset_get(struct ptlrpc_request_set *set)
-{
-	atomic_inc(&set->set_refcount);
-}
-
 /**
  * Check if there is more work to do on ptlrpcd set.
  * Returns 1 if yes.
@@ -401,16 +559,28 @@ static int ptlrpcd_check(struct lu_env *env, struct ptlrpcd_ctl *pc)
 				spin_unlock(&partner->pc_lock);
 
 				if (atomic_read(&ps->set_new_count)) {
-					rc = ptlrpcd_steal_rqset(set, ps);
-					if (rc > 0)
+					rc = ptlrpcd_steal_rqset(set, ps,
+								 INT_MAX);
+					if (rc > 0) {
+						atomic_long_add(rc,
+						  &ptlrpcd_pc2pd(pc)->
+						  pd_partner_stolen);
 						CDEBUG(D_RPCTRACE, "transfer %d"
 						       " async RPCs [%d->%d]\n",
 						       rc, partner->pc_index,
 						       pc->pc_index);
+					}
 				}
 				ptlrpc_reqset_put(ps);
 			} while (rc == 0 && pc->pc_cursor != first);
 		}
+
+		/* Still idle, help the overloaded threads of other CPTs. */
+		if (rc == 0 && ptlrpcds_num > 1 &&
+		    atomic_read(&set->set_remaining) == 0 &&
+		    !test_bit(LIOD_RECOVERY, &pc->pc_flags) &&
+		    !test_bit(LIOD_STOP, &pc->pc_flags))
+			rc = ptlrpcd_steal_remote(pc);
 	}
 
 	RETURN(rc || test_bit(LIOD_STOP, &pc->pc_flags));
@@ -559,6 +729,13 @@ static void ptlrpcd_ctl_init(struct ptlrpcd_ctl *pc, int index, int cpt)
  *      The desired number of partner threads can be tuned by setting
  *      ptlrpcd_partner_group_size. The default is to create pairs of
  *      partner threads.
+ *
+ *      When all threads of a CPT are busy, partners do not help. An
+ *      idle thread therefore also takes half of the new requests of
+ *      any thread on another CPT that has ptlrpcd_steal_threshold or
+ *      more of them waiting, and such a thread wakes an idle thread
+ *      of another CPT when it crosses the threshold. The requests it
+ *      did not give away still complete on the CPT that issued them.
  */
 static int ptlrpcd_partners(struct ptlrpcd *pd, int index)
 {
@@ -684,6 +861,76 @@ out:
         EXIT;
 }
 
+static int ptlrpcd_stats_seq_show(struct seq_file *m, void *v)
+{
+	struct timespec64	 now;
+	struct ptlrpcd		*pd;
+	long			 queued;
+	long			 partner;
+	long			 stolen_in;
+	long			 stolen_out;
+	int			 i;
+
+	ktime_get_real_ts64(&now);
+	seq_printf(m, "snapshot_time: %lld.%09lu\n",
+		   (s64)now.tv_sec, now.tv_nsec);
+
+	for (i = 0; i < ptlrpcds_num; i++) {
+		pd = ptlrpcds[i];
+		if (pd == NULL)
+			break;
+
+		queued = atomic_long_read(&pd->pd_queued);
+		partner = atomic_long_read(&pd->pd_partner_stolen);
+		stolen_in = atomic_long_read(&pd->pd_remote_stolen_in);
+		stolen_out = atomic_long_read(&pd->pd_remote_stolen_out);
+		seq_printf(m, "cpt_%d:\n"
+			   "  threads: %d\n"
+			   "  queued: %ld\n"
+			   "  partner_stolen: %ld\n"
+			   "  remote_stolen_in: %ld\n"
+			   "  remote_stolen_out: %ld\n"
+			   "  partner_steal_pct: %ld\n"
+			   "  affinity_pct: %ld\n",
+			   pd->pd_cpt, pd->pd_nthreads, queued, partner,
+			   stolen_in, stolen_out,
+			   queued > 0 ? partner * 100 / queued : 0,
+			   queued > 0 ? (queued - stolen_out) * 100 / queued :
+					100);
+	}
+
+	return 0;
+}
+
+/* any write clears the counters */
+static ssize_t ptlrpcd_stats_seq_write(struct file *file,
+				       const char __user *buffer,
+				       size_t count, loff_t *off)
+{
+	struct ptlrpcd	*pd;
+	int		 i;
+
+	for (i = 0; i < ptlrpcds_num; i++) {
+		pd = ptlrpcds[i];
+		if (pd == NULL)
+			break;
+
+		atomic_long_set(&pd->pd_queued, 0);
+		atomic_long_set(&pd->pd_partner_stolen, 0);
+		atomic_long_set(&pd->pd_remote_stolen_in, 0);
+		atomic_long_set(&pd->pd_remote_stolen_out, 0);
+	}
+
+	return count;
+}
+LPROC_SEQ_FOPS(ptlrpcd_stats);
+
+static struct lprocfs_vars ptlrpcd_lprocfs_vars[] = {
+	{ .name	=	"stats",
+	  .fops	=	&ptlrpcd_stats_fops	},
+	{ NULL }
+};
+
 static void ptlrpcd_fini(void)
 {
 	int	i;
@@ -691,14 +938,29 @@ static void ptlrpcd_fini(void)
 	int	ncpts;
 	ENTRY;
 
+	if (ptlrpcd_proc_root != NULL)
+		lprocfs_remove(&ptlrpcd_proc_root);
+
 	if (ptlrpcds != NULL) {
+		/*
+		 * Threads look into the queues of other CPTs, so all of
+		 * them must be stopped before any of them is freed.
+		 */
 		for (i = 0; i < ptlrpcds_num; i++) {
 			if (ptlrpcds[i] == NULL)
 				break;
 			for (j = 0; j < ptlrpcds[i]->pd_nthreads; j++)
 				ptlrpcd_stop(&ptlrpcds[i]->pd_threads[j], 0);
+		}
+		for (i = 0; i < ptlrpcds_num; i++) {
+			if (ptlrpcds[i] == NULL)
+				break;
 			for (j = 0; j < ptlrpcds[i]->pd_nthreads; j++)
 				ptlrpcd_free(&ptlrpcds[i]->pd_threads[j]);
+		}
+		for (i = 0; i < ptlrpcds_num; i++) {
+			if (ptlrpcds[i] == NULL)
+				break;
 			OBD_FREE(ptlrpcds[i], ptlrpcds[i]->pd_size);
 			ptlrpcds[i] = NULL;
 		}
@@ -890,8 +1152,13 @@ static int ptlrpcd_init(void)
 		pd->pd_index     = i;
 		pd->pd_cpt       = cpt;
 		pd->pd_cursor    = 0;
+		pd->pd_thief_cursor = 0;
 		pd->pd_nthreads  = nthreads;
 		pd->pd_groupsize = groupsize;
+		atomic_long_set(&pd->pd_queued, 0);
+		atomic_long_set(&pd->pd_partner_stolen, 0);
+		atomic_long_set(&pd->pd_remote_stolen_in, 0);
+		atomic_long_set(&pd->pd_remote_stolen_out, 0);
 		ptlrpcds[i] = pd;
 
 		/*
@@ -905,6 +1172,15 @@ static int ptlrpcd_init(void)
 			if (rc < 0)
 				GOTO(out, rc);
 		}
+	}
+
+	/*
+	 * The threads steal requests from the threads of the other CPTs,
+	 * and wake them up, so none is started before all of them are
+	 * initialized.
+	 */
+	for (i = 0; i < ncpts; i++) {
+		pd = ptlrpcds[i];
 
 		/* XXX: We start nthreads ptlrpc daemons on this cpt.
 		 *      Each of them can process any non-recovery
@@ -925,12 +1201,21 @@ static int ptlrpcd_init(void)
 		 *      load among all the ptlrpc daemons becomes
 		 *      another trouble.
 		 */
-		for (j = 0; j < nthreads; j++) {
+		for (j = 0; j < pd->pd_nthreads; j++) {
 			rc = ptlrpcd_start(&pd->pd_threads[j]);
 			if (rc < 0)
 				GOTO(out, rc);
 		}
 	}
+
+	/* The statistics are not worth failing the setup for. */
+	ptlrpcd_proc_root = lprocfs_register("ptlrpcd", proc_lustre_root,
+					     ptlrpcd_lprocfs_vars, NULL);
+	if (IS_ERR(ptlrpcd_proc_root)) {
+		CWARN("cannot register ptlrpcd proc entries: rc = %ld\n",
+		      PTR_ERR(ptlrpcd_proc_root));
+		ptlrpcd_proc_root = NULL;
+	}
 out:
 	if (rc != 0)
 		ptlrpcd_fini();
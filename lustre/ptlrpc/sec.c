@@ -41,6 +41,7 @@
 # include <linux/uidgid.h>
 #endif
 #include <linux/crypto.h>
+#include <linux/cred.h>
 #include <linux/key.h>
 
 #include <libcfs/libcfs.h>
@@ -271,9 +272,191 @@ EXPORT_SYMBOL(sptlrpc_secflags2str);
  * client context APIs                            *
  **************************************************/
 
+/*
+ * Context lookup of a policy can be expensive, e.g. a keyring search under
+ * sec->ps_lock, while a thread usually sends many RPCs with the same
+ * credential.  Each CPU caches a reference on the last context it looked up
+ * for a sec, which is taken without any lock.  The slot is claimed with
+ * cmpxchg by the owning CPU with preemption disabled, or by a thread
+ * flushing the cache.  Entries are not invalidated when their context dies
+ * or expires, but checked when used, and dropped by the flush done on
+ * ctx cache flush, sec kill and by the sec garbage collector.
+ *
+ * The keyring policy finds contexts in the keyrings of the caller, so two
+ * processes of a user in different sessions may use different contexts.
+ * Entries are thus keyed on the credentials, which hold the keyrings, and
+ * keep a reference on them so that their address isn't reused.
+ */
+struct ptlrpc_ctx_cache {
+	atomic_t		 pcc_busy;
+	uid_t			 pcc_uid;
+	const struct cred	*pcc_cred;
+	struct ptlrpc_cli_ctx	*pcc_ctx;
+	unsigned long		 pcc_hits;
+	unsigned long		 pcc_misses;
+};
+
+static inline struct ptlrpc_ctx_cache *
+sec_ctx_cache_claim(struct ptlrpc_sec *sec, int cpu)
+{
+	struct ptlrpc_ctx_cache *pcc = per_cpu_ptr(sec->ps_ctx_cache, cpu);
+
+	if (atomic_cmpxchg(&pcc->pcc_busy, 0, 1) != 0)
+		return NULL;
+	return pcc;
+}
+
+static inline void sec_ctx_cache_release(struct ptlrpc_ctx_cache *pcc)
+{
+	smp_mb();
+	atomic_set(&pcc->pcc_busy, 0);
+}
+
+static inline bool sec_ctx_cache_valid(struct ptlrpc_cli_ctx *ctx)
+{
+	return cli_ctx_is_ready(ctx) &&
+	       (ctx->cc_expire == 0 ||
+		ctx->cc_expire > ktime_get_real_seconds());
+}
+
+static struct ptlrpc_cli_ctx *sec_ctx_cache_lookup(struct ptlrpc_sec *sec,
+						   uid_t uid)
+{
+	struct ptlrpc_ctx_cache *pcc;
+	struct ptlrpc_cli_ctx *ctx = NULL;
+	struct ptlrpc_cli_ctx *stale = NULL;
+	const struct cred *stale_cred = NULL;
+
+	pcc = sec_ctx_cache_claim(sec, get_cpu());
+	if (pcc == NULL)
+		goto out;
+
+	if (pcc->pcc_ctx != NULL && pcc->pcc_uid == uid &&
+	    pcc->pcc_cred == current_cred()) {
+		if (sec_ctx_cache_valid(pcc->pcc_ctx)) {
+			ctx = sptlrpc_cli_ctx_get(pcc->pcc_ctx);
+		} else {
+			/* lazy expiry */
+			stale = pcc->pcc_ctx;
+			stale_cred = pcc->pcc_cred;
+			pcc->pcc_ctx = NULL;
+			pcc->pcc_cred = NULL;
+		}
+	}
+
+	if (ctx != NULL)
+		pcc->pcc_hits++;
+	else
+		pcc->pcc_misses++;
+	sec_ctx_cache_release(pcc);
+out:
+	put_cpu();
+
+	if (stale != NULL) {
+		sptlrpc_cli_ctx_put(stale, 0);
+		put_cred(stale_cred);
+	}
+	return ctx;
+}
+
+static void sec_ctx_cache_insert(struct ptlrpc_sec *sec, uid_t uid,
+				 struct ptlrpc_cli_ctx *ctx)
+{
+	struct ptlrpc_ctx_cache *pcc;
+	struct ptlrpc_cli_ctx *old = ctx;
+	const struct cred *cred;
+	const struct cred *old_cred;
+
+	if (!sec_ctx_cache_valid(ctx) ||
+	    test_bit(PTLRPC_CTX_ETERNAL_BIT, &ctx->cc_flags))
+		return;
+
+	sptlrpc_cli_ctx_get(ctx);
+	cred = get_current_cred();
+	old_cred = cred;
+	pcc = sec_ctx_cache_claim(sec, get_cpu());
+	if (pcc != NULL) {
+		old = pcc->pcc_ctx;
+		old_cred = pcc->pcc_cred;
+		pcc->pcc_ctx = ctx;
+		pcc->pcc_cred = cred;
+		pcc->pcc_uid = uid;
+		sec_ctx_cache_release(pcc);
+	}
+	put_cpu();
+
+	if (old != NULL) {
+		sptlrpc_cli_ctx_put(old, 0);
+		put_cred(old_cred);
+	}
+
+	/* pairs with sptlrpc_sec_kill(), don't keep the sec alive */
+	smp_mb();
+	if (unlikely(sec->ps_dying))
+		sptlrpc_sec_ctx_cache_flush(sec, -1, false);
+}
+
+/**
+ * Drop the contexts cached for \a uid, -1 for all users, or only the
+ * expired or dead ones if \a stale_only is set.
+ */
+void sptlrpc_sec_ctx_cache_flush(struct ptlrpc_sec *sec, uid_t uid,
+				 bool stale_only)
+{
+	struct ptlrpc_ctx_cache *pcc;
+	struct ptlrpc_cli_ctx *ctx;
+	const struct cred *cred;
+	int cpu;
+
+	if (sec->ps_ctx_cache == NULL)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		/* the owner only holds it for a few instructions */
+		while ((pcc = sec_ctx_cache_claim(sec, cpu)) == NULL)
+			cpu_relax();
+
+		ctx = pcc->pcc_ctx;
+		cred = pcc->pcc_cred;
+		if (ctx != NULL &&
+		    (stale_only ? !sec_ctx_cache_valid(ctx) :
+		     (uid == (uid_t)-1 || pcc->pcc_uid == uid))) {
+			pcc->pcc_ctx = NULL;
+			pcc->pcc_cred = NULL;
+		} else {
+			ctx = NULL;
+		}
+		sec_ctx_cache_release(pcc);
+
+		if (ctx != NULL) {
+			sptlrpc_cli_ctx_put(ctx, 0);
+			put_cred(cred);
+		}
+	}
+}
+
+void sptlrpc_sec_ctx_cache_stats(struct ptlrpc_sec *sec, unsigned long *hits,
+				 unsigned long *misses)
+{
+	int cpu;
+
+	*hits = *misses = 0;
+	if (sec->ps_ctx_cache == NULL)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct ptlrpc_ctx_cache *pcc;
+
+		pcc = per_cpu_ptr(sec->ps_ctx_cache, cpu);
+		*hits += pcc->pcc_hits;
+		*misses += pcc->pcc_misses;
+	}
+}
+
 static
 struct ptlrpc_cli_ctx *get_my_ctx(struct ptlrpc_sec *sec)
 {
+	struct ptlrpc_cli_ctx *ctx;
         struct vfs_cred vcred;
         int create = 1, remove_dead = 1;
 
@@ -293,8 +476,19 @@ struct ptlrpc_cli_ctx *get_my_ctx(struct ptlrpc_sec *sec)
 		vcred.vc_gid = from_kgid(&init_user_ns, current_gid());
 	}
 
-	return sec->ps_policy->sp_cops->lookup_ctx(sec, &vcred, create,
-						   remove_dead);
+	if (sec->ps_ctx_cache == NULL)
+		return sec->ps_policy->sp_cops->lookup_ctx(sec, &vcred, create,
+							   remove_dead);
+
+	ctx = sec_ctx_cache_lookup(sec, vcred.vc_uid);
+	if (ctx != NULL)
+		return ctx;
+
+	ctx = sec->ps_policy->sp_cops->lookup_ctx(sec, &vcred, create,
+						  remove_dead);
+	if (ctx != NULL)
+		sec_ctx_cache_insert(sec, vcred.vc_uid, ctx);
+	return ctx;
 }
 
 struct ptlrpc_cli_ctx *sptlrpc_cli_ctx_get(struct ptlrpc_cli_ctx *ctx)
@@ -1260,6 +1454,9 @@ static int sec_cop_flush_ctx_cache(struct ptlrpc_sec *sec, uid_t uid,
         LASSERT(policy->sp_cops);
         LASSERT(policy->sp_cops->flush_ctx_cache);
 
+	/* the references held by the cache would keep contexts busy */
+	sptlrpc_sec_ctx_cache_flush(sec, uid, false);
+
         return policy->sp_cops->flush_ctx_cache(sec, uid, grace, force);
 }
 
@@ -1273,6 +1470,12 @@ static void sec_cop_destroy_sec(struct ptlrpc_sec *sec)
 
         CDEBUG(D_SEC, "%s@%p: being destroied\n", sec->ps_policy->sp_name, sec);
 
+	/* cached contexts hold a reference on the sec */
+	if (sec->ps_ctx_cache != NULL) {
+		free_percpu(sec->ps_ctx_cache);
+		sec->ps_ctx_cache = NULL;
+	}
+
         policy->sp_cops->destroy_sec(sec);
         sptlrpc_policy_put(policy);
 }
@@ -1290,6 +1493,8 @@ static void sptlrpc_sec_kill(struct ptlrpc_sec *sec)
         if (sec->ps_policy->sp_cops->kill_sec) {
                 sec->ps_policy->sp_cops->kill_sec(sec);
 
+		/* pairs with sec_ctx_cache_insert() */
+		smp_mb();
                 sec_cop_flush_ctx_cache(sec, -1, 1, 1);
         }
 }
@@ -1361,6 +1566,13 @@ struct ptlrpc_sec * sptlrpc_sec_create(struct obd_import *imp,
 
 		sec->ps_part = sp;
 
+		/* other policies look up their contexts cheaply, and reverse
+		 * contexts are only looked up directly */
+		if (SPTLRPC_FLVR_POLICY(sf->sf_rpc) == SPTLRPC_POLICY_GSS &&
+		    !svc_ctx)
+			sec->ps_ctx_cache =
+				alloc_percpu(struct ptlrpc_ctx_cache);
+
 		if (sec->ps_gc_interval && policy->sp_cops->gc_ctx)
 			sptlrpc_gc_add_sec(sec);
 	} else {
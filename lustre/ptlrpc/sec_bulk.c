@@ -68,10 +68,20 @@ MODULE_PARM_DESC(enc_pool_max_memory_mb,
 
 #define CACHE_QUIESCENT_PERIOD  (20)
 
-static struct ptlrpc_enc_page_pool {
+/* pages of one 1MB RPC kept by each CPU for the lockless fast path */
+#define ENC_POOL_MAG_PAGES	(ONE_MB_BRW_SIZE >> PAGE_SHIFT)
+
+/*
+ * The pages are split into one pool per CPU partition, each with its own
+ * lock and wait queue, so that bulk RPCs of different partitions don't
+ * serialize on a single lock.  A descriptor always gets all its pages from
+ * one partition, and gives them back to it.
+ */
+struct ptlrpc_enc_page_pool {
         /*
          * constants
          */
+	int		 epp_cpt;	  /* CPU partition of the pool */
         unsigned long    epp_max_pages;   /* maximum pages can hold, const */
         unsigned int     epp_max_pools;   /* number of pools, const */
 
@@ -112,6 +122,8 @@ static struct ptlrpc_enc_page_pool {
         unsigned int     epp_st_shrinks;        /* # of shrinks */
         unsigned long    epp_st_access;         /* # of access */
         unsigned long    epp_st_missings;       /* # of cache missing */
+	unsigned long	 epp_st_stolen;		/* # of gets served by
+						 * another partition */
         unsigned long    epp_st_lowfree;        /* lowest free pages reached */
         unsigned int     epp_st_max_wqlen;      /* highest waitqueue length */
         cfs_time_t       epp_st_max_wait;       /* in jeffies */
@@ -120,7 +132,27 @@ static struct ptlrpc_enc_page_pool {
 	 * pointers to pools, may be vmalloc'd
 	 */
 	struct page    ***epp_pools;
-} page_pools;
+};
+
+/* per-CPT pools, indexed by partition */
+static struct ptlrpc_enc_page_pool **page_pools;
+/* pages all the pools may hold together, from enc_pool_max_memory_mb */
+static unsigned long enc_pools_max_pages;
+
+/*
+ * Per-CPU cache holding the pages of at most one RPC, taken and refilled
+ * without any lock.  \a epm_busy is only ever claimed with cmpxchg, by the
+ * owning CPU with preemption disabled or by the shrinker draining it.
+ */
+struct enc_pool_mag {
+	atomic_t	 epm_busy;
+	int		 epm_cpt;	/* partition the pages belong to */
+	int		 epm_count;
+	unsigned long	 epm_hits;
+	struct page	*epm_pages[ENC_POOL_MAG_PAGES];
+};
+
+static struct enc_pool_mag __percpu *enc_pool_mags;
 
 /*
  * memory shrinker
@@ -128,86 +160,193 @@ static struct ptlrpc_enc_page_pool {
 static const int pools_shrinker_seeks = DEFAULT_SEEKS;
 static struct shrinker *pools_shrinker;
 
+static inline struct enc_pool_mag *enc_pool_mag_claim(int cpu)
+{
+	struct enc_pool_mag *mag = per_cpu_ptr(enc_pool_mags, cpu);
+
+	if (atomic_cmpxchg(&mag->epm_busy, 0, 1) != 0)
+		return NULL;
+	return mag;
+}
+
+static inline void enc_pool_mag_release(struct enc_pool_mag *mag)
+{
+	smp_mb();
+	atomic_set(&mag->epm_busy, 0);
+}
+
+/* pages of partition @cpt cached by the CPUs, racy but fine for stats and
+ * heuristics */
+static unsigned long enc_pool_mag_pages(int cpt)
+{
+	unsigned long count = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct enc_pool_mag *mag = per_cpu_ptr(enc_pool_mags, cpu);
+
+		if (mag->epm_count > 0 && mag->epm_cpt == cpt)
+			count += mag->epm_count;
+	}
+
+	return count;
+}
+
+/* pages held by all the pools, including those cached by the CPUs */
+static unsigned long enc_pools_total_pages(void)
+{
+	struct ptlrpc_enc_page_pool *pool;
+	unsigned long total = 0;
+	int i;
+
+	cfs_percpt_for_each(pool, i, page_pools)
+		total += pool->epp_total_pages;
+
+	return total;
+}
 
 /*
  * /proc/fs/lustre/sptlrpc/encrypt_page_pools
  */
 int sptlrpc_proc_enc_pool_seq_show(struct seq_file *m, void *v)
 {
-	spin_lock(&page_pools.epp_lock);
+	struct ptlrpc_enc_page_pool *pool;
+	unsigned long cached = 0;
+	unsigned long hits = 0;
+	int cpu;
+	int i;
+
+	for_each_possible_cpu(cpu) {
+		struct enc_pool_mag *mag = per_cpu_ptr(enc_pool_mags, cpu);
+
+		cached += mag->epm_count;
+		hits += mag->epm_hits;
+	}
 
 	seq_printf(m, "physical pages:          %lu\n"
 		   "pages per pool:          %lu\n"
-		   "max pages:               %lu\n"
-		   "max pools:               %u\n"
-		   "total pages:             %lu\n"
-		   "total free:              %lu\n"
-		   "idle index:              %lu/100\n"
-		   "last shrink:             %lds\n"
-		   "last access:             %lds\n"
-		   "max pages reached:       %lu\n"
-		   "grows:                   %u\n"
-		   "grows failure:           %u\n"
-		   "shrinks:                 %u\n"
-		   "cache access:            %lu\n"
-		   "cache missing:           %lu\n"
-		   "low free mark:           %lu\n"
-		   "max waitqueue depth:     %u\n"
-		   "max wait time:           %ld/%lu\n"
-		   "out of mem:              %lu\n",
+		   "partitions:              %d\n"
+		   "per-cpu cached pages:    %lu\n"
+		   "per-cpu cache hits:      %lu\n",
 		   totalram_pages, PAGES_PER_POOL,
-		   page_pools.epp_max_pages,
-		   page_pools.epp_max_pools,
-		   page_pools.epp_total_pages,
-		   page_pools.epp_free_pages,
-		   page_pools.epp_idle_idx,
-		   (long)(ktime_get_seconds() - page_pools.epp_last_shrink),
-		   (long)(ktime_get_seconds() - page_pools.epp_last_access),
-		   page_pools.epp_st_max_pages,
-		   page_pools.epp_st_grows,
-		   page_pools.epp_st_grow_fails,
-		   page_pools.epp_st_shrinks,
-		   page_pools.epp_st_access,
-		   page_pools.epp_st_missings,
-		   page_pools.epp_st_lowfree,
-		   page_pools.epp_st_max_wqlen,
-		   page_pools.epp_st_max_wait,
-		   msecs_to_jiffies(MSEC_PER_SEC),
-		   page_pools.epp_st_outofmem);
-
-	spin_unlock(&page_pools.epp_lock);
+		   cfs_cpt_number(cfs_cpt_table), cached, hits);
+
+	cfs_percpt_for_each(pool, i, page_pools) {
+		spin_lock(&pool->epp_lock);
+		seq_printf(m, "partition %d:\n"
+			   "  max pages:               %lu\n"
+			   "  max pools:               %u\n"
+			   "  total pages:             %lu\n"
+			   "  total free:              %lu\n"
+			   "  idle index:              %lu/100\n"
+			   "  last shrink:             %lds\n"
+			   "  last access:             %lds\n"
+			   "  max pages reached:       %lu\n"
+			   "  grows:                   %u\n"
+			   "  grows failure:           %u\n"
+			   "  shrinks:                 %u\n"
+			   "  cache access:            %lu\n"
+			   "  cache missing:           %lu\n"
+			   "  stolen:                  %lu\n"
+			   "  low free mark:           %lu\n"
+			   "  max waitqueue depth:     %u\n"
+			   "  max wait time:           %ld/%lu\n"
+			   "  out of mem:              %lu\n",
+			   i,
+			   pool->epp_max_pages,
+			   pool->epp_max_pools,
+			   pool->epp_total_pages,
+			   pool->epp_free_pages,
+			   pool->epp_idle_idx,
+			   (long)(ktime_get_seconds() - pool->epp_last_shrink),
+			   (long)(ktime_get_seconds() - pool->epp_last_access),
+			   pool->epp_st_max_pages,
+			   pool->epp_st_grows,
+			   pool->epp_st_grow_fails,
+			   pool->epp_st_shrinks,
+			   pool->epp_st_access,
+			   pool->epp_st_missings,
+			   pool->epp_st_stolen,
+			   pool->epp_st_lowfree,
+			   pool->epp_st_max_wqlen,
+			   pool->epp_st_max_wait,
+			   msecs_to_jiffies(MSEC_PER_SEC),
+			   pool->epp_st_outofmem);
+		spin_unlock(&pool->epp_lock);
+	}
+
 	return 0;
 }
 
-static void enc_pools_release_free_pages(long npages)
+/* take the last free page of @pool */
+static inline struct page *enc_pools_get_page(struct ptlrpc_enc_page_pool *pool)
+{
+	struct page *page;
+	int p_idx, g_idx;
+
+	assert_spin_locked(&pool->epp_lock);
+	LASSERT(pool->epp_free_pages > 0);
+
+	pool->epp_free_pages--;
+	p_idx = pool->epp_free_pages / PAGES_PER_POOL;
+	g_idx = pool->epp_free_pages % PAGES_PER_POOL;
+
+	page = pool->epp_pools[p_idx][g_idx];
+	LASSERT(page != NULL);
+	pool->epp_pools[p_idx][g_idx] = NULL;
+
+	return page;
+}
+
+/* give back a page rented from @pool */
+static inline void enc_pools_put_page(struct ptlrpc_enc_page_pool *pool,
+				      struct page *page)
+{
+	int p_idx, g_idx;
+
+	assert_spin_locked(&pool->epp_lock);
+	LASSERT(page != NULL);
+	LASSERT(pool->epp_free_pages < pool->epp_total_pages);
+
+	p_idx = pool->epp_free_pages / PAGES_PER_POOL;
+	g_idx = pool->epp_free_pages % PAGES_PER_POOL;
+
+	LASSERT(pool->epp_pools[p_idx]);
+	LASSERT(pool->epp_pools[p_idx][g_idx] == NULL);
+	pool->epp_pools[p_idx][g_idx] = page;
+	pool->epp_free_pages++;
+}
+
+static void enc_pools_release_free_pages(struct ptlrpc_enc_page_pool *pool,
+					 long npages)
 {
         int     p_idx, g_idx;
         int     p_idx_max1, p_idx_max2;
 
         LASSERT(npages > 0);
-        LASSERT(npages <= page_pools.epp_free_pages);
-        LASSERT(page_pools.epp_free_pages <= page_pools.epp_total_pages);
+        LASSERT(npages <= pool->epp_free_pages);
+        LASSERT(pool->epp_free_pages <= pool->epp_total_pages);
 
         /* max pool index before the release */
-        p_idx_max2 = (page_pools.epp_total_pages - 1) / PAGES_PER_POOL;
+        p_idx_max2 = (pool->epp_total_pages - 1) / PAGES_PER_POOL;
 
-        page_pools.epp_free_pages -= npages;
-        page_pools.epp_total_pages -= npages;
+        pool->epp_free_pages -= npages;
+        pool->epp_total_pages -= npages;
 
         /* max pool index after the release */
-        p_idx_max1 = page_pools.epp_total_pages == 0 ? -1 :
-                     ((page_pools.epp_total_pages - 1) / PAGES_PER_POOL);
+        p_idx_max1 = pool->epp_total_pages == 0 ? -1 :
+                     ((pool->epp_total_pages - 1) / PAGES_PER_POOL);
 
-        p_idx = page_pools.epp_free_pages / PAGES_PER_POOL;
-        g_idx = page_pools.epp_free_pages % PAGES_PER_POOL;
-        LASSERT(page_pools.epp_pools[p_idx]);
+        p_idx = pool->epp_free_pages / PAGES_PER_POOL;
+        g_idx = pool->epp_free_pages % PAGES_PER_POOL;
+        LASSERT(pool->epp_pools[p_idx]);
 
         while (npages--) {
-                LASSERT(page_pools.epp_pools[p_idx]);
-                LASSERT(page_pools.epp_pools[p_idx][g_idx] != NULL);
+                LASSERT(pool->epp_pools[p_idx]);
+                LASSERT(pool->epp_pools[p_idx][g_idx] != NULL);
 
-		__free_page(page_pools.epp_pools[p_idx][g_idx]);
-                page_pools.epp_pools[p_idx][g_idx] = NULL;
+		__free_page(pool->epp_pools[p_idx][g_idx]);
+                pool->epp_pools[p_idx][g_idx] = NULL;
 
                 if (++g_idx == PAGES_PER_POOL) {
                         p_idx++;
@@ -217,71 +356,124 @@ static void enc_pools_release_free_pages(long npages)
 
         /* free unused pools */
         while (p_idx_max1 < p_idx_max2) {
-                LASSERT(page_pools.epp_pools[p_idx_max2]);
-		OBD_FREE(page_pools.epp_pools[p_idx_max2], PAGE_SIZE);
-                page_pools.epp_pools[p_idx_max2] = NULL;
+                LASSERT(pool->epp_pools[p_idx_max2]);
+		OBD_FREE(pool->epp_pools[p_idx_max2], PAGE_SIZE);
+                pool->epp_pools[p_idx_max2] = NULL;
                 p_idx_max2--;
         }
 }
 
 /*
- * we try to keep at least PTLRPC_MAX_BRW_PAGES pages in the pool.
+ * move the pages cached by all CPUs back to their pools, so that the
+ * shrinker can release them.
  */
-static unsigned long enc_pools_shrink_count(struct shrinker *s,
-					    struct shrink_control *sc)
+static void enc_pools_drain_mags(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct ptlrpc_enc_page_pool *pool;
+		struct enc_pool_mag *mag;
+
+		mag = enc_pool_mag_claim(cpu);
+		if (mag == NULL)
+			continue;
+
+		if (mag->epm_count > 0) {
+			pool = page_pools[mag->epm_cpt];
+			spin_lock(&pool->epp_lock);
+			while (mag->epm_count > 0)
+				enc_pools_put_page(pool,
+					mag->epm_pages[--mag->epm_count]);
+			spin_unlock(&pool->epp_lock);
+		}
+		enc_pool_mag_release(mag);
+	}
+}
+
+/*
+ * pages a pool keeps when shrinking, so that all the pools together can
+ * still serve a full size RPC, with the help of stealing.
+ */
+static inline unsigned long enc_pools_min_free(void)
+{
+	return PTLRPC_MAX_BRW_PAGES / cfs_cpt_number(cfs_cpt_table);
+}
+
+static void enc_pools_update_idle(struct ptlrpc_enc_page_pool *pool)
 {
 	/*
 	 * if no pool access for a long time, we consider it's fully idle.
 	 * a little race here is fine.
 	 */
-	if (unlikely(ktime_get_real_seconds() - page_pools.epp_last_access >
+	if (unlikely(ktime_get_real_seconds() - pool->epp_last_access >
 		     CACHE_QUIESCENT_PERIOD)) {
-		spin_lock(&page_pools.epp_lock);
-		page_pools.epp_idle_idx = IDLE_IDX_MAX;
-		spin_unlock(&page_pools.epp_lock);
+		spin_lock(&pool->epp_lock);
+		pool->epp_idle_idx = IDLE_IDX_MAX;
+		spin_unlock(&pool->epp_lock);
 	}
 
-	LASSERT(page_pools.epp_idle_idx <= IDLE_IDX_MAX);
-	return (page_pools.epp_free_pages <= PTLRPC_MAX_BRW_PAGES) ? 0 :
-		(page_pools.epp_free_pages - PTLRPC_MAX_BRW_PAGES) *
-		(IDLE_IDX_MAX - page_pools.epp_idle_idx) / IDLE_IDX_MAX;
+	LASSERT(pool->epp_idle_idx <= IDLE_IDX_MAX);
 }
 
 /*
- * we try to keep at least PTLRPC_MAX_BRW_PAGES pages in the pool.
+ * we try to keep at least PTLRPC_MAX_BRW_PAGES pages in the pools.
+ */
+static unsigned long enc_pools_shrink_count(struct shrinker *s,
+					    struct shrink_control *sc)
+{
+	struct ptlrpc_enc_page_pool *pool;
+	unsigned long count = 0;
+	int i;
+
+	cfs_percpt_for_each(pool, i, page_pools) {
+		enc_pools_update_idle(pool);
+		if (pool->epp_free_pages <= enc_pools_min_free())
+			continue;
+
+		count += (pool->epp_free_pages - enc_pools_min_free()) *
+			 (IDLE_IDX_MAX - pool->epp_idle_idx) / IDLE_IDX_MAX;
+	}
+
+	return count;
+}
+
+/*
+ * we try to keep at least PTLRPC_MAX_BRW_PAGES pages in the pools.
  */
 static unsigned long enc_pools_shrink_scan(struct shrinker *s,
 					   struct shrink_control *sc)
 {
-	spin_lock(&page_pools.epp_lock);
-	if (page_pools.epp_free_pages <= PTLRPC_MAX_BRW_PAGES)
-		sc->nr_to_scan = 0;
-	else
-		sc->nr_to_scan = min_t(unsigned long, sc->nr_to_scan,
-			      page_pools.epp_free_pages - PTLRPC_MAX_BRW_PAGES);
-	if (sc->nr_to_scan > 0) {
-		enc_pools_release_free_pages(sc->nr_to_scan);
-		CDEBUG(D_SEC, "released %ld pages, %ld left\n",
-		       (long)sc->nr_to_scan, page_pools.epp_free_pages);
-
-		page_pools.epp_st_shrinks++;
-		page_pools.epp_last_shrink = ktime_get_real_seconds();
-	}
-	spin_unlock(&page_pools.epp_lock);
+	struct ptlrpc_enc_page_pool *pool;
+	unsigned long released = 0;
+	unsigned long nr;
+	int i;
+
+	enc_pools_drain_mags();
+
+	cfs_percpt_for_each(pool, i, page_pools) {
+		if (released >= sc->nr_to_scan)
+			break;
+
+		spin_lock(&pool->epp_lock);
+		if (pool->epp_free_pages > enc_pools_min_free()) {
+			nr = min_t(unsigned long, sc->nr_to_scan - released,
+				   pool->epp_free_pages - enc_pools_min_free());
+			enc_pools_release_free_pages(pool, nr);
+			CDEBUG(D_SEC, "released %ld pages from pool %d, %ld left\n",
+			       nr, i, pool->epp_free_pages);
+
+			pool->epp_st_shrinks++;
+			pool->epp_last_shrink = ktime_get_real_seconds();
+			released += nr;
+		}
+		spin_unlock(&pool->epp_lock);
 
-	/*
-	 * if no pool access for a long time, we consider it's fully idle.
-	 * a little race here is fine.
-	 */
-	if (unlikely(ktime_get_real_seconds() - page_pools.epp_last_access >
-		     CACHE_QUIESCENT_PERIOD)) {
-		spin_lock(&page_pools.epp_lock);
-		page_pools.epp_idle_idx = IDLE_IDX_MAX;
-		spin_unlock(&page_pools.epp_lock);
+		enc_pools_update_idle(pool);
 	}
 
-	LASSERT(page_pools.epp_idle_idx <= IDLE_IDX_MAX);
-	return sc->nr_to_scan;
+	sc->nr_to_scan = released;
+	return released;
 }
 
 #ifndef HAVE_SHRINKER_COUNT
@@ -299,7 +491,8 @@ static int enc_pools_shrink(SHRINKER_ARGS(sc, nr_to_scan, gfp_mask))
 	struct shrinker* shrinker = NULL;
 #endif
 
-	enc_pools_shrink_scan(shrinker, &scv);
+	if (scv.nr_to_scan > 0)
+		enc_pools_shrink_scan(shrinker, &scv);
 
 	return enc_pools_shrink_count(shrinker, &scv);
 }
@@ -343,39 +536,40 @@ static unsigned long enc_pools_cleanup(struct page ***pools, int npools)
  * we have options to avoid most memory copy with some tricks. but we choose
  * the simplest way to avoid complexity. It's not frequently called.
  */
-static void enc_pools_insert(struct page ***pools, int npools, int npages)
+static void enc_pools_insert(struct ptlrpc_enc_page_pool *pool,
+			     struct page ***pools, int npools, int npages)
 {
         int     freeslot;
         int     op_idx, np_idx, og_idx, ng_idx;
         int     cur_npools, end_npools;
 
         LASSERT(npages > 0);
-        LASSERT(page_pools.epp_total_pages+npages <= page_pools.epp_max_pages);
+        LASSERT(pool->epp_total_pages+npages <= pool->epp_max_pages);
         LASSERT(npages_to_npools(npages) == npools);
-        LASSERT(page_pools.epp_growing);
+        LASSERT(pool->epp_growing);
 
-	spin_lock(&page_pools.epp_lock);
+	spin_lock(&pool->epp_lock);
 
         /*
          * (1) fill all the free slots of current pools.
          */
         /* free slots are those left by rent pages, and the extra ones with
          * index >= total_pages, locate at the tail of last pool. */
-        freeslot = page_pools.epp_total_pages % PAGES_PER_POOL;
+        freeslot = pool->epp_total_pages % PAGES_PER_POOL;
         if (freeslot != 0)
                 freeslot = PAGES_PER_POOL - freeslot;
-        freeslot += page_pools.epp_total_pages - page_pools.epp_free_pages;
+        freeslot += pool->epp_total_pages - pool->epp_free_pages;
 
-        op_idx = page_pools.epp_free_pages / PAGES_PER_POOL;
-        og_idx = page_pools.epp_free_pages % PAGES_PER_POOL;
+        op_idx = pool->epp_free_pages / PAGES_PER_POOL;
+        og_idx = pool->epp_free_pages % PAGES_PER_POOL;
         np_idx = npools - 1;
         ng_idx = (npages - 1) % PAGES_PER_POOL;
 
         while (freeslot) {
-                LASSERT(page_pools.epp_pools[op_idx][og_idx] == NULL);
+                LASSERT(pool->epp_pools[op_idx][og_idx] == NULL);
                 LASSERT(pools[np_idx][ng_idx] != NULL);
 
-                page_pools.epp_pools[op_idx][og_idx] = pools[np_idx][ng_idx];
+                pool->epp_pools[op_idx][og_idx] = pools[np_idx][ng_idx];
                 pools[np_idx][ng_idx] = NULL;
 
                 freeslot--;
@@ -395,52 +589,66 @@ static void enc_pools_insert(struct page ***pools, int npools, int npages)
         /*
          * (2) add pools if needed.
          */
-        cur_npools = (page_pools.epp_total_pages + PAGES_PER_POOL - 1) /
+        cur_npools = (pool->epp_total_pages + PAGES_PER_POOL - 1) /
                      PAGES_PER_POOL;
-        end_npools = (page_pools.epp_total_pages + npages + PAGES_PER_POOL -1) /
+        end_npools = (pool->epp_total_pages + npages + PAGES_PER_POOL -1) /
                      PAGES_PER_POOL;
-        LASSERT(end_npools <= page_pools.epp_max_pools);
+        LASSERT(end_npools <= pool->epp_max_pools);
 
         np_idx = 0;
         while (cur_npools < end_npools) {
-                LASSERT(page_pools.epp_pools[cur_npools] == NULL);
+                LASSERT(pool->epp_pools[cur_npools] == NULL);
                 LASSERT(np_idx < npools);
                 LASSERT(pools[np_idx] != NULL);
 
-                page_pools.epp_pools[cur_npools++] = pools[np_idx];
+                pool->epp_pools[cur_npools++] = pools[np_idx];
                 pools[np_idx++] = NULL;
         }
 
-        page_pools.epp_total_pages += npages;
-        page_pools.epp_free_pages += npages;
-        page_pools.epp_st_lowfree = page_pools.epp_free_pages;
+        pool->epp_total_pages += npages;
+        pool->epp_free_pages += npages;
+        pool->epp_st_lowfree = pool->epp_free_pages;
 
-        if (page_pools.epp_total_pages > page_pools.epp_st_max_pages)
-                page_pools.epp_st_max_pages = page_pools.epp_total_pages;
+        if (pool->epp_total_pages > pool->epp_st_max_pages)
+                pool->epp_st_max_pages = pool->epp_total_pages;
 
-        CDEBUG(D_SEC, "add %d pages to total %lu\n", npages,
-               page_pools.epp_total_pages);
+        CDEBUG(D_SEC, "add %d pages to total %lu of pool %d\n", npages,
+               pool->epp_total_pages, pool->epp_cpt);
 
-	spin_unlock(&page_pools.epp_lock);
+	spin_unlock(&pool->epp_lock);
 }
 
-static int enc_pools_add_pages(int npages)
+static int enc_pools_add_pages(struct ptlrpc_enc_page_pool *pool, int npages)
 {
 	static DEFINE_MUTEX(add_pages_mutex);
 	struct page   ***pools;
 	int             npools, alloced = 0;
 	int             i, j, rc = -ENOMEM;
+	unsigned long	total;
 
 	if (npages < PTLRPC_MAX_BRW_PAGES)
 		npages = PTLRPC_MAX_BRW_PAGES;
 
 	mutex_lock(&add_pages_mutex);
 
-        if (npages + page_pools.epp_total_pages > page_pools.epp_max_pages)
-                npages = page_pools.epp_max_pages - page_pools.epp_total_pages;
-        LASSERT(npages > 0);
+        if (npages + pool->epp_total_pages > pool->epp_max_pages)
+                npages = pool->epp_max_pages - pool->epp_total_pages;
+
+	/* all the pools together stay within enc_pool_max_memory_mb */
+	total = enc_pools_total_pages();
+	if (total + npages > enc_pools_max_pages)
+		npages = total < enc_pools_max_pages ?
+			 enc_pools_max_pages - total : 0;
+	if (npages <= 0) {
+		pool->epp_st_grow_fails++;
+		CDEBUG(D_SEC, "pool %d can't grow: %lu/%lu pages, %lu/%lu in all pools\n",
+		       pool->epp_cpt, pool->epp_total_pages,
+		       pool->epp_max_pages, total, enc_pools_max_pages);
+		mutex_unlock(&add_pages_mutex);
+		return -ENOMEM;
+	}
 
-        page_pools.epp_st_grows++;
+        pool->epp_st_grows++;
 
         npools = npages_to_npools(npages);
         OBD_ALLOC(pools, npools * sizeof(*pools));
@@ -453,8 +661,10 @@ static int enc_pools_add_pages(int npages)
 			goto out_pools;
 
 		for (j = 0; j < PAGES_PER_POOL && alloced < npages; j++) {
-			pools[i][j] = alloc_page(GFP_NOFS |
-						 __GFP_HIGHMEM);
+			pools[i][j] = cfs_page_cpt_alloc(cfs_cpt_table,
+							 pool->epp_cpt,
+							 GFP_NOFS |
+							 __GFP_HIGHMEM);
 			if (pools[i][j] == NULL)
 				goto out_pools;
 
@@ -463,7 +673,7 @@ static int enc_pools_add_pages(int npages)
 	}
 	LASSERT(alloced == npages);
 
-        enc_pools_insert(pools, npools, npages);
+        enc_pools_insert(pool, pools, npools, npages);
         CDEBUG(D_SEC, "added %d pages into pools\n", npages);
         rc = 0;
 
@@ -472,7 +682,7 @@ out_pools:
         OBD_FREE(pools, npools * sizeof(*pools));
 out:
         if (rc) {
-                page_pools.epp_st_grow_fails++;
+                pool->epp_st_grow_fails++;
                 CERROR("Failed to allocate %d enc pages\n", npages);
         }
 
@@ -480,27 +690,29 @@ out:
         return rc;
 }
 
-static inline void enc_pools_wakeup(void)
+static inline void enc_pools_wakeup(struct ptlrpc_enc_page_pool *pool)
 {
-	assert_spin_locked(&page_pools.epp_lock);
+	assert_spin_locked(&pool->epp_lock);
 
-	if (unlikely(page_pools.epp_waitqlen)) {
-		LASSERT(waitqueue_active(&page_pools.epp_waitq));
-		wake_up_all(&page_pools.epp_waitq);
+	if (unlikely(pool->epp_waitqlen)) {
+		LASSERT(waitqueue_active(&pool->epp_waitq));
+		wake_up_all(&pool->epp_waitq);
 	}
 }
 
-static int enc_pools_should_grow(int page_needed, time64_t now)
+static int enc_pools_should_grow(struct ptlrpc_enc_page_pool *pool,
+				 int page_needed, time64_t now)
 {
 	/* don't grow if someone else is growing the pools right now,
 	 * or the pools has reached its full capacity
 	 */
-	if (page_pools.epp_growing ||
-	    page_pools.epp_total_pages == page_pools.epp_max_pages)
+	if (pool->epp_growing ||
+	    pool->epp_total_pages == pool->epp_max_pages ||
+	    enc_pools_total_pages() >= enc_pools_max_pages)
 		return 0;
 
 	/* if total pages is not enough, we need to grow */
-	if (page_pools.epp_total_pages < page_needed)
+	if (pool->epp_total_pages < page_needed)
 		return 1;
 
 	/*
@@ -519,38 +731,186 @@ static int enc_pools_should_grow(int page_needed, time64_t now)
 }
 
 /*
- * Export the number of free pages in the pool
+ * Export the number of free pages in the pool, counting the pages cached by
+ * the CPUs which sptlrpc_enc_pool_get_pages() drains when short
  */
 int get_free_pages_in_pool(void)
 {
-	return page_pools.epp_free_pages;
+	struct ptlrpc_enc_page_pool *pool;
+	unsigned long free = 0;
+	int i;
+
+	cfs_percpt_for_each(pool, i, page_pools)
+		free = max(free, pool->epp_free_pages + enc_pool_mag_pages(i));
+
+	return free;
 }
 EXPORT_SYMBOL(get_free_pages_in_pool);
 
 /*
- * Let outside world know if enc_pool full capacity is reached
+ * Let outside world know if enc_pool full capacity is reached, the pages
+ * cached by the CPUs are part of epp_total_pages
  */
 int pool_is_at_full_capacity(void)
 {
-	return (page_pools.epp_total_pages == page_pools.epp_max_pages);
+	struct ptlrpc_enc_page_pool *pool;
+	int i;
+
+	if (enc_pools_total_pages() >= enc_pools_max_pages)
+		return 1;
+
+	cfs_percpt_for_each(pool, i, page_pools)
+		if (pool->epp_total_pages < pool->epp_max_pages)
+			return 0;
+
+	return 1;
 }
 EXPORT_SYMBOL(pool_is_at_full_capacity);
 
+/*
+ * take the pages of @desc from the pages cached by the current CPU, if the
+ * cache holds enough of them.
+ */
+static bool enc_pools_get_cached(struct ptlrpc_bulk_desc *desc)
+{
+	struct enc_pool_mag *mag;
+	bool got = false;
+	int i;
+
+	if (desc->bd_iov_count > ENC_POOL_MAG_PAGES)
+		return false;
+
+	mag = enc_pool_mag_claim(get_cpu());
+	if (mag == NULL)
+		goto out;
+
+	if (mag->epm_count >= desc->bd_iov_count) {
+		for (i = 0; i < desc->bd_iov_count; i++)
+			BD_GET_ENC_KIOV(desc, i).kiov_page =
+				mag->epm_pages[--mag->epm_count];
+		desc->bd_enc_cpt = mag->epm_cpt;
+		mag->epm_hits++;
+		got = true;
+	}
+	enc_pool_mag_release(mag);
+out:
+	put_cpu();
+	return got;
+}
+
+/*
+ * keep the pages of @desc in the cache of the current CPU, if it is empty
+ * or holds pages of the same pool and has room for them.
+ */
+static bool enc_pools_put_cached(struct ptlrpc_bulk_desc *desc)
+{
+	struct enc_pool_mag *mag;
+	bool put = false;
+	int i;
+
+	if (desc->bd_iov_count > ENC_POOL_MAG_PAGES)
+		return false;
+
+	mag = enc_pool_mag_claim(get_cpu());
+	if (mag == NULL)
+		goto out;
+
+	if (mag->epm_count == 0)
+		mag->epm_cpt = desc->bd_enc_cpt;
+
+	if (mag->epm_cpt == desc->bd_enc_cpt &&
+	    mag->epm_count + desc->bd_iov_count <= ENC_POOL_MAG_PAGES) {
+		for (i = 0; i < desc->bd_iov_count; i++) {
+			LASSERT(BD_GET_ENC_KIOV(desc, i).kiov_page != NULL);
+			mag->epm_pages[mag->epm_count++] =
+				BD_GET_ENC_KIOV(desc, i).kiov_page;
+		}
+		put = true;
+	}
+	enc_pool_mag_release(mag);
+out:
+	put_cpu();
+	return put;
+}
+
+/*
+ * take the pages of @desc from @pool, which must have enough free pages.
+ */
+static void enc_pools_take(struct ptlrpc_enc_page_pool *pool,
+			   struct ptlrpc_bulk_desc *desc,
+			   unsigned long this_idle)
+{
+	int i;
+
+	assert_spin_locked(&pool->epp_lock);
+	LASSERT(pool->epp_free_pages >= desc->bd_iov_count);
+
+	for (i = 0; i < desc->bd_iov_count; i++)
+		BD_GET_ENC_KIOV(desc, i).kiov_page = enc_pools_get_page(pool);
+	desc->bd_enc_cpt = pool->epp_cpt;
+
+        if (pool->epp_free_pages < pool->epp_st_lowfree)
+                pool->epp_st_lowfree = pool->epp_free_pages;
+
+        /*
+         * new idle index = (old * weight + new) / (weight + 1)
+         */
+        if (this_idle == -1) {
+                this_idle = pool->epp_free_pages * IDLE_IDX_MAX /
+                            pool->epp_total_pages;
+        }
+        pool->epp_idle_idx = (pool->epp_idle_idx * IDLE_IDX_WEIGHT +
+                              this_idle) /
+                             (IDLE_IDX_WEIGHT + 1);
+
+	pool->epp_last_access = ktime_get_real_seconds();
+}
+
+/*
+ * take the pages of @desc from another pool than @local having enough
+ * free pages, rather than growing @local.
+ */
+static bool enc_pools_steal(struct ptlrpc_enc_page_pool *local,
+			    struct ptlrpc_bulk_desc *desc)
+{
+	struct ptlrpc_enc_page_pool *pool;
+	int i;
+
+	cfs_percpt_for_each(pool, i, page_pools) {
+		/* unlocked check, a little race here is fine */
+		if (pool == local ||
+		    pool->epp_free_pages < desc->bd_iov_count)
+			continue;
+
+		spin_lock(&pool->epp_lock);
+		if (pool->epp_free_pages >= desc->bd_iov_count) {
+			enc_pools_take(pool, desc, -1);
+			pool->epp_st_stolen++;
+			spin_unlock(&pool->epp_lock);
+			return true;
+		}
+		spin_unlock(&pool->epp_lock);
+	}
+
+	return false;
+}
+
 /*
  * we allocate the requested pages atomically.
  */
 int sptlrpc_enc_pool_get_pages(struct ptlrpc_bulk_desc *desc)
 {
+	struct ptlrpc_enc_page_pool *pool;
 	wait_queue_t  waitlink;
 	unsigned long   this_idle = -1;
 	cfs_time_t      tick = 0;
 	long            now;
-	int             p_idx, g_idx;
-	int             i;
+	bool		drained = false;
+	bool		steal = true;
 
 	LASSERT(ptlrpc_is_bulk_desc_kiov(desc->bd_type));
 	LASSERT(desc->bd_iov_count > 0);
-	LASSERT(desc->bd_iov_count <= page_pools.epp_max_pages);
+	LASSERT(desc->bd_iov_count <= page_pools[0]->epp_max_pages);
 
 	/* resent bulk, enc iov might have been allocated previously */
 	if (GET_ENC_KIOV(desc) != NULL)
@@ -561,55 +921,78 @@ int sptlrpc_enc_pool_get_pages(struct ptlrpc_bulk_desc *desc)
 	if (GET_ENC_KIOV(desc) == NULL)
 		return -ENOMEM;
 
-	spin_lock(&page_pools.epp_lock);
+	if (enc_pools_get_cached(desc))
+		return 0;
 
-	page_pools.epp_st_access++;
+	pool = page_pools[cfs_cpt_current(cfs_cpt_table, 1)];
+	spin_lock(&pool->epp_lock);
+
+	pool->epp_st_access++;
 again:
-	if (unlikely(page_pools.epp_free_pages < desc->bd_iov_count)) {
+	if (unlikely(pool->epp_free_pages < desc->bd_iov_count)) {
+		if (!drained) {
+			/* the CPUs may be caching the missing pages */
+			spin_unlock(&pool->epp_lock);
+			enc_pools_drain_mags();
+			drained = true;
+			spin_lock(&pool->epp_lock);
+			goto again;
+		}
+
+		if (steal) {
+			/* never hold the locks of two pools */
+			spin_unlock(&pool->epp_lock);
+			if (enc_pools_steal(pool, desc))
+				return 0;
+			steal = false;
+			spin_lock(&pool->epp_lock);
+			goto again;
+		}
+
 		if (tick == 0)
 			tick = cfs_time_current();
 
 		now = ktime_get_real_seconds();
 
-		page_pools.epp_st_missings++;
-		page_pools.epp_pages_short += desc->bd_iov_count;
+		pool->epp_st_missings++;
+		pool->epp_pages_short += desc->bd_iov_count;
 
-		if (enc_pools_should_grow(desc->bd_iov_count, now)) {
-			page_pools.epp_growing = 1;
+		if (enc_pools_should_grow(pool, desc->bd_iov_count, now)) {
+			pool->epp_growing = 1;
 
-			spin_unlock(&page_pools.epp_lock);
-			enc_pools_add_pages(page_pools.epp_pages_short / 2);
-			spin_lock(&page_pools.epp_lock);
+			spin_unlock(&pool->epp_lock);
+			enc_pools_add_pages(pool, pool->epp_pages_short / 2);
+			spin_lock(&pool->epp_lock);
 
-			page_pools.epp_growing = 0;
+			pool->epp_growing = 0;
 
-			enc_pools_wakeup();
+			enc_pools_wakeup(pool);
 		} else {
-			if (page_pools.epp_growing) {
-				if (++page_pools.epp_waitqlen >
-				    page_pools.epp_st_max_wqlen)
-					page_pools.epp_st_max_wqlen =
-							page_pools.epp_waitqlen;
+			if (pool->epp_growing) {
+				if (++pool->epp_waitqlen >
+				    pool->epp_st_max_wqlen)
+					pool->epp_st_max_wqlen =
+							pool->epp_waitqlen;
 
 				set_current_state(TASK_UNINTERRUPTIBLE);
 				init_waitqueue_entry(&waitlink, current);
-				add_wait_queue(&page_pools.epp_waitq,
-					       &waitlink);
+				add_wait_queue(&pool->epp_waitq, &waitlink);
 
-				spin_unlock(&page_pools.epp_lock);
+				spin_unlock(&pool->epp_lock);
 				schedule();
-				remove_wait_queue(&page_pools.epp_waitq,
-						  &waitlink);
-				LASSERT(page_pools.epp_waitqlen > 0);
-				spin_lock(&page_pools.epp_lock);
-				page_pools.epp_waitqlen--;
+				remove_wait_queue(&pool->epp_waitq, &waitlink);
+				LASSERT(pool->epp_waitqlen > 0);
+				spin_lock(&pool->epp_lock);
+				pool->epp_waitqlen--;
+				/* woken by pages put in a CPU cache */
+				drained = false;
 			} else {
 				/* ptlrpcd thread should not sleep in that case,
 				 * or deadlock may occur!
 				 * Instead, return -ENOMEM so that upper layers
 				 * will put request back in queue. */
-				page_pools.epp_st_outofmem++;
-				spin_unlock(&page_pools.epp_lock);
+				pool->epp_st_outofmem++;
+				spin_unlock(&pool->epp_lock);
 				OBD_FREE_LARGE(GET_ENC_KIOV(desc),
 					       desc->bd_iov_count *
 						sizeof(*GET_ENC_KIOV(desc)));
@@ -618,8 +1001,8 @@ again:
 			}
 		}
 
-		LASSERT(page_pools.epp_pages_short >= desc->bd_iov_count);
-		page_pools.epp_pages_short -= desc->bd_iov_count;
+		LASSERT(pool->epp_pages_short >= desc->bd_iov_count);
+		pool->epp_pages_short -= desc->bd_iov_count;
 
 		this_idle = 0;
 		goto again;
@@ -628,52 +1011,50 @@ again:
         /* record max wait time */
         if (unlikely(tick != 0)) {
                 tick = cfs_time_current() - tick;
-                if (tick > page_pools.epp_st_max_wait)
-                        page_pools.epp_st_max_wait = tick;
+                if (tick > pool->epp_st_max_wait)
+                        pool->epp_st_max_wait = tick;
         }
 
-        /* proceed with rest of allocation */
-        page_pools.epp_free_pages -= desc->bd_iov_count;
+	/* proceed with rest of allocation */
+	enc_pools_take(pool, desc, this_idle);
 
-        p_idx = page_pools.epp_free_pages / PAGES_PER_POOL;
-        g_idx = page_pools.epp_free_pages % PAGES_PER_POOL;
+	spin_unlock(&pool->epp_lock);
+	return 0;
+}
+EXPORT_SYMBOL(sptlrpc_enc_pool_get_pages);
 
-	for (i = 0; i < desc->bd_iov_count; i++) {
-		LASSERT(page_pools.epp_pools[p_idx][g_idx] != NULL);
-		BD_GET_ENC_KIOV(desc, i).kiov_page =
-		       page_pools.epp_pools[p_idx][g_idx];
-		page_pools.epp_pools[p_idx][g_idx] = NULL;
-
-		if (++g_idx == PAGES_PER_POOL) {
-			p_idx++;
-			g_idx = 0;
-		}
-	}
+/**
+ * Set up the encrypted iov of \a desc on the pages of the bulk itself, for
+ * the cipher text to be received and decrypted in place.  No page is taken
+ * from the pools.  Released by sptlrpc_enc_pool_put_pages() as well.
+ *
+ * \retval	0 on success
+ * \retval	-ENOMEM if the iov can't be allocated
+ */
+int sptlrpc_enc_pool_alias_pages(struct ptlrpc_bulk_desc *desc)
+{
+	int i;
 
-        if (page_pools.epp_free_pages < page_pools.epp_st_lowfree)
-                page_pools.epp_st_lowfree = page_pools.epp_free_pages;
+	LASSERT(ptlrpc_is_bulk_desc_kiov(desc->bd_type));
+	LASSERT(desc->bd_iov_count > 0);
+	LASSERT(GET_ENC_KIOV(desc) == NULL);
 
-        /*
-         * new idle index = (old * weight + new) / (weight + 1)
-         */
-        if (this_idle == -1) {
-                this_idle = page_pools.epp_free_pages * IDLE_IDX_MAX /
-                            page_pools.epp_total_pages;
-        }
-        page_pools.epp_idle_idx = (page_pools.epp_idle_idx * IDLE_IDX_WEIGHT +
-                                   this_idle) /
-                                  (IDLE_IDX_WEIGHT + 1);
+	OBD_ALLOC_LARGE(GET_ENC_KIOV(desc),
+			desc->bd_iov_count * sizeof(*GET_ENC_KIOV(desc)));
+	if (GET_ENC_KIOV(desc) == NULL)
+		return -ENOMEM;
 
-	page_pools.epp_last_access = ktime_get_real_seconds();
+	for (i = 0; i < desc->bd_iov_count; i++)
+		BD_GET_ENC_KIOV(desc, i) = BD_GET_KIOV(desc, i);
+	desc->bd_enc_inplace = 1;
 
-	spin_unlock(&page_pools.epp_lock);
 	return 0;
 }
-EXPORT_SYMBOL(sptlrpc_enc_pool_get_pages);
+EXPORT_SYMBOL(sptlrpc_enc_pool_alias_pages);
 
 void sptlrpc_enc_pool_put_pages(struct ptlrpc_bulk_desc *desc)
 {
-	int     p_idx, g_idx;
+	struct ptlrpc_enc_page_pool *pool;
 	int     i;
 
 	LASSERT(ptlrpc_is_bulk_desc_kiov(desc->bd_type));
@@ -683,35 +1064,35 @@ void sptlrpc_enc_pool_put_pages(struct ptlrpc_bulk_desc *desc)
 
 	LASSERT(desc->bd_iov_count > 0);
 
-	spin_lock(&page_pools.epp_lock);
-
-	p_idx = page_pools.epp_free_pages / PAGES_PER_POOL;
-	g_idx = page_pools.epp_free_pages % PAGES_PER_POOL;
-
-	LASSERT(page_pools.epp_free_pages + desc->bd_iov_count <=
-		page_pools.epp_total_pages);
-	LASSERT(page_pools.epp_pools[p_idx]);
-
-	for (i = 0; i < desc->bd_iov_count; i++) {
-		LASSERT(BD_GET_ENC_KIOV(desc, i).kiov_page != NULL);
-		LASSERT(g_idx != 0 || page_pools.epp_pools[p_idx]);
-		LASSERT(page_pools.epp_pools[p_idx][g_idx] == NULL);
-
-		page_pools.epp_pools[p_idx][g_idx] =
-			BD_GET_ENC_KIOV(desc, i).kiov_page;
+	/* the pages belong to the bulk */
+	if (desc->bd_enc_inplace) {
+		desc->bd_enc_inplace = 0;
+		goto out;
+	}
 
-		if (++g_idx == PAGES_PER_POOL) {
-			p_idx++;
-			g_idx = 0;
+	pool = page_pools[desc->bd_enc_cpt];
+	if (enc_pools_put_cached(desc)) {
+		/* waiters drain the CPU caches before sleeping again */
+		if (unlikely(pool->epp_waitqlen)) {
+			spin_lock(&pool->epp_lock);
+			enc_pools_wakeup(pool);
+			spin_unlock(&pool->epp_lock);
 		}
+		goto out;
 	}
 
-	page_pools.epp_free_pages += desc->bd_iov_count;
+	spin_lock(&pool->epp_lock);
+
+	LASSERT(pool->epp_free_pages + desc->bd_iov_count <=
+		pool->epp_total_pages);
 
-	enc_pools_wakeup();
+	for (i = 0; i < desc->bd_iov_count; i++)
+		enc_pools_put_page(pool, BD_GET_ENC_KIOV(desc, i).kiov_page);
 
-	spin_unlock(&page_pools.epp_lock);
+	enc_pools_wakeup(pool);
 
+	spin_unlock(&pool->epp_lock);
+out:
 	OBD_FREE_LARGE(GET_ENC_KIOV(desc),
 		 desc->bd_iov_count * sizeof(*GET_ENC_KIOV(desc)));
 	GET_ENC_KIOV(desc) = NULL;
@@ -724,23 +1105,25 @@ void sptlrpc_enc_pool_put_pages(struct ptlrpc_bulk_desc *desc)
  */
 int sptlrpc_enc_pool_add_user(void)
 {
+	struct ptlrpc_enc_page_pool *pool;
 	int     need_grow = 0;
 
-	spin_lock(&page_pools.epp_lock);
-	if (page_pools.epp_growing == 0 && page_pools.epp_total_pages == 0) {
-		page_pools.epp_growing = 1;
+	pool = page_pools[cfs_cpt_current(cfs_cpt_table, 1)];
+	spin_lock(&pool->epp_lock);
+	if (pool->epp_growing == 0 && pool->epp_total_pages == 0) {
+		pool->epp_growing = 1;
 		need_grow = 1;
 	}
-	spin_unlock(&page_pools.epp_lock);
+	spin_unlock(&pool->epp_lock);
 
 	if (need_grow) {
-		enc_pools_add_pages(PTLRPC_MAX_BRW_PAGES +
+		enc_pools_add_pages(pool, PTLRPC_MAX_BRW_PAGES +
 				    PTLRPC_MAX_BRW_PAGES);
 
-		spin_lock(&page_pools.epp_lock);
-		page_pools.epp_growing = 0;
-		enc_pools_wakeup();
-		spin_unlock(&page_pools.epp_lock);
+		spin_lock(&pool->epp_lock);
+		pool->epp_growing = 0;
+		enc_pools_wakeup(pool);
+		spin_unlock(&pool->epp_lock);
 	}
 	return 0;
 }
@@ -752,101 +1135,138 @@ int sptlrpc_enc_pool_del_user(void)
 }
 EXPORT_SYMBOL(sptlrpc_enc_pool_del_user);
 
-static inline void enc_pools_alloc(void)
+static inline void enc_pools_alloc(struct ptlrpc_enc_page_pool *pool)
 {
-	LASSERT(page_pools.epp_max_pools);
-	OBD_ALLOC_LARGE(page_pools.epp_pools,
-			page_pools.epp_max_pools *
-			sizeof(*page_pools.epp_pools));
+	LASSERT(pool->epp_max_pools);
+	OBD_ALLOC_LARGE(pool->epp_pools,
+			pool->epp_max_pools *
+			sizeof(*pool->epp_pools));
 }
 
-static inline void enc_pools_free(void)
+static inline void enc_pools_free(struct ptlrpc_enc_page_pool *pool)
 {
-	LASSERT(page_pools.epp_max_pools);
-	LASSERT(page_pools.epp_pools);
+	LASSERT(pool->epp_max_pools);
+	LASSERT(pool->epp_pools);
 
-	OBD_FREE_LARGE(page_pools.epp_pools,
-		       page_pools.epp_max_pools *
-		       sizeof(*page_pools.epp_pools));
+	OBD_FREE_LARGE(pool->epp_pools,
+		       pool->epp_max_pools *
+		       sizeof(*pool->epp_pools));
+}
+
+static void enc_pools_fini_parts(void)
+{
+	struct ptlrpc_enc_page_pool *pool;
+	unsigned long cleaned, npools;
+	int i;
+
+	cfs_percpt_for_each(pool, i, page_pools) {
+		if (pool->epp_pools == NULL)
+			continue;
+
+		LASSERT(pool->epp_total_pages == pool->epp_free_pages);
+
+		npools = npages_to_npools(pool->epp_total_pages);
+		cleaned = enc_pools_cleanup(pool->epp_pools, npools);
+		LASSERT(cleaned == pool->epp_total_pages);
+
+		enc_pools_free(pool);
+
+		if (pool->epp_st_access > 0) {
+			CDEBUG(D_SEC,
+			       "pool %d: max pages %lu, grows %u, grow fails %u, shrinks %u, access %lu, missing %lu, stolen %lu, max qlen %u, max wait %ld/%lu, out of mem %lu\n",
+			       i, pool->epp_st_max_pages, pool->epp_st_grows,
+			       pool->epp_st_grow_fails,
+			       pool->epp_st_shrinks, pool->epp_st_access,
+			       pool->epp_st_missings, pool->epp_st_stolen,
+			       pool->epp_st_max_wqlen,
+			       pool->epp_st_max_wait,
+			       msecs_to_jiffies(MSEC_PER_SEC),
+			       pool->epp_st_outofmem);
+		}
+	}
+
+	cfs_percpt_free(page_pools);
+	page_pools = NULL;
 }
 
 int sptlrpc_enc_pool_init(void)
 {
 	DEF_SHRINKER_VAR(shvar, enc_pools_shrink,
 			 enc_pools_shrink_count, enc_pools_shrink_scan);
+	struct ptlrpc_enc_page_pool *pool;
+	unsigned long max_pages;
+	int cpu;
+	int i;
 
-	page_pools.epp_max_pages = totalram_pages / 8;
+	max_pages = totalram_pages / 8;
 	if (enc_pool_max_memory_mb > 0 &&
 	    enc_pool_max_memory_mb <= (totalram_pages >> mult))
-		page_pools.epp_max_pages = enc_pool_max_memory_mb << mult;
-
-	page_pools.epp_max_pools = npages_to_npools(page_pools.epp_max_pages);
-
-	init_waitqueue_head(&page_pools.epp_waitq);
-	page_pools.epp_waitqlen = 0;
-	page_pools.epp_pages_short = 0;
+		max_pages = enc_pool_max_memory_mb << mult;
+
+	if (max_pages < PTLRPC_MAX_BRW_PAGES)
+		max_pages = PTLRPC_MAX_BRW_PAGES;
+	enc_pools_max_pages = max_pages;
+
+	/* the limit is shared by all partitions, but each of them must be
+	 * able to hold the pages of a full size RPC; enc_pools_max_pages
+	 * still bounds them all together, the pools short of pages steal
+	 * from the others */
+	max_pages /= cfs_cpt_number(cfs_cpt_table);
+	if (max_pages < PTLRPC_MAX_BRW_PAGES)
+		max_pages = PTLRPC_MAX_BRW_PAGES;
+
+	enc_pool_mags = alloc_percpu(struct enc_pool_mag);
+	if (enc_pool_mags == NULL)
+		return -ENOMEM;
 
-        page_pools.epp_growing = 0;
+	for_each_possible_cpu(cpu)
+		atomic_set(&per_cpu_ptr(enc_pool_mags, cpu)->epm_busy, 0);
 
-        page_pools.epp_idle_idx = 0;
-	page_pools.epp_last_shrink = ktime_get_real_seconds();
-	page_pools.epp_last_access = ktime_get_real_seconds();
+	page_pools = cfs_percpt_alloc(cfs_cpt_table, sizeof(*pool));
+	if (page_pools == NULL)
+		goto out_mags;
 
-	spin_lock_init(&page_pools.epp_lock);
-        page_pools.epp_total_pages = 0;
-        page_pools.epp_free_pages = 0;
+	cfs_percpt_for_each(pool, i, page_pools) {
+		pool->epp_cpt = i;
+		pool->epp_max_pages = max_pages;
+		pool->epp_max_pools = npages_to_npools(max_pages);
 
-        page_pools.epp_st_max_pages = 0;
-        page_pools.epp_st_grows = 0;
-        page_pools.epp_st_grow_fails = 0;
-        page_pools.epp_st_shrinks = 0;
-        page_pools.epp_st_access = 0;
-        page_pools.epp_st_missings = 0;
-        page_pools.epp_st_lowfree = 0;
-        page_pools.epp_st_max_wqlen = 0;
-        page_pools.epp_st_max_wait = 0;
-	page_pools.epp_st_outofmem = 0;
+		init_waitqueue_head(&pool->epp_waitq);
+		pool->epp_last_shrink = ktime_get_real_seconds();
+		pool->epp_last_access = ktime_get_real_seconds();
+		spin_lock_init(&pool->epp_lock);
 
-        enc_pools_alloc();
-        if (page_pools.epp_pools == NULL)
-                return -ENOMEM;
+		enc_pools_alloc(pool);
+		if (pool->epp_pools == NULL)
+			goto out_parts;
+	}
 
 	pools_shrinker = set_shrinker(pools_shrinker_seeks, &shvar);
-        if (pools_shrinker == NULL) {
-                enc_pools_free();
-                return -ENOMEM;
-        }
+	if (pools_shrinker == NULL)
+		goto out_parts;
 
         return 0;
+
+out_parts:
+	enc_pools_fini_parts();
+out_mags:
+	free_percpu(enc_pool_mags);
+	enc_pool_mags = NULL;
+	return -ENOMEM;
 }
 
 void sptlrpc_enc_pool_fini(void)
 {
-        unsigned long cleaned, npools;
-
         LASSERT(pools_shrinker);
-        LASSERT(page_pools.epp_pools);
-        LASSERT(page_pools.epp_total_pages == page_pools.epp_free_pages);
+        LASSERT(page_pools);
 
 	remove_shrinker(pools_shrinker);
 
-        npools = npages_to_npools(page_pools.epp_total_pages);
-        cleaned = enc_pools_cleanup(page_pools.epp_pools, npools);
-        LASSERT(cleaned == page_pools.epp_total_pages);
-
-        enc_pools_free();
-
-	if (page_pools.epp_st_access > 0) {
-		CDEBUG(D_SEC,
-		       "max pages %lu, grows %u, grow fails %u, shrinks %u, access %lu, missing %lu, max qlen %u, max wait %ld/%lu, out of mem %lu\n",
-		       page_pools.epp_st_max_pages, page_pools.epp_st_grows,
-		       page_pools.epp_st_grow_fails,
-		       page_pools.epp_st_shrinks, page_pools.epp_st_access,
-		       page_pools.epp_st_missings, page_pools.epp_st_max_wqlen,
-		       page_pools.epp_st_max_wait,
-		       msecs_to_jiffies(MSEC_PER_SEC),
-		       page_pools.epp_st_outofmem);
-	}
+	enc_pools_drain_mags();
+	enc_pools_fini_parts();
+
+	free_percpu(enc_pool_mags);
+	enc_pool_mags = NULL;
 }
 
 
@@ -152,6 +152,7 @@ static void sec_do_gc(struct ptlrpc_sec *sec)
 	if (sec->ps_gc_next > ktime_get_real_seconds())
                 return;
 
+	sptlrpc_sec_ctx_cache_flush(sec, -1, true);
         sec->ps_policy->sp_cops->gc_ctx(sec);
 	sec->ps_gc_next = ktime_get_real_seconds() + sec->ps_gc_interval;
 }
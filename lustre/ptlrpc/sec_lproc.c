@@ -77,6 +77,7 @@ static int sptlrpc_info_lprocfs_seq_show(struct seq_file *seq, void *v)
         struct client_obd *cli = &dev->u.cli;
         struct ptlrpc_sec *sec = NULL;
         char               str[32];
+	unsigned long	   hits, misses;
 
 	LASSERT(strcmp(dev->obd_type->typ_name, LUSTRE_OSC_NAME) == 0 ||
 		strcmp(dev->obd_type->typ_name, LUSTRE_MDC_NAME) == 0 ||
@@ -101,6 +102,8 @@ static int sptlrpc_info_lprocfs_seq_show(struct seq_file *seq, void *v)
 	seq_printf(seq, "refcount:	%d\n",
 		   atomic_read(&sec->ps_refcount));
 	seq_printf(seq, "nctx:	%d\n", atomic_read(&sec->ps_nctx));
+	sptlrpc_sec_ctx_cache_stats(sec, &hits, &misses);
+	seq_printf(seq, "ctx cache:	%lu hits, %lu misses\n", hits, misses);
 	seq_printf(seq, "gc internal	%lld\n", sec->ps_gc_interval);
 	seq_printf(seq, "gc next	%lld\n",
 		   sec->ps_gc_interval ?
@@ -33,6 +33,7 @@
 #define DEBUG_SUBSYSTEM S_RPC
 
 #include <linux/kthread.h>
+#include <linux/tick.h>
 #include <obd_support.h>
 #include <obd_class.h>
 #include <lustre_net.h>
@@ -67,7 +68,8 @@ struct list_head ptlrpc_all_services;
 struct mutex ptlrpc_all_services_mutex;
 
 static struct ptlrpc_request_buffer_desc *
-ptlrpc_alloc_rqbd(struct ptlrpc_service_part *svcpt)
+ptlrpc_alloc_rqbd(struct ptlrpc_service_part *svcpt,
+		  enum ptlrpc_rqbd_class cls)
 {
 	struct ptlrpc_service		  *svc = svcpt->scp_service;
 	struct ptlrpc_request_buffer_desc *rqbd;
@@ -78,11 +80,12 @@ ptlrpc_alloc_rqbd(struct ptlrpc_service_part *svcpt)
 
 	rqbd->rqbd_svcpt = svcpt;
 	rqbd->rqbd_refcount = 0;
+	rqbd->rqbd_class = cls;
 	rqbd->rqbd_cbid.cbid_fn = request_in_callback;
 	rqbd->rqbd_cbid.cbid_arg = rqbd;
 	INIT_LIST_HEAD(&rqbd->rqbd_reqs);
 	OBD_CPT_ALLOC_LARGE(rqbd->rqbd_buffer, svc->srv_cptable,
-			    svcpt->scp_cpt, svc->srv_buf_size);
+			    svcpt->scp_cpt, ptlrpc_rqbd_buf_size(svc, cls));
 	if (rqbd->rqbd_buffer == NULL) {
 		OBD_FREE_PTR(rqbd);
 		return NULL;
@@ -91,6 +94,7 @@ ptlrpc_alloc_rqbd(struct ptlrpc_service_part *svcpt)
 	spin_lock(&svcpt->scp_lock);
 	list_add(&rqbd->rqbd_list, &svcpt->scp_rqbd_idle);
 	svcpt->scp_nrqbds_total++;
+	svcpt->scp_rqbd_pools[cls].rbp_nrqbds_total++;
 	spin_unlock(&svcpt->scp_lock);
 
 	return rqbd;
@@ -107,17 +111,38 @@ ptlrpc_free_rqbd(struct ptlrpc_request_buffer_desc *rqbd)
 	spin_lock(&svcpt->scp_lock);
 	list_del(&rqbd->rqbd_list);
 	svcpt->scp_nrqbds_total--;
+	svcpt->scp_rqbd_pools[rqbd->rqbd_class].rbp_nrqbds_total--;
 	spin_unlock(&svcpt->scp_lock);
 
-	OBD_FREE_LARGE(rqbd->rqbd_buffer, svcpt->scp_service->srv_buf_size);
+	OBD_FREE_LARGE(rqbd->rqbd_buffer,
+		       ptlrpc_rqbd_buf_size(svcpt->scp_service,
+					    rqbd->rqbd_class));
 	OBD_FREE_PTR(rqbd);
 }
 
+/**
+ * Whether few enough request buffers of class \a cls are posted on \a svcpt
+ * that more should be allocated.
+ */
+static bool
+ptlrpc_rqbd_pool_low(struct ptlrpc_service_part *svcpt,
+		     enum ptlrpc_rqbd_class cls)
+{
+	int nbufs = ptlrpc_rqbd_nbufs(svcpt->scp_service, cls);
+	int low_water = test_req_buffer_pressure ? 0 : nbufs / 2;
+
+	/* NB I'm not locking; just looking. */
+	return nbufs > 0 &&
+	       svcpt->scp_rqbd_pools[cls].rbp_nrqbds_posted <= low_water;
+}
+
 static int
 ptlrpc_grow_req_bufs(struct ptlrpc_service_part *svcpt, int post)
 {
 	struct ptlrpc_service		  *svc = svcpt->scp_service;
         struct ptlrpc_request_buffer_desc *rqbd;
+	enum ptlrpc_rqbd_class		   cls;
+	int				   nbufs;
         int                                rc = 0;
         int                                i;
 
@@ -137,20 +162,34 @@ ptlrpc_grow_req_bufs(struct ptlrpc_service_part *svcpt, int post)
 	spin_unlock(&svcpt->scp_lock);
 
 
-        for (i = 0; i < svc->srv_nbuf_per_group; i++) {
-                /* NB: another thread might have recycled enough rqbds, we
-		 * need to make sure it wouldn't over-allocate, see LU-1212. */
-		if (svcpt->scp_nrqbds_posted >= svc->srv_nbuf_per_group)
-			break;
+	for (cls = 0; cls < PTLRPC_RQBD_NCLASS && rc == 0; cls++) {
+		/* only top up the size classes that are running low */
+		if (!ptlrpc_rqbd_pool_low(svcpt, cls))
+			continue;
+
+		nbufs = ptlrpc_rqbd_nbufs(svc, cls);
+		for (i = 0; i < nbufs; i++) {
+			/* NB: another thread might have recycled enough rqbds,
+			 * we need to make sure it wouldn't over-allocate, see
+			 * LU-1212. */
+			if (svcpt->scp_rqbd_pools[cls].rbp_nrqbds_posted >=
+			    nbufs)
+				break;
 
-		rqbd = ptlrpc_alloc_rqbd(svcpt);
+			rqbd = ptlrpc_alloc_rqbd(svcpt, cls);
+			if (rqbd == NULL) {
+				CERROR("%s: Can't allocate request buffer\n",
+				       svc->srv_name);
+				rc = -ENOMEM;
+				break;
+			}
+		}
 
-                if (rqbd == NULL) {
-                        CERROR("%s: Can't allocate request buffer\n",
-                               svc->srv_name);
-                        rc = -ENOMEM;
-                        break;
-                }
+		CDEBUG(D_RPCTRACE, "%s: allocate %d new %d-byte reqbufs "
+		       "(%d/%d left), rc = %d\n", svc->srv_name, i,
+		       ptlrpc_rqbd_buf_size(svc, cls),
+		       svcpt->scp_rqbd_pools[cls].rbp_nrqbds_posted,
+		       svcpt->scp_rqbd_pools[cls].rbp_nrqbds_total, rc);
 	}
 
 	spin_lock(&svcpt->scp_lock);
@@ -160,11 +199,6 @@ ptlrpc_grow_req_bufs(struct ptlrpc_service_part *svcpt, int post)
 
 	spin_unlock(&svcpt->scp_lock);
 
-	CDEBUG(D_RPCTRACE,
-	       "%s: allocate %d new %d-byte reqbufs (%d/%d left), rc = %d\n",
-	       svc->srv_name, i, svc->srv_buf_size, svcpt->scp_nrqbds_posted,
-	       svcpt->scp_nrqbds_total, rc);
-
  try_post:
 	if (post && rc == 0)
 		rc = ptlrpc_server_post_idle_rqbds(svcpt);
@@ -448,6 +482,7 @@ ptlrpc_server_post_idle_rqbds(struct ptlrpc_service_part *svcpt)
 
 		/* assume we will post successfully */
 		svcpt->scp_nrqbds_posted++;
+		svcpt->scp_rqbd_pools[rqbd->rqbd_class].rbp_nrqbds_posted++;
 		list_add(&rqbd->rqbd_list, &svcpt->scp_rqbd_posted);
 
 		spin_unlock(&svcpt->scp_lock);
@@ -462,6 +497,7 @@ ptlrpc_server_post_idle_rqbds(struct ptlrpc_service_part *svcpt)
 	spin_lock(&svcpt->scp_lock);
 
 	svcpt->scp_nrqbds_posted--;
+	svcpt->scp_rqbd_pools[rqbd->rqbd_class].rbp_nrqbds_posted--;
 	list_del(&rqbd->rqbd_list);
 	list_add_tail(&rqbd->rqbd_list, &svcpt->scp_rqbd_idle);
 
@@ -503,7 +539,7 @@ ptlrpc_server_nthreads_check(struct ptlrpc_service *svc,
 	 * number for each CPT to guarantee each pool will have enough
 	 * threads to keep the service healthy.
 	 */
-	init = PTLRPC_NTHRS_INIT + (svc->srv_ops.so_hpreq_handler != NULL);
+	init = PTLRPC_NTHRS_INIT + svc->srv_nthrs_cpt_hp;
 	init = max_t(int, init, tc->tc_nthrs_init);
 
 	/* NB: please see comments in lustre_lnet.h for definition
@@ -574,9 +610,12 @@ ptlrpc_server_nthreads_check(struct ptlrpc_service *svc,
 			    tc->tc_nthrs_max / svc->srv_ncpts);
 	}
  out:
-	nthrs = max(nthrs, tc->tc_nthrs_init);
+	nthrs = max(nthrs, init);
 	svc->srv_nthrs_cpt_limit = nthrs;
 	svc->srv_nthrs_cpt_init = init;
+	svc->srv_thrs_idle_timeout = PTLRPC_THR_IDLE_TIMEOUT;
+	svc->srv_thrs_cpu_max = 100;
+	svc->srv_reply_batch_usec = PTLRPC_REPLY_BATCH_USEC;
 
 	if (nthrs * svc->srv_ncpts > tc->tc_nthrs_max) {
 		CDEBUG(D_OTHER, "%s: This service may have more threads (%d) "
@@ -620,6 +659,8 @@ ptlrpc_service_part_init(struct ptlrpc_service *svc,
 	INIT_LIST_HEAD(&svcpt->scp_rep_idle);
 	init_waitqueue_head(&svcpt->scp_rep_waitq);
 	atomic_set(&svcpt->scp_nreps_difficult, 0);
+	INIT_LIST_HEAD(&svcpt->scp_rep_batch);
+	INIT_DELAYED_WORK(&svcpt->scp_rep_batch_work, ptlrpc_reply_batch_work);
 
 	/* adaptive timeout */
 	spin_lock_init(&svcpt->scp_at_lock);
@@ -763,6 +804,19 @@ ptlrpc_register_service(struct ptlrpc_service_conf *conf,
 	service->srv_max_req_size	= conf->psc_buf.bc_req_max_size +
 					  SPTLRPC_MAX_PAYLOAD;
 	service->srv_buf_size		= conf->psc_buf.bc_buf_size;
+	if (conf->psc_buf.bc_small_nbufs > 0 &&
+	    conf->psc_buf.bc_small_req_max_size <
+	    conf->psc_buf.bc_req_max_size) {
+		LASSERT(conf->psc_buf.bc_small_buf_size >=
+			conf->psc_buf.bc_small_req_max_size +
+			SPTLRPC_MAX_PAYLOAD);
+		service->srv_small_nbuf_per_group = test_req_buffer_pressure ?
+					1 : conf->psc_buf.bc_small_nbufs;
+		service->srv_small_max_req_size =
+					conf->psc_buf.bc_small_req_max_size +
+					SPTLRPC_MAX_PAYLOAD;
+		service->srv_small_buf_size = conf->psc_buf.bc_small_buf_size;
+	}
 	service->srv_rep_portal		= conf->psc_buf.bc_rep_portal;
 	service->srv_req_portal		= conf->psc_buf.bc_req_portal;
 
@@ -776,6 +830,10 @@ ptlrpc_register_service(struct ptlrpc_service_conf *conf,
 	service->srv_ctx_tags		= conf->psc_thr.tc_ctx_tags;
 	service->srv_hpreq_ratio	= PTLRPC_SVC_HP_RATIO;
 	service->srv_ops		= conf->psc_ops;
+	if (service->srv_ops.so_hpreq_handler != NULL)
+		service->srv_nthrs_cpt_hp = conf->psc_thr.tc_nthrs_hp != 0 ?
+					    conf->psc_thr.tc_nthrs_hp :
+					    PTLRPC_NTHRS_HP;
 
 	for (i = 0; i < ncpts; i++) {
 		if (!conf->psc_thr.tc_cpu_affinity)
@@ -864,6 +922,7 @@ void ptlrpc_server_drop_request(struct ptlrpc_request *req)
 	struct ptlrpc_request_buffer_desc *rqbd = req->rq_rqbd;
 	struct ptlrpc_service_part	  *svcpt = rqbd->rqbd_svcpt;
 	struct ptlrpc_service		  *svc = svcpt->scp_service;
+	struct ptlrpc_rqbd_pool		  *pool;
 	int				   refcount;
 	struct list_head			  *tmp;
 	struct list_head			  *nxt;
@@ -946,13 +1005,16 @@ void ptlrpc_server_drop_request(struct ptlrpc_request *req)
 			 * or free it to drain some in excess.
 			 */
 			LASSERT(atomic_read(&rqbd->rqbd_req.rq_refcount) == 0);
-			if (svcpt->scp_nrqbds_posted >=
-			    svc->srv_nbuf_per_group &&
+			pool = &svcpt->scp_rqbd_pools[rqbd->rqbd_class];
+			if (pool->rbp_nrqbds_posted >=
+			    ptlrpc_rqbd_nbufs(svc, rqbd->rqbd_class) &&
 			    !test_req_buffer_pressure) {
 				/* like in ptlrpc_free_rqbd() */
 				svcpt->scp_nrqbds_total--;
+				pool->rbp_nrqbds_total--;
 				OBD_FREE_LARGE(rqbd->rqbd_buffer,
-					       svc->srv_buf_size);
+					       ptlrpc_rqbd_buf_size(svc,
+							rqbd->rqbd_class));
 				OBD_FREE_PTR(rqbd);
 			} else {
 				list_add_tail(&rqbd->rqbd_list,
@@ -978,6 +1040,102 @@ void ptlrpc_server_drop_request(struct ptlrpc_request *req)
 	}
 }
 
+/**
+ * Create a server request for one of the requests carried by MDS_REINT_BATCH.
+ *
+ * The sub-request is a copy of the batch request \a req sharing its export,
+ * security context and service thread, but with its own request message
+ * \a msg, found inside the batch buffer, and its own reply state.  It is
+ * handled by the same thread as the batch and is never sent a reply of its
+ * own, see ptlrpc_send_reply().
+ *
+ * \param[in] req	MDS_REINT_BATCH request
+ * \param[in] msg	request message of the sub-request
+ * \param[in] len	length of \a msg
+ * \param[in] xid	XID the client assigned to the sub-request
+ *
+ * \retval		sub-request on success
+ * \retval		ERR_PTR(negative errno) on failure
+ */
+struct ptlrpc_request *ptlrpc_batch_subreq_alloc(struct ptlrpc_request *req,
+						 struct lustre_msg *msg,
+						 int len, __u64 xid)
+{
+	struct ptlrpc_request *sub;
+	int rc;
+
+	ENTRY;
+
+	sub = ptlrpc_request_cache_alloc(GFP_NOFS);
+	if (sub == NULL)
+		RETURN(ERR_PTR(-ENOMEM));
+
+	*sub = *req;
+	sub->rq_reply_state = NULL;
+	sub->rq_repmsg = NULL;
+	sub->rq_replen = 0;
+	sub->rq_req_swab_mask = 0;
+	sub->rq_rep_swab_mask = 0;
+	sub->rq_pack_bulk = 0;
+	sub->rq_pack_udesc = 0;
+	sub->rq_packed_final = 0;
+	sub->rq_at_linked = 0;
+	sub->rq_no_reply = 0;
+	sub->rq_transno = 0;
+	sub->rq_status = 0;
+	sub->rq_reqmsg = msg;
+	sub->rq_reqlen = len;
+	sub->rq_xid = xid;
+	sub->rq_batched = 1;
+	INIT_LIST_HEAD(&sub->rq_list);
+	INIT_LIST_HEAD(&sub->rq_timed_list);
+	INIT_LIST_HEAD(&sub->rq_exp_list);
+	INIT_LIST_HEAD(&sub->rq_history_list);
+	INIT_LIST_HEAD(&sub->rq_replay_list);
+	atomic_set(&sub->rq_refcount, 1);
+	sptlrpc_svc_ctx_addref(sub);
+	class_export_get(sub->rq_export);
+
+	rc = ptlrpc_unpack_req_msg(sub, len);
+	if (rc == 0)
+		rc = lustre_unpack_req_ptlrpc_body(sub, MSG_PTLRPC_BODY_OFF);
+	if (rc == 0 &&
+	    lustre_msg_get_type(sub->rq_reqmsg) != PTL_RPC_MSG_REQUEST)
+		rc = -EPROTO;
+	/* all the requests of a batch come from the same connection */
+	if (rc == 0 &&
+	    lustre_msg_get_handle(sub->rq_reqmsg)->cookie !=
+	    lustre_msg_get_handle(req->rq_reqmsg)->cookie)
+		rc = -EPROTO;
+	if (rc != 0) {
+		DEBUG_REQ(D_ERROR, req, "bad batched request x%llu: rc = %d",
+			  xid, rc);
+		ptlrpc_batch_subreq_free(sub);
+		RETURN(ERR_PTR(rc));
+	}
+
+	RETURN(sub);
+}
+EXPORT_SYMBOL(ptlrpc_batch_subreq_alloc);
+
+/**
+ * Release a sub-request created by ptlrpc_batch_subreq_alloc().
+ *
+ * The reply state of a sub-request saving reply locks is kept alive by
+ * the reply handling threads until the locks can be released.
+ */
+void ptlrpc_batch_subreq_free(struct ptlrpc_request *sub)
+{
+	LASSERT(sub->rq_batched);
+	LASSERT(atomic_dec_and_test(&sub->rq_refcount));
+
+	ptlrpc_req_drop_rs(sub);
+	sptlrpc_svc_ctx_decref(sub);
+	class_export_put(sub->rq_export);
+	ptlrpc_request_cache_free(sub);
+}
+EXPORT_SYMBOL(ptlrpc_batch_subreq_free);
+
 /** Change request export and move hp request from old export to new */
 void ptlrpc_request_change_export(struct ptlrpc_request *req,
 				  struct obd_export *export)
@@ -1751,10 +1909,10 @@ static bool ptlrpc_server_high_pending(struct ptlrpc_service_part *svcpt,
 
 /**
  * Only allow normal priority requests on a service that has a high-priority
- * queue if forced (i.e. cleanup), if there are other high priority requests
- * already being processed (i.e. those threads can service more high-priority
- * requests), or if there are enough idle threads that a later thread can do
- * a high priority request.
+ * queue if forced (i.e. cleanup), or if fewer normal requests are being
+ * processed than there are threads outside of the
+ * ptlrpc_service::srv_nthrs_cpt_hp ones kept for high priority requests, so
+ * that a later thread can always do a high priority request.
  * User can call it w/o any lock but need to hold
  * ptlrpc_service_part::scp_req_lock to get reliable result
  */
@@ -1776,13 +1934,14 @@ static bool ptlrpc_server_allow_normal(struct ptlrpc_service_part *svcpt,
 	if (ptlrpc_nrs_req_throttling_nolock(svcpt, false))
 		return false;
 
-	if (svcpt->scp_nreqs_active < running - 2)
-		return true;
-
 	if (svcpt->scp_nreqs_active >= running - 1)
 		return false;
 
-	return svcpt->scp_nhreqs_active > 0 || !nrs_svcpt_has_hp(svcpt);
+	if (!nrs_svcpt_has_hp(svcpt))
+		return true;
+
+	return svcpt->scp_nreqs_active - svcpt->scp_nhreqs_active <
+	       running - 1 - svcpt->scp_service->srv_nthrs_cpt_hp;
 }
 
 static bool ptlrpc_server_normal_pending(struct ptlrpc_service_part *svcpt,
@@ -2004,6 +2163,14 @@ ptlrpc_server_handle_req_in(struct ptlrpc_service_part *svcpt,
 
 	ptlrpc_at_add_timed(req);
 
+	req->rq_srv.sr_enqueue_time = ktime_get_real();
+	ptlrpc_lprocfs_lat_tally(svcpt->scp_service->srv_lat_stats,
+				 lustre_msg_get_opc(req->rq_reqmsg),
+				 PTLRPC_LAT_REQ_IN,
+				 ktime_us_delta(req->rq_srv.sr_enqueue_time,
+				       timespec64_to_ktime(req->rq_arrival_time)),
+				 true);
+
 	/* Move it over to the request processing queue */
 	rc = ptlrpc_server_request_add(svcpt, req);
 	if (rc)
@@ -2059,9 +2226,14 @@ ptlrpc_server_handle_request(struct ptlrpc_service_part *svcpt,
 	work_start = ktime_get_real();
 	arrived = timespec64_to_ktime(request->rq_arrival_time);
 	timediff_usecs = ktime_us_delta(work_start, arrived);
+	svcpt->scp_req_wait = timediff_usecs;
 	if (likely(svc->srv_stats != NULL)) {
                 lprocfs_counter_add(svc->srv_stats, PTLRPC_REQWAIT_CNTR,
 				    timediff_usecs);
+		if (request->rq_hp)
+			lprocfs_counter_add(svc->srv_stats,
+					    PTLRPC_REQHPWAIT_CNTR,
+					    timediff_usecs);
                 lprocfs_counter_add(svc->srv_stats, PTLRPC_REQQDEPTH_CNTR,
 				    svcpt->scp_nreqs_incoming);
 		lprocfs_counter_add(svc->srv_stats, PTLRPC_REQACTIVE_CNTR,
@@ -2069,6 +2241,12 @@ ptlrpc_server_handle_request(struct ptlrpc_service_part *svcpt,
 		lprocfs_counter_add(svc->srv_stats, PTLRPC_TIMEOUT,
 				    at_get(&svcpt->scp_at_estimate));
         }
+	ptlrpc_lprocfs_lat_tally(svc->srv_lat_stats,
+				 lustre_msg_get_opc(request->rq_reqmsg),
+				 PTLRPC_LAT_QUEUED,
+				 ktime_us_delta(work_start,
+					request->rq_srv.sr_enqueue_time),
+				 true);
 
 	if (likely(request->rq_export)) {
 		if (unlikely(ptlrpc_check_req(request)))
@@ -2153,6 +2331,11 @@ put_conn:
 					    timediff_usecs);
                 }
         }
+	if (request->rq_reqmsg != NULL)
+		ptlrpc_lprocfs_lat_tally(svc->srv_lat_stats,
+					 lustre_msg_get_opc(request->rq_reqmsg),
+					 PTLRPC_LAT_HANDLE, timediff_usecs,
+					 true);
         if (unlikely(request->rq_early_count)) {
                 DEBUG_REQ(D_ADAPTTO, request,
 			  "sent %d early replies before finishing in %llds",
@@ -2322,18 +2505,19 @@ static void
 ptlrpc_check_rqbd_pool(struct ptlrpc_service_part *svcpt)
 {
 	int avail = svcpt->scp_nrqbds_posted;
-	int low_water = test_req_buffer_pressure ? 0 :
-			svcpt->scp_service->srv_nbuf_per_group / 2;
-
-        /* NB I'm not locking; just looking. */
+	int cls;
 
         /* CAVEAT EMPTOR: We might be allocating buffers here because we've
          * allowed the request history to grow out of control.  We could put a
          * sanity check on that here and cull some history if we need the
          * space. */
 
-        if (avail <= low_water)
-		ptlrpc_grow_req_bufs(svcpt, 1);
+	for (cls = 0; cls < PTLRPC_RQBD_NCLASS; cls++) {
+		if (ptlrpc_rqbd_pool_low(svcpt, cls)) {
+			ptlrpc_grow_req_bufs(svcpt, 1);
+			break;
+		}
+	}
 
 	if (svcpt->scp_service->srv_stats) {
 		lprocfs_counter_add(svcpt->scp_service->srv_stats,
@@ -2355,7 +2539,7 @@ ptlrpc_threads_enough(struct ptlrpc_service_part *svcpt)
 {
 	return svcpt->scp_nreqs_active <
 	       svcpt->scp_nthrs_running - 1 -
-	       (svcpt->scp_service->srv_ops.so_hpreq_handler != NULL);
+	       svcpt->scp_service->srv_nthrs_cpt_hp;
 }
 
 /**
@@ -2372,13 +2556,118 @@ ptlrpc_threads_increasable(struct ptlrpc_service_part *svcpt)
 }
 
 /**
- * too many requests and allowed to create more threads
+ * requests are queued long enough, or in large enough numbers, for another
+ * thread to help: the last request handled waited longer than
+ * ptlrpc_service::srv_thrs_grow_wait, or more requests are queued than there
+ * are threads to handle them
+ */
+static inline int
+ptlrpc_threads_queue_busy(struct ptlrpc_service_part *svcpt)
+{
+	int wait = svcpt->scp_service->srv_thrs_grow_wait;
+
+	return wait == 0 ||
+	       svcpt->scp_req_wait >= (s64)wait * USEC_PER_MSEC ||
+	       svcpt->scp_nreqs_incoming +
+	       svcpt->scp_nrs_reg.nrs_req_queued >= svcpt->scp_nthrs_running;
+}
+
+/**
+ * Utilization of the CPUs the partition runs on, sampled at most once a
+ * second. Time spent waiting on I/O counts as idle, as service threads
+ * sleeping on the disk leave the CPU to others.
+ *
+ * \param[in] svcpt	service partition
+ *
+ * \retval		utilization in percent over the last sample period
+ */
+static int ptlrpc_svcpt_cpu_busy(struct ptlrpc_service_part *svcpt)
+{
+	struct ptlrpc_service	*svc = svcpt->scp_service;
+	u64			 now = ktime_to_us(ktime_get());
+	u64			 idle = 0;
+	u64			 elapsed;
+	int			 ncpus = 0;
+	int			 cpu;
+
+	if (now - svcpt->scp_cpu_stamp < USEC_PER_SEC)
+		return svcpt->scp_cpu_busy;
+
+	spin_lock(&svcpt->scp_lock);
+	if (now - svcpt->scp_cpu_stamp < USEC_PER_SEC)
+		goto out;
+
+	for_each_cpu(cpu, cfs_cpt_cpumask(svc->srv_cptable, svcpt->scp_cpt)) {
+		u64 time = get_cpu_idle_time_us(cpu, NULL);
+
+		/* no idle accounting without NOHZ, assume CPUs are free */
+		if (time == -1ULL) {
+			ncpus = 0;
+			break;
+		}
+		idle += time;
+		time = get_cpu_iowait_time_us(cpu, NULL);
+		if (time != -1ULL)
+			idle += time;
+		ncpus++;
+	}
+
+	if (ncpus == 0) {
+		svcpt->scp_cpu_busy = 0;
+	} else if (svcpt->scp_cpu_stamp != 0 && idle >= svcpt->scp_cpu_idle) {
+		elapsed = (now - svcpt->scp_cpu_stamp) * ncpus;
+		idle -= svcpt->scp_cpu_idle;
+		svcpt->scp_cpu_busy = idle >= elapsed ? 0 :
+				      100 - div64_u64(idle * 100, elapsed);
+		idle += svcpt->scp_cpu_idle;
+	}
+	svcpt->scp_cpu_idle = idle;
+	svcpt->scp_cpu_stamp = now;
+out:
+	spin_unlock(&svcpt->scp_lock);
+
+	return svcpt->scp_cpu_busy;
+}
+
+/**
+ * too many requests and allowed to create more threads; threads beyond
+ * ptlrpc_service::srv_nthrs_cpt_init are only added when requests wait
+ * for them and the CPUs of the partition are not saturated already
  */
 static inline int
 ptlrpc_threads_need_create(struct ptlrpc_service_part *svcpt)
 {
-	return !ptlrpc_threads_enough(svcpt) &&
-		ptlrpc_threads_increasable(svcpt);
+	struct ptlrpc_service *svc = svcpt->scp_service;
+
+	if (ptlrpc_threads_enough(svcpt) || !ptlrpc_threads_increasable(svcpt))
+		return 0;
+
+	if (svcpt->scp_nthrs_running + svcpt->scp_nthrs_starting <
+	    svc->srv_nthrs_cpt_init)
+		return 1;
+
+	return ptlrpc_threads_queue_busy(svcpt) &&
+	       (svc->srv_thrs_cpu_max >= 100 ||
+		ptlrpc_svcpt_cpu_busy(svcpt) < svc->srv_thrs_cpu_max);
+}
+
+/**
+ * An idle thread may exit as long as ptlrpc_service::srv_nthrs_cpt_init
+ * threads are left running in the partition.
+ */
+static int ptlrpc_thread_retire(struct ptlrpc_service_part *svcpt)
+{
+	int rc = 0;
+
+	spin_lock(&svcpt->scp_lock);
+	if (svcpt->scp_nthrs_running - svcpt->scp_nthrs_stopping >
+	    svcpt->scp_service->srv_nthrs_cpt_init) {
+		svcpt->scp_nthrs_stopping++;
+		rc = 1;
+	}
+	spin_unlock(&svcpt->scp_lock);
+
+	return rc;
 }
 
 static inline int
@@ -2412,19 +2701,57 @@ ptlrpc_server_request_incoming(struct ptlrpc_service_part *svcpt)
 	return !list_empty(&svcpt->scp_req_incoming);
 }
 
+/**
+ * Whether the replies queued on \a svcpt are to be sent now: either no more
+ * requests are waiting, or the oldest reply has waited long enough.
+ */
+static bool ptlrpc_reply_batch_due(struct ptlrpc_service_part *svcpt)
+{
+	struct ptlrpc_service *svc = svcpt->scp_service;
+
+	if (ACCESS_ONCE(svcpt->scp_rep_batch_count) == 0)
+		return false;
+
+	if (!ptlrpc_server_request_incoming(svcpt) &&
+	    !ptlrpc_server_request_pending(svcpt, false))
+		return true;
+
+	return ktime_us_delta(ktime_get(), svcpt->scp_rep_batch_start) >=
+	       ACCESS_ONCE(svc->srv_reply_batch_usec);
+}
+
+/**
+ * Waits for something to do.
+ *
+ * \retval 0		there may be work to do
+ * \retval -EINTR	the thread is to be stopped
+ * \retval -ETIMEDOUT	the thread was idle for too long, and is to exit
+ */
 static __attribute__((__noinline__)) int
 ptlrpc_wait_event(struct ptlrpc_service_part *svcpt,
 		  struct ptlrpc_thread *thread)
 {
+	struct ptlrpc_service *svc = svcpt->scp_service;
 	/* Don't exit while there are replies to be handled */
 	struct l_wait_info lwi = LWI_TIMEOUT(svcpt->scp_rqbd_timeout,
 					     ptlrpc_retry_rqbds, svcpt);
+	int idle = svc->srv_thrs_idle_timeout;
+	int rc;
+
+	/* threads are woken up LIFO, so the extra ones are left idle */
+	if (svcpt->scp_rqbd_timeout == 0 && idle > 0 &&
+	    svcpt->scp_nthrs_running > svc->srv_nthrs_cpt_init)
+		lwi = LWI_TIMEOUT(cfs_time_seconds(idle), NULL, NULL);
+
+	/* do not keep replies queued while going to sleep */
+	if (ptlrpc_reply_batch_due(svcpt))
+		ptlrpc_reply_batch_flush(svcpt);
 
 	lc_watchdog_disable(thread->t_watchdog);
 
 	cond_resched();
 
-	l_wait_event_exclusive_head(svcpt->scp_waitq,
+	rc = l_wait_event_exclusive_head(svcpt->scp_waitq,
 				ptlrpc_thread_stopping(thread) ||
 				ptlrpc_server_request_incoming(svcpt) ||
 				ptlrpc_server_request_pending(svcpt, false) ||
@@ -2434,6 +2761,16 @@ ptlrpc_wait_event(struct ptlrpc_service_part *svcpt,
 	if (ptlrpc_thread_stopping(thread))
 		return -EINTR;
 
+	/* a wakeup may have come along with the timeout, do not lose it */
+	if (rc == -ETIMEDOUT && lwi.lwi_on_timeout == NULL &&
+	    !ptlrpc_server_request_incoming(svcpt) &&
+	    !ptlrpc_server_request_pending(svcpt, false) &&
+	    ptlrpc_thread_retire(svcpt)) {
+		CDEBUG(D_RPCTRACE, "%s: idle for %ds, exiting\n",
+		       thread->t_name, idle);
+		return -ETIMEDOUT;
+	}
+
 	lc_watchdog_touch(thread->t_watchdog,
 			  ptlrpc_server_get_timeout(svcpt));
 	return 0;
@@ -2453,6 +2790,7 @@ static int ptlrpc_main(void *arg)
 	struct ptlrpc_reply_state	*rs;
 	struct group_info *ginfo = NULL;
 	struct lu_env *env;
+	bool retired = false;
 	int counter = 0, rc = 0;
 	ENTRY;
 
@@ -2547,8 +2885,12 @@ static int ptlrpc_main(void *arg)
 
 	/* XXX maintain a list of all managed devices: insert here */
 	while (!ptlrpc_thread_stopping(thread)) {
-		if (ptlrpc_wait_event(svcpt, thread))
+		rc = ptlrpc_wait_event(svcpt, thread);
+		if (rc != 0) {
+			retired = rc == -ETIMEDOUT;
+			rc = 0;
 			break;
+		}
 
 		ptlrpc_check_rqbd_pool(svcpt);
 
@@ -2591,9 +2933,26 @@ static int ptlrpc_main(void *arg)
                 }
         }
 
+	/* nobody else may be left to send the replies this thread queued */
+	ptlrpc_reply_batch_flush(svcpt);
+
         lc_watchdog_delete(thread->t_watchdog);
         thread->t_watchdog = NULL;
 
+	if (retired) {
+		/* give back the reply state allocated for this thread */
+		rs = NULL;
+		spin_lock(&svcpt->scp_rep_lock);
+		if (!list_empty(&svcpt->scp_rep_idle)) {
+			rs = list_entry(svcpt->scp_rep_idle.next,
+					struct ptlrpc_reply_state, rs_list);
+			list_del(&rs->rs_list);
+		}
+		spin_unlock(&svcpt->scp_rep_lock);
+		if (rs != NULL)
+			OBD_FREE_LARGE(rs, svc->srv_max_reply_size);
+	}
+
 out_srv_fini:
         /*
          * deconstruct service specific state created by ptlrpc_start_thread()
@@ -2618,6 +2977,17 @@ out:
 		svcpt->scp_nthrs_running--;
 	}
 
+	if (retired) {
+		svcpt->scp_nthrs_stopping--;
+		/* nobody waits for a thread that was not asked to stop */
+		if (!thread_is_stopping(thread)) {
+			list_del(&thread->t_link);
+			spin_unlock(&svcpt->scp_lock);
+			OBD_FREE_PTR(thread);
+			return rc;
+		}
+	}
+
 	thread->t_id = rc;
 	thread_add_flags(thread, SVC_STOPPED);
 
@@ -3066,6 +3436,22 @@ ptlrpc_service_del_atimer(struct ptlrpc_service *svc)
 	}
 }
 
+/* the threads are stopped, send what they left queued and stop the work */
+static void
+ptlrpc_service_flush_replies(struct ptlrpc_service *svc)
+{
+	struct ptlrpc_service_part	*svcpt;
+	int				i;
+
+	ptlrpc_service_for_each_part(svcpt, i, svc) {
+		if (svcpt->scp_service == NULL)
+			break;
+
+		cancel_delayed_work_sync(&svcpt->scp_rep_batch_work);
+		ptlrpc_reply_batch_flush(svcpt);
+	}
+}
+
 static void
 ptlrpc_service_unlink_rqbd(struct ptlrpc_service *svc)
 {
@@ -3243,6 +3629,7 @@ int ptlrpc_unregister_service(struct ptlrpc_service *service)
 
 	ptlrpc_service_del_atimer(service);
 	ptlrpc_stop_all_threads(service);
+	ptlrpc_service_flush_replies(service);
 
 	ptlrpc_service_unlink_rqbd(service);
 	ptlrpc_service_purge_all(service);
@@ -721,6 +721,12 @@ static void tgt_grant_check(const struct lu_env *env, struct obd_export *exp,
 		skip = true;
 		CDEBUG(D_CACHE, "Recoverable resend arrived, skipping "
 				"accounting\n");
+	} else if (tgt_grant_claimed(env)) {
+		/* Object of a multi-object write, its grant was accounted with
+		 * the first object of the RPC */
+		skip = true;
+		CDEBUG(D_CACHE, "Grant claimed by the RPC, skipping "
+				"accounting\n");
 	} else if (exp_grant_param_supp(exp) && oa->o_grant_used > 0) {
 		/* Client supports the new grant parameters and is telling us
 		 * how much grant space it consumed for this bulk write.
@@ -187,12 +187,46 @@ out:
 }
 EXPORT_SYMBOL(tgt_validate_obdo);
 
+/**
+ * Validate an additional object of a multi-object BRW write.
+ *
+ * Only FID-capable clients can send such requests, so unlike
+ * tgt_validate_obdo() there is no compatibility to care about: the ost_id
+ * must map to a valid OST object FID, which is stored back into \a ioo.
+ */
+static int tgt_validate_ioobj(struct tgt_session_info *tsi,
+			      struct obd_ioobj *ioo)
+{
+	struct tgt_thread_info	*tti = tgt_th_info(tsi->tsi_env);
+	struct ost_id		*oi = &ioo->ioo_oid;
+	u64			 seq = ostid_seq(oi);
+	int			 rc;
+
+	if (unlikely(!(fid_seq_is_idif(seq) || fid_seq_is_mdt0(seq) ||
+		       fid_seq_is_norm(seq))))
+		GOTO(out, rc = -EPROTO);
+
+	rc = ostid_to_fid(&tti->tti_fid1, oi,
+			  tsi->tsi_tgt->lut_lsd.lsd_osd_index);
+	if (unlikely(rc != 0))
+		GOTO(out, rc);
+
+	oi->oi_fid = tti->tti_fid1;
+	return 0;
+out:
+	CERROR("%s: client %s sent bad object "DOSTID": rc = %d\n",
+	       tgt_name(tsi->tsi_tgt), obd_export_nid2str(tsi->tsi_exp),
+	       POSTID(oi), rc);
+	return rc;
+}
+
 static int tgt_io_data_unpack(struct tgt_session_info *tsi, struct ost_id *oi)
 {
 	unsigned		 max_brw;
 	struct niobuf_remote	*rnb;
 	struct obd_ioobj	*ioo;
 	int			 obj_count;
+	int			 i;
 
 	ENTRY;
 
@@ -223,22 +257,37 @@ static int tgt_io_data_unpack(struct tgt_session_info *tsi, struct ost_id *oi)
 	if (obj_count == 0) {
 		CERROR("%s: short ioobj\n", tgt_name(tsi->tsi_tgt));
 		RETURN(-EPROTO);
-	} else if (obj_count > 1) {
+	} else if (obj_count > 1 &&
+		   (!exp_connect_multiobj_brw(tsi->tsi_exp) ||
+		    lustre_msg_get_opc(tgt_ses_req(tsi)->rq_reqmsg) !=
+		    OST_WRITE || obj_count > PTLRPC_MAX_BRW_OBJS)) {
 		CERROR("%s: too many ioobjs (%d)\n", tgt_name(tsi->tsi_tgt),
 		       obj_count);
 		RETURN(-EPROTO);
 	}
 
-	if (ioo->ioo_bufcnt == 0) {
-		CERROR("%s: ioo has zero bufcnt\n", tgt_name(tsi->tsi_tgt));
-		RETURN(-EPROTO);
-	}
+	for (i = 0; i < obj_count; i++) {
+		if (ioo[i].ioo_bufcnt == 0) {
+			CERROR("%s: ioo has zero bufcnt\n",
+			       tgt_name(tsi->tsi_tgt));
+			RETURN(-EPROTO);
+		}
 
-	if (ioo->ioo_bufcnt > PTLRPC_MAX_BRW_PAGES) {
-		DEBUG_REQ(D_RPCTRACE, tgt_ses_req(tsi),
-			  "bulk has too many pages (%d)",
-			  ioo->ioo_bufcnt);
-		RETURN(-EPROTO);
+		if (ioo[i].ioo_bufcnt > PTLRPC_MAX_BRW_PAGES) {
+			DEBUG_REQ(D_RPCTRACE, tgt_ses_req(tsi),
+				  "bulk has too many pages (%d)",
+				  ioo[i].ioo_bufcnt);
+			RETURN(-EPROTO);
+		}
+
+		/* the first object was validated with the ost_body, the
+		 * others of a multi-object write are checked here */
+		if (i > 0) {
+			int rc = tgt_validate_ioobj(tsi, &ioo[i]);
+
+			if (rc != 0)
+				RETURN(rc);
+		}
 	}
 
 	RETURN(0);
@@ -844,6 +893,21 @@ int tgt_hpreq_handler(struct ptlrpc_request *req)
 }
 EXPORT_SYMBOL(tgt_hpreq_handler);
 
+/**
+ * Assign high priority operations to a request of the main OST service.
+ *
+ * Glimpses get them from tgt_hpreq_handler(), pings and reconnects from
+ * ptlrpc_hpreq_handler() as on the other services.
+ */
+int tgt_ost_hpreq_handler(struct ptlrpc_request *req)
+{
+	if (lustre_msg_get_opc(req->rq_reqmsg) == LDLM_ENQUEUE)
+		return tgt_hpreq_handler(req);
+
+	return ptlrpc_hpreq_handler(req);
+}
+EXPORT_SYMBOL(tgt_ost_hpreq_handler);
+
 void tgt_counter_incr(struct obd_export *exp, int opcode)
 {
 	lprocfs_counter_incr(exp->exp_obd->obd_stats, opcode);
@@ -1348,9 +1412,42 @@ int tgt_cp_callback(struct tgt_session_info *tsi)
 	return err_serious(-EOPNOTSUPP);
 }
 
+static int tgt_glimpse_hpreq_check(struct ptlrpc_request *req)
+{
+	return 1;
+}
+
+static struct ptlrpc_hpreq_ops tgt_hpreq_glimpse = {
+	.hpreq_check	= tgt_glimpse_hpreq_check,
+};
+
+/**
+ * Assign high priority operations to a glimpse.
+ *
+ * An intent enqueue of an extent lock is a glimpse: it is answered from the
+ * object attributes without granting any lock, while the client waits for
+ * the file size. It must not queue behind the other requests of the
+ * service.
+ *
+ * \param[in] tsi	target session environment for this request
+ */
+static void tgt_hp_enqueue(struct tgt_session_info *tsi)
+{
+	struct ldlm_request *dlm_req = tsi->tsi_dlm_req;
+
+	if (dlm_req == NULL ||
+	    dlm_req->lock_desc.l_resource.lr_type != LDLM_EXTENT ||
+	    !(dlm_req->lock_flags & LDLM_FL_HAS_INTENT) ||
+	    lustre_msg_get_flags(tgt_ses_req(tsi)->rq_reqmsg) & MSG_REPLAY)
+		return;
+
+	tgt_ses_req(tsi)->rq_ops = &tgt_hpreq_glimpse;
+}
+
 /* generic LDLM target handler */
 struct tgt_handler tgt_dlm_handlers[] = {
-TGT_DLM_HDL    (HABEO_CLAVIS,	LDLM_ENQUEUE,		tgt_enqueue),
+TGT_DLM_HDL_HP (HABEO_CLAVIS,	LDLM_ENQUEUE,		tgt_enqueue,
+		tgt_hp_enqueue),
 TGT_DLM_HDL_VAR(HABEO_CLAVIS,	LDLM_CONVERT,		tgt_convert),
 TGT_DLM_HDL_VAR(0,		LDLM_BL_CALLBACK,	tgt_bl_callback),
 TGT_DLM_HDL_VAR(0,		LDLM_CP_CALLBACK,	tgt_cp_callback)
@@ -2727,7 +2824,9 @@ skip_transfer:
 		ptlrpc_lprocfs_brw(req, nob);
 	}
 
-	/* Decompression */
+	/* Decompression. With a privacy flavor target_bulk_io() has already
+	 * decrypted the bulk in place, so only the psize bytes transferred
+	 * were deciphered and are now expanded to the logical pages. */
 	p = decompress_data(OBD_BRW_WRITE, c_npages, local_nb, chunks, cdesc, plens);
 	if (p != 0)
 			RETURN(-1);
@@ -2776,6 +2875,162 @@ out:
 	RETURN(rc);
 }
 
+/* per-object state of a multi-object BRW write */
+struct tgt_brw_obj {
+	struct obdo		 tbo_oa;	/* private obdo, objects > 0 */
+	struct obdo		*tbo_oap;	/* obdo used for this object */
+	struct niobuf_remote	*tbo_rnb;
+	struct niobuf_local	*tbo_lnb;
+	int			 tbo_npages;
+};
+
+/**
+ * Prepare local buffers for a write RPC carrying several objects.
+ *
+ * Objects are prepared one after another with obd_preprw() into consecutive
+ * slots of \a lnb, so that the bulk transfer and the checksum are done once
+ * for the whole RPC.  The first object uses the reply obdo \a oa, the others
+ * get a private copy pointing to their own object.
+ *
+ * Grant is claimed by the client for the whole RPC, so it is accounted
+ * together with the first object; tgt_session_info::tsi_grant_claimed tells
+ * tgt_grant_prepare_write() to skip it for the others.
+ *
+ * \param[in] tsi	target session environment
+ * \param[in] oa	reply obdo, already filled from the request
+ * \param[in] objcount	number of objects
+ * \param[in] ioo	array of objects
+ * \param[in] rnb	remote buffers of all objects
+ * \param[in] lnb	local buffers to fill
+ * \param[in] bobj	per-object state
+ * \param[in,out] npages	local buffers available / used
+ *
+ * \retval		0 on success, all objects are prepared
+ * \retval		negative value on error, nothing is left prepared
+ */
+static int tgt_brw_prep_multi(struct tgt_session_info *tsi, struct obdo *oa,
+			      int objcount, struct obd_ioobj *ioo,
+			      struct niobuf_remote *rnb,
+			      struct niobuf_local *lnb,
+			      struct tgt_brw_obj *bobj, int *npages)
+{
+	struct obd_export	*exp = tsi->tsi_exp;
+	bool			 grant_claimed;
+	int			 niocount = 0;
+	int			 left = *npages;
+	int			 total = 0;
+	int			 i, rc = 0;
+
+	ENTRY;
+
+	/* local buffers are shared by all objects, check they all fit */
+	for (i = 0; i < objcount; i++)
+		niocount += ioo[i].ioo_bufcnt;
+	for (i = 0; i < niocount; i++) {
+		if (rnb[i].rnb_flags & OBD_BRW_SRVLOCK)
+			RETURN(-EPROTO);
+		total += ((rnb[i].rnb_offset + rnb[i].rnb_len - 1) >>
+			  PAGE_SHIFT) - (rnb[i].rnb_offset >> PAGE_SHIFT) + 1;
+	}
+	if (total > left)
+		RETURN(-EPROTO);
+
+	grant_claimed = exp_grant_param_supp(exp) && oa->o_grant_used > 0;
+	for (i = 0; i < objcount; i++) {
+		struct tgt_brw_obj *tbo = &bobj[i];
+
+		if (i == 0) {
+			tbo->tbo_oap = oa;
+		} else {
+			struct obdo *toa = &tbo->tbo_oa;
+
+			*toa = *oa;
+			toa->o_oi = ioo[i].ioo_oid;
+			/* incoming grant, parent FID, layout version and
+			 * timestamps describe the first object only */
+			toa->o_valid &= ~(OBD_MD_FLGRANT | OBD_MD_FLFID |
+					  OBD_MD_LAYOUT_VERSION |
+					  OBD_MD_FLATIME | OBD_MD_FLMTIME |
+					  OBD_MD_FLCTIME);
+			toa->o_grant_used = 0;
+			tsi->tsi_grant_claimed = grant_claimed;
+			tbo->tbo_oap = toa;
+		}
+
+		tbo->tbo_rnb = rnb;
+		tbo->tbo_lnb = lnb;
+		tbo->tbo_npages = left;
+		rc = obd_preprw(tsi->tsi_env, OBD_BRW_WRITE, exp,
+				tbo->tbo_oap, 1, &ioo[i], rnb,
+				&tbo->tbo_npages, lnb, NULL);
+		if (rc < 0)
+			break;
+
+		rnb += ioo[i].ioo_bufcnt;
+		lnb += tbo->tbo_npages;
+		left -= tbo->tbo_npages;
+	}
+	tsi->tsi_grant_claimed = false;
+
+	if (rc < 0) {
+		/* release the objects already prepared */
+		while (--i >= 0)
+			obd_commitrw(tsi->tsi_env, OBD_BRW_WRITE, exp,
+				     bobj[i].tbo_oap, 1, &ioo[i],
+				     bobj[i].tbo_rnb, bobj[i].tbo_npages,
+				     bobj[i].tbo_lnb, rc);
+		RETURN(rc);
+	}
+
+	*npages -= left;
+	RETURN(0);
+}
+
+/**
+ * Commit all objects of a write prepared by tgt_brw_prep_multi().
+ *
+ * Every object must be committed, even after an error, to release its
+ * resources.  Over-quota state of any object is reported back to the
+ * client in the reply obdo.
+ *
+ * \retval		0 on success
+ * \retval		first error met otherwise
+ */
+static int tgt_brw_commit_multi(struct tgt_session_info *tsi,
+				struct obdo *oa, int objcount,
+				struct obd_ioobj *ioo,
+				struct tgt_brw_obj *bobj, int old_rc)
+{
+	__u32	quota_flags = 0;
+	int	result = 0;
+	int	i, rc;
+
+	for (i = 0; i < objcount; i++) {
+		struct tgt_brw_obj *tbo = &bobj[i];
+
+		rc = obd_commitrw(tsi->tsi_env, OBD_BRW_WRITE, tsi->tsi_exp,
+				  tbo->tbo_oap, 1, &ioo[i], tbo->tbo_rnb,
+				  tbo->tbo_npages, tbo->tbo_lnb, old_rc);
+		if (rc != 0 && result == 0)
+			result = rc;
+
+		if (tbo->tbo_oap->o_valid & OBD_MD_FLFLAGS)
+			quota_flags |= tbo->tbo_oap->o_flags &
+				       (OBD_FL_NO_USRQUOTA |
+					OBD_FL_NO_GRPQUOTA |
+					OBD_FL_NO_PRJQUOTA);
+	}
+
+	if (quota_flags != 0) {
+		if (!(oa->o_valid & OBD_MD_FLFLAGS))
+			oa->o_flags = 0;
+		oa->o_flags |= quota_flags;
+		oa->o_valid |= OBD_MD_FLFLAGS | OBD_MD_FLALLQUOTA;
+	}
+
+	return result;
+}
+
 int tgt_brw_write(struct tgt_session_info *tsi)
 {
 	struct ptlrpc_request	*req = tgt_ses_req(tsi);
@@ -2794,6 +3049,7 @@ int tgt_brw_write(struct tgt_session_info *tsi)
 	bool			 no_reply = false, mmap;
 	struct tgt_thread_big_cache *tbc = req->rq_svc_thread->t_data;
 	bool wait_sync = false;
+	struct tgt_brw_obj	*bobj = NULL;
 
 	struct chunk_desc *cdesc = NULL;
 
@@ -2812,6 +3068,12 @@ int tgt_brw_write(struct tgt_session_info *tsi)
 		cdesc = req_capsule_client_get(tsi->tsi_pill, &RMF_CHUNK_DESC);
 		if (cdesc != NULL)
 		{
+			/* compressed writes carry a single object */
+			if (cdesc[0].algo == L_COMPRESS_LZ4 &&
+			    req_capsule_get_size(&req->rq_pill,
+						 &RMF_OBD_IOOBJ, RCL_CLIENT) >
+			    sizeof(struct obd_ioobj))
+				RETURN(err_serious(-EPROTO));
 			if (cdesc[0].algo == L_COMPRESS_LZ4)
 				return tgt_brw_write_compressed(tsi);
 		}
@@ -2873,6 +3135,12 @@ int tgt_brw_write(struct tgt_session_info *tsi)
 
 	local_nb = tbc->local;
 
+	if (objcount > 1) {
+		OBD_ALLOC(bobj, sizeof(*bobj) * objcount);
+		if (bobj == NULL)
+			GOTO(out, rc = -ENOMEM);
+	}
+
 	rc = tgt_brw_lock(exp, &tsi->tsi_resid, ioo,
 			  remote_nb, &lockh, LCK_PW);
 	if (rc != 0)
@@ -2908,8 +3176,13 @@ int tgt_brw_write(struct tgt_session_info *tsi)
 	repbody->oa = body->oa;
 
 	npages = PTLRPC_MAX_BRW_PAGES;
-	rc = obd_preprw(tsi->tsi_env, OBD_BRW_WRITE, exp, &repbody->oa,
-			objcount, ioo, remote_nb, &npages, local_nb, NULL);
+	if (bobj != NULL)
+		rc = tgt_brw_prep_multi(tsi, &repbody->oa, objcount, ioo,
+					remote_nb, local_nb, bobj, &npages);
+	else
+		rc = obd_preprw(tsi->tsi_env, OBD_BRW_WRITE, exp,
+				&repbody->oa, objcount, ioo, remote_nb,
+				&npages, local_nb, NULL);
 	if (rc < 0)
 		GOTO(out_lock, rc);
 	if (body->oa.o_flags & OBD_FL_SHORT_IO) {
@@ -2986,8 +3259,13 @@ skip_transfer:
 	}
 
 	/* Must commit after prep above in all cases */
-	rc = obd_commitrw(tsi->tsi_env, OBD_BRW_WRITE, exp, &repbody->oa,
-			  objcount, ioo, remote_nb, npages, local_nb, rc);
+	if (bobj != NULL)
+		rc = tgt_brw_commit_multi(tsi, &repbody->oa, objcount, ioo,
+					  bobj, rc);
+	else
+		rc = obd_commitrw(tsi->tsi_env, OBD_BRW_WRITE, exp,
+				  &repbody->oa, objcount, ioo, remote_nb,
+				  npages, local_nb, rc);
 	if (rc == -ENOTCONN)
 		/* quota acquire process has been given up because
 		 * either the client has been evicted or the client
@@ -3034,6 +3312,8 @@ out_lock:
 	if (desc)
 		ptlrpc_free_bulk(desc);
 out:
+	if (bobj != NULL)
+		OBD_FREE(bobj, sizeof(*bobj) * objcount);
 	if (unlikely(no_reply || (exp->exp_obd->obd_no_transno && wait_sync))) {
 		req->rq_no_reply = 1;
 		/* reply out callback would free */
@@ -3050,6 +3330,227 @@ out:
 }
 EXPORT_SYMBOL(tgt_brw_write);
 
+/**
+ * Handle one request carried by an MDS_REINT_BATCH RPC.
+ *
+ * The request goes through the checks of a request received alone and is
+ * then handled by the regular handler of its opcode in the session of the
+ * batch, with a transaction and reply data of its own.  Only the reint
+ * operations clients batch are accepted.
+ *
+ * \param[in] tsi	target session environment of the batch
+ * \param[in] sub	request to handle
+ *
+ * \retval		0 if the request was handled
+ * \retval		negative value if it was rejected
+ */
+static int tgt_batch_subreq_handle(struct tgt_session_info *tsi,
+				   struct ptlrpc_request *sub)
+{
+	struct tgt_thread_info	*tti = tgt_th_info(tsi->tsi_env);
+	struct tgt_handler	*h;
+	__u32			*opcp;
+	__u32			 opc;
+	int			 rc;
+
+	ENTRY;
+
+	if (lustre_msg_get_opc(sub->rq_reqmsg) != MDS_REINT)
+		RETURN(-EPROTO);
+
+	opcp = lustre_msg_buf(sub->rq_reqmsg, REQ_REC_OFF, sizeof(*opcp));
+	if (opcp == NULL)
+		RETURN(-EPROTO);
+	opc = *opcp;
+	if (ptlrpc_req_need_swab(sub))
+		__swab32s(&opc);
+	if (opc != REINT_SETATTR && opc != REINT_CREATE && opc != REINT_UNLINK)
+		RETURN(-EPROTO);
+
+	rc = process_req_last_xid(sub);
+	if (rc)
+		RETURN(rc);
+
+	h = tgt_handler_find_check(sub);
+	if (IS_ERR(h))
+		RETURN(PTR_ERR(h));
+
+	rc = lustre_msg_check_version(sub->rq_reqmsg, h->th_version);
+	if (unlikely(rc)) {
+		DEBUG_REQ(D_ERROR, sub, "%s: drop mal-formed request, version"
+			  " %08x, expecting %08x\n", tgt_name(tsi->tsi_tgt),
+			  lustre_msg_get_version(sub->rq_reqmsg),
+			  h->th_version);
+		RETURN(-EINVAL);
+	}
+
+	req_capsule_init(&sub->rq_pill, sub, RCL_SERVER);
+	tsi->tsi_pill = &sub->rq_pill;
+	tsi->tsi_dlm_req = NULL;
+	tsi->tsi_mdt_body = NULL;
+	tsi->tsi_ost_body = NULL;
+	tsi->tsi_corpus = NULL;
+	tsi->tsi_vbr_obj = NULL;
+	tsi->tsi_opdata = 0;
+	tsi->tsi_preprocessed = false;
+	tsi->tsi_reply_fail_id = tsi->tsi_tgt->lut_reply_fail_id;
+	if (exp_connect_flags(sub->rq_export) & OBD_CONNECT_JOBSTATS)
+		tsi->tsi_jobid = lustre_msg_get_jobid(sub->rq_reqmsg);
+
+	/* last_rcvd is updated for each request of the batch */
+	tti->tti_has_trans = 0;
+	tti->tti_mult_trans = 0;
+
+	/* batches are refused during recovery, see
+	 * tgt_filter_recovery_request(), never queue a part of one */
+	if (unlikely(sub->rq_export->exp_obd->obd_recovering))
+		GOTO(out, rc = -EAGAIN);
+
+	rc = tgt_handle_recovery(sub, tsi->tsi_reply_fail_id);
+	if (likely(rc == 1))
+		rc = tgt_handle_request0(tsi, h, sub);
+	else if (rc == 0)
+		rc = -EAGAIN;
+	EXIT;
+out:
+	req_capsule_fini(tsi->tsi_pill);
+	if (tsi->tsi_corpus != NULL) {
+		lu_object_put(tsi->tsi_env, tsi->tsi_corpus);
+		tsi->tsi_corpus = NULL;
+	}
+	return rc;
+}
+
+/**
+ * Handle an MDS_REINT_BATCH RPC.
+ *
+ * The RPC carries several complete reint requests a client had ready at the
+ * same time.  They are handled one after another as if they were received
+ * alone, so each of them can be resent or replayed by itself, and their
+ * replies are packed one after another in the batch reply.  A request left
+ * without reply, because it was rejected or its reply does not fit, is sent
+ * again alone by the client; if it was executed, its reply is reconstructed
+ * then.
+ *
+ * \param[in] tsi	target session environment for this request
+ *
+ * \retval		0 on success
+ * \retval		negative value on error
+ */
+int tgt_batch(struct tgt_session_info *tsi)
+{
+	struct ptlrpc_request		*req = tgt_ses_req(tsi);
+	struct req_capsule		*pill = tsi->tsi_pill;
+	struct reint_batch_header	*rbh;
+	struct reint_batch_reply	*rbp;
+	char				*jobid = tsi->tsi_jobid;
+	char				*buf;
+	char				*rep;
+	int				 buflen;
+	int				 repsize;
+	int				 replen;
+	int				 i, rc;
+
+	ENTRY;
+
+	/* identity and integrity of GSS requests are bound to each RPC */
+	if (!exp_connect_reint_batch(tsi->tsi_exp) ||
+	    !tgt_is_multimodrpcs_client(tsi->tsi_exp) || req->rq_auth_gss)
+		RETURN(err_serious(-EOPNOTSUPP));
+
+	rbh = req_capsule_client_get(pill, &RMF_REINT_BATCH_HEADER);
+	if (rbh == NULL || rbh->rbh_magic != REINT_BATCH_MAGIC ||
+	    rbh->rbh_count == 0 || rbh->rbh_count > REINT_BATCH_MAX_REQS)
+		RETURN(err_serious(-EPROTO));
+
+	buf = req_capsule_client_get(pill, &RMF_REINT_BATCH_BUF);
+	if (buf == NULL)
+		RETURN(err_serious(-EPROTO));
+	buflen = req_capsule_get_size(pill, &RMF_REINT_BATCH_BUF, RCL_CLIENT);
+
+	repsize = min_t(int, rbh->rbh_reply_size, MDS_REINT_BATCH_MAXREPSIZE);
+	if (repsize < (int)sizeof(*rbp))
+		RETURN(err_serious(-EPROTO));
+
+	req_capsule_set_size(pill, &RMF_REINT_BATCH_REPLY, RCL_SERVER, repsize);
+	rc = req_capsule_server_pack(pill);
+	if (rc)
+		RETURN(err_serious(rc));
+
+	rbp = req_capsule_server_get(pill, &RMF_REINT_BATCH_REPLY);
+	rbp->rbp_magic = REINT_BATCH_REPLY_MAGIC;
+	rbp->rbp_count = 0;
+	rep = (char *)(rbp + 1);
+	replen = sizeof(*rbp);
+
+	for (i = 0; i < rbh->rbh_count; i++) {
+		struct reint_batch_request	*rbq;
+		struct reint_batch_result	*rbs;
+		struct ptlrpc_request		*sub;
+		int				 reqlen;
+		int				 size;
+
+		if (buflen < (int)sizeof(*rbq))
+			break;
+
+		rbq = (struct reint_batch_request *)buf;
+		if (ptlrpc_req_need_swab(req)) {
+			__swab64s(&rbq->rbq_xid);
+			__swab32s(&rbq->rbq_reqlen);
+		}
+		buf += sizeof(*rbq);
+		buflen -= sizeof(*rbq);
+
+		reqlen = rbq->rbq_reqlen;
+		if (reqlen <= 0 || cfs_size_round(reqlen) > buflen) {
+			DEBUG_REQ(D_ERROR, req, "bad batched request %d/%u",
+				  i, rbh->rbh_count);
+			break;
+		}
+
+		sub = ptlrpc_batch_subreq_alloc(req, (struct lustre_msg *)buf,
+						reqlen, rbq->rbq_xid);
+		buf += cfs_size_round(reqlen);
+		buflen -= cfs_size_round(reqlen);
+		if (IS_ERR(sub))
+			continue;
+
+		if (lustre_msg_get_flags(req->rq_reqmsg) & MSG_RESENT)
+			lustre_msg_add_flags(sub->rq_reqmsg, MSG_RESENT);
+
+		rc = tgt_batch_subreq_handle(tsi, sub);
+		size = sub->rq_repmsg != NULL ? sub->rq_replen : 0;
+		if (rc == 0 && size > 0 &&
+		    replen + sizeof(*rbs) + cfs_size_round(size) <= repsize) {
+			rbs = (struct reint_batch_result *)rep;
+			rbs->rbs_xid = sub->rq_xid;
+			rbs->rbs_replen = size;
+			rbs->rbs_padding = 0;
+			memcpy(rbs + 1, sub->rq_repmsg, size);
+			rep += sizeof(*rbs) + cfs_size_round(size);
+			replen += sizeof(*rbs) + cfs_size_round(size);
+			rbp->rbp_count++;
+		} else {
+			DEBUG_REQ(D_RPCTRACE, sub, "left out of batch reply: "
+				  "rc = %d, size = %d", rc, size);
+		}
+		ptlrpc_batch_subreq_free(sub);
+	}
+
+	tsi->tsi_pill = pill;
+	tsi->tsi_jobid = jobid;
+	tsi->tsi_reply_fail_id = OBD_FAIL_MDS_REINT_BATCH_NET_REP;
+	tsi->tsi_dlm_req = NULL;
+	tsi->tsi_mdt_body = NULL;
+	tsi->tsi_ost_body = NULL;
+	tsi->tsi_vbr_obj = NULL;
+	tsi->tsi_opdata = 0;
+
+	req_capsule_shrink(pill, &RMF_REINT_BATCH_REPLY, replen, RCL_SERVER);
+	RETURN(0);
+}
+EXPORT_SYMBOL(tgt_batch);
+
 /* Check if request can be reconstructed from saved reply data
  * A copy of the reply data is returned in @trd if the pointer is not NULL
  */
@@ -4606,6 +4606,56 @@ test_120() {
 }
 run_test 120 "DNE fail abort should stop both normal and DNE replay"
 
+# run createmany or unlinkmany from several processes with a single modify
+# RPC slot, so that the reints are sent in MDS_REINT_BATCH RPCs
+reint_batch_run_121() {
+	local op=$1
+	local pids=""
+	local pid
+	local i
+
+	for i in $(seq 8); do
+		${op}many -o $DIR/$tdir/f$i- 50 > /dev/null &
+		pids="$pids $!"
+	done
+	for pid in $pids; do
+		wait $pid || error "${op}many failed"
+	done
+}
+
+test_121() {
+	local mdc="mdc.$FSNAME-MDT0000-mdc-*"
+	local saved
+
+	$LCTL get_param -n $mdc.import | grep -q reint_batch ||
+		{ skip "MDT does not support reint_batch"; return 0; }
+
+	saved=$($LCTL get_param -n $mdc.max_mod_rpcs_in_flight)
+	$LCTL set_param $mdc.max_mod_rpcs_in_flight=1
+	stack_trap "$LCTL set_param $mdc.max_mod_rpcs_in_flight=$saved" EXIT
+	$LCTL set_param $mdc.stats=clear
+
+	test_mkdir -i 0 -c 1 $DIR/$tdir
+	replay_barrier $SINGLEMDS
+	reint_batch_run_121 create
+	$LCTL get_param $mdc.stats | grep mds_reint_batch ||
+		echo "no MDS_REINT_BATCH RPC was sent"
+	fail $SINGLEMDS
+
+	# each batched reint is replayed by itself
+	[ $(ls $DIR/$tdir | wc -l) -eq 400 ] ||
+		error "$(ls $DIR/$tdir | wc -l) files after replay, not 400"
+
+	replay_barrier $SINGLEMDS
+	reint_batch_run_121 unlink
+	fail $SINGLEMDS
+
+	[ $(ls $DIR/$tdir | wc -l) -eq 0 ] ||
+		error "files left after replay of unlinks"
+	rm -rf $DIR/$tdir
+}
+run_test 121 "replay of batched creates and unlinks"
+
 complete $SECONDS
 check_and_cleanup_lustre
 exit_status
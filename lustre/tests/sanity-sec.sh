@@ -2036,6 +2036,98 @@ test_30() {
 }
 run_test 30 "check for invalid shared key"
 
+# switch the crypt algorithm of the shared key on all nodes and reload it
+sk_set_crypt() {
+	local crypt=$1
+
+	do_nodes $(comma_list $(all_nodes)) \
+		"lgss_sk -m $SK_PATH/$FSNAME.key -c $crypt >/dev/null &&
+		 keyctl show | awk '/lustre/ { print \$1 }' |
+			xargs -IX keyctl unlink X &&
+		 lgss_sk -l $SK_PATH/$FSNAME.key >/dev/null" ||
+		error "cannot switch shared key to $crypt"
+	do_facet $SINGLEMDS lfs flushctx ||
+		error "could not run flushctx on $SINGLEMDS"
+	do_facet ost1 lfs flushctx || error "could not run flushctx on ost1"
+	lfs flushctx || error "could not run flushctx on client"
+}
+
+test_31() {
+	if ! $SHARED_KEY; then
+		skip "need shared key feature for this test" && return
+	fi
+	if [ $SK_FLAVOR != "skpi" ]; then
+		skip "test only valid if privacy is active"
+	fi
+	lgss_sk -h 2>&1 | grep -q AES-256-GCM ||
+		skip "AES-256-GCM is not supported by lgss_sk"
+
+	local tf=$DIR/$tdir/$tfile
+	local sum
+
+	mkdir -p $DIR/$tdir || error "mkdir failed"
+	dd if=/dev/urandom of=$TMP/$tfile bs=1M count=8 ||
+		error "cannot create reference file"
+	sum=$(md5sum < $TMP/$tfile)
+	stack_trap "rm -f $TMP/$tfile" EXIT
+
+	stack_trap "sk_set_crypt AES-256-CTR" EXIT
+	sk_set_crypt AES-256-GCM
+	lgss_sk -r $SK_PATH/$FSNAME.key | grep -q "AES-256-GCM" ||
+		error "shared key not switched to GCM"
+
+	# full and partial pages, buffered and direct
+	cp $TMP/$tfile $tf || error "buffered write failed"
+	dd if=$TMP/$tfile of=$tf.dio bs=1M oflag=direct ||
+		error "direct write failed"
+	dd if=$TMP/$tfile of=$tf.tail bs=1000 count=77 ||
+		error "partial page write failed"
+	cancel_lru_locks osc
+
+	[ "$(md5sum < $tf)" == "$sum" ] ||
+		error "buffered data corrupted in GCM mode"
+	[ "$(dd if=$tf.dio bs=1M iflag=direct 2>/dev/null | md5sum)" == \
+	  "$sum" ] || error "direct data corrupted in GCM mode"
+	cmp -n 77000 $TMP/$tfile $tf.tail ||
+		error "partial page data corrupted in GCM mode"
+}
+run_test 31 "check bulk data with an AES-256-GCM shared key"
+
+test_32() {
+	if ! $SHARED_KEY; then
+		skip "need shared key feature for this test" && return
+	fi
+	if [ $SK_FLAVOR != "skpi" ]; then
+		skip "test only valid if privacy is active"
+	fi
+
+	local param=sptlrpc.encrypt_page_pools
+	local nparts
+	local access
+
+	nparts=$($LCTL get_param -n $param |
+		 awk '/^partitions:/ { print $2 }')
+	[ -n "$nparts" ] || error "no partitions in $param"
+	[ $($LCTL get_param -n $param | grep -c "^partition [0-9]*:") == \
+	  $nparts ] || error "$param doesn't show $nparts partitions"
+
+	mkdir -p $DIR/$tdir || error "mkdir failed"
+	dd if=/dev/zero of=$DIR/$tdir/$tfile bs=1M count=16 oflag=direct ||
+		error "direct write failed"
+	$LCTL get_param $param
+
+	# bulk pages were taken from the pools, none beyond a partition's max
+	access=$($LCTL get_param -n $param |
+		 awk '/cache access:/ { sum += $3 } END { print sum }')
+	(( access > 0 )) || error "no page taken from the pools"
+	$LCTL get_param -n $param | awk '
+		/^partition/ { part = $2 }
+		/max pages:/ { max = $3 }
+		/total pages:/ { if ($3 > max) { print part, $3, max; bad++ } }
+		END { exit bad }' || error "a partition exceeds its max pages"
+}
+run_test 32 "check the per-partition encryption page pools"
+
 log "cleanup: ======================================================"
 
 sec_unsetup() {
@@ -8934,6 +8934,44 @@ test_123b () { # statahead(bug 15027)
 }
 run_test 123b "not panic with network error in statahead enqueue (bug 15027)"
 
+test_123c() { # statahead xattr prefetch
+	[ $PARALLEL == "yes" ] && skip "skip parallel run" && return
+	local save="$TMP/$TESTSUITE-$TESTNAME.parameters"
+	local nr=100
+	local before
+	local after
+
+	test_mkdir $DIR/$tdir
+	createmany -o $DIR/$tdir/$tfile- $nr || error "createmany failed"
+	for ((i = 0; i < nr; i++)); do
+		setfattr -n user.$tfile -v $i $DIR/$tdir/$tfile-$i ||
+			error "setfattr $DIR/$tdir/$tfile-$i failed"
+	done
+
+	save_lustre_params client "llite.*.xattr_cache" > $save
+	save_lustre_params client "llite.*.statahead_xattr" >> $save
+	$LCTL set_param llite.*.xattr_cache=1
+	$LCTL set_param llite.*.statahead_xattr=1
+	cancel_lru_locks mdc
+
+	before=$($LCTL get_param -n llite.*.statahead_stats |
+		 awk '/xattr prefetch/ { sum += $3 } END { print sum }')
+	ls -l $DIR/$tdir > /dev/null
+	for ((i = 0; i < nr; i++)); do
+		[ "$(getfattr --only-values -n user.$tfile \
+		     $DIR/$tdir/$tfile-$i)" == "$i" ] ||
+			error "wrong user.$tfile on $DIR/$tdir/$tfile-$i"
+	done
+	after=$($LCTL get_param -n llite.*.statahead_stats |
+		awk '/xattr prefetch/ { sum += $3 } END { print sum }')
+
+	restore_lustre_params < $save
+	rm -f $save
+	echo "xattr prefetched: $((after - before))"
+	[ $after -gt $before ] || error "no xattr prefetched by statahead"
+}
+run_test 123c "statahead prefetches xattrs into xattr cache"
+
 test_124a() {
 	[ $PARALLEL == "yes" ] && skip "skip parallel run" && return
 	$LCTL get_param -n mdc.*.connect_flags | grep -q lru_resize ||
@@ -9251,6 +9289,62 @@ test_127b() { # bug LU-333
 }
 run_test 127b "verify the llite client stats are sane"
 
+test_127c() {
+	local osc=$($LCTL get_param -N osc.*OST0000*-osc-[^mM]* | head -n1)
+	local rif=$($LCTL get_param -n $osc.max_rpcs_in_flight)
+	local ppr=$($LCTL get_param -n $osc.max_pages_per_rpc)
+	local stats=$osc.rpc_autotune_stats
+	local window
+	local cur
+	local inc
+	local dec
+
+	$LCTL get_param -n $osc.rpc_autotune > /dev/null 2>&1 ||
+		{ skip "no rpc_autotune support" && return; }
+
+	# start from a small RPC size and a window with room to shrink
+	$LCTL set_param $osc.max_pages_per_rpc=256 $osc.max_rpcs_in_flight=8
+	stack_trap "$LCTL set_param $osc.rpc_autotune=0 \
+		$osc.max_pages_per_rpc=$ppr $osc.max_rpcs_in_flight=$rif" EXIT
+	$LCTL set_param $osc.rpc_autotune=1 || error "enable rpc_autotune"
+	$LFS setstripe -i 0 -c 1 $DIR/$tfile || error "setstripe failed"
+
+	# plenty of pending pages on an idle path: the window grows
+	dd if=/dev/zero of=$DIR/$tfile bs=1M count=256 ||
+		error "dd failed"
+	sync
+	$LCTL get_param $stats
+	inc=$($LCTL get_param -n $stats | awk '/^increases:/ { print $2 }')
+	window=$(($($LCTL get_param -n $osc.max_rpcs_in_flight) *
+		  $($LCTL get_param -n $osc.max_pages_per_rpc)))
+	[ $inc -gt 0 ] || error "the window never grew"
+	[ $window -gt $((8 * 256)) ] ||
+		error "window of $window pages did not grow past $((8 * 256))"
+
+	# the OST holds each BRW for a second: RPCs queue up, it shrinks
+	#define OBD_FAIL_OST_BRW_PAUSE_BULK	0x214
+	do_facet ost1 $LCTL set_param fail_val=1 fail_loc=0x214
+	dd if=/dev/zero of=$DIR/$tfile bs=1M count=64 oflag=direct
+	do_facet ost1 $LCTL set_param fail_val=0 fail_loc=0
+	$LCTL get_param $stats
+	dec=$($LCTL get_param -n $stats | awk '/^decreases:/ { print $2 }')
+	cur=$(($($LCTL get_param -n $osc.max_rpcs_in_flight) *
+	       $($LCTL get_param -n $osc.max_pages_per_rpc)))
+	[ $dec -gt 0 ] || error "the window never shrank"
+	[ $cur -lt $window ] ||
+		error "window of $cur pages did not shrink below $window"
+
+	$LCTL set_param $osc.rpc_autotune=0 || error "disable rpc_autotune"
+	cur=$($LCTL get_param -n $osc.max_rpcs_in_flight)
+	[ $cur -eq 8 ] ||
+		error "max_rpcs_in_flight $cur not restored to 8"
+	cur=$($LCTL get_param -n $osc.max_pages_per_rpc)
+	[ $cur -eq 256 ] ||
+		error "max_pages_per_rpc $cur not restored to 256"
+	rm -f $DIR/$tfile
+}
+run_test 127c "adaptive RPC window grows, shrinks and restores tunables"
+
 test_128() { # bug 15212
 	touch $DIR/$tfile
 	$LFS 2>&1 <<-EOF | tee $TMP/$tfile.log
@@ -17046,6 +17140,420 @@ test_411() {
 }
 run_test 411 "Slab allocation error with cgroup does not LBUG"
 
+test_412() {
+	local osc="osc.*-OST0000-osc-[^M]*"
+
+	$LCTL get_param -n $osc.import | grep -q multiobj_brw ||
+		{ skip "OST does not support multiobj_brw"; return; }
+
+	local saved=$($LCTL get_param -n $osc.max_objs_per_rpc)
+
+	test_mkdir $DIR/$tdir
+	$LFS setstripe -i 0 -c 1 $DIR/$tdir || error "setstripe failed"
+	dd if=/dev/urandom of=$TMP/$tfile bs=4k count=1 ||
+		error "dd to $TMP/$tfile failed"
+
+	$LCTL set_param $osc.max_objs_per_rpc=16
+	stack_trap "$LCTL set_param $osc.max_objs_per_rpc=$saved" EXIT
+
+	# small writes to many objects, flushed together by a single sync
+	for i in $(seq 64); do
+		cp $TMP/$tfile $DIR/$tdir/f$i || error "cp to f$i failed"
+	done
+	sync
+	cancel_lru_locks osc
+
+	for i in $(seq 64); do
+		cmp $TMP/$tfile $DIR/$tdir/f$i || error "f$i is corrupted"
+	done
+	rm -f $TMP/$tfile
+}
+run_test 412 "multi-object write RPCs keep data of every object"
+
+# create or unlink files from several processes at once, with a single
+# modify RPC slot, so that the reints wait for the slot and are batched
+reint_batch_run() {
+	local op=$1
+	local dir=$2
+	local pids=""
+	local pid
+	local i
+
+	for i in $(seq 8); do
+		${op}many -o $dir/f$i- 50 > /dev/null &
+		pids="$pids $!"
+	done
+	for pid in $pids; do
+		wait $pid || error "${op}many in $dir failed"
+	done
+}
+
+reint_batch_prep() {
+	local mdc="mdc.$FSNAME-MDT0000-mdc-*"
+	local saved=$($LCTL get_param -n $mdc.max_mod_rpcs_in_flight)
+
+	$LCTL set_param $mdc.max_mod_rpcs_in_flight=1
+	stack_trap "$LCTL set_param $mdc.max_mod_rpcs_in_flight=$saved" EXIT
+	$LCTL set_param $mdc.stats=clear
+
+	test_mkdir -i 0 -c 1 $DIR/$tdir
+}
+
+reint_batch_count() {
+	$LCTL get_param -n mdc.$FSNAME-MDT0000-mdc-*.stats |
+		awk '/^mds_reint_batch/ { sum += $2 } END { print sum + 0 }'
+}
+
+test_413a() {
+	$LCTL get_param -n mdc.$FSNAME-MDT0000-mdc-*.import |
+		grep -q reint_batch ||
+		{ skip "MDT does not support reint_batch"; return; }
+
+	reint_batch_prep
+
+	reint_batch_run create $DIR/$tdir
+	[ $(reint_batch_count) -gt 0 ] || error "no MDS_REINT_BATCH RPC was sent"
+	[ $(ls $DIR/$tdir | wc -l) -eq 400 ] ||
+		error "$(ls $DIR/$tdir | wc -l) files created instead of 400"
+
+	reint_batch_run unlink $DIR/$tdir
+	[ $(ls $DIR/$tdir | wc -l) -eq 0 ] || error "files left after unlink"
+}
+run_test 413a "batched creates and unlinks"
+
+test_413b() {
+	$LCTL get_param -n mdc.$FSNAME-MDT0000-mdc-*.import |
+		grep -q reint_batch ||
+		{ skip "MDT does not support reint_batch"; return; }
+
+	reint_batch_prep
+
+	#define OBD_FAIL_MDS_REINT_BATCH_NET		0x15d
+	# the first batch is dropped before its reints are handled
+	do_facet mds1 $LCTL set_param fail_loc=0x8000015d
+	reint_batch_run create $DIR/$tdir
+	do_facet mds1 $LCTL set_param fail_loc=0
+	[ $(ls $DIR/$tdir | wc -l) -eq 400 ] ||
+		error "$(ls $DIR/$tdir | wc -l) files created instead of 400"
+	reint_batch_run unlink $DIR/$tdir
+
+	#define OBD_FAIL_MDS_REINT_BATCH_NET_REP	0x15e
+	# the reply of the first batch is lost, the reints are executed and
+	# their replies have to be reconstructed when they are resent
+	do_facet mds1 $LCTL set_param fail_loc=0x8000015e
+	reint_batch_run create $DIR/$tdir
+	do_facet mds1 $LCTL set_param fail_loc=0
+	[ $(ls $DIR/$tdir | wc -l) -eq 400 ] ||
+		error "$(ls $DIR/$tdir | wc -l) files created instead of 400"
+
+	do_facet mds1 $LCTL set_param fail_loc=0x8000015e
+	reint_batch_run unlink $DIR/$tdir
+	do_facet mds1 $LCTL set_param fail_loc=0
+	[ $(ls $DIR/$tdir | wc -l) -eq 0 ] || error "files left after unlink"
+}
+run_test 413b "resend and reconstruction of batched reints"
+
+test_414() {
+	local svcs="mds.MDS.mdt ost.OSS.ost ost.OSS.ost_io"
+	local nodes=$(comma_list $(mdts_nodes) $(osts_nodes))
+	local svc
+	local start
+	local elapsed
+	local pids=""
+	local pid
+	local i
+
+	for svc in $svcs; do
+		do_nodes $nodes "$LCTL get_param -n $svc.reply_batch" \
+			&> /dev/null ||
+			{ skip "servers do not support reply_batch"; return; }
+	done
+
+	# reply_batch is off by default, and reply_batch_usec is 50
+	for svc in $svcs; do
+		stack_trap "do_nodes $nodes $LCTL set_param \
+			$svc.reply_batch=0 $svc.reply_batch_usec=50" EXIT
+		do_nodes $nodes $LCTL set_param $svc.reply_batch=16 \
+			$svc.reply_batch_usec=1000 ||
+			error "failed to enable reply_batch on $svc"
+	done
+
+	test_mkdir $DIR/$tdir
+
+	# one RPC at a time: each reply must be sent although no request
+	# follows it, or every RPC waits for a resend
+	start=$SECONDS
+	createmany -o $DIR/$tdir/s- 200 || error "createmany failed"
+	dd if=/dev/zero of=$DIR/$tdir/s-0 bs=4k count=200 oflag=sync ||
+		error "dd failed"
+	unlinkmany $DIR/$tdir/s- 200 || error "unlinkmany failed"
+	elapsed=$((SECONDS - start))
+	echo "serial RPCs done in ${elapsed}s"
+	[ $elapsed -lt $((TIMEOUT / 2 + 10)) ] ||
+		error "serial RPCs took ${elapsed}s, replies are held back"
+
+	# many RPCs in flight, the replies are sent in batches
+	for i in $(seq 8); do
+		createmany -o $DIR/$tdir/p$i- 200 > /dev/null &
+		pids="$pids $!"
+		dd if=/dev/zero of=$DIR/$tdir/d$i bs=64k count=64 \
+			2> /dev/null &
+		pids="$pids $!"
+	done
+	for pid in $pids; do
+		wait $pid || error "parallel I/O failed"
+	done
+	sync
+
+	# MDT threads blocked in their handlers must not hold back the
+	# replies queued before: a create keeps the PDO lock of blk/ for 15s
+	# and a stat of blk/ waits for that lock in another thread
+	test_mkdir -i 0 -c 1 $DIR/$tdir/blk
+	test_mkdir -i 0 -c 1 $DIR/$tdir/free
+	#define OBD_FAIL_MDS_PDO_LOCK	0x145
+	do_facet mds1 $LCTL set_param fail_loc=0x80000145
+	touch $DIR/$tdir/blk/f &
+	pids=$!
+	sleep 1
+	stat $DIR/$tdir/blk > /dev/null &
+	pids="$pids $!"
+	sleep 1
+	start=$SECONDS
+	createmany -o $DIR/$tdir/free/f- 200 || error "createmany failed"
+	elapsed=$((SECONDS - start))
+	do_facet mds1 $LCTL set_param fail_loc=0
+	for pid in $pids; do
+		wait $pid || error "blocked create or stat failed"
+	done
+	echo "RPCs beside blocked ones done in ${elapsed}s"
+	[ $elapsed -lt 10 ] ||
+		error "RPCs took ${elapsed}s, replies wait for blocked threads"
+
+	for svc in $svcs; do
+		do_nodes $nodes "$LCTL get_param $svc.stats 2> /dev/null" |
+			grep rep_batch
+	done
+	rm -rf $DIR/$tdir
+}
+run_test 414 "replies batched by the services are all sent"
+
+# run parallel direct writes to ost1, leave in OST_IO_MOST the largest
+# number of ost_io threads seen meanwhile
+ost_io_threads_load() {
+	local param=ost.OSS.ost_io.threads_started
+	local started
+	local pids=""
+	local pid
+	local i
+
+	OST_IO_MOST=0
+	for i in $(seq 32); do
+		dd if=/dev/zero of=$DIR/$tdir/f$i bs=1M count=16 oflag=direct \
+			2> /dev/null &
+		pids="$pids $!"
+	done
+	while [ -n "$(jobs -rp)" ]; do
+		started=$(do_facet ost1 "$LCTL get_param -n $param")
+		((started > OST_IO_MOST)) && OST_IO_MOST=$started
+		sleep 0.5
+	done
+	for pid in $pids; do
+		wait $pid || error "write to $DIR/$tdir failed"
+	done
+	echo "at most $OST_IO_MOST ost_io threads"
+}
+
+# set up ost1 and a directory on it for the thread controller tests, the
+# idle threads exit after 2s and new ones start as soon as requests wait
+ost_io_threads_setup() {
+	local param=ost.OSS.ost_io
+	local idle
+	local grow
+	local cpu
+
+	do_facet ost1 "$LCTL get_param -n $param.threads_cpu_max" \
+		&> /dev/null || return 1
+
+	idle=$(do_facet ost1 "$LCTL get_param -n $param.threads_idle_timeout")
+	grow=$(do_facet ost1 "$LCTL get_param -n $param.threads_grow_wait_ms")
+	cpu=$(do_facet ost1 "$LCTL get_param -n $param.threads_cpu_max")
+	stack_trap "do_facet ost1 $LCTL set_param \
+		$param.threads_idle_timeout=$idle \
+		$param.threads_grow_wait_ms=$grow \
+		$param.threads_cpu_max=$cpu" EXIT
+	do_facet ost1 $LCTL set_param $param.threads_idle_timeout=2 \
+		$param.threads_grow_wait_ms=0 ||
+		error "cannot set up the ost_io thread controller"
+
+	OST_IO_MIN=$(do_facet ost1 "$LCTL get_param -n $param.threads_min")
+	stack_trap "$LCTL set_param \
+		$($LCTL get_param osc.$FSNAME-OST0000*.max_rpcs_in_flight)" EXIT
+	$LCTL set_param osc.$FSNAME-OST0000*.max_rpcs_in_flight=32
+
+	test_mkdir $DIR/$tdir
+	$LFS setstripe -i 0 -c 1 $DIR/$tdir || error "setstripe failed"
+}
+
+# the extra ost_io threads exit once idle
+ost_io_threads_wait_min() {
+	wait_update_facet ost1 \
+		"$LCTL get_param -n ost.OSS.ost_io.threads_started" \
+		$OST_IO_MIN 60 ||
+		error "ost_io threads did not drop back to $OST_IO_MIN"
+}
+
+test_415a() {
+	remote_ost_nodsh && skip "remote OST with nodsh" && return
+	ost_io_threads_setup ||
+		{ skip "server does not have the thread controller"; return; }
+
+	ost_io_threads_load
+	((OST_IO_MOST > OST_IO_MIN)) ||
+		error "no ost_io thread started beyond $OST_IO_MIN"
+	ost_io_threads_wait_min
+}
+run_test 415a "idle service threads exit down to threads_min"
+
+test_415b() {
+	remote_ost_nodsh && skip "remote OST with nodsh" && return
+	ost_io_threads_setup ||
+		{ skip "server does not have the thread controller"; return; }
+
+	# keep every CPU of the OSS busy
+	stack_trap "do_facet ost1 pkill -f sanity_415b_burn" EXIT
+	do_facet ost1 "for i in \$(seq \$(nproc)); do
+		nohup timeout 300 sh -c 'while :; do :; done' \
+			sanity_415b_burn > /dev/null 2>&1 &
+		done"
+	do_facet ost1 $LCTL set_param ost.OSS.ost_io.threads_cpu_max=50 ||
+		error "cannot set threads_cpu_max"
+
+	# the first CPU sample has no reference, let it be taken
+	ost_io_threads_load
+	ost_io_threads_wait_min
+	sleep 2
+
+	ost_io_threads_load
+	((OST_IO_MOST == OST_IO_MIN)) ||
+		error "$OST_IO_MOST ost_io threads started on saturated CPUs"
+}
+run_test 415b "threads_cpu_max stops service thread growth"
+
+# print the samples of phase $3 of opcode $2 in latency histograms $1
+latency_samples() {
+	echo "$1" | awk -v op="$2:" -v ph="$3:" '
+		/^[^ ]/ { o = ($1 == op); p = 0; next }
+		o && /^  [^ ]/ { p = ($1 == ph); next }
+		o && p && $1 == "samples:" { print $2; exit }'
+}
+
+test_416() {
+	remote_ost_nodsh && skip "remote OST with nodsh" && return
+
+	local cli_param="osc.$FSNAME-OST0000-osc-[^M]*.rpc_latency"
+	local srv_param="ost.OSS.ost_io.req_latency"
+	local hist
+	local phase
+	local key
+	local n
+
+	$LCTL get_param -n $cli_param &> /dev/null &&
+	do_facet ost1 "$LCTL get_param -n $srv_param" &> /dev/null ||
+		{ skip "no RPC latency histograms"; return; }
+
+	$LCTL set_param $cli_param=clear || error "cannot clear $cli_param"
+	do_facet ost1 "$LCTL set_param $srv_param=clear" ||
+		error "cannot clear $srv_param"
+
+	test_mkdir $DIR/$tdir
+	$LFS setstripe -i 0 -c 1 $DIR/$tdir || error "setstripe failed"
+	dd if=/dev/zero of=$DIR/$tdir/$tfile bs=1M count=4 oflag=direct ||
+		error "dd failed"
+
+	hist=$($LCTL get_param -n $cli_param)
+	echo "$hist"
+	echo "$hist" | grep -q "^snapshot_time: [0-9]*\.[0-9]*$" ||
+		error "no snapshot_time in $cli_param"
+	n=$(latency_samples "$hist" ost_write rtt)
+	((n >= 4)) || error "$n ost_write RTT samples in $cli_param, not 4"
+	for key in p50_usec p90_usec p99_usec usec; do
+		echo "$hist" | grep -q "^    $key: " ||
+			error "no $key in $cli_param"
+	done
+
+	hist=$(do_facet ost1 "$LCTL get_param -n $srv_param")
+	echo "$hist"
+	for phase in req_in queued handle reply; do
+		n=$(latency_samples "$hist" ost_write $phase)
+		((n >= 4)) ||
+			error "$n ost_write $phase samples in $srv_param, not 4"
+	done
+
+	# any write clears the histograms
+	$LCTL set_param $cli_param=clear || error "cannot clear $cli_param"
+	do_facet ost1 "$LCTL set_param $srv_param=clear" ||
+		error "cannot clear $srv_param"
+	[ -z "$(latency_samples "$($LCTL get_param -n $cli_param)" \
+		ost_write rtt)" ] || error "$cli_param not cleared"
+	[ -z "$(latency_samples "$(do_facet ost1 \
+		"$LCTL get_param -n $srv_param")" ost_write req_in)" ] ||
+		error "$srv_param not cleared"
+	rm -rf $DIR/$tdir
+}
+run_test 416 "RPC latency histograms count RPCs and are cleared"
+
+test_417() {
+	remote_ost_nodsh && skip "remote OST with nodsh" && return
+
+	local param=ost.OSS.ost
+	local hp
+	local min
+	local new_min
+	local ncpts
+	local n
+	local i
+
+	hp=$(do_facet ost1 "$LCTL get_param -n $param.threads_hp_reserved" \
+		2> /dev/null) || { skip "no threads_hp_reserved"; return; }
+	min=$(do_facet ost1 "$LCTL get_param -n $param.threads_min")
+	stack_trap "do_facet ost1 $LCTL set_param $param.threads_min=$min" EXIT
+	stack_trap "do_facet ost1 $LCTL set_param \
+		$param.threads_hp_reserved=$hp" EXIT
+
+	# the reserved threads of each partition come on top of threads_min,
+	# which cannot go below them and the 2 threads for normal requests
+	do_facet ost1 $LCTL set_param $param.threads_hp_reserved=$((hp + 2)) ||
+		error "cannot reserve $((hp + 2)) threads"
+	new_min=$(do_facet ost1 "$LCTL get_param -n $param.threads_min")
+	ncpts=$(((new_min - min) / 2))
+	(( ncpts > 0 && new_min == min + 2 * ncpts )) ||
+		error "threads_min $new_min after 2 more reserved, was $min"
+	do_facet ost1 $LCTL set_param \
+		$param.threads_min=$(((hp + 3) * ncpts)) &&
+		error "threads_min set below the reserved threads"
+
+	# glimpses are high priority requests of the OST service
+	test_mkdir $DIR/$tdir
+	$LFS setstripe -i 0 -c 1 $DIR/$tdir || error "setstripe failed"
+	dd if=/dev/zero of=$DIR/$tdir/$tfile bs=1M count=1 || error "dd failed"
+	do_facet ost1 "$LCTL set_param $param.stats=clear"
+	for i in $(seq 20); do
+		cancel_lru_locks osc
+		stat -c %s $DIR/$tdir/$tfile > /dev/null || error "stat failed"
+	done
+	n=$(do_facet ost1 "$LCTL get_param -n $param.stats" |
+		awk '$1 == "req_hp_waittime" { print $2 }')
+	echo "$n high priority requests"
+	(( ${n:-0} >= 20 )) || error "${n:-0} req_hp_waittime samples, not 20"
+
+	do_facet ost1 $LCTL set_param $param.threads_hp_reserved=$hp ||
+		error "cannot restore threads_hp_reserved"
+	n=$(do_facet ost1 "$LCTL get_param -n $param.threads_min")
+	[ $n -eq $min ] || error "threads_min $n after restore, was $min"
+	rm -rf $DIR/$tdir
+}
+run_test 417 "threads reserved for glimpses and req_hp_waittime"
+
 prep_801() {
 	[[ $(lustre_version_code mds1) -lt $(version_code 2.9.55) ]] ||
 	[[ $(lustre_version_code ost1) -lt $(version_code 2.9.55) ]] &&
@@ -3570,6 +3570,145 @@ test_77l() {
 }
 run_test 77l "check NRS Delay slows write RPC processing"
 
+tbf_bw_verify() {
+	local dir=$DIR/$tdir
+	local np=$(check_cpt_number ost1)
+
+	[ $np -gt 0 ] || error "CPU partitions should not be $np."
+
+	echo "Verify the write bandwidth is under $1 MB/s per partition"
+	local start=$SECONDS
+	dd if=/dev/zero of=$dir/tbf_bw bs=4M count=25 oflag=direct ||
+		error "dd to $dir/tbf_bw failed"
+	local runtime=$((SECONDS - start + 1))
+	local bw=$(bc <<< "scale=6; 100 / $runtime")
+	echo "Write runtime is $runtime s, bandwidth is $bw MB/s"
+
+	[ $(bc <<< "$bw < 1.1 * $np * $1") -eq 1 ] ||
+		error "The bandwidth ($bw) exceeds 110% of limit ($1 * $np)"
+	rm -f $dir/tbf_bw
+}
+
+test_77m() {
+	local nodes=$(comma_list $(osts_nodes))
+	local dir=$DIR/$tdir
+
+	do_nodes $nodes lctl set_param ost.OSS.ost_io.nrs_policies="tbf\ opcode"
+	[ $? -ne 0 ] && error "failed to set TBF OPCode policy"
+	stack_trap "do_nodes $nodes lctl set_param \
+		ost.OSS.ost_io.nrs_policies=fifo; sleep 3" EXIT
+
+	# a rule limits either RPC/s or MB/s
+	do_facet ost1 lctl set_param \
+		ost.OSS.ost_io.nrs_tbf_rule="start\ bw_w\ opcode={ost_write}\ rate=10\ bw=10" &&
+		error "rule with both rate and bw should be rejected"
+
+	do_nodes $nodes lctl set_param \
+		ost.OSS.ost_io.nrs_tbf_rule="start\ bw_w\ opcode={ost_write}\ bw=10"
+	[ $? -ne 0 ] && error "failed to start TBF bandwidth rule"
+	do_facet ost1 lctl get_param -n ost.OSS.ost_io.nrs_tbf_rule |
+		grep -q "bw_w {ost_write} 10MB/s" ||
+		error "bandwidth rule is not listed in MB/s"
+
+	mkdir $dir || error "mkdir $dir failed"
+	$LFS setstripe -c 1 -i 0 $dir || error "setstripe to $dir failed"
+	tbf_bw_verify 10
+
+	# the clients keep the tokens they owe when the limit changes
+	do_nodes $nodes lctl set_param \
+		ost.OSS.ost_io.nrs_tbf_rule="change\ bw_w\ bw=20"
+	[ $? -ne 0 ] && error "failed to change TBF bandwidth rule"
+	tbf_bw_verify 20
+
+	do_nodes $nodes lctl set_param \
+		ost.OSS.ost_io.nrs_tbf_rule="stop\ bw_w"
+	rm -rf $dir
+}
+run_test 77m "check TBF bandwidth rules"
+
+test_77n() {
+	local nodes=$(comma_list $(osts_nodes))
+	local dir=$DIR/$tdir
+	local weights
+	local uid
+	local ost
+
+	do_nodes $nodes lctl set_param ost.OSS.ost_io.nrs_policies="wfs\ uid"
+	[ $? -ne 0 ] && error "failed to set WFS uid policy"
+	stack_trap "do_nodes $nodes lctl set_param \
+		ost.OSS.ost_io.nrs_policies=fifo" EXIT
+
+	do_nodes $nodes lctl set_param \
+		ost.OSS.ost_io.nrs_wfs_weights="500=4\ 1000=2\ 2000=3" ||
+		error "failed to set WFS weights"
+
+	# removing a weight moves the last one in its place
+	do_nodes $nodes lctl set_param ost.OSS.ost_io.nrs_wfs_weights="500=1" ||
+		error "failed to reset weight of uid 500"
+	weights=$(do_facet ost1 lctl get_param -n \
+		  ost.OSS.ost_io.nrs_wfs_weights | awk '/weights:/ { print; exit }')
+	echo "$weights"
+	[[ "$weights" =~ " 500=" ]] && error "uid 500 still has a weight"
+	[[ "$weights" =~ " 1000=2" && "$weights" =~ " 2000=3" ]] ||
+		error "weights of uids 1000 and 2000 were lost"
+
+	nrs_write_read
+	nrs_write_read "$RUNAS"
+
+	# each request comes with a new ID, the classes must be freed
+	mkdir $dir || error "mkdir $dir failed"
+	$LFS setstripe -c $OSTCOUNT $dir || error "setstripe to $dir failed"
+	chmod 777 $dir
+	for ((uid = 60000; uid < 60200; uid++)); do
+		runas -u $uid -g $uid dd if=/dev/zero of=$dir/f_$uid bs=4k \
+			count=1 oflag=sync 2>/dev/null ||
+			error "dd as uid $uid failed"
+	done
+	rm -rf $dir || error "rm -rf $dir failed"
+
+	for ((ost = 1; ost <= OSTCOUNT; ost++)); do
+		wait_update_facet ost$ost "lctl get_param -n \
+			ost.OSS.ost_io.nrs_wfs_weights |
+			sed -n 's/.*classes: //p' | sort -nr | head -1" 0 20 ||
+			error "WFS classes of idle IDs were not freed on ost$ost"
+	done
+}
+run_test 77n "check WFS policy weights and classes"
+
+test_77o() {
+	local nodes=$(comma_list $(osts_nodes))
+
+	# only an "orr" stage may follow TBF
+	do_facet ost1 lctl set_param \
+		ost.OSS.ost_io.nrs_policies="tbf\ opcode\>crrn" &&
+		error "TBF should not accept a crrn stage"
+
+	do_nodes $nodes lctl set_param \
+		ost.OSS.ost_io.nrs_policies="tbf\ opcode\>orr"
+	[ $? -ne 0 ] && error "failed to set TBF OPCode policy with orr stage"
+	stack_trap "do_nodes $nodes lctl set_param \
+		ost.OSS.ost_io.nrs_policies=fifo; sleep 3" EXIT
+	do_facet ost1 lctl get_param -n ost.OSS.ost_io.nrs_policies |
+		grep -A 2 "name: tbf" | grep -q "state: started" ||
+		error "TBF policy with orr stage is not started"
+
+	# the elevator must not lose or reorder the data of the I/O
+	nrs_write_read
+
+	do_nodes $nodes lctl set_param \
+		ost.OSS.ost_io.nrs_tbf_rule="start\ ost_r\ opcode={ost_read}\ rate=5" \
+		ost.OSS.ost_io.nrs_tbf_rule="start\ ost_w\ opcode={ost_write}\ rate=20"
+	[ $? -ne 0 ] && error "failed to start TBF rules"
+
+	# the staged requests are still charged by TBF
+	tbf_verify 20 5
+
+	do_nodes $nodes lctl set_param \
+		ost.OSS.ost_io.nrs_tbf_rule="stop\ ost_r" \
+		ost.OSS.ost_io.nrs_tbf_rule="stop\ ost_w"
+}
+run_test 77o "check TBF policy with an orr elevator stage"
+
 test_78() { #LU-6673
 	local server_version=$(lustre_version_code ost1)
 	[[ $server_version -ge $(version_code 2.7.58) ]] ||
@@ -59,12 +59,14 @@
 char *sk_crypt2name[] = {
 	[SK_CRYPT_EMPTY] = "NONE",
 	[SK_CRYPT_AES256_CTR] = "AES-256-CTR",
+	[SK_CRYPT_AES256_GCM] = "AES-256-GCM",
 };
 
 char *sk_hmac2name[] = {
 	[SK_HMAC_EMPTY] = "NONE",
 	[SK_HMAC_SHA256] = "SHA256",
 	[SK_HMAC_SHA512] = "SHA512",
+	[SK_HMAC_SHA256_GMAC] = "SHA256-GMAC",
 };
 
 static int sk_name2crypt(char *name)
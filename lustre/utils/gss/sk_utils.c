@@ -50,6 +50,10 @@ static struct sk_crypt_type sk_crypt_types[] = {
 		.sct_name = "ctr(aes)",
 		.sct_bytes = 32,
 	},
+	[SK_CRYPT_AES256_GCM] = {
+		.sct_name = "gcm(aes)",
+		.sct_bytes = 32,
+	},
 };
 
 static struct sk_hmac_type sk_hmac_types[] = {
@@ -61,6 +65,10 @@ static struct sk_hmac_type sk_hmac_types[] = {
 		.sht_name = "hmac(sha512)",
 		.sht_bytes = 64,
 	},
+	[SK_HMAC_SHA256_GMAC] = {
+		.sht_name = "hmac(sha256)",
+		.sht_bytes = 32,
+	},
 };
 
 #ifdef _NEW_BUILD_
@@ -785,6 +793,7 @@ static inline const EVP_MD *sk_hash_to_evp_md(enum sk_hmac_alg alg)
 {
 	switch (alg) {
 	case SK_HMAC_SHA256:
+	case SK_HMAC_SHA256_GMAC:
 		return EVP_sha256();
 	case SK_HMAC_SHA512:
 		return EVP_sha512();
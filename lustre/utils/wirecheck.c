@@ -595,6 +595,8 @@ check_obd_connect_data(void)
 	CHECK_DEFINE_64X(OBD_CONNECT_FLAGS2);
 	CHECK_DEFINE_64X(OBD_CONNECT2_FILE_SECCTX);
 	CHECK_DEFINE_64X(OBD_CONNECT2_LOCKAHEAD);
+	CHECK_DEFINE_64X(OBD_CONNECT2_MULTIOBJ_BRW);
+	CHECK_DEFINE_64X(OBD_CONNECT2_REINT_BATCH);
 
 	CHECK_VALUE_X(OBD_CKSUM_CRC32);
 	CHECK_VALUE_X(OBD_CKSUM_ADLER);
@@ -2333,6 +2335,42 @@ static void check_out_update_buffer(void)
 	CHECK_MEMBER(out_update_buffer, oub_padding);
 }
 
+static void check_reint_batch_header(void)
+{
+	BLANK_LINE();
+	CHECK_STRUCT(reint_batch_header);
+	CHECK_MEMBER(reint_batch_header, rbh_magic);
+	CHECK_MEMBER(reint_batch_header, rbh_count);
+	CHECK_MEMBER(reint_batch_header, rbh_reply_size);
+	CHECK_MEMBER(reint_batch_header, rbh_padding);
+}
+
+static void check_reint_batch_request(void)
+{
+	BLANK_LINE();
+	CHECK_STRUCT(reint_batch_request);
+	CHECK_MEMBER(reint_batch_request, rbq_xid);
+	CHECK_MEMBER(reint_batch_request, rbq_reqlen);
+	CHECK_MEMBER(reint_batch_request, rbq_padding);
+}
+
+static void check_reint_batch_reply(void)
+{
+	BLANK_LINE();
+	CHECK_STRUCT(reint_batch_reply);
+	CHECK_MEMBER(reint_batch_reply, rbp_magic);
+	CHECK_MEMBER(reint_batch_reply, rbp_count);
+}
+
+static void check_reint_batch_result(void)
+{
+	BLANK_LINE();
+	CHECK_STRUCT(reint_batch_result);
+	CHECK_MEMBER(reint_batch_result, rbs_xid);
+	CHECK_MEMBER(reint_batch_result, rbs_replen);
+	CHECK_MEMBER(reint_batch_result, rbs_padding);
+}
+
 static void check_nodemap_cluster_rec(void)
 {
 	BLANK_LINE();
@@ -2571,6 +2609,9 @@ main(int argc, char **argv)
 	CHECK_VALUE(MDS_HSM_CT_REGISTER);
 	CHECK_VALUE(MDS_HSM_CT_UNREGISTER);
 	CHECK_VALUE(MDS_SWAP_LAYOUTS);
+	CHECK_VALUE(MDS_RMFID);
+	CHECK_VALUE(MDS_BATCH);
+	CHECK_VALUE(MDS_REINT_BATCH);
 	CHECK_VALUE(MDS_LAST_OPC);
 
 	CHECK_VALUE(REINT_SETATTR);
@@ -2836,6 +2877,10 @@ main(int argc, char **argv)
 	check_object_update_reply();
 	check_out_update_header();
 	check_out_update_buffer();
+	check_reint_batch_header();
+	check_reint_batch_request();
+	check_reint_batch_reply();
+	check_reint_batch_result();
 
 	check_nodemap_cluster_rec();
 	check_nodemap_range_rec();
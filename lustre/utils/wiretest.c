@@ -195,7 +195,13 @@ void lustre_assert_wire_constants(void)
 		 (long long)MDS_HSM_CT_UNREGISTER);
 	LASSERTF(MDS_SWAP_LAYOUTS == 61, "found %lld\n",
 		 (long long)MDS_SWAP_LAYOUTS);
-	LASSERTF(MDS_LAST_OPC == 62, "found %lld\n",
+	LASSERTF(MDS_RMFID == 62, "found %lld\n",
+		 (long long)MDS_RMFID);
+	LASSERTF(MDS_BATCH == 63, "found %lld\n",
+		 (long long)MDS_BATCH);
+	LASSERTF(MDS_REINT_BATCH == 64, "found %lld\n",
+		 (long long)MDS_REINT_BATCH);
+	LASSERTF(MDS_LAST_OPC == 65, "found %lld\n",
 		 (long long)MDS_LAST_OPC);
 	LASSERTF(REINT_SETATTR == 1, "found %lld\n",
 		 (long long)REINT_SETATTR);
@@ -1333,6 +1339,10 @@ void lustre_assert_wire_constants(void)
 		 OBD_CONNECT2_FILE_SECCTX);
 	LASSERTF(OBD_CONNECT2_LOCKAHEAD == 0x2ULL, "found 0x%.16llxULL\n",
 		 OBD_CONNECT2_LOCKAHEAD);
+	LASSERTF(OBD_CONNECT2_MULTIOBJ_BRW == 0x1000000000000ULL, "found 0x%.16llxULL\n",
+		 OBD_CONNECT2_MULTIOBJ_BRW);
+	LASSERTF(OBD_CONNECT2_REINT_BATCH == 0x2000000000000ULL, "found 0x%.16llxULL\n",
+		 OBD_CONNECT2_REINT_BATCH);
 	LASSERTF(OBD_CKSUM_CRC32 == 0x00000001UL, "found 0x%.8xUL\n",
 		(unsigned)OBD_CKSUM_CRC32);
 	LASSERTF(OBD_CKSUM_ADLER == 0x00000002UL, "found 0x%.8xUL\n",
@@ -5107,6 +5117,70 @@ void lustre_assert_wire_constants(void)
 	LASSERTF((int)sizeof(((struct out_update_buffer *)0)->oub_padding) == 4, "found %lld\n",
 		 (long long)(int)sizeof(((struct out_update_buffer *)0)->oub_padding));
 
+	/* Checks for struct reint_batch_header */
+	LASSERTF((int)sizeof(struct reint_batch_header) == 16, "found %lld\n",
+		 (long long)(int)sizeof(struct reint_batch_header));
+	LASSERTF((int)offsetof(struct reint_batch_header, rbh_magic) == 0, "found %lld\n",
+		 (long long)(int)offsetof(struct reint_batch_header, rbh_magic));
+	LASSERTF((int)sizeof(((struct reint_batch_header *)0)->rbh_magic) == 4, "found %lld\n",
+		 (long long)(int)sizeof(((struct reint_batch_header *)0)->rbh_magic));
+	LASSERTF((int)offsetof(struct reint_batch_header, rbh_count) == 4, "found %lld\n",
+		 (long long)(int)offsetof(struct reint_batch_header, rbh_count));
+	LASSERTF((int)sizeof(((struct reint_batch_header *)0)->rbh_count) == 4, "found %lld\n",
+		 (long long)(int)sizeof(((struct reint_batch_header *)0)->rbh_count));
+	LASSERTF((int)offsetof(struct reint_batch_header, rbh_reply_size) == 8, "found %lld\n",
+		 (long long)(int)offsetof(struct reint_batch_header, rbh_reply_size));
+	LASSERTF((int)sizeof(((struct reint_batch_header *)0)->rbh_reply_size) == 4, "found %lld\n",
+		 (long long)(int)sizeof(((struct reint_batch_header *)0)->rbh_reply_size));
+	LASSERTF((int)offsetof(struct reint_batch_header, rbh_padding) == 12, "found %lld\n",
+		 (long long)(int)offsetof(struct reint_batch_header, rbh_padding));
+	LASSERTF((int)sizeof(((struct reint_batch_header *)0)->rbh_padding) == 4, "found %lld\n",
+		 (long long)(int)sizeof(((struct reint_batch_header *)0)->rbh_padding));
+
+	/* Checks for struct reint_batch_request */
+	LASSERTF((int)sizeof(struct reint_batch_request) == 16, "found %lld\n",
+		 (long long)(int)sizeof(struct reint_batch_request));
+	LASSERTF((int)offsetof(struct reint_batch_request, rbq_xid) == 0, "found %lld\n",
+		 (long long)(int)offsetof(struct reint_batch_request, rbq_xid));
+	LASSERTF((int)sizeof(((struct reint_batch_request *)0)->rbq_xid) == 8, "found %lld\n",
+		 (long long)(int)sizeof(((struct reint_batch_request *)0)->rbq_xid));
+	LASSERTF((int)offsetof(struct reint_batch_request, rbq_reqlen) == 8, "found %lld\n",
+		 (long long)(int)offsetof(struct reint_batch_request, rbq_reqlen));
+	LASSERTF((int)sizeof(((struct reint_batch_request *)0)->rbq_reqlen) == 4, "found %lld\n",
+		 (long long)(int)sizeof(((struct reint_batch_request *)0)->rbq_reqlen));
+	LASSERTF((int)offsetof(struct reint_batch_request, rbq_padding) == 12, "found %lld\n",
+		 (long long)(int)offsetof(struct reint_batch_request, rbq_padding));
+	LASSERTF((int)sizeof(((struct reint_batch_request *)0)->rbq_padding) == 4, "found %lld\n",
+		 (long long)(int)sizeof(((struct reint_batch_request *)0)->rbq_padding));
+
+	/* Checks for struct reint_batch_reply */
+	LASSERTF((int)sizeof(struct reint_batch_reply) == 8, "found %lld\n",
+		 (long long)(int)sizeof(struct reint_batch_reply));
+	LASSERTF((int)offsetof(struct reint_batch_reply, rbp_magic) == 0, "found %lld\n",
+		 (long long)(int)offsetof(struct reint_batch_reply, rbp_magic));
+	LASSERTF((int)sizeof(((struct reint_batch_reply *)0)->rbp_magic) == 4, "found %lld\n",
+		 (long long)(int)sizeof(((struct reint_batch_reply *)0)->rbp_magic));
+	LASSERTF((int)offsetof(struct reint_batch_reply, rbp_count) == 4, "found %lld\n",
+		 (long long)(int)offsetof(struct reint_batch_reply, rbp_count));
+	LASSERTF((int)sizeof(((struct reint_batch_reply *)0)->rbp_count) == 4, "found %lld\n",
+		 (long long)(int)sizeof(((struct reint_batch_reply *)0)->rbp_count));
+
+	/* Checks for struct reint_batch_result */
+	LASSERTF((int)sizeof(struct reint_batch_result) == 16, "found %lld\n",
+		 (long long)(int)sizeof(struct reint_batch_result));
+	LASSERTF((int)offsetof(struct reint_batch_result, rbs_xid) == 0, "found %lld\n",
+		 (long long)(int)offsetof(struct reint_batch_result, rbs_xid));
+	LASSERTF((int)sizeof(((struct reint_batch_result *)0)->rbs_xid) == 8, "found %lld\n",
+		 (long long)(int)sizeof(((struct reint_batch_result *)0)->rbs_xid));
+	LASSERTF((int)offsetof(struct reint_batch_result, rbs_replen) == 8, "found %lld\n",
+		 (long long)(int)offsetof(struct reint_batch_result, rbs_replen));
+	LASSERTF((int)sizeof(((struct reint_batch_result *)0)->rbs_replen) == 4, "found %lld\n",
+		 (long long)(int)sizeof(((struct reint_batch_result *)0)->rbs_replen));
+	LASSERTF((int)offsetof(struct reint_batch_result, rbs_padding) == 12, "found %lld\n",
+		 (long long)(int)offsetof(struct reint_batch_result, rbs_padding));
+	LASSERTF((int)sizeof(((struct reint_batch_result *)0)->rbs_padding) == 4, "found %lld\n",
+		 (long long)(int)sizeof(((struct reint_batch_result *)0)->rbs_padding));
+
 	/* Checks for struct nodemap_cluster_rec */
 	LASSERTF((int)sizeof(struct nodemap_cluster_rec) == 32, "found %lld\n",
 		 (long long)(int)sizeof(struct nodemap_cluster_rec));